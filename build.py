@@ -1,5 +1,5 @@
 # Typheus engine build script.
-# TODO(caio): PROFILE builds
+# Usage: build.py -d|-r [--full] [--tools] [--bench] [--profile] [--avx2]
 
 import sys
 import subprocess
@@ -78,6 +78,47 @@ def build_engine(output_dir, build_type, cc_flags):
     end = time.time()
     print(f'Finished building typheus in {end - start} seconds')
 
+def build_tools(output_dir, build_type, cc_flags):
+    tools = ['packer']
+    for tool in tools:
+        build_command = f'clang {cc_flags}'
+        if build_type == 'd':
+            build_command += f' --debug -O0'
+            build_command += f' -DTY_DEBUG=1'
+        elif build_type == 'r':
+            build_command += f' -Ofast'
+            build_command += f' -DTY_NDEBUG=1'
+        build_command += f' -include ./src/stdafx.hpp'
+        build_command += f' ./src/tools/{tool}.cpp'
+        build_command += f' -fms-runtime-lib=dll'
+        build_command += f' --output={output_dir}/{tool}.exe'
+
+        print(f'Starting {tool} build...')
+        start = time.time()
+        subprocess.run(build_command, shell=True)
+        end = time.time()
+        print(f'Finished building {tool} in {end - start} seconds')
+
+def build_bench(output_dir, build_type, cc_flags):
+    # Benchmarks are meant to be run from release builds, debug builds only check they work.
+    build_command = f'clang {cc_flags}'
+    if build_type == 'd':
+        build_command += f' --debug -O0'
+        build_command += f' -DTY_DEBUG=1'
+    elif build_type == 'r':
+        build_command += f' -Ofast'
+        build_command += f' -DTY_NDEBUG=1'
+    build_command += f' -include ./src/stdafx.hpp'
+    build_command += f' ./src/bench/bench.cpp'
+    build_command += f' -fms-runtime-lib=dll'
+    build_command += f' --output={output_dir}/bench.exe'
+
+    print(f'Starting bench build...')
+    start = time.time()
+    subprocess.run(build_command, shell=True)
+    end = time.time()
+    print(f'Finished building bench in {end - start} seconds')
+
 # Build type
 build_type = ''
 output_dir = ''
@@ -96,6 +137,11 @@ f = open('compile_flags.txt')
 cc_flags = ' '.join(f.read().splitlines())
 f.close()
 
+if '--profile' in sys.argv:
+    cc_flags += ' -D_PROFILE=1'     # Enables core/profile instrumentation
+if '--avx2' in sys.argv:
+    cc_flags += ' -mavx2 -mfma -mf16c'  # Wider core/simd kernels, needs a full build to match the PCH
+
 if '--full' in sys.argv:
     print('full build')
     build_pch(output_dir, cc_flags, False)
@@ -103,4 +149,8 @@ if '--full' in sys.argv:
     build_engine_dependencies(output_dir, cc_flags)
 
 build_engine(output_dir, build_type, cc_flags)
+if '--tools' in sys.argv:
+    build_tools(output_dir, build_type, cc_flags)
+if '--bench' in sys.argv:
+    build_bench(output_dir, build_type, cc_flags)
 clean(output_dir)
@@ -36,6 +36,7 @@ namespace asset
 #define ASSET_MAX_MATERIALS 1024
 #define ASSET_MAX_MODELS 256
 #define ASSET_MAX_ASSETS 2048
+#define ASSET_MAX_DEPENDENCIES 8192
 
 Context* MakeAssetContext(u64 arenaSize, u64 tempArenaSize)
 {
@@ -45,11 +46,14 @@ Context* MakeAssetContext(u64 arenaSize, u64 tempArenaSize)
     *ctx = {};
     ctx->arena = arena;
     ctx->tempArena = tempArena;
+    metrics::TrackArena("asset.arena_used", arena);
 
     ctx->loadedAssets = MakeMap<String, handle>(ctx->arena, ASSET_MAX_ASSETS);
     ctx->shaders = MakeSArray<Shader>(ctx->arena, ASSET_MAX_SHADERS);
     ctx->images = MakeSArray<Image>(ctx->arena, ASSET_MAX_IMAGES);
     ctx->modelsGLTF = MakeSArray<GltfModel>(ctx->arena, ASSET_MAX_MODELS);
+    ctx->dependencies = MakeSArray<AssetDependency>(ctx->arena, ASSET_MAX_DEPENDENCIES);
+    ctx->reloadQueue = MakeSArray<AssetRef>(ctx->arena, ASSET_MAX_ASSETS);
 
     return ctx;
 }
@@ -60,15 +64,45 @@ bool IsLoaded(Context* ctx, String assetPath)
     return ctx->loadedAssets.HasKey(assetPath);
 }
 
+void AddAssetDependency(Context* ctx, String filePath, AssetType type, handle hAsset)
+{
+    MEM_ARENA_CHECKPOINT_SET(ctx->tempArena, dependency);
+    String path = file::PathCanonical(ctx->tempArena, filePath);
+    for(u64 i = 0; i < ctx->dependencies.count; i++)
+    {
+        AssetDependency& dependency = ctx->dependencies[i];
+        if(dependency.asset.type == type && dependency.asset.hAsset == hAsset && dependency.path == path)
+        {
+            MEM_ARENA_CHECKPOINT_RESET(ctx->tempArena, dependency);
+            return;
+        }
+    }
+    MEM_ARENA_CHECKPOINT_RESET(ctx->tempArena, dependency);
+
+    AssetDependency dependency = {};
+    dependency.path = file::PathCanonical(ctx->arena, filePath);
+    dependency.asset.type = type;
+    dependency.asset.hAsset = hAsset;
+    ctx->dependencies.Push(dependency);
+}
+
+struct ShaderIncludeContext
+{
+    Context* ctx = NULL;
+    handle hShader = HANDLE_INVALID;
+};
+
 shaderc_include_result* ResolveShaderInclude(void* userData, const char* requested, i32 requestType,
         const char* requesting, size_t includeDepth)
 {
     ASSERT(requestType == shaderc_include_type_relative);
-    mem::Arena* tempArena = (mem::Arena*)userData;
+    ShaderIncludeContext* includeCtx = (ShaderIncludeContext*)userData;
+    mem::Arena* tempArena = includeCtx->ctx->tempArena;
 
     String assetDir = file::PathFileDir(requesting);
     String assetName = StrConcat(tempArena, assetDir, requested);
     String assetStr = file::ReadFileToString(tempArena, assetName);
+    AddAssetDependency(includeCtx->ctx, assetName, ASSET_TYPE_SHADER, includeCtx->hShader);
 
     shaderc_include_result result = {};
     result.source_name = assetName.CStr();
@@ -87,14 +121,10 @@ void ReleaseShaderInclude(void* userData, shaderc_include_result* result)
     // Empty
 }
 
-handle LoadShader(Context* ctx, String assetPath)
+bool CompileShader(Context* ctx, String assetPath, handle hShader, Shader* out)
 {
-    if(IsLoaded(ctx, assetPath))
-    {
-        return ctx->loadedAssets[assetPath];
-    }
-
     //mem::ArenaClear(ctx->tempArena);
+    AddAssetDependency(ctx, assetPath, ASSET_TYPE_SHADER, hShader);
     String shaderStr = file::ReadFileToString(ctx->tempArena, assetPath);
     String shaderExt = file::PathExt(assetPath);
     ShaderType type;
@@ -124,7 +154,10 @@ handle LoadShader(Context* ctx, String assetPath)
 #else
     shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
 #endif
-    shaderc_compile_options_set_include_callbacks(options, ResolveShaderInclude, ReleaseShaderInclude, ctx->tempArena);
+    ShaderIncludeContext includeCtx = {};
+    includeCtx.ctx = ctx;
+    includeCtx.hShader = hShader;
+    shaderc_compile_options_set_include_callbacks(options, ResolveShaderInclude, ReleaseShaderInclude, &includeCtx);
     shaderc_compilation_result_t compiled = shaderc_compile_into_spv(
             compiler,
             (char*)shaderStr.data,
@@ -137,7 +170,10 @@ handle LoadShader(Context* ctx, String assetPath)
     if(errorCount != 0)
     {
         LOGLF("SHADER COMPILE", "%s", shaderc_result_get_error_message(compiled));
-        ASSERT(0);
+        shaderc_result_release(compiled);
+        shaderc_compile_options_release(options);
+        shaderc_compiler_release(compiler);
+        return false;
     }
 
     u64 compiledLen = shaderc_result_get_length(compiled);
@@ -149,23 +185,34 @@ handle LoadShader(Context* ctx, String assetPath)
     shaderc_compile_options_release(options);
     shaderc_compiler_release(compiler);
 
+    out->type = type;
+    out->size = compiledLen;
+    out->data = resultData;
+    return true;
+}
+
+handle LoadShader(Context* ctx, String assetPath)
+{
+    if(IsLoaded(ctx, assetPath))
+    {
+        METRIC_ADD("asset.cache_hits", 1);
+        return ctx->loadedAssets[assetPath];
+    }
+
     Shader shader = {};
-    shader.type = type;
-    shader.size = compiledLen;
-    shader.data = resultData;
+    bool ret = CompileShader(ctx, assetPath, ctx->shaders.count, &shader);
+    ASSERT(ret);
     shader.path = Str(ctx->arena, assetPath);
     
     handle result = ctx->shaders.Push(shader);
     ctx->loadedAssets.Insert(assetPath, result);
+    METRIC_ADD("asset.loaded", 1);
     return result;
 }
 
-handle LoadImageFile(Context* ctx, String assetPath, bool flipVertical)
+bool DecodeImageFile(Context* ctx, String assetPath, bool flipVertical, handle hImage, Image* out)
 {
-    if(IsLoaded(ctx, assetPath))
-    {
-        return ctx->loadedAssets[assetPath];
-    }
+    AddAssetDependency(ctx, assetPath, ASSET_TYPE_IMAGE, hImage);
 
     //TODO(caio): This assetFileData memory is not used after parsed into an image asset.
     // Maybe deal with that waste later.
@@ -173,22 +220,138 @@ handle LoadImageFile(Context* ctx, String assetPath, bool flipVertical)
     //mem::ArenaClear(ctx->tempArena);
     byte* assetFileData = file::ReadFileToBuffer(ctx->tempArena, assetPath, &assetFileSize);
 
-    Image image = {};
-    image.path = Str(ctx->arena, assetPath);
-
     i32 width, height, channels;
     stbiArena = ctx->arena;
     stbi_set_flip_vertically_on_load(flipVertical);
     byte* data = stbi_load_from_memory(assetFileData, assetFileSize, &width, &height, &channels, STBI_rgb_alpha);     // Hardcoded 4 channels for now
     
-    image.width = width;
-    image.height = height;
-    //image.channels = channels;
-    image.channels = 4;
-    image.data = data;
+    out->width = width;
+    out->height = height;
+    //out->channels = channels;
+    out->channels = 4;
+    out->data = data;
+    out->flipVertical = flipVertical;
+    return data != NULL;
+}
+
+handle LoadImageFile(Context* ctx, String assetPath, bool flipVertical)
+{
+    if(IsLoaded(ctx, assetPath))
+    {
+        METRIC_ADD("asset.cache_hits", 1);
+        return ctx->loadedAssets[assetPath];
+    }
+
+    Image image = {};
+    DecodeImageFile(ctx, assetPath, flipVertical, ctx->images.count, &image);
+    image.path = Str(ctx->arena, assetPath);
 
     handle result = ctx->images.Push(image);
     ctx->loadedAssets.Insert(assetPath, result);
+    METRIC_ADD("asset.loaded", 1);
+    return result;
+}
+
+// ========================================================
+// [HOT RELOAD]
+void LoadModelGLTF_Parse(Context* ctx, String assetPath, handle hModel, GltfModel* out);   // gltf.cpp
+
+bool WatchAssetDir(Context* ctx, String dirPath)
+{
+    ASSERT(ctx);
+    if(!ctx->watcher) ctx->watcher = watch::MakeWatcher();
+    return watch::AddWatchDir(ctx->watcher, dirPath, true);
+}
+
+bool QueueAssetReload(Context* ctx, AssetRef asset)
+{
+    for(u64 i = 0; i < ctx->reloadQueue.count; i++)
+    {
+        if(ctx->reloadQueue[i].type == asset.type && ctx->reloadQueue[i].hAsset == asset.hAsset) return false;
+    }
+    ctx->reloadQueue.Push(asset);
+    return true;
+}
+
+u32 PollAssetChanges(Context* ctx)
+{
+    ASSERT(ctx);
+    if(!ctx->watcher) return 0;
+
+    u32 result = 0;
+    MEM_ARENA_CHECKPOINT_SET(ctx->tempArena, poll);
+    SArray<String> changes = watch::PollChanges(ctx->watcher, ctx->tempArena);
+    for(u64 i = 0; i < changes.count; i++)
+    {
+        for(u64 j = 0; j < ctx->dependencies.count; j++)
+        {
+            AssetDependency& dependency = ctx->dependencies[j];
+            if(dependency.path == changes[i] && QueueAssetReload(ctx, dependency.asset)) result++;
+        }
+    }
+    MEM_ARENA_CHECKPOINT_RESET(ctx->tempArena, poll);
+    return result;
+}
+
+bool ReloadAsset(Context* ctx, AssetRef asset)
+{
+    switch(asset.type)
+    {
+        case ASSET_TYPE_SHADER:
+        {
+            Shader& shader = ctx->shaders[asset.hAsset];
+            if(!file::PathExists(shader.path)) return false;
+            Shader reloaded = {};
+            if(!CompileShader(ctx, shader.path, asset.hAsset, &reloaded)) return false;
+            reloaded.path = shader.path;
+            shader = reloaded;
+            return true;
+        } break;
+        case ASSET_TYPE_IMAGE:
+        {
+            Image& image = ctx->images[asset.hAsset];
+            if(!file::PathExists(image.path)) return false;
+            Image reloaded = {};
+            if(!DecodeImageFile(ctx, image.path, image.flipVertical, asset.hAsset, &reloaded)) return false;
+            reloaded.path = image.path;
+            image = reloaded;
+            return true;
+        } break;
+        case ASSET_TYPE_MODEL_GLTF:
+        {
+            GltfModel& model = ctx->modelsGLTF[asset.hAsset];
+            if(!file::PathExists(model.path)) return false;
+            GltfModel reloaded = {};
+            LoadModelGLTF_Parse(ctx, model.path, asset.hAsset, &reloaded);
+            reloaded.path = model.path;
+            model = reloaded;
+            return true;
+        } break;
+        default: ASSERT(0);
+    }
+    return false;
+}
+
+SArray<AssetRef> ReloadQueuedAssets(Context* ctx, mem::Arena* arena)
+{
+    ASSERT(ctx);
+    SArray<AssetRef> result = {};
+    if(ctx->reloadQueue.count == 0) return result;
+
+    result = MakeSArray<AssetRef>(arena, ctx->reloadQueue.count);
+    for(u64 i = 0; i < ctx->reloadQueue.count; i++)
+    {
+        AssetRef asset = ctx->reloadQueue[i];
+        if(ReloadAsset(ctx, asset))
+        {
+            result.Push(asset);
+        }
+        else
+        {
+            LOGLF("ASSET", "Failed to reload asset (type %u, handle %u), keeping previous version.", asset.type, asset.hAsset);
+        }
+    }
+    ctx->reloadQueue.Clear();
     return result;
 }
 
@@ -10,6 +10,9 @@
 #include "../core/file.hpp"
 #include "../core/math.hpp"
 #include "../core/ds.hpp"
+#include "../core/watch.hpp"
+#include "../core/metrics.hpp"
+#include "../core/raycast.hpp"
 
 namespace ty
 {
@@ -47,6 +50,7 @@ struct Image : Asset
     u32 height = 0;
     u32 channels = 0;
     byte* data = NULL;
+    bool flipVertical = true;
 };
 
 // ========================================================
@@ -135,7 +139,7 @@ struct GltfMesh
 struct GltfNode
 {
     SArray<handle> hChildren;
-    m4f mTransform = math::Identity();
+    affine3x4 mTransform = math::IdentityAffine();
     handle hMesh = HANDLE_INVALID;
 };
 
@@ -158,6 +162,27 @@ struct GltfModel : Asset
     SArray<f32> vTexCoords2 = {};
 };
 
+// ========================================================
+// [HOT RELOAD]
+enum AssetType
+{
+    ASSET_TYPE_SHADER,
+    ASSET_TYPE_IMAGE,
+    ASSET_TYPE_MODEL_GLTF,
+};
+
+struct AssetRef
+{
+    AssetType type;
+    handle hAsset = HANDLE_INVALID;
+};
+
+struct AssetDependency
+{
+    String path;        // Canonical path of a file the asset was built from.
+    AssetRef asset;
+};
+
 // ========================================================
 // [ASSET LISTS]
 
@@ -175,6 +200,11 @@ struct Context
     SArray<Shader> shaders;
     SArray<Image> images;
     SArray<GltfModel> modelsGLTF;
+
+    // Hot reload
+    watch::Watcher* watcher;
+    SArray<AssetDependency> dependencies;
+    SArray<AssetRef> reloadQueue;
 };
 
 Context* MakeAssetContext(u64 arenaSize, u64 tempArenaSize);
@@ -183,5 +213,35 @@ handle  LoadShader(Context* ctx, String assetPath);
 handle  LoadImageFile(Context* ctx, String assetPath, bool flipVertical = true);
 handle  LoadModelGLTF(Context* ctx, String assetPath);
 
+// Hot reload. Poll once per frame: changed files are mapped back to every loaded asset built
+// from them (including shader #include files), and only those assets are queued for reload.
+// Reloaded assets keep their handles. Returned refs are the assets that reloaded successfully,
+// so the renderer can rebuild any GPU resources created from them.
+// NOTE: Previous asset data is not freed, the asset arena grows with every reload.
+bool    WatchAssetDir(Context* ctx, String dirPath);
+u32     PollAssetChanges(Context* ctx);     // Returns # of assets queued for reload.
+SArray<AssetRef> ReloadQueuedAssets(Context* ctx, mem::Arena* arena);
+
+// ========================================================
+// [RAYCAST]
+// Raycast scene over a model's triangles in model space, with one raycast mesh per primitive
+// of every mesh node in the hierarchy. A hit's mesh indexes primitives, its triangle's vertex
+// indices start at rangeIndices.start + 3 * triangle in the model indices.
+// NOTE: Rebuild it when the model reloads, it copies the vertex positions.
+struct GltfPrimitiveRef
+{
+    handle hNode = HANDLE_INVALID;
+    handle hMesh = HANDLE_INVALID;
+    u32 primitive = 0;
+};
+
+struct GltfRaycastScene
+{
+    raycast::Scene scene;
+    SArray<GltfPrimitiveRef> primitives;
+};
+
+GltfRaycastScene MakeRaycastSceneGLTF(mem::Arena* arena, Context* ctx, handle hModel, bvh::BuildDesc desc = {});
+
 };
 };
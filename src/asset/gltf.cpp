@@ -13,7 +13,7 @@ namespace ty
 namespace asset
 {
 
-void LoadModelGLTF_LoadBuffers(Context* ctx, JsonObject* gltfJson, String assetPath, byte** out)
+void LoadModelGLTF_LoadBuffers(Context* ctx, JsonObject* gltfJson, String assetPath, handle hModel, byte** out)
 {
     JsonArray& buffersJson = *gltfJson->GetArrayValue("buffers");
     ASSERT(buffersJson.count <= TY_GLTF_MAX_BUFFERS);
@@ -24,6 +24,7 @@ void LoadModelGLTF_LoadBuffers(Context* ctx, JsonObject* gltfJson, String assetP
                 file::PathFileDir(assetPath), 
                 bufferJson->GetStringValue("uri"));
         out[i] = file::ReadFileToBuffer(ctx->tempArena, bufferPath);
+        AddAssetDependency(ctx, bufferPath, ASSET_TYPE_MODEL_GLTF, hModel);
     }
 }
 
@@ -413,20 +414,9 @@ SArray<GltfMesh> LoadModelGLTF_LoadMeshes(Context* ctx, JsonObject* gltfJson, Ra
                 // POSITION attribute require min and max properties for AABB.
                 // Simple implementation: iterate on primitive vertices and find them manually instead
                 // of using GLTF provided values.
-                v3f pMin = {MAX_F32, MAX_F32, MAX_F32};
-                v3f pMax = {0,0,0};
-                for(i64 iPos = rangePos.start; iPos < rangePos.start + rangePos.len; iPos += 3)
-                {
-                    v3f vPos = { vPositions[iPos], vPositions[iPos + 1], vPositions[iPos + 2] };
-                    pMin.x = MIN(pMin.x, vPos.x);
-                    pMin.y = MIN(pMin.y, vPos.y);
-                    pMin.z = MIN(pMin.z, vPos.z);
-                    pMax.x = MAX(pMax.x, vPos.x);
-                    pMax.y = MAX(pMax.y, vPos.y);
-                    pMax.z = MAX(pMax.z, vPos.z);
-                }
-                mesh.primitives[j].min = pMin;
-                mesh.primitives[j].max = pMax;
+                math::AABB bounds = math::GetAABB(vPositions.data + rangePos.start, rangePos.len / 3);
+                mesh.primitives[j].min = bounds.min;
+                mesh.primitives[j].max = bounds.max;
             }
             if(attributesJson->GetNumberValue("NORMAL", &attributeAccessorIndex))
             {
@@ -510,36 +500,39 @@ SArray<GltfNode> LoadModelGLTF_LoadNodes(Context* ctx, JsonObject* gltfJson)
             nodeTransform.m13 = matrixJson[13].AsNumber();
             nodeTransform.m23 = matrixJson[14].AsNumber();
             nodeTransform.m33 = matrixJson[15].AsNumber();
+            node.mTransform = math::ToAffine(nodeTransform);
         }
         else
         {
-            m4f translation = math::Identity();
-            m4f rotation = math::Identity();
-            m4f scale = math::Identity();
+            math::trs nodeTRS = {};
 
             JsonArray transformPropertyJson;
             if(nodeJson->GetArrayValue("translation", &transformPropertyJson))
             {
-                translation = math::TranslationMatrix({
+                nodeTRS.translation = {
                         (f32)transformPropertyJson[0].AsNumber(),
                         (f32)transformPropertyJson[1].AsNumber(),
-                        (f32)transformPropertyJson[2].AsNumber()});
+                        (f32)transformPropertyJson[2].AsNumber()};
             }
             if(nodeJson->GetArrayValue("rotation", &transformPropertyJson))
             {
-                ASSERT(0);  // TODO(caio): To add support for rotation in GLTF I need support for quaternions in core math first.
+                // (x, y, z, w), w being the scalar part as in math::quat.
+                nodeTRS.rotation = {
+                        (f32)transformPropertyJson[0].AsNumber(),
+                        (f32)transformPropertyJson[1].AsNumber(),
+                        (f32)transformPropertyJson[2].AsNumber(),
+                        (f32)transformPropertyJson[3].AsNumber()};
             }
             if(nodeJson->GetArrayValue("scale", &transformPropertyJson))
             {
-                scale = math::ScaleMatrix({
+                nodeTRS.scale = {
                         (f32)transformPropertyJson[0].AsNumber(),
                         (f32)transformPropertyJson[1].AsNumber(),
-                        (f32)transformPropertyJson[2].AsNumber()});
+                        (f32)transformPropertyJson[2].AsNumber()};
             }
 
-            nodeTransform = translation * rotation * scale;
+            node.mTransform = math::ToAffine(nodeTRS);
         }
-        node.mTransform = nodeTransform;
 
         JsonArray childrenList;
         if(nodeJson->GetArrayValue("children", &childrenList))
@@ -575,23 +568,20 @@ handle LoadModelGLTF_LoadSceneRoot(Context* ctx, JsonObject* gltfJson, SArray<Gl
     return gltfNodes.count - 1; // Index pointing to root node
 }
 
-handle LoadModelGLTF(Context* ctx, String assetPath)
+void LoadModelGLTF_Parse(Context* ctx, String assetPath, handle hModel, GltfModel* out)
 {
-    if(IsLoaded(ctx, assetPath))
-    {
-        return ctx->loadedAssets[assetPath];
-    }
     mem::ArenaClear(ctx->tempArena);
 
     // Load GLTF Json
+    AddAssetDependency(ctx, assetPath, ASSET_TYPE_MODEL_GLTF, hModel);
     JsonObject* gltfJson = MakeJsonFromFile(ctx->tempArena, assetPath);
 
-    GltfModel model = {};
+    GltfModel& model = *out;
 
     // Create and populate temporary buffers
     byte* buffers[TY_GLTF_MAX_BUFFERS];
     memset(buffers, NULL, TY_GLTF_MAX_BUFFERS * sizeof(byte*));
-    LoadModelGLTF_LoadBuffers(ctx, gltfJson, assetPath, buffers);
+    LoadModelGLTF_LoadBuffers(ctx, gltfJson, assetPath, hModel, buffers);
 
     // Load GLTF textures and materials
     model.textures = LoadModelGLTF_LoadTextures(ctx, gltfJson, assetPath);
@@ -615,10 +605,83 @@ handle LoadModelGLTF(Context* ctx, String assetPath)
     // Load mesh nodes and scene hierarchy
     model.nodes = LoadModelGLTF_LoadNodes(ctx, gltfJson);
     model.hRootNode = LoadModelGLTF_LoadSceneRoot(ctx, gltfJson, model.nodes);
+}
+
+handle LoadModelGLTF(Context* ctx, String assetPath)
+{
+    if(IsLoaded(ctx, assetPath))
+    {
+        METRIC_ADD("asset.cache_hits", 1);
+        return ctx->loadedAssets[assetPath];
+    }
 
+    GltfModel model = {};
+    LoadModelGLTF_Parse(ctx, assetPath, ctx->modelsGLTF.count, &model);
     model.path = Str(ctx->arena, assetPath);
     handle result = ctx->modelsGLTF.Push(model);
     ctx->loadedAssets.Insert(assetPath, result);
+    METRIC_ADD("asset.loaded", 1);
+    return result;
+}
+
+// Counts primitive instances under hNode when meshes is NULL.
+u32 MakeRaycastSceneGLTF_CollectPrimitives(GltfModel& model, handle hNode, const affine3x4& parentTransform,
+        SArray<raycast::Mesh>* meshes, SArray<GltfPrimitiveRef>* primitives)
+{
+    GltfNode& node = model.nodes[hNode];
+    affine3x4 transform = parentTransform * node.mTransform;
+    u32 result = 0;
+    if(node.hMesh != HANDLE_INVALID)
+    {
+        GltfMesh& mesh = model.meshes[node.hMesh];
+        for(i32 i = 0; i < mesh.primitives.count; i++)
+        {
+            GltfPrimitive& primitive = mesh.primitives[i];
+            if(primitive.rangePositions.start < 0) continue;
+            result++;
+            if(!meshes) continue;
+
+            raycast::Mesh raycastMesh = {};
+            raycastMesh.positions = model.vPositions.data + primitive.rangePositions.start;
+            raycastMesh.vertexCount = (u32)(primitive.rangePositions.len / 3);
+            if(primitive.rangeIndices.start >= 0)
+            {
+                raycastMesh.indices = model.indices.data + primitive.rangeIndices.start;
+                raycastMesh.triangleCount = (u32)(primitive.rangeIndices.len / 3);
+            }
+            else
+            {
+                raycastMesh.triangleCount = raycastMesh.vertexCount / 3;
+            }
+            raycastMesh.transform = math::ToMatrix(transform);
+            meshes->Push(raycastMesh);
+
+            GltfPrimitiveRef ref = {};
+            ref.hNode = hNode;
+            ref.hMesh = node.hMesh;
+            ref.primitive = i;
+            primitives->Push(ref);
+        }
+    }
+    for(i32 i = 0; i < node.hChildren.count; i++)
+    {
+        result += MakeRaycastSceneGLTF_CollectPrimitives(model, node.hChildren[i], transform, meshes, primitives);
+    }
+    return result;
+}
+
+GltfRaycastScene MakeRaycastSceneGLTF(mem::Arena* arena, Context* ctx, handle hModel, bvh::BuildDesc desc)
+{
+    GltfModel& model = ctx->modelsGLTF[hModel];
+    GltfRaycastScene result = {};
+    u32 primitiveCount = MakeRaycastSceneGLTF_CollectPrimitives(model, model.hRootNode, math::IdentityAffine(), NULL, NULL);
+
+    u64 tempArenaOffset = ctx->tempArena->offset;
+    SArray<raycast::Mesh> meshes = MakeSArray<raycast::Mesh>(ctx->tempArena, MAX(primitiveCount, 1));
+    result.primitives = MakeSArray<GltfPrimitiveRef>(arena, MAX(primitiveCount, 1));
+    MakeRaycastSceneGLTF_CollectPrimitives(model, model.hRootNode, math::IdentityAffine(), &meshes, &result.primitives);
+    result.scene = raycast::Build(arena, meshes.data, (u32)meshes.count, desc);
+    mem::ArenaFallback(ctx->tempArena, tempArenaOffset);
     return result;
 }
 
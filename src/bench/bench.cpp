@@ -0,0 +1,463 @@
+// ========================================================
+// BENCH
+// Benchmark runner executable.
+// Usage: bench [--filter <substr>] [--out <json>] [--baseline <json>] [--threshold <pct>]
+//              [--samples <n>] [--min-ms <ms>] [--cpu <index>] [--list] [--check]
+// @Caio Guedes, 2023
+// ========================================================
+
+// ===============================================================
+// [HEADER FILES]
+#include "../core/base.hpp"
+#include "../core/debug.hpp"
+#include "../core/memory.hpp"
+#include "../core/string.hpp"
+#include "../core/simd.hpp"
+#include "../core/math.hpp"
+#include "../core/approx.hpp"
+#include "../core/quantize.hpp"
+#include "../core/time.hpp"
+#include "../core/async.hpp"
+#include "../core/cull.hpp"
+#include "../core/occlusion.hpp"
+#include "../core/cluster.hpp"
+#include "../core/shadow.hpp"
+#include "../core/compress.hpp"
+#include "../core/file.hpp"
+#include "../core/ds.hpp"
+#include "../core/bvh.hpp"
+#include "../core/raycast.hpp"
+#include "../core/spatial.hpp"
+#include "../core/stats.hpp"
+#include "../core/pack.hpp"
+#include "../core/profile.hpp"
+#include "../core/metrics.hpp"
+#include "../asset/json.hpp"
+#include "./bench.hpp"
+
+// ===============================================================
+// [SOURCE FILES]
+#include "../core/debug.cpp"
+#include "../core/memory.cpp"
+#include "../core/string.cpp"
+#include "../core/math.cpp"
+#include "../core/approx.cpp"
+#include "../core/quantize.cpp"
+#include "../core/time.cpp"
+#include "../core/async.cpp"
+#include "../core/cull.cpp"
+#include "../core/occlusion.cpp"
+#include "../core/cluster.cpp"
+#include "../core/shadow.cpp"
+#include "../core/compress.cpp"
+#include "../core/file.cpp"
+#include "../core/bvh.cpp"
+#include "../core/raycast.cpp"
+#include "../core/spatial.cpp"
+#include "../core/stats.cpp"
+#include "../core/pack.cpp"
+#include "../core/profile.cpp"
+#include "../core/metrics.cpp"
+#include "../asset/json.cpp"
+
+// ===============================================================
+// [SUITES]
+#include "./bench_core.cpp"
+#include "./bench_math.cpp"
+#include "./bench_asset.cpp"
+
+namespace ty
+{
+namespace bench
+{
+
+#define BENCH_MAX_SAMPLES 256
+#define BENCH_MAX_ITERATIONS (1ULL << 32)
+
+#define BENCH_MAX_PRINTED_FAILURES 8
+
+static Benchmark* benchmarkList = NULL;
+static Check* checkList = NULL;
+
+Registrar::Registrar(Benchmark* benchmark, const char* name, BenchProc proc)
+{
+    benchmark->name = name;
+    benchmark->proc = proc;
+    benchmark->next = benchmarkList;
+    benchmarkList = benchmark;
+}
+
+u64 BeginLoop(State* state)
+{
+    ClobberMemory();
+    state->startTimestamp = time::GetTimestamp();
+    return 0;
+}
+
+CheckRegistrar::CheckRegistrar(Check* check, const char* name, CheckProc proc)
+{
+    check->name = name;
+    check->proc = proc;
+    check->next = checkList;
+    checkList = check;
+}
+
+void ExpectFailed(CheckState* state, const char* file, i32 line, const char* fmt, ...)
+{
+    state->failures++;
+    if(state->failures > BENCH_MAX_PRINTED_FAILURES) return;
+    printf("  %s(%d): ", file, line);
+    va_list args;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+    printf("\n");
+}
+
+bool EndLoop(State* state)
+{
+    state->endTimestamp = time::GetTimestamp();
+    ClobberMemory();
+    return false;
+}
+
+void PauseTiming(State* state)
+{
+    ClobberMemory();
+    state->pauseTimestamp = time::GetTimestamp();
+}
+
+void ResumeTiming(State* state)
+{
+    state->pausedTicks += time::GetTimestamp() - state->pauseTimestamp;
+    ClobberMemory();
+}
+
+struct RunDesc
+{
+    u32 samples = 15;
+    u32 minSampleMs = 20;
+};
+
+struct Result
+{
+    const char* name = NULL;
+    u64 iterations = 0;
+    u32 samples = 0;
+    f64 medianNs = 0;
+    f64 madNs = 0;
+    f64 minNs = 0;
+    f64 meanNs = 0;
+    f64 bytesPerSec = 0;
+    f64 itemsPerSec = 0;
+};
+
+// Runs a benchmark once and returns elapsed timestamp ticks.
+u64 RunSample(Benchmark* benchmark, State* state, u64 iterations)
+{
+    state->iterations = iterations;
+    state->startTimestamp = 0;
+    state->endTimestamp = 0;
+    state->pausedTicks = 0;
+    benchmark->proc(state);
+    ASSERTF(state->endTimestamp, "Benchmark %s has no BENCH_LOOP.", benchmark->name);
+    return state->endTimestamp - state->startTimestamp - state->pausedTicks;
+}
+
+i32 CompareF64(const void* a, const void* b)
+{
+    f64 fa = *(f64*)a;
+    f64 fb = *(f64*)b;
+    return fa < fb ? -1 : (fa > fb ? 1 : 0);
+}
+
+f64 GetMedian(f64* sorted, u32 count)
+{
+    if(count % 2) return sorted[count / 2];
+    return (sorted[count / 2 - 1] + sorted[count / 2]) * 0.5;
+}
+
+Result RunBenchmark(Benchmark* benchmark, RunDesc desc)
+{
+    State state = {};
+    u64 minTicks = time::GetTimestampFrequency() * desc.minSampleMs / 1000;
+
+    // Scale iterations until a sample takes at least the minimum time. The scaling runs
+    // double as warmup (caches, branch predictors, page faults on first touch).
+    u64 iterations = 1;
+    while(true)
+    {
+        u64 ticks = RunSample(benchmark, &state, iterations);
+        if(ticks >= minTicks || iterations >= BENCH_MAX_ITERATIONS) break;
+        u64 next = ticks < minTicks / 10 ? iterations * 10 : (u64)((f64)iterations * (f64)minTicks / (f64)MAX(ticks, 1) * 1.2) + 1;
+        iterations = MIN(MAX(next, iterations + 1), BENCH_MAX_ITERATIONS);
+    }
+    RunSample(benchmark, &state, iterations);
+
+    f64 samples[BENCH_MAX_SAMPLES];
+    u32 sampleCount = MIN(MAX(desc.samples, 1), BENCH_MAX_SAMPLES);
+    f64 sum = 0;
+    for(u32 i = 0; i < sampleCount; i++)
+    {
+        u64 ticks = RunSample(benchmark, &state, iterations);
+        samples[i] = (f64)time::TimestampToNSec(ticks) / (f64)iterations;
+        sum += samples[i];
+    }
+    qsort(samples, sampleCount, sizeof(f64), CompareF64);
+
+    Result result = {};
+    result.name = benchmark->name;
+    result.iterations = iterations;
+    result.samples = sampleCount;
+    result.medianNs = GetMedian(samples, sampleCount);
+    result.minNs = samples[0];
+    result.meanNs = sum / sampleCount;
+    f64 deviations[BENCH_MAX_SAMPLES];
+    for(u32 i = 0; i < sampleCount; i++)
+    {
+        deviations[i] = ABS(samples[i] - result.medianNs);
+    }
+    qsort(deviations, sampleCount, sizeof(f64), CompareF64);
+    result.madNs = GetMedian(deviations, sampleCount);
+    if(result.medianNs > 0)
+    {
+        result.bytesPerSec = (f64)state.bytesPerIteration * 1e9 / result.medianNs;
+        result.itemsPerSec = (f64)state.itemsPerIteration * 1e9 / result.medianNs;
+    }
+    return result;
+}
+
+void PinToCpu(i32 cpu)
+{
+    if(cpu < 0) return;
+    DWORD_PTR processMask = 0;
+    DWORD_PTR systemMask = 0;
+    GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask);
+    DWORD_PTR mask = (DWORD_PTR)1 << cpu;
+    if(!(processMask & mask))
+    {
+        printf("CPU %d not available, running unpinned.\n", cpu);
+        return;
+    }
+    SetThreadAffinityMask(GetCurrentThread(), mask);
+    SetPriorityClass(GetCurrentProcess(), HIGH_PRIORITY_CLASS);
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+}
+
+String ResultsToJson(mem::Arena* arena, Result* results, u64 count)
+{
+    String json = StrFmt(arena, "{\"benchmarks\":[\n");
+    for(u64 i = 0; i < count; i++)
+    {
+        Result& r = results[i];
+        String line = StrFmt(arena,
+                "{\"name\":\"%s\",\"iterations\":%llu,\"samples\":%u,\"median_ns\":%.4f,\"mad_ns\":%.4f,"
+                "\"min_ns\":%.4f,\"mean_ns\":%.4f,\"bytes_per_sec\":%.1f,\"items_per_sec\":%.1f}%s\n",
+                r.name, r.iterations, r.samples, r.medianNs, r.madNs,
+                r.minNs, r.meanNs, r.bytesPerSec, r.itemsPerSec, i + 1 < count ? "," : "");
+        json = StrConcat(arena, json, line);
+    }
+    return StrConcat(arena, json, "]}\n");
+}
+
+// A result regressed if its median is slower than the baseline by more than threshold percent,
+// and by more than 3 MADs (so noisy benchmarks don't trip it).
+u32 CompareToBaseline(mem::Arena* arena, String baselinePath, Result* results, u64 count, f64 threshold)
+{
+    if(!file::PathExists(baselinePath))
+    {
+        printf("Baseline not found: %s\n", baselinePath.CStr());
+        return 0;
+    }
+    String baselineStr = file::ReadFileToString(arena, baselinePath);
+    asset::JsonObject* baseline = asset::MakeJsonFromStr(arena, baselineStr);
+    asset::JsonArray entries = {};
+    if(!baseline->GetArrayValue("benchmarks", &entries))
+    {
+        printf("Invalid baseline: %s\n", baselinePath.CStr());
+        return 0;
+    }
+
+    printf("\n%-40s %14s %14s %9s\n", "Benchmark", "Baseline ns", "Current ns", "Delta");
+    u32 regressions = 0;
+    for(u64 i = 0; i < count; i++)
+    {
+        Result& r = results[i];
+        f64 baseMedian = -1;
+        for(u64 j = 0; j < entries.count; j++)
+        {
+            asset::JsonObject* entry = entries[j].AsObject();
+            String name = "";
+            if(entry->GetStringValue("name", &name) && name == r.name)
+            {
+                entry->GetNumberValue("median_ns", &baseMedian);
+                break;
+            }
+        }
+        if(baseMedian <= 0)
+        {
+            printf("%-40s %14s %14.2f %9s\n", r.name, "-", r.medianNs, "new");
+            continue;
+        }
+        f64 delta = (r.medianNs - baseMedian) / baseMedian * 100.0;
+        bool regressed = delta > threshold && (r.medianNs - baseMedian) > 3.0 * r.madNs;
+        if(regressed) regressions++;
+        printf("%-40s %14.2f %14.2f %+8.1f%%%s\n", r.name, baseMedian, r.medianNs, delta, regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+void PrintUsage()
+{
+    printf("Usage: bench [options]\n");
+    printf("  --filter <substr>   Only run benchmarks whose name contains substr.\n");
+    printf("  --out <json>        Write results as JSON.\n");
+    printf("  --baseline <json>   Compare against saved results, exits with 1 on regressions.\n");
+    printf("  --threshold <pct>   Regression threshold for --baseline (default 5).\n");
+    printf("  --samples <n>       Samples per benchmark (default 15).\n");
+    printf("  --min-ms <ms>       Minimum duration of one sample (default 20).\n");
+    printf("  --cpu <index>       Pin to CPU (default 1, -1 disables pinning).\n");
+    printf("  --list              List benchmarks and exit.\n");
+    printf("  --check             Run the correctness checks instead, exits with 1 on failures.\n");
+}
+
+};
+};
+
+using namespace ty;
+
+int main(int argc, char** argv)
+{
+    bench::RunDesc desc = {};
+    String filter = "";
+    String outPath = "";
+    String baselinePath = "";
+    f64 threshold = 5.0;
+    i32 cpu = 1;
+    bool list = false;
+    bool check = false;
+    for(i32 i = 1; i < argc; i++)
+    {
+        String arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(arg == "--filter" && hasValue)           filter = argv[++i];
+        else if(arg == "--out" && hasValue)         outPath = argv[++i];
+        else if(arg == "--baseline" && hasValue)    baselinePath = argv[++i];
+        else if(arg == "--threshold" && hasValue)   threshold = atof(argv[++i]);
+        else if(arg == "--samples" && hasValue)     desc.samples = (u32)atoi(argv[++i]);
+        else if(arg == "--min-ms" && hasValue)      desc.minSampleMs = (u32)atoi(argv[++i]);
+        else if(arg == "--cpu" && hasValue)         cpu = atoi(argv[++i]);
+        else if(arg == "--list")                    list = true;
+        else if(arg == "--check")                   check = true;
+        else
+        {
+            bench::PrintUsage();
+            return 1;
+        }
+    }
+
+    // Registration prepends, reverse to run in declaration order.
+    bench::Benchmark* ordered = NULL;
+    u64 benchmarkCount = 0;
+    while(bench::benchmarkList)
+    {
+        bench::Benchmark* next = bench::benchmarkList->next;
+        bench::benchmarkList->next = ordered;
+        ordered = bench::benchmarkList;
+        bench::benchmarkList = next;
+        benchmarkCount++;
+    }
+    if(list)
+    {
+        for(bench::Benchmark* b = ordered; b; b = b->next)
+        {
+            printf("%s\n", b->name);
+        }
+        return 0;
+    }
+    if(check)
+    {
+        bench::Check* orderedChecks = NULL;
+        while(bench::checkList)
+        {
+            bench::Check* next = bench::checkList->next;
+            bench::checkList->next = orderedChecks;
+            orderedChecks = bench::checkList;
+            bench::checkList = next;
+        }
+        u32 failedChecks = 0;
+        for(bench::Check* c = orderedChecks; c; c = c->next)
+        {
+            if(filter.len && StrFind(c->name, filter) == -1) continue;
+            bench::CheckState state = {};
+            state.name = c->name;
+            c->proc(&state);
+            if(state.failures)
+            {
+                printf("%-40s FAILED (%u)\n", c->name, state.failures);
+                failedChecks++;
+            }
+            else
+            {
+                printf("%-40s ok\n", c->name);
+            }
+        }
+        if(failedChecks)
+        {
+            printf("\n%u check(s) failed.\n", failedChecks);
+            return 1;
+        }
+        return 0;
+    }
+
+    time::InitTimestamps();
+    // The log benchmark writes a whole sample before draining, keep it off the console.
+    LogDesc logDesc = {};
+    logDesc.ringSize = MB(64);
+    logDesc.consoleLevel = LOG_LEVEL_INFO;
+    InitLog(logDesc);
+#if _PROFILE
+    // Rings must hold a whole sample of the zone benchmark, it only drains between samples.
+    profile::ProfileDesc profileDesc = {};
+    profileDesc.ringSize = 1 << 21;
+    profile::Init(profileDesc);
+#endif
+    bench::PinToCpu(cpu);
+    mem::Arena* arena = mem::MakeArena(MB(64));
+    bench::Result* results = (bench::Result*)mem::ArenaPush(arena, benchmarkCount * sizeof(bench::Result));
+    u64 resultCount = 0;
+
+    printf("%-40s %12s %10s %12s %12s %14s\n", "Benchmark", "Median ns", "MAD ns", "Min ns", "Iterations", "Throughput");
+    for(bench::Benchmark* b = ordered; b; b = b->next)
+    {
+        if(filter.len && StrFind(b->name, filter) == -1) continue;
+        bench::Result r = bench::RunBenchmark(b, desc);
+        results[resultCount++] = r;
+
+        char throughput[64] = "";
+        if(r.bytesPerSec > 0) snprintf(throughput, sizeof(throughput), "%.1f MB/s", r.bytesPerSec / (f64)MB(1));
+        else if(r.itemsPerSec > 0) snprintf(throughput, sizeof(throughput), "%.2f M/s", r.itemsPerSec / 1e6);
+        printf("%-40s %12.2f %10.2f %12.2f %12llu %14s\n",
+                r.name, r.medianNs, r.madNs, r.minNs, r.iterations, throughput);
+    }
+
+    if(outPath.len)
+    {
+        String json = bench::ResultsToJson(arena, results, resultCount);
+        if(!file::WriteFile(outPath, json.data, json.len, true))
+        {
+            printf("Failed to write %s\n", outPath.CStr());
+            return 1;
+        }
+    }
+    if(baselinePath.len)
+    {
+        u32 regressions = bench::CompareToBaseline(arena, baselinePath, results, resultCount, threshold);
+        if(regressions)
+        {
+            printf("\n%u regression(s) over %.1f%%.\n", regressions, threshold);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+// ========================================================
+// BENCH
+// Micro-benchmark harness. Benchmarks register themselves with BENCH and time a loop with
+// BENCH_LOOP, anything outside the loop is untimed setup. The runner scales the iteration
+// count until a sample is long enough to measure reliably, then reports median, MAD
+// (median absolute deviation) and min time per iteration over several samples. Checks of
+// the same kernels' results register with BENCH_CHECK and run with --check.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "../core/base.hpp"
+#include "../core/debug.hpp"
+#include "../core/time.hpp"
+
+namespace ty
+{
+namespace bench
+{
+
+struct State
+{
+    u64 iterations = 0;
+    u64 bytesPerIteration = 0;      // Set by the benchmark to report throughput.
+    u64 itemsPerIteration = 0;
+    u64 startTimestamp = 0;
+    u64 endTimestamp = 0;
+    u64 pauseTimestamp = 0;
+    u64 pausedTicks = 0;            // Excluded from the sample by PauseTiming/ResumeTiming.
+};
+
+typedef void (*BenchProc)(State* state);
+
+struct Benchmark
+{
+    const char* name = NULL;
+    BenchProc proc = NULL;
+    Benchmark* next = NULL;
+};
+
+// Static registration, benchmarks are linked into a list before main runs.
+struct Registrar
+{
+    Registrar(Benchmark* benchmark, const char* name, BenchProc proc);
+};
+
+u64 BeginLoop(State* state);
+bool EndLoop(State* state);     // Always false, ends the loop.
+
+// Untimed work inside a BENCH_LOOP, such as resetting state each iteration. Costs two
+// timestamps, so only for iterations long enough to hide them.
+void PauseTiming(State* state);
+void ResumeTiming(State* state);
+
+// Forces value to be computed and kept, without otherwise affecting codegen.
+template <typename T>
+inline void DoNotOptimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Forces all pending memory writes to be treated as observable.
+inline void ClobberMemory()
+{
+    asm volatile("" : : : "memory");
+}
+
+#define BENCH_IMPL(NAME, PROC) \
+    static void PROC(ty::bench::State* state); \
+    static ty::bench::Benchmark CONCATENATE(PROC, _benchmark); \
+    static ty::bench::Registrar CONCATENATE(PROC, _registrar)(&CONCATENATE(PROC, _benchmark), NAME, PROC); \
+    static void PROC(ty::bench::State* state)
+// Counter rather than line, the bench files share one translation unit.
+#define BENCH(NAME) BENCH_IMPL(NAME, CONCATENATE(Bench_, __COUNTER__))
+
+// Timed loop, runs state->iterations times. The iteration index is available as _benchIteration.
+#define BENCH_LOOP(STATE) \
+    for(u64 _benchIteration = ty::bench::BeginLoop(STATE); \
+            _benchIteration < (STATE)->iterations || ty::bench::EndLoop(STATE); \
+            _benchIteration++)
+
+// ========================================================
+// [CHECKS]
+// Correctness checks for the benchmarked kernels, run with --check instead of the timings.
+// BENCH_CHECK registers one, BENCH_EXPECT counts a failure when its condition is false.
+struct CheckState
+{
+    const char* name = NULL;
+    u32 failures = 0;
+};
+
+typedef void (*CheckProc)(CheckState* state);
+
+struct Check
+{
+    const char* name = NULL;
+    CheckProc proc = NULL;
+    Check* next = NULL;
+};
+
+struct CheckRegistrar
+{
+    CheckRegistrar(Check* check, const char* name, CheckProc proc);
+};
+
+// Prints the first few failures of a check, all of them count.
+void ExpectFailed(CheckState* state, const char* file, i32 line, const char* fmt, ...);
+
+// Distance between two floats in units in the last place, 0 when their bits match.
+inline u32 UlpDistance(f32 a, f32 b)
+{
+    i32 ia;
+    i32 ib;
+    memcpy(&ia, &a, sizeof(f32));
+    memcpy(&ib, &b, sizeof(f32));
+    // Sign-magnitude to two's complement, so adjacent floats are adjacent integers across 0.
+    i64 oa = ia < 0 ? (i64)(i32)0x80000000 - ia : ia;
+    i64 ob = ib < 0 ? (i64)(i32)0x80000000 - ib : ib;
+    i64 distance = oa > ob ? oa - ob : ob - oa;
+    return (u32)MIN(distance, (i64)MAX_U32);
+}
+
+#define BENCH_CHECK_IMPL(NAME, PROC) \
+    static void PROC(ty::bench::CheckState* state); \
+    static ty::bench::Check CONCATENATE(PROC, _check); \
+    static ty::bench::CheckRegistrar CONCATENATE(PROC, _registrar)(&CONCATENATE(PROC, _check), NAME, PROC); \
+    static void PROC(ty::bench::CheckState* state)
+#define BENCH_CHECK(NAME) BENCH_CHECK_IMPL(NAME, CONCATENATE(Check_, __COUNTER__))
+
+#define BENCH_EXPECT(STATE, EXPR, FMT, ...) \
+    STMT(if(!(EXPR)) ty::bench::ExpectFailed(STATE, __FILE__, __LINE__, FMT, ##__VA_ARGS__);)
+
+};
+};
@@ -0,0 +1,58 @@
+// ========================================================
+// BENCH ASSET
+// Benchmarks for asset parsing.
+// @Caio Guedes, 2023
+// ========================================================
+
+namespace ty
+{
+namespace bench
+{
+
+// glTF-like document: a node hierarchy, meshes and accessors.
+String MakeBenchJson(mem::Arena* arena, u32 nodeCount)
+{
+    u64 capacity = nodeCount * 512 + 256;
+    char* data = (char*)mem::ArenaPush(arena, capacity);
+    u64 len = snprintf(data, capacity, "{\"asset\":{\"version\":\"2.0\",\"generator\":\"typheus bench\"},\"scene\":0,\"nodes\":[");
+    for(u32 i = 0; i < nodeCount; i++)
+    {
+        len += snprintf(data + len, capacity - len,
+                "%s{\"name\":\"node_%u\",\"mesh\":%u,\"children\":[%u,%u],"
+                "\"translation\":[%.3f,%.3f,%.3f],\"rotation\":[0.0,0.7071068,0.0,0.7071068],\"scale\":[1.0,1.0,1.0]}",
+                i ? "," : "", i, i, i * 2 + 1, i * 2 + 2, i * 0.5f, -(f32)i * 0.25f, i * 1.5f);
+    }
+    len += snprintf(data + len, capacity - len, "],\"accessors\":[");
+    for(u32 i = 0; i < nodeCount; i++)
+    {
+        len += snprintf(data + len, capacity - len,
+                "%s{\"bufferView\":%u,\"componentType\":5126,\"count\":%u,\"type\":\"VEC3\","
+                "\"max\":[1.0,1.0,1.0],\"min\":[-1.0,-1.0,-1.0]}",
+                i ? "," : "", i, 1024 + i);
+    }
+    len += snprintf(data + len, capacity - len, "]}");
+    ASSERT(len < capacity);
+    return Str((byte*)data, len);
+}
+
+void BenchParseJson(State* state, u32 nodeCount)
+{
+    mem::Arena* dataArena = mem::MakeArena(nodeCount * 512 + KB(1));
+    String json = MakeBenchJson(dataArena, nodeCount);
+    mem::Arena* arena = mem::MakeArena(MB(64));
+    BENCH_LOOP(state)
+    {
+        mem::ArenaClear(arena);
+        asset::JsonObject* result = asset::MakeJsonFromStr(arena, json);
+        DoNotOptimize(result);
+    }
+    state->bytesPerIteration = json.len;
+    mem::DestroyArena(arena);
+    mem::DestroyArena(dataArena);
+}
+
+BENCH("json/parse_small")   { BenchParseJson(state, 16); }
+BENCH("json/parse_large")   { BenchParseJson(state, 2048); }
+
+};
+};
@@ -0,0 +1,784 @@
+// ========================================================
+// BENCH CORE
+// Benchmarks for core data structures, strings, compression, file I/O and instrumentation.
+// @Caio Guedes, 2023
+// ========================================================
+
+namespace ty
+{
+namespace bench
+{
+
+#define BENCH_TEMP_DIR "bench_temp/"
+
+// ========================================================
+// [DATA]
+u64 ScrambleKey(u64 i)
+{
+    return (i + 1) * 0x9E3779B97F4A7C15ULL;
+}
+
+// Words separated by spaces and newlines, compresses like source code or JSON.
+void FillText(byte* data, u64 size)
+{
+    const char* words[] = { "vertex", "buffer", "texture", "shader", "render", "pass", "asset", "material",
+        "{", "}", "0.5", "\"name\":", "for", "return", "i32", "mesh", "node", "scene", "=", ";" };
+    u64 seed = 1;
+    u64 offset = 0;
+    while(offset < size)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        const char* word = words[(seed >> 33) % ARR_LEN(words)];
+        for(const char* c = word; *c && offset < size; c++)
+        {
+            data[offset++] = *c;
+        }
+        if(offset < size) data[offset++] = (seed >> 60) == 0 ? '\n' : ' ';
+    }
+}
+
+// RGBA gradients with low amplitude noise, compresses like uncompressed textures.
+void FillImage(byte* data, u64 size)
+{
+    u64 seed = 7;
+    for(u64 i = 0; i < size; i++)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        u64 pixel = i / 4;
+        u32 x = pixel % 1024;
+        u32 y = (u32)(pixel / 1024);
+        byte value = (byte)((x + y * (i % 4 + 1)) / 8);
+        if((seed >> 62) == 0) value += (byte)(seed >> 59);
+        data[i] = value;
+    }
+}
+
+void FillRandom(byte* data, u64 size)
+{
+    u64 seed = 13;
+    for(u64 i = 0; i < size; i++)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        data[i] = (byte)(seed >> 56);
+    }
+}
+
+// ========================================================
+// [HASH MAP]
+#define BENCH_MAP_KEYS 4096
+
+BENCH("ds/hashmap_insert")
+{
+    mem::Arena* arena = mem::MakeArena(MB(1));
+    HashMap<u64, u32> map = MakeMap<u64, u32>(arena, BENCH_MAP_KEYS * 2);
+    BENCH_LOOP(state)
+    {
+        map.Clear();
+        for(u32 i = 0; i < BENCH_MAP_KEYS; i++)
+        {
+            map.Insert(ScrambleKey(i), i);
+        }
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_MAP_KEYS;
+    mem::DestroyArena(arena);
+}
+
+BENCH("ds/hashmap_find_hit")
+{
+    mem::Arena* arena = mem::MakeArena(MB(1));
+    HashMap<u64, u32> map = MakeMap<u64, u32>(arena, BENCH_MAP_KEYS * 2);
+    for(u32 i = 0; i < BENCH_MAP_KEYS; i++)
+    {
+        map.Insert(ScrambleKey(i), i);
+    }
+    BENCH_LOOP(state)
+    {
+        i64 pos = map.Find(ScrambleKey(_benchIteration % BENCH_MAP_KEYS));
+        DoNotOptimize(pos);
+    }
+    state->itemsPerIteration = 1;
+    mem::DestroyArena(arena);
+}
+
+BENCH("ds/hashmap_find_miss")
+{
+    mem::Arena* arena = mem::MakeArena(MB(1));
+    HashMap<u64, u32> map = MakeMap<u64, u32>(arena, BENCH_MAP_KEYS * 2);
+    for(u32 i = 0; i < BENCH_MAP_KEYS; i++)
+    {
+        map.Insert(ScrambleKey(i), i);
+    }
+    BENCH_LOOP(state)
+    {
+        i64 pos = map.Find(ScrambleKey(BENCH_MAP_KEYS + _benchIteration % BENCH_MAP_KEYS));
+        DoNotOptimize(pos);
+    }
+    state->itemsPerIteration = 1;
+    mem::DestroyArena(arena);
+}
+
+BENCH("ds/hashmap_find_string")
+{
+    mem::Arena* arena = mem::MakeArena(MB(4));
+    HashMap<String, u32> map = MakeMap<String, u32>(arena, BENCH_MAP_KEYS * 2);
+    String* keys = (String*)mem::ArenaPush(arena, BENCH_MAP_KEYS * sizeof(String));
+    for(u32 i = 0; i < BENCH_MAP_KEYS; i++)
+    {
+        keys[i] = StrFmt(arena, "assets/textures/environment/texture_%u.png", i);
+        map.Insert(keys[i], i);
+    }
+    BENCH_LOOP(state)
+    {
+        i64 pos = map.Find(keys[_benchIteration % BENCH_MAP_KEYS]);
+        DoNotOptimize(pos);
+    }
+    state->itemsPerIteration = 1;
+    mem::DestroyArena(arena);
+}
+
+// ========================================================
+// [DYNAMIC ARRAY]
+#define BENCH_ARRAY_COUNT 4096
+
+BENCH("ds/darray_push")
+{
+    mem::Arena* arena = mem::MakeArena(MB(4));
+    BENCH_LOOP(state)
+    {
+        mem::ArenaClear(arena);
+        DArray<u32> array = MakeDArray<u32>(arena, 16);
+        for(u32 i = 0; i < BENCH_ARRAY_COUNT; i++)
+        {
+            array.Push(i);
+        }
+        DoNotOptimize(array.data);
+    }
+    state->itemsPerIteration = BENCH_ARRAY_COUNT;
+    mem::DestroyArena(arena);
+}
+
+BENCH("ds/darray_iterate")
+{
+    mem::Arena* arena = mem::MakeArena(MB(1));
+    DArray<u32> array = MakeDArray<u32>(arena, BENCH_ARRAY_COUNT);
+    for(u32 i = 0; i < BENCH_ARRAY_COUNT; i++)
+    {
+        array.Push(i);
+    }
+    BENCH_LOOP(state)
+    {
+        u64 sum = 0;
+        for(u64 i = 0; i < array.count; i++)
+        {
+            sum += array[i];
+        }
+        DoNotOptimize(sum);
+    }
+    state->bytesPerIteration = BENCH_ARRAY_COUNT * sizeof(u32);
+    mem::DestroyArena(arena);
+}
+
+// ========================================================
+// [STRING]
+#define BENCH_TEXT_SIZE KB(64)
+
+BENCH("string/strfind_char")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_TEXT_SIZE + KB(1));
+    byte* text = (byte*)mem::ArenaPush(arena, BENCH_TEXT_SIZE);
+    FillText(text, BENCH_TEXT_SIZE);
+    String s = Str(text, BENCH_TEXT_SIZE);
+    BENCH_LOOP(state)
+    {
+        i64 pos = StrFind(s, '#');
+        DoNotOptimize(pos);
+    }
+    state->bytesPerIteration = BENCH_TEXT_SIZE;
+    mem::DestroyArena(arena);
+}
+
+BENCH("string/strfind_substr")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_TEXT_SIZE + KB(1));
+    byte* text = (byte*)mem::ArenaPush(arena, BENCH_TEXT_SIZE);
+    FillText(text, BENCH_TEXT_SIZE);
+    String s = Str(text, BENCH_TEXT_SIZE);
+    BENCH_LOOP(state)
+    {
+        i64 pos = StrFind(s, "texture shader missing");
+        DoNotOptimize(pos);
+    }
+    state->bytesPerIteration = BENCH_TEXT_SIZE;
+    mem::DestroyArena(arena);
+}
+
+BENCH("string/hash_path")
+{
+    String path = "assets/models/sponza/textures/background_ddn.png";
+    BENCH_LOOP(state)
+    {
+        DoNotOptimize(path.data);
+        u32 hash = Hash(path);
+        DoNotOptimize(hash);
+    }
+    state->bytesPerIteration = path.len;
+}
+
+// ========================================================
+// [COMPRESS]
+#define BENCH_LZ_SIZE MB(1)
+
+enum BenchDataKind
+{
+    BENCH_DATA_TEXT,
+    BENCH_DATA_IMAGE,
+    BENCH_DATA_RANDOM,
+};
+
+void FillData(BenchDataKind kind, byte* data, u64 size)
+{
+    switch(kind)
+    {
+        case BENCH_DATA_TEXT: FillText(data, size); break;
+        case BENCH_DATA_IMAGE: FillImage(data, size); break;
+        case BENCH_DATA_RANDOM: FillRandom(data, size); break;
+        default: ASSERT(0);
+    }
+}
+
+void BenchCompressBlock(State* state, BenchDataKind kind)
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_LZ_SIZE + compress::GetMaxCompressedSize(BENCH_LZ_SIZE) + KB(4));
+    byte* src = (byte*)mem::ArenaPush(arena, BENCH_LZ_SIZE);
+    u64 dstCapacity = compress::GetMaxCompressedSize(BENCH_LZ_SIZE);
+    byte* dst = (byte*)mem::ArenaPush(arena, dstCapacity);
+    FillData(kind, src, BENCH_LZ_SIZE);
+    BENCH_LOOP(state)
+    {
+        u64 size = compress::CompressBlock(src, BENCH_LZ_SIZE, dst, dstCapacity);
+        DoNotOptimize(size);
+    }
+    state->bytesPerIteration = BENCH_LZ_SIZE;
+    mem::DestroyArena(arena);
+}
+
+void BenchDecompressBlock(State* state, BenchDataKind kind)
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_LZ_SIZE * 2 + compress::GetMaxCompressedSize(BENCH_LZ_SIZE) + KB(4));
+    byte* src = (byte*)mem::ArenaPush(arena, BENCH_LZ_SIZE);
+    u64 compressedCapacity = compress::GetMaxCompressedSize(BENCH_LZ_SIZE);
+    byte* compressed = (byte*)mem::ArenaPush(arena, compressedCapacity);
+    byte* dst = (byte*)mem::ArenaPush(arena, BENCH_LZ_SIZE);
+    FillData(kind, src, BENCH_LZ_SIZE);
+    u64 compressedSize = compress::CompressBlock(src, BENCH_LZ_SIZE, compressed, compressedCapacity);
+    ASSERT(compressedSize);
+    BENCH_LOOP(state)
+    {
+        u64 size = compress::DecompressBlock(compressed, compressedSize, dst, BENCH_LZ_SIZE);
+        DoNotOptimize(size);
+    }
+    state->bytesPerIteration = BENCH_LZ_SIZE;
+    mem::DestroyArena(arena);
+}
+
+BENCH("compress/lz_compress_text")      { BenchCompressBlock(state, BENCH_DATA_TEXT); }
+BENCH("compress/lz_compress_image")     { BenchCompressBlock(state, BENCH_DATA_IMAGE); }
+BENCH("compress/lz_compress_random")    { BenchCompressBlock(state, BENCH_DATA_RANDOM); }
+BENCH("compress/lz_decompress_text")    { BenchDecompressBlock(state, BENCH_DATA_TEXT); }
+BENCH("compress/lz_decompress_image")   { BenchDecompressBlock(state, BENCH_DATA_IMAGE); }
+BENCH("compress/lz_decompress_random")  { BenchDecompressBlock(state, BENCH_DATA_RANDOM); }
+
+BENCH("compress/frame_compress_parallel")
+{
+    u64 srcSize = MB(8);
+    u64 dstCapacity = compress::GetMaxFrameSize(srcSize);
+    mem::Arena* arena = mem::MakeArena(srcSize + dstCapacity + KB(4));
+    byte* src = (byte*)mem::ArenaPush(arena, srcSize);
+    byte* dst = (byte*)mem::ArenaPush(arena, dstCapacity);
+    FillText(src, srcSize);
+    BENCH_LOOP(state)
+    {
+        u64 size = compress::CompressFrame(src, srcSize, dst, dstCapacity);
+        DoNotOptimize(size);
+    }
+    state->bytesPerIteration = srcSize;
+    mem::DestroyArena(arena);
+}
+
+BENCH("compress/checksum32")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_LZ_SIZE + KB(1));
+    byte* src = (byte*)mem::ArenaPush(arena, BENCH_LZ_SIZE);
+    FillRandom(src, BENCH_LZ_SIZE);
+    BENCH_LOOP(state)
+    {
+        u32 checksum = compress::Checksum32(src, BENCH_LZ_SIZE);
+        DoNotOptimize(checksum);
+    }
+    state->bytesPerIteration = BENCH_LZ_SIZE;
+    mem::DestroyArena(arena);
+}
+
+// Round trips through blocks and frames, and corrupt input that must be rejected. Inputs and
+// outputs sit right before a no-access page, so reading or writing past either one faults.
+#define BENCH_LZ_CHECK_SIZE KB(64)
+#define BENCH_GUARD_PAGE KB(4)
+
+struct GuardedBuffer
+{
+    byte* memory = NULL;
+    u64 capacity = 0;       // Bytes before the no-access page.
+};
+
+GuardedBuffer MakeGuardedBuffer(u64 capacity)
+{
+    GuardedBuffer result = {};
+    result.capacity = ALIGN_TO(capacity, BENCH_GUARD_PAGE);
+    result.memory = (byte*)VirtualAlloc(NULL, result.capacity + BENCH_GUARD_PAGE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    ASSERT(result.memory);
+    DWORD oldProtect = 0;
+    BOOL guarded = VirtualProtect(result.memory + result.capacity, BENCH_GUARD_PAGE, PAGE_NOACCESS, &oldProtect);
+    ASSERT(guarded);
+    return result;
+}
+
+void DestroyGuardedBuffer(GuardedBuffer* buffer)
+{
+    VirtualFree(buffer->memory, 0, MEM_RELEASE);
+    *buffer = {};
+}
+
+// The last size bytes before the guard page.
+byte* GuardedTail(GuardedBuffer* buffer, u64 size)
+{
+    ASSERT(size <= buffer->capacity);
+    return buffer->memory + buffer->capacity - size;
+}
+
+// Copies the block in against the guard page and decompresses it into exactly dstCapacity.
+u64 DecompressGuarded(GuardedBuffer* in, GuardedBuffer* out, const byte* block, u64 blockSize, u64 dstCapacity)
+{
+    byte* src = GuardedTail(in, blockSize);
+    memmove(src, block, blockSize);
+    return compress::DecompressBlock(src, blockSize, GuardedTail(out, dstCapacity), dstCapacity);
+}
+
+// Where the first match's offset sits in a block, 0 if it has no match.
+u64 FindFirstOffset(const byte* block, u64 blockSize)
+{
+    u64 litLen = block[0] >> 4;
+    u64 cursor = 1;
+    if(litLen == 15)
+    {
+        byte b;
+        do
+        {
+            b = block[cursor++];
+            litLen += b;
+        } while(b == 255);
+    }
+    cursor += litLen;
+    return cursor + 2 <= blockSize ? cursor : 0;
+}
+
+void CheckBlockRoundTrip(CheckState* state, const char* name, const byte* data, u64 size,
+        byte* block, GuardedBuffer* in, GuardedBuffer* out)
+{
+    u64 blockSize = compress::CompressBlock(data, size, block, compress::GetMaxCompressedSize(size));
+    BENCH_EXPECT(state, blockSize > 0, "%s of %llu bytes didn't compress", name, size);
+    u64 result = DecompressGuarded(in, out, block, blockSize, size);
+    BENCH_EXPECT(state, result == size && !memcmp(GuardedTail(out, size), data, size),
+            "%s of %llu bytes decompressed to %llu different bytes", name, size, result);
+    if(size)
+    {
+        result = DecompressGuarded(in, out, block, blockSize, size - 1);
+        BENCH_EXPECT(state, result == MAX_U64, "%s of %llu bytes fit in one byte less", name, size);
+    }
+
+    // Cutting into the last literals leaves them longer than the block. Cut anywhere else,
+    // the block can end on a sequence boundary and decode shorter, but never to all of it.
+    u64 lastLiterals = size > LZ_MF_LIMIT ? LZ_LAST_LITERALS : 1;
+    for(u64 cut = 1; cut <= MIN(lastLiterals, blockSize); cut++)
+    {
+        result = DecompressGuarded(in, out, block, blockSize - cut, size);
+        BENCH_EXPECT(state, result == MAX_U64, "%s of %llu bytes cut by %llu gave %llu", name, size, cut, result);
+    }
+    u64 cutStep = blockSize / 64 + 1;
+    for(u64 cut = lastLiterals + 1; cut <= blockSize; cut += cutStep)
+    {
+        result = DecompressGuarded(in, out, block, blockSize - cut, size);
+        BENCH_EXPECT(state, result == MAX_U64 || result < size, "%s of %llu bytes cut by %llu gave all of it",
+                name, size, cut);
+    }
+
+    // An offset reaching before the output is rejected. Flips elsewhere may still decode,
+    // literals to other bytes (the frame checksum catches those), but stay in bounds.
+    u64 offsetAt = FindFirstOffset(block, blockSize);
+    u64 offset = offsetAt ? block[offsetAt] | ((u64)block[offsetAt + 1] << 8) : 0;
+    if(offsetAt && offset < 0x8000 && offset + 0x8000 > offsetAt)
+    {
+        block[offsetAt + 1] ^= 0x80;
+        result = DecompressGuarded(in, out, block, blockSize, size);
+        BENCH_EXPECT(state, result == MAX_U64, "%s of %llu bytes with a far offset gave %llu", name, size, result);
+        block[offsetAt + 1] ^= 0x80;
+    }
+    u64 flipStep = blockSize / 256 + 1;
+    for(u64 i = 0; i < blockSize; i += flipStep)
+    {
+        for(u32 bit = 0; bit < 8; bit++)
+        {
+            block[i] ^= (byte)(1 << bit);
+            result = DecompressGuarded(in, out, block, blockSize, size);
+            BENCH_EXPECT(state, result == MAX_U64 || result <= size, "%s of %llu bytes flipped at %llu gave %llu",
+                    name, size, i, result);
+            block[i] ^= (byte)(1 << bit);
+        }
+    }
+}
+
+BENCH_CHECK("compress/block_round_trip")
+{
+    u64 size = BENCH_LZ_CHECK_SIZE;
+    mem::Arena* arena = mem::MakeArena(size * 2 + compress::GetMaxCompressedSize(size) + KB(4));
+    byte* data = (byte*)mem::ArenaPush(arena, size);
+    byte* block = (byte*)mem::ArenaPush(arena, compress::GetMaxCompressedSize(size));
+    GuardedBuffer in = MakeGuardedBuffer(compress::GetMaxCompressedSize(size));
+    GuardedBuffer out = MakeGuardedBuffer(size);
+
+    const char* names[] = { "text", "image", "random" };
+    BenchDataKind kinds[] = { BENCH_DATA_TEXT, BENCH_DATA_IMAGE, BENCH_DATA_RANDOM };
+    for(u32 k = 0; k < ARR_LEN(kinds); k++)
+    {
+        FillData(kinds[k], data, size);
+        CheckBlockRoundTrip(state, names[k], data, size, block, &in, &out);
+        // Empty, too small to hold a match, and just past that.
+        for(u64 small = 0; small <= LZ_MF_LIMIT + 8; small++)
+        {
+            CheckBlockRoundTrip(state, names[k], data, small, block, &in, &out);
+        }
+        CheckBlockRoundTrip(state, names[k], data, 1000, block, &in, &out);
+    }
+
+    // Repeats shorter than 8 bytes take the pattern expanding match copy.
+    for(u64 period = 1; period <= 16; period++)
+    {
+        for(u64 i = 0; i < size; i++)
+        {
+            data[i] = (byte)('a' + i % period);
+        }
+        CheckBlockRoundTrip(state, "pattern", data, KB(4) + period, block, &in, &out);
+    }
+
+    // Lengths running past the block or the output.
+    byte longLiterals[] = { 0xF0, 255, 255, 'a' };
+    BENCH_EXPECT(state, DecompressGuarded(&in, &out, longLiterals, sizeof(longLiterals), size) == MAX_U64,
+            "literal length past the block accepted");
+    byte longMatch[] = { 0x1F, 'a', 1, 0, 255, 255, 255, 0, 0x00 };
+    BENCH_EXPECT(state, DecompressGuarded(&in, &out, longMatch, sizeof(longMatch), 512) == MAX_U64,
+            "match length past the output accepted");
+    byte zeroOffset[] = { 0x10, 'a', 0, 0, 0x00 };
+    BENCH_EXPECT(state, DecompressGuarded(&in, &out, zeroOffset, sizeof(zeroOffset), size) == MAX_U64,
+            "zero offset accepted");
+    byte farOffset[] = { 0x10, 'a', 2, 0, 0x00 };
+    BENCH_EXPECT(state, DecompressGuarded(&in, &out, farOffset, sizeof(farOffset), size) == MAX_U64,
+            "offset before the output accepted");
+    BENCH_EXPECT(state, DecompressGuarded(&in, &out, longLiterals, 0, size) == MAX_U64, "empty block accepted");
+
+    DestroyGuardedBuffer(&in);
+    DestroyGuardedBuffer(&out);
+    mem::DestroyArena(arena);
+}
+
+BENCH_CHECK("compress/frame_round_trip")
+{
+    u64 size = BENCH_LZ_CHECK_SIZE * 4 + 123;
+    compress::CompressDesc descs[2] = {};
+    descs[0].blockSize = KB(16);
+    descs[0].parallel = false;
+    descs[1].blockSize = KB(16);
+    u64 frameCapacity = compress::GetMaxFrameSize(size, descs[0]);
+    mem::Arena* arena = mem::MakeArena(size + frameCapacity + KB(4));
+    byte* data = (byte*)mem::ArenaPush(arena, size);
+    byte* frame = (byte*)mem::ArenaPush(arena, frameCapacity);
+    GuardedBuffer in = MakeGuardedBuffer(frameCapacity);
+    GuardedBuffer out = MakeGuardedBuffer(size);
+
+    const char* names[] = { "text", "image", "random" };
+    BenchDataKind kinds[] = { BENCH_DATA_TEXT, BENCH_DATA_IMAGE, BENCH_DATA_RANDOM };
+    for(u32 k = 0; k < ARR_LEN(kinds); k++)
+    {
+        FillData(kinds[k], data, size);
+        for(u32 d = 0; d < ARR_LEN(descs); d++)
+        {
+            u64 sizes[] = { 0, 1, size };
+            for(u32 s = 0; s < ARR_LEN(sizes); s++)
+            {
+                u64 rawSize = sizes[s];
+                u64 frameSize = compress::CompressFrame(data, rawSize, frame, frameCapacity, descs[d]);
+                byte* src = GuardedTail(&in, frameSize);
+                memcpy(src, frame, frameSize);
+                byte* dst = GuardedTail(&out, rawSize);
+                BENCH_EXPECT(state, compress::GetFrameRawSize(src, frameSize) == rawSize, "%s frame lost its size", names[k]);
+                bool ok = compress::DecompressFrame(src, frameSize, dst, rawSize);
+                BENCH_EXPECT(state, ok && !memcmp(dst, data, rawSize), "%s frame of %llu bytes didn't round trip",
+                        names[k], rawSize);
+                if(rawSize)
+                {
+                    ok = compress::DecompressFrame(src, frameSize, GuardedTail(&out, rawSize - 1), rawSize - 1);
+                    BENCH_EXPECT(state, !ok, "%s frame decompressed to the wrong size", names[k]);
+                }
+            }
+
+            // Every block's checksum and a byte of its data, flipped, then truncated and padded frames.
+            u64 frameSize = compress::CompressFrame(data, size, frame, frameCapacity, descs[d]);
+            byte* src = GuardedTail(&in, frameSize);
+            memcpy(src, frame, frameSize);
+            byte* dst = GuardedTail(&out, size);
+            u64 cursor = sizeof(compress::FrameHeader);
+            while(cursor < frameSize)
+            {
+                compress::BlockHeader header;
+                memcpy(&header, src + cursor, sizeof(compress::BlockHeader));
+                u64 checksumAt = cursor + offsetof(compress::BlockHeader, checksum);
+                u64 dataAt = cursor + sizeof(compress::BlockHeader) + (header.size & ~TY_LZ_BLOCK_STORED) / 2;
+                src[checksumAt] ^= 1;
+                BENCH_EXPECT(state, !compress::DecompressFrame(src, frameSize, dst, size),
+                        "%s frame with a flipped checksum at %llu accepted", names[k], checksumAt);
+                src[checksumAt] ^= 1;
+                src[dataAt] ^= 0x10;
+                BENCH_EXPECT(state, !compress::DecompressFrame(src, frameSize, dst, size),
+                        "%s frame with a flipped byte at %llu accepted", names[k], dataAt);
+                src[dataAt] ^= 0x10;
+                cursor += sizeof(compress::BlockHeader) + (header.size & ~TY_LZ_BLOCK_STORED);
+            }
+            BENCH_EXPECT(state, cursor == frameSize, "%s frame blocks don't add up", names[k]);
+            BENCH_EXPECT(state, !compress::DecompressFrame(src, frameSize - 1, dst, size), "%s truncated frame accepted", names[k]);
+            byte* padded = GuardedTail(&in, frameSize + 1);
+            memmove(padded, frame, frameSize);
+            padded[frameSize] = 0;
+            BENCH_EXPECT(state, !compress::DecompressFrame(padded, frameSize + 1, dst, size), "%s padded frame accepted", names[k]);
+        }
+    }
+
+    DestroyGuardedBuffer(&in);
+    DestroyGuardedBuffer(&out);
+    mem::DestroyArena(arena);
+}
+
+// ========================================================
+// [FILE]
+// File benchmarks go through the OS file cache, they measure API and syscall overhead
+// rather than disk speed.
+#define BENCH_RECORD_SIZE 64
+#define BENCH_RECORD_COUNT 65536
+#define BENCH_BLOB_SIZE MB(32)
+
+BENCH("file/writer_small_records")
+{
+    CreateDirectory(BENCH_TEMP_DIR, NULL);
+    mem::Arena* arena = mem::MakeArena(MB(4));
+    byte record[BENCH_RECORD_SIZE];
+    FillText(record, BENCH_RECORD_SIZE);
+    BENCH_LOOP(state)
+    {
+        MEM_ARENA_CHECKPOINT_SET(arena, writerCheckpoint);
+        file::FileWriter writer = file::MakeFileWriter(arena, BENCH_TEMP_DIR "writer_small.bin");
+        for(u32 i = 0; i < BENCH_RECORD_COUNT; i++)
+        {
+            file::Write(&writer, record, BENCH_RECORD_SIZE);
+        }
+        bool result = file::CloseFileWriter(&writer);
+        ASSERT(result);
+        MEM_ARENA_CHECKPOINT_RESET(arena, writerCheckpoint);
+    }
+    state->bytesPerIteration = BENCH_RECORD_SIZE * BENCH_RECORD_COUNT;
+    state->itemsPerIteration = BENCH_RECORD_COUNT;
+    mem::DestroyArena(arena);
+    DeleteFile(BENCH_TEMP_DIR "writer_small.bin");
+}
+
+BENCH("file/writer_large_blob")
+{
+    CreateDirectory(BENCH_TEMP_DIR, NULL);
+    mem::Arena* arena = mem::MakeArena(BENCH_BLOB_SIZE + KB(4));
+    byte* blob = (byte*)mem::ArenaPush(arena, BENCH_BLOB_SIZE);
+    FillImage(blob, BENCH_BLOB_SIZE);
+    BENCH_LOOP(state)
+    {
+        bool result = file::WriteFile(BENCH_TEMP_DIR "writer_blob.bin", blob, BENCH_BLOB_SIZE);
+        ASSERT(result);
+    }
+    state->bytesPerIteration = BENCH_BLOB_SIZE;
+    mem::DestroyArena(arena);
+    DeleteFile(BENCH_TEMP_DIR "writer_blob.bin");
+}
+
+// ========================================================
+// [PACK]
+// Startup cost of reading many small assets, loose vs from a pack (mount included). Warm
+// runs read from the OS file cache, cold ones evict the files first, untimed, so each
+// iteration goes to the drive as a first launch would.
+#define BENCH_PACK_FILES 512
+#define BENCH_PACK_FILE_SIZE KB(4)
+#define BENCH_PACK_ROOT BENCH_TEMP_DIR "loose/"
+#define BENCH_PACK_PATH BENCH_TEMP_DIR "assets.pack"
+
+SArray<String> PreparePackFiles(mem::Arena* arena)
+{
+    CreateDirectory(BENCH_TEMP_DIR, NULL);
+    CreateDirectory(BENCH_PACK_ROOT, NULL);
+    byte data[BENCH_PACK_FILE_SIZE];
+    SArray<String> paths = MakeSArray<String>(arena, BENCH_PACK_FILES);
+    for(u32 i = 0; i < BENCH_PACK_FILES; i++)
+    {
+        String path = StrFmt(arena, BENCH_PACK_ROOT "asset_%u.bin", i);
+        if(!file::PathExists(path))
+        {
+            FillText(data, BENCH_PACK_FILE_SIZE);
+            data[0] = (byte)i;
+            file::WriteFile(path, data, BENCH_PACK_FILE_SIZE);
+        }
+        paths.Push(path);
+    }
+    // Rebuilt once per run, so a pack from an older format is never read.
+    static bool packBuilt = false;
+    if(!packBuilt)
+    {
+        SArray<file::DirEntry> entries = file::WalkDir(arena, BENCH_PACK_ROOT);
+        bool result = pack::BuildPack(BENCH_PACK_PATH, BENCH_PACK_ROOT, entries);
+        ASSERT(result);
+        packBuilt = true;
+    }
+    return paths;
+}
+
+// Drops a file from the OS file cache: opening it unbuffered makes the cache manager flush
+// and purge its pages, as long as nothing has it mapped. The drive's own cache still holds it.
+void EvictFromFileCache(String path)
+{
+    HANDLE hFile = CreateFile(path.CStr(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+            OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, NULL);
+    ASSERT(hFile != INVALID_HANDLE_VALUE);
+    CloseHandle(hFile);
+}
+
+u64 ReadAllFiles(SArray<String> paths, byte* buffer)
+{
+    u64 total = 0;
+    for(u64 i = 0; i < paths.count; i++)
+    {
+        u64 size = file::GetFileSize(paths[i]);
+        ASSERT(size <= BENCH_PACK_FILE_SIZE);
+        total += file::ReadFile(paths[i], buffer);
+    }
+    return total;
+}
+
+void BenchStartupLoose(State* state, bool cold)
+{
+    mem::Arena* arena = mem::MakeArena(MB(1));
+    SArray<String> paths = PreparePackFiles(arena);
+    byte* buffer = (byte*)mem::ArenaPush(arena, BENCH_PACK_FILE_SIZE);
+    BENCH_LOOP(state)
+    {
+        if(cold)
+        {
+            PauseTiming(state);
+            for(u64 i = 0; i < paths.count; i++)
+            {
+                EvictFromFileCache(paths[i]);
+            }
+            ResumeTiming(state);
+        }
+        u64 total = ReadAllFiles(paths, buffer);
+        DoNotOptimize(total);
+    }
+    state->bytesPerIteration = BENCH_PACK_FILES * BENCH_PACK_FILE_SIZE;
+    state->itemsPerIteration = BENCH_PACK_FILES;
+    mem::DestroyArena(arena);
+}
+
+void BenchStartupPacked(State* state, bool cold)
+{
+    mem::Arena* arena = mem::MakeArena(MB(1));
+    SArray<String> paths = PreparePackFiles(arena);
+    byte* buffer = (byte*)mem::ArenaPush(arena, BENCH_PACK_FILE_SIZE);
+    BENCH_LOOP(state)
+    {
+        if(cold)
+        {
+            // Unmounted here, so the pack isn't mapped.
+            PauseTiming(state);
+            EvictFromFileCache(BENCH_PACK_PATH);
+            ResumeTiming(state);
+        }
+        bool mounted = pack::Mount(BENCH_PACK_PATH, BENCH_PACK_ROOT);
+        ASSERT(mounted);
+        u64 total = ReadAllFiles(paths, buffer);
+        DoNotOptimize(total);
+        pack::UnmountAll();
+    }
+    state->bytesPerIteration = BENCH_PACK_FILES * BENCH_PACK_FILE_SIZE;
+    state->itemsPerIteration = BENCH_PACK_FILES;
+    mem::DestroyArena(arena);
+}
+
+BENCH("pack/startup_loose")         { BenchStartupLoose(state, false); }
+BENCH("pack/startup_loose_cold")    { BenchStartupLoose(state, true); }
+BENCH("pack/startup_packed")        { BenchStartupPacked(state, false); }
+BENCH("pack/startup_packed_cold")   { BenchStartupPacked(state, true); }
+
+// ========================================================
+// [INSTRUMENTATION]
+BENCH("time/get_timestamp")
+{
+    BENCH_LOOP(state)
+    {
+        u64 timestamp = time::GetTimestamp();
+        DoNotOptimize(timestamp);
+    }
+}
+
+BENCH("stats/histogram_record")
+{
+    mem::Arena* arena = mem::MakeArena(MB(1));
+    stats::Histogram histogram = stats::MakeHistogram(arena);
+    BENCH_LOOP(state)
+    {
+        stats::Record(&histogram, 1000 + (_benchIteration * 7919) % 50000);
+    }
+    DoNotOptimize(histogram.totalCount);
+    mem::DestroyArena(arena);
+}
+
+BENCH("metrics/counter_add")
+{
+    BENCH_LOOP(state)
+    {
+        METRIC_ADD("bench.counter", _benchIteration);
+    }
+}
+
+BENCH("log/message")
+{
+    BENCH_LOOP(state)
+    {
+        LOG_AT(LOG_LEVEL_DEBUG, "BENCH", "message %llu from %s, %.2f", _benchIteration, "bench", 1.5);
+    }
+    FlushLog();
+}
+
+#if _PROFILE
+BENCH("profile/zone")
+{
+    BENCH_LOOP(state)
+    {
+        PROFILE_SCOPE("bench::Zone");
+    }
+    profile::FrameMark();
+}
+#endif
+
+};
+};
@@ -0,0 +1,3683 @@
+// ========================================================
+// BENCH MATH
+// Benchmarks for matrix operations, batched transforms, frustum tests, random numbers, culling,
+// BVH and raycasts.
+// @Caio Guedes, 2023
+// ========================================================
+
+namespace ty
+{
+namespace bench
+{
+
+#define BENCH_MATH_COUNT 1024
+
+// Random rigid transforms with scale, like scene node transforms.
+void FillTransforms(m4f* transforms, u64 count)
+{
+    for(u64 i = 0; i < count; i++)
+    {
+        v3f axis = math::Normalize(math::RandomUniformV3F(-1, 1) + v3f{0, 0.001f, 0});
+        transforms[i] = math::TranslationMatrix(math::RandomUniformV3F(-100, 100))
+            * math::RotationMatrix(math::RandomUniformF32(0, 2 * PI), axis)
+            * math::ScaleMatrix(math::RandomUniformV3F(0.5f, 2));
+    }
+}
+
+BENCH("math/m4f_mul")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_MATH_COUNT * sizeof(m4f) * 2 + KB(1));
+    m4f* a = (m4f*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(m4f));
+    m4f* b = (m4f*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(m4f));
+    FillTransforms(a, BENCH_MATH_COUNT);
+    FillTransforms(b, BENCH_MATH_COUNT);
+    BENCH_LOOP(state)
+    {
+        u64 i = _benchIteration % BENCH_MATH_COUNT;
+        m4f result = a[i] * b[i];
+        DoNotOptimize(result);
+    }
+    state->itemsPerIteration = 1;
+    mem::DestroyArena(arena);
+}
+
+BENCH("math/m4f_mul_v4f")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_MATH_COUNT * sizeof(m4f) + KB(1));
+    m4f* a = (m4f*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(m4f));
+    FillTransforms(a, BENCH_MATH_COUNT);
+    v4f v = {1, 2, 3, 1};
+    BENCH_LOOP(state)
+    {
+        v4f result = a[_benchIteration % BENCH_MATH_COUNT] * v;
+        DoNotOptimize(result);
+    }
+    state->itemsPerIteration = 1;
+    mem::DestroyArena(arena);
+}
+
+BENCH("math/m4f_inverse")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_MATH_COUNT * sizeof(m4f) + KB(1));
+    m4f* a = (m4f*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(m4f));
+    FillTransforms(a, BENCH_MATH_COUNT);
+    BENCH_LOOP(state)
+    {
+        m4f result = math::Inverse(a[_benchIteration % BENCH_MATH_COUNT]);
+        DoNotOptimize(result);
+    }
+    state->itemsPerIteration = 1;
+    mem::DestroyArena(arena);
+}
+
+BENCH("math/m4f_transpose")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_MATH_COUNT * sizeof(m4f) + KB(1));
+    m4f* a = (m4f*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(m4f));
+    FillTransforms(a, BENCH_MATH_COUNT);
+    BENCH_LOOP(state)
+    {
+        m4f result = math::Transpose(a[_benchIteration % BENCH_MATH_COUNT]);
+        DoNotOptimize(result);
+    }
+    state->itemsPerIteration = 1;
+    mem::DestroyArena(arena);
+}
+
+// The SIMD products, transpose and inverse do the scalar versions' operations in the same
+// order, so they give the same bits. Builds that let the compiler fuse or reorder them
+// (FMA, NEON where scalar multiply-adds get fused, -Ofast release builds) round differently,
+// and get a bound relative to the largest element instead.
+#if TY_SIMD_FMA || TY_SIMD_NEON || defined(__FAST_MATH__)
+#define BENCH_MATRIX_MAX_ERROR 1e-5f
+#else
+#define BENCH_MATRIX_MAX_ERROR 0
+#endif
+
+void ExpectScalarMatch(CheckState* state, const char* op, u64 index, const f32* simd, const f32* scalar, u32 count)
+{
+    f32 scale = 1;
+    for(u32 i = 0; i < count; i++)
+    {
+        scale = MAX(scale, fabsf(scalar[i]));
+    }
+    for(u32 i = 0; i < count; i++)
+    {
+        bool match = UlpDistance(simd[i], scalar[i]) == 0 || fabsf(simd[i] - scalar[i]) <= BENCH_MATRIX_MAX_ERROR * scale;
+        BENCH_EXPECT(state, match, "%s %llu, element %u: %.9g, scalar %.9g (%u ulps)",
+                op, index, i, simd[i], scalar[i], UlpDistance(simd[i], scalar[i]));
+    }
+}
+
+BENCH_CHECK("math/m4f_simd_matches_scalar")
+{
+    // Fixed cases, then transforms and random well conditioned matrices.
+    mem::Arena* arena = mem::MakeArena(MB(1));
+    u64 count = 2 * BENCH_MATH_COUNT + 4;
+    m4f* m = (m4f*)mem::ArenaPush(arena, count * sizeof(m4f), 16);
+    m4f* aligned = (m4f*)mem::ArenaPush(arena, sizeof(m4f), 16);
+    v4f* alignedV = (v4f*)mem::ArenaPush(arena, 2 * sizeof(v4f), 16);
+    m[0] = math::Identity();
+    m[1] = math::PerspectiveRH(TO_RAD(70.f), 16.f / 9.f, 0.1f, 200.f);
+    m[2] = math::ViewRH(math::Normalize(v3f{1, 0, 1}), {0, 1, 0}, math::Normalize(v3f{-1, 0, 1}), {10, -3, 250});
+    m[3] = math::ScaleMatrix({1e-3f, 1e3f, -2});
+    FillTransforms(m + 4, BENCH_MATH_COUNT);
+    math::Rng rng = math::MakeRng(38);
+    for(u64 i = 4 + BENCH_MATH_COUNT; i < count; i++)
+    {
+        for(u32 j = 0; j < 16; j++)
+        {
+            m[i].data[j] = math::RandomUniformF32(&rng, -1, 1) + (j % 5 == 0 ? 4.f : 0.f);
+        }
+    }
+
+    for(u64 i = 0; i < count; i++)
+    {
+        const m4f& a = m[i];
+        const m4f& b = m[(i + 1) % count];
+        v4f v = { math::RandomUniformF32(&rng, -10, 10), math::RandomUniformF32(&rng, -10, 10), math::RandomUniformF32(&rng, -10, 10), 1 };
+
+        m4f product = a * b;
+        m4f scalarProduct = math::MulScalar(a, b);
+        ExpectScalarMatch(state, "product", i, product.data, scalarProduct.data, 16);
+        math::MulAligned(aligned, &a, &b);
+        ExpectScalarMatch(state, "aligned product", i, aligned->data, scalarProduct.data, 16);
+
+        v4f vector = a * v;
+        v4f scalarVector = math::MulScalar(a, v);
+        ExpectScalarMatch(state, "vector product", i, vector.data, scalarVector.data, 4);
+        alignedV[0] = v;
+        math::MulAligned(&alignedV[1], &a, &alignedV[0]);
+        ExpectScalarMatch(state, "aligned vector product", i, alignedV[1].data, scalarVector.data, 4);
+
+        // Moves only, exact in every build.
+        m4f transpose = math::Transpose(a);
+        m4f scalarTranspose = math::TransposeScalar(a);
+        BENCH_EXPECT(state, !memcmp(transpose.data, scalarTranspose.data, sizeof(m4f)), "transpose %llu differs", i);
+
+        m4f inverse = math::Inverse(a);
+        m4f scalarInverse = math::InverseScalar(a);
+        ExpectScalarMatch(state, "inverse", i, inverse.data, scalarInverse.data, 16);
+    }
+    mem::DestroyArena(arena);
+}
+
+// Same transforms as affine3x4.
+void FillTransforms(affine3x4* transforms, u64 count)
+{
+    for(u64 i = 0; i < count; i++)
+    {
+        m4f transform;
+        FillTransforms(&transform, 1);
+        transforms[i] = math::ToAffine(transform);
+    }
+}
+
+BENCH("math/affine_mul")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_MATH_COUNT * sizeof(affine3x4) * 2 + KB(1));
+    affine3x4* a = (affine3x4*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(affine3x4));
+    affine3x4* b = (affine3x4*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(affine3x4));
+    FillTransforms(a, BENCH_MATH_COUNT);
+    FillTransforms(b, BENCH_MATH_COUNT);
+    BENCH_LOOP(state)
+    {
+        u64 i = _benchIteration % BENCH_MATH_COUNT;
+        affine3x4 result = a[i] * b[i];
+        DoNotOptimize(result);
+    }
+    state->itemsPerIteration = 1;
+    mem::DestroyArena(arena);
+}
+
+BENCH("math/affine_inverse_scaled")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_MATH_COUNT * sizeof(affine3x4) + KB(1));
+    affine3x4* a = (affine3x4*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(affine3x4));
+    FillTransforms(a, BENCH_MATH_COUNT);
+    BENCH_LOOP(state)
+    {
+        affine3x4 result = math::InverseScaled(a[_benchIteration % BENCH_MATH_COUNT]);
+        DoNotOptimize(result);
+    }
+    state->itemsPerIteration = 1;
+    mem::DestroyArena(arena);
+}
+
+BENCH("math/affine_inverse")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_MATH_COUNT * sizeof(affine3x4) + KB(1));
+    affine3x4* a = (affine3x4*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(affine3x4));
+    FillTransforms(a, BENCH_MATH_COUNT);
+    BENCH_LOOP(state)
+    {
+        affine3x4 result = math::Inverse(a[_benchIteration % BENCH_MATH_COUNT]);
+        DoNotOptimize(result);
+    }
+    state->itemsPerIteration = 1;
+    mem::DestroyArena(arena);
+}
+
+// Inverses computed differently only agree to rounding, relative to the largest element.
+#define BENCH_AFFINE_INVERSE_MAX_ERROR 1e-5f
+
+void ExpectInverseMatch(CheckState* state, const char* op, u64 index, const affine3x4& inverse, const m4f& expected)
+{
+    f32 scale = 1;
+    for(u32 i = 0; i < 12; i++)
+    {
+        scale = MAX(scale, fabsf(expected.data[i]));
+    }
+    for(u32 i = 0; i < 12; i++)
+    {
+        f32 error = fabsf(inverse.data[i] - expected.data[i]);
+        BENCH_EXPECT(state, error <= BENCH_AFFINE_INVERSE_MAX_ERROR * scale, "%s %llu, element %u: %.9g, math::Inverse %.9g",
+                op, index, i, inverse.data[i], expected.data[i]);
+    }
+}
+
+inline bool IsNear(f32 a, f32 b, f32 scale)
+{
+    return fabsf(a - b) <= BENCH_AFFINE_INVERSE_MAX_ERROR * MAX(scale, 1.f);
+}
+
+BENCH_CHECK("math/affine_matches_m4f")
+{
+    // Rigid transforms, then rotation, scale and translation, then random well conditioned ones
+    // with shear. Each inverse is checked on the kinds it's meant for.
+    const u64 kindCount = BENCH_MATH_COUNT / 4;
+    const u64 count = 3 * kindCount;
+    mem::Arena* arena = mem::MakeArena(MB(1));
+    affine3x4* a = (affine3x4*)mem::ArenaPush(arena, count * sizeof(affine3x4));
+    math::Rng rng = math::MakeRng(48);
+    for(u64 i = 0; i < count; i++)
+    {
+        v3f axis = math::Normalize(math::RandomUniformV3F(&rng, -1, 1) + v3f{0, 0.001f, 0});
+        m4f transform = math::TranslationMatrix(math::RandomUniformV3F(&rng, -100, 100))
+            * math::RotationMatrix(math::RandomUniformF32(&rng, 0, 2 * PI), axis);
+        if(i >= kindCount) transform = transform * math::ScaleMatrix(math::RandomUniformV3F(&rng, 0.5f, 2));
+        a[i] = math::ToAffine(transform);
+        if(i < 2 * kindCount) continue;
+        for(u32 j = 0; j < 12; j++)
+        {
+            if(j % 4 < 3) a[i].data[j] = math::RandomUniformF32(&rng, -1, 1) + (j % 5 == 0 ? 4.f : 0.f);
+        }
+    }
+
+    for(u64 i = 0; i < count; i++)
+    {
+        // Composing is the m4f product with the implicit last rows, which it keeps.
+        const affine3x4& b = a[(i + 1) % count];
+        affine3x4 product = a[i] * b;
+        m4f expected = math::ToMatrix(a[i]) * math::ToMatrix(b);
+        ExpectScalarMatch(state, "affine product", i, product.data, expected.data, 12);
+        BENCH_EXPECT(state, expected.m30 == 0 && expected.m31 == 0 && expected.m32 == 0 && expected.m33 == 1, "m4f product %llu: last row changed", i);
+
+        m4f inverse = math::Inverse(math::ToMatrix(a[i]));
+        if(i < kindCount) ExpectInverseMatch(state, "InverseRigid", i, math::InverseRigid(a[i]), inverse);
+        if(i < 2 * kindCount) ExpectInverseMatch(state, "InverseScaled", i, math::InverseScaled(a[i]), inverse);
+        ExpectInverseMatch(state, "Inverse", i, math::Inverse(a[i]), inverse);
+    }
+
+    // trs to affine matches the matrices it stands for. Back to trs gives the same values (the
+    // rotation up to sign) for positive scales; with a mirror, its affine is the same instead.
+    for(u64 i = 0; i < kindCount; i++)
+    {
+        math::trs t;
+        t.translation = math::RandomUniformV3F(&rng, -100, 100);
+        t.rotation = math::Normalize(math::quat{ math::RandomUniformF32(&rng, -1, 1), math::RandomUniformF32(&rng, -1, 1),
+                math::RandomUniformF32(&rng, -1, 1), math::RandomUniformF32(&rng, -1, 1) + 0.001f });
+        t.scale = math::RandomUniformV3F(&rng, 0.5f, 2);
+        bool mirrored = i % 4 == 0;
+        if(mirrored) t.scale.data[i / 4 % 3] = -t.scale.data[i / 4 % 3];
+        affine3x4 affine = math::ToAffine(t);
+        m4f expected = math::TranslationMatrix(t.translation) * math::RotationMatrix(t.rotation) * math::ScaleMatrix(t.scale);
+        ExpectScalarMatch(state, "trs affine", i, affine.data, expected.data, 12);
+
+        math::trs back = math::ToTRS(affine);
+        if(mirrored)
+        {
+            affine3x4 again = math::ToAffine(back);
+            for(u32 j = 0; j < 12; j++)
+            {
+                BENCH_EXPECT(state, IsNear(again.data[j], affine.data[j], fabsf(affine.data[j])), "mirrored trs %llu, element %u: %.9g, was %.9g", i, j, again.data[j], affine.data[j]);
+            }
+            continue;
+        }
+        f32 sign = math::Dot(back.rotation, t.rotation) < 0 ? -1.f : 1.f;
+        for(u32 j = 0; j < 3; j++)
+        {
+            BENCH_EXPECT(state, back.translation.data[j] == t.translation.data[j], "trs %llu, translation %u: %.9g, was %.9g", i, j, back.translation.data[j], t.translation.data[j]);
+            BENCH_EXPECT(state, IsNear(back.scale.data[j], t.scale.data[j], 1), "trs %llu, scale %u: %.9g, was %.9g", i, j, back.scale.data[j], t.scale.data[j]);
+        }
+        for(u32 j = 0; j < 4; j++)
+        {
+            BENCH_EXPECT(state, IsNear(sign * back.rotation.data[j], t.rotation.data[j], 1), "trs %llu, rotation %u: %.9g, was %.9g", i, j, sign * back.rotation.data[j], t.rotation.data[j]);
+        }
+    }
+    mem::DestroyArena(arena);
+}
+
+BENCH("math/transform_aabb")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_MATH_COUNT * sizeof(m4f) + KB(1));
+    m4f* a = (m4f*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(m4f));
+    FillTransforms(a, BENCH_MATH_COUNT);
+    math::AABB aabb = { {-1, -1, -1}, {1, 1, 1} };
+    BENCH_LOOP(state)
+    {
+        math::AABB result = math::TransformAABB(aabb, a[_benchIteration % BENCH_MATH_COUNT]);
+        DoNotOptimize(result);
+    }
+    state->itemsPerIteration = 1;
+    mem::DestroyArena(arena);
+}
+
+// ========================================================
+// [BATCH]
+BENCH("math/transform_positions")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_MATH_COUNT * sizeof(v3f) * 2 + KB(1));
+    v3f* positions = (v3f*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(v3f));
+    v3f* result = (v3f*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(v3f));
+    for(u64 i = 0; i < BENCH_MATH_COUNT; i++)
+    {
+        positions[i] = math::RandomUniformV3F(-10, 10);
+    }
+    m4f transform;
+    FillTransforms(&transform, 1);
+    BENCH_LOOP(state)
+    {
+        math::TransformPositions(result, positions, BENCH_MATH_COUNT, transform);
+        DoNotOptimize(result[0]);
+    }
+    state->itemsPerIteration = BENCH_MATH_COUNT;
+    mem::DestroyArena(arena);
+}
+
+BENCH("math/transform_aabbs")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_MATH_COUNT * (sizeof(m4f) + sizeof(math::AABB) * 2) + KB(1));
+    m4f* transforms = (m4f*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(m4f));
+    math::AABB* aabbs = (math::AABB*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(math::AABB));
+    math::AABB* result = (math::AABB*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(math::AABB));
+    FillTransforms(transforms, BENCH_MATH_COUNT);
+    for(u64 i = 0; i < BENCH_MATH_COUNT; i++)
+    {
+        v3f center = math::RandomUniformV3F(-10, 10);
+        v3f extent = math::RandomUniformV3F(0.1f, 2);
+        aabbs[i] = { center - extent, center + extent };
+    }
+    BENCH_LOOP(state)
+    {
+        math::TransformAABBs(result, aabbs, transforms, BENCH_MATH_COUNT);
+        DoNotOptimize(result[0]);
+    }
+    state->itemsPerIteration = BENCH_MATH_COUNT;
+    mem::DestroyArena(arena);
+}
+
+BENCH("math/aabb_of_positions")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_MATH_COUNT * sizeof(v3f) + KB(1));
+    v3f* positions = (v3f*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(v3f));
+    for(u64 i = 0; i < BENCH_MATH_COUNT; i++)
+    {
+        positions[i] = math::RandomUniformV3F(-10, 10);
+    }
+    BENCH_LOOP(state)
+    {
+        math::AABB result = math::GetAABB(positions[0].data, BENCH_MATH_COUNT);
+        DoNotOptimize(result);
+    }
+    state->itemsPerIteration = BENCH_MATH_COUNT;
+    mem::DestroyArena(arena);
+}
+
+// Batches match the single transforms bit for bit, and AABBs their transformed corners, except
+// with the scalar backend under fast-math, where the compiler reorders the single version's sums.
+#if TY_SIMD_SCALAR && defined(__FAST_MATH__)
+#define BENCH_BATCH_MAX_ERROR 1e-5f
+#else
+#define BENCH_BATCH_MAX_ERROR 0
+#endif
+
+void ExpectBatchMatch(CheckState* state, const char* op, u64 index, v3f batch, v3f single)
+{
+    f32 scale = MAX(1.f, MAX(fabsf(single.x), MAX(fabsf(single.y), fabsf(single.z))));
+    for(u32 i = 0; i < 3; i++)
+    {
+        bool match = UlpDistance(batch.data[i], single.data[i]) == 0 || fabsf(batch.data[i] - single.data[i]) <= BENCH_BATCH_MAX_ERROR * scale;
+        BENCH_EXPECT(state, match, "%s %llu, element %u: %.9g, single %.9g", op, index, i, batch.data[i], single.data[i]);
+    }
+}
+
+BENCH_CHECK("math/transform_batch_matches_single")
+{
+    // Odd count so the scalar tail runs. The AABB versions match min/max of the 8 transformed
+    // corners exactly for affine transforms.
+    const u64 count = 1003;
+    mem::Arena* arena = mem::MakeArena(MB(1));
+    v3f* points = (v3f*)mem::ArenaPush(arena, count * sizeof(v3f));
+    v3f* expected = (v3f*)mem::ArenaPush(arena, count * sizeof(v3f));
+    v3f* result = (v3f*)mem::ArenaPush(arena, count * sizeof(v3f));
+    f32* soa = (f32*)mem::ArenaPush(arena, count * 3 * sizeof(f32));
+    f32* soaResult = (f32*)mem::ArenaPush(arena, count * 3 * sizeof(f32));
+    m4f* transforms = (m4f*)mem::ArenaPush(arena, count * sizeof(m4f));
+    math::AABB* aabbs = (math::AABB*)mem::ArenaPush(arena, count * sizeof(math::AABB));
+    math::AABB* aabbResult = (math::AABB*)mem::ArenaPush(arena, count * sizeof(math::AABB));
+    FillTransforms(transforms, count);
+    for(u64 i = 0; i < count; i++)
+    {
+        points[i] = math::RandomUniformV3F(-10, 10);
+        soa[i] = points[i].x;
+        soa[count + i] = points[i].y;
+        soa[2 * count + i] = points[i].z;
+        v3f center = math::RandomUniformV3F(-10, 10);
+        v3f extent = math::RandomUniformV3F(0, 2);
+        aabbs[i] = { center - extent, center + extent };
+    }
+
+    // Affine ones, then a projection whose 4th row the batches ignore like the single versions.
+    m4f projection = math::PerspectiveRH(TO_RAD(70.f), 16.f / 9.f, 0.1f, 200.f);
+    const m4f* checked[] = { &transforms[0], &transforms[1], &projection };
+    for(u32 t = 0; t < ARR_LEN(checked); t++)
+    {
+        const m4f& transform = *checked[t];
+        for(u32 translate = 0; translate < 2; translate++)
+        {
+            for(u64 i = 0; i < count; i++)
+            {
+                expected[i] = translate ? math::TransformPosition(points[i], transform) : math::TransformDirection(points[i], transform);
+            }
+            const char* kind = translate ? "positions" : "directions";
+            char aos[64], inPlace[64], soaOp[64];
+            snprintf(aos, sizeof(aos), "transform %u AoS %s", t, kind);
+            snprintf(inPlace, sizeof(inPlace), "transform %u in place %s", t, kind);
+            snprintf(soaOp, sizeof(soaOp), "transform %u SoA %s", t, kind);
+            if(translate) math::TransformPositions(result, points, count, transform);
+            else math::TransformDirections(result, points, count, transform);
+            for(u64 i = 0; i < count; i++)
+            {
+                ExpectBatchMatch(state, aos, i, result[i], expected[i]);
+            }
+
+            memcpy(result, points, count * sizeof(v3f));
+            if(translate) math::TransformPositions(result, result, count, transform);
+            else math::TransformDirections(result, result, count, transform);
+            for(u64 i = 0; i < count; i++)
+            {
+                ExpectBatchMatch(state, inPlace, i, result[i], expected[i]);
+            }
+
+            f32* rx = soaResult;
+            f32* ry = soaResult + count;
+            f32* rz = soaResult + 2 * count;
+            if(translate) math::TransformPositions(rx, ry, rz, soa, soa + count, soa + 2 * count, count, transform);
+            else math::TransformDirections(rx, ry, rz, soa, soa + count, soa + 2 * count, count, transform);
+            for(u64 i = 0; i < count; i++)
+            {
+                ExpectBatchMatch(state, soaOp, i, {rx[i], ry[i], rz[i]}, expected[i]);
+            }
+        }
+    }
+
+    math::TransformAABBs(aabbResult, aabbs, count, transforms[0]);
+    for(u64 i = 0; i < count; i++)
+    {
+        math::AABB single = math::TransformAABB(aabbs[i], transforms[0]);
+        BENCH_EXPECT(state, !memcmp(&aabbResult[i], &single, sizeof(single)), "shared transform AABB %llu differs", i);
+    }
+    math::TransformAABBs(aabbResult, aabbs, transforms, count);
+    for(u64 i = 0; i < count; i++)
+    {
+        math::AABB single = math::TransformAABB(aabbs[i], transforms[i]);
+        BENCH_EXPECT(state, !memcmp(&aabbResult[i], &single, sizeof(single)), "per transform AABB %llu differs", i);
+
+        math::AABB corners = { {MAX_F32, MAX_F32, MAX_F32}, {-MAX_F32, -MAX_F32, -MAX_F32} };
+        math::AABB affineCorners = corners;
+        affine3x4 affine = math::ToAffine(transforms[i]);
+        for(u32 c = 0; c < 8; c++)
+        {
+            v3f corner =
+            {
+                (c & 1) ? aabbs[i].max.x : aabbs[i].min.x,
+                (c & 2) ? aabbs[i].max.y : aabbs[i].min.y,
+                (c & 4) ? aabbs[i].max.z : aabbs[i].min.z,
+            };
+            v3f p = math::TransformPosition(corner, transforms[i]);
+            v3f q = math::TransformPosition(corner, affine);
+            for(u32 j = 0; j < 3; j++)
+            {
+                corners.min.data[j] = MIN(corners.min.data[j], p.data[j]);
+                corners.max.data[j] = MAX(corners.max.data[j], p.data[j]);
+                affineCorners.min.data[j] = MIN(affineCorners.min.data[j], q.data[j]);
+                affineCorners.max.data[j] = MAX(affineCorners.max.data[j], q.data[j]);
+            }
+        }
+        ExpectBatchMatch(state, "AABB min corner", i, single.min, corners.min);
+        ExpectBatchMatch(state, "AABB max corner", i, single.max, corners.max);
+        math::AABB affineSingle = math::TransformAABB(aabbs[i], affine);
+        BENCH_EXPECT(state, !memcmp(&affineSingle, &single, sizeof(single)), "affine AABB %llu differs from the m4f one", i);
+        // The scalar affine TransformPosition is the one the compiler may fuse.
+        ExpectScalarMatch(state, "affine AABB corners", i, &affineSingle.min.x, &affineCorners.min.x, 6);
+    }
+    mem::DestroyArena(arena);
+}
+
+// ========================================================
+// [FRUSTUM]
+// Points and boxes scattered around the camera, roughly a third of them visible.
+math::Frustum MakeBenchFrustum()
+{
+    m4f view = math::ViewRH({1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {0, 0, 0});
+    m4f proj = math::PerspectiveRH(TO_RAD(70.f), 16.f / 9.f, 0.1f, 200.f);
+    return math::GetFrustum(view, proj);
+}
+
+BENCH("math/frustum_point")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_MATH_COUNT * sizeof(v3f) + KB(1));
+    v3f* points = (v3f*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(v3f));
+    for(u32 i = 0; i < BENCH_MATH_COUNT; i++)
+    {
+        points[i] = math::RandomUniformV3F(-150, 150);
+    }
+    math::Frustum frustum = MakeBenchFrustum();
+    BENCH_LOOP(state)
+    {
+        bool inside = math::IsInFrustum(points[_benchIteration % BENCH_MATH_COUNT], frustum);
+        DoNotOptimize(inside);
+    }
+    state->itemsPerIteration = 1;
+    mem::DestroyArena(arena);
+}
+
+BENCH("math/frustum_aabb")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_MATH_COUNT * sizeof(math::AABB) + KB(1));
+    math::AABB* boxes = (math::AABB*)mem::ArenaPush(arena, BENCH_MATH_COUNT * sizeof(math::AABB));
+    for(u32 i = 0; i < BENCH_MATH_COUNT; i++)
+    {
+        v3f center = math::RandomUniformV3F(-150, 150);
+        v3f extent = math::RandomUniformV3F(0.5f, 5);
+        boxes[i] = { center - extent, center + extent };
+    }
+    math::Frustum frustum = MakeBenchFrustum();
+    BENCH_LOOP(state)
+    {
+        bool inside = math::IsInFrustum(boxes[_benchIteration % BENCH_MATH_COUNT], frustum);
+        DoNotOptimize(inside);
+    }
+    state->itemsPerIteration = 1;
+    mem::DestroyArena(arena);
+}
+
+// ========================================================
+// [RANDOM]
+#define BENCH_RANDOM_COUNT (64 * 1024)
+
+BENCH("math/random_u64")
+{
+    math::Rng rng = math::MakeRng(1);
+    BENCH_LOOP(state)
+    {
+        u64 value = math::RandomU64(&rng);
+        DoNotOptimize(value);
+    }
+    state->itemsPerIteration = 1;
+}
+
+BENCH("math/random_f32_loop")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_RANDOM_COUNT * sizeof(f32) + KB(1));
+    f32* values = (f32*)mem::ArenaPush(arena, BENCH_RANDOM_COUNT * sizeof(f32));
+    math::Rng rng = math::MakeRng(1);
+    BENCH_LOOP(state)
+    {
+        for(u32 i = 0; i < BENCH_RANDOM_COUNT; i++)
+        {
+            values[i] = math::RandomUniformF32(&rng);
+        }
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_RANDOM_COUNT;
+    mem::DestroyArena(arena);
+}
+
+BENCH("math/random_fill_f32")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_RANDOM_COUNT * sizeof(f32) + KB(1));
+    f32* values = (f32*)mem::ArenaPush(arena, BENCH_RANDOM_COUNT * sizeof(f32));
+    math::Rng rng = math::MakeRng(1);
+    BENCH_LOOP(state)
+    {
+        math::RandomFillF32(&rng, values, BENCH_RANDOM_COUNT);
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_RANDOM_COUNT;
+    mem::DestroyArena(arena);
+}
+
+BENCH("math/random_fill_i32_bounded")
+{
+    mem::Arena* arena = mem::MakeArena(BENCH_RANDOM_COUNT * sizeof(i32) + KB(1));
+    i32* values = (i32*)mem::ArenaPush(arena, BENCH_RANDOM_COUNT * sizeof(i32));
+    math::Rng rng = math::MakeRng(1);
+    BENCH_LOOP(state)
+    {
+        math::RandomFillI32(&rng, values, BENCH_RANDOM_COUNT, -1000, 1000);
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_RANDOM_COUNT;
+    mem::DestroyArena(arena);
+}
+
+// Scalar reference for the bulk fills: stream i starts i long jumps after rng, and each step
+// takes the next number of every stream in lane order, low half first.
+struct ReferenceLanes
+{
+    math::Rng lanes[4];
+};
+
+ReferenceLanes MakeReferenceLanes(math::Rng rng)
+{
+    ReferenceLanes result;
+    for(u32 lane = 0; lane < 4; lane++)
+    {
+        result.lanes[lane] = rng;
+        math::LongJump(&rng);
+    }
+    return result;
+}
+
+u64 NextReference(math::Rng* rng)
+{
+    return math::NextXoshiro(rng->state[0], rng->state[1], rng->state[2], rng->state[3]);
+}
+
+void FillReference(ReferenceLanes* lanes, u32* result, u64 count)
+{
+    for(u64 i = 0; i < count; i += 8)
+    {
+        u32 step[8];
+        for(u32 lane = 0; lane < 4; lane++)
+        {
+            u64 value = NextReference(&lanes->lanes[lane]);
+            step[2 * lane] = (u32)value;
+            step[2 * lane + 1] = (u32)(value >> 32);
+        }
+        memcpy(result + i, step, MIN(8, count - i) * sizeof(u32));
+    }
+}
+
+// Plain rejection sampling: draw until the low half is at least 2^32 mod bound.
+u32 BoundedReference(math::Rng* rng, u32 bound)
+{
+    u32 threshold = (0 - bound) % bound;
+    for(;;)
+    {
+        u64 m = (NextReference(rng) >> 32) * bound;
+        if((u32)m >= threshold) return (u32)(m >> 32);
+    }
+}
+
+// Exact for the power of 2 ranges checked, with or without a fused multiply-add.
+inline f32 UniformReference(u32 bits, f32 start, f32 end)
+{
+    return start + ldexpf((f32)(bits >> 8), -24) * (end - start);
+}
+
+void ExpectSameRng(CheckState* state, const char* name, u64 count, const math::Rng& rng, const math::Rng& expected)
+{
+    bool match = !memcmp(rng.state, expected.state, sizeof(rng.state));
+    BENCH_EXPECT(state, match, "%s %llu: rng state differs after the fill", name, count);
+}
+
+BENCH_CHECK("math/random_matches_reference")
+{
+    // Golden values from the reference xoshiro256++ and splitmix64, so seeds give the same
+    // numbers on every backend and across changes.
+    const u64 seed = 43;
+    const u64 seeded[] = { 0xBA69EC90EB4FEF88ULL, 0x9CDE98852E60034BULL, 0x6EC624AA85685867ULL, 0xD49FFE504BFDAB7FULL };
+    const u64 numbers[] = { 0x2B05935E6F17747DULL, 0x990660BFC6A5DF45ULL, 0xE04E171981A890D4ULL };
+    const u64 jumped[] = { 0x7DE04400F9B38EEDULL, 0x76B58D10B800F701ULL };
+    const u64 longJumped[] = { 0x65E1482A640CEC85ULL, 0x424F080C0A4F4DE9ULL };
+    math::Rng rng = math::MakeRng(seed);
+    for(u32 i = 0; i < ARR_LEN(seeded); i++)
+    {
+        BENCH_EXPECT(state, rng.state[i] == seeded[i], "MakeRng(%llu) state %u: %016llx, expected %016llx", seed, i, rng.state[i], seeded[i]);
+    }
+    for(u32 i = 0; i < ARR_LEN(numbers); i++)
+    {
+        u64 value = math::RandomU64(&rng);
+        BENCH_EXPECT(state, value == numbers[i], "number %u: %016llx, expected %016llx", i, value, numbers[i]);
+    }
+    math::Jump(&rng);
+    for(u32 i = 0; i < ARR_LEN(jumped); i++)
+    {
+        u64 value = math::RandomU64(&rng);
+        BENCH_EXPECT(state, value == jumped[i], "number %u after Jump: %016llx, expected %016llx", i, value, jumped[i]);
+    }
+    math::LongJump(&rng);
+    for(u32 i = 0; i < ARR_LEN(longJumped); i++)
+    {
+        u64 value = math::RandomU64(&rng);
+        BENCH_EXPECT(state, value == longJumped[i], "number %u after LongJump: %016llx, expected %016llx", i, value, longJumped[i]);
+    }
+
+    // Bounds with no, rare and near 1/2 rejections.
+    const u32 bounds[] = { 1, 7, 1000, 0x80000001u, 0xC0000000u, 0xFFFFFFFFu };
+    for(u32 b = 0; b < ARR_LEN(bounds); b++)
+    {
+        math::Rng bounded = math::MakeRng(b);
+        math::Rng reference = bounded;
+        for(u32 i = 0; i < 1000; i++)
+        {
+            u32 value = math::RandomBoundedU32(&bounded, bounds[b]);
+            u32 expected = BoundedReference(&reference, bounds[b]);
+            BENCH_EXPECT(state, value == expected, "RandomBoundedU32 bound %u, draw %u: %u, expected %u", bounds[b], i, value, expected);
+        }
+        ExpectSameRng(state, "RandomBoundedU32", bounds[b], bounded, reference);
+    }
+
+    // Below the lane threshold, at it, and several blocks with a partial step at the end.
+    const u64 counts[] = { 100, TY_RANDOM_FILL_MIN, 3 * TY_RANDOM_FILL_BLOCK + 13 };
+    const u64 maxCount = counts[ARR_LEN(counts) - 1];
+    mem::Arena* arena = mem::MakeArena(MB(1));
+    u32* values = (u32*)mem::ArenaPush(arena, maxCount * sizeof(u32));
+    u32* bits = (u32*)mem::ArenaPush(arena, maxCount * sizeof(u32));
+    for(u32 c = 0; c < ARR_LEN(counts); c++)
+    {
+        u64 count = counts[c];
+        bool lanes = count >= TY_RANDOM_FILL_MIN;
+
+        // The numbers every fill starts from, and the rng they leave behind.
+        math::Rng start = math::MakeRng(1000 + c);
+        math::Rng expectedRng = start;
+        ReferenceLanes reference = MakeReferenceLanes(start);
+        if(lanes) FillReference(&reference, bits, count);
+        for(u64 i = 0; i < count; i++)
+        {
+            if(!lanes) bits[i] = (u32)(NextReference(&expectedRng) >> 32);
+        }
+        if(lanes) expectedRng = reference.lanes[0];
+
+        rng = start;
+        math::RandomFillU32(&rng, values, count);
+        for(u64 i = 0; i < count; i++)
+        {
+            BENCH_EXPECT(state, values[i] == bits[i], "RandomFillU32 %llu, value %llu: %08x, expected %08x", count, i, values[i], bits[i]);
+        }
+        ExpectSameRng(state, "RandomFillU32", count, rng, expectedRng);
+
+        const f32 ranges[][2] = { { 0, 1 }, { -3, 5 } };
+        for(u32 r = 0; r < ARR_LEN(ranges); r++)
+        {
+            f32* floats = (f32*)values;
+            rng = start;
+            math::RandomFillF32(&rng, floats, count, ranges[r][0], ranges[r][1]);
+            for(u64 i = 0; i < count; i++)
+            {
+                f32 expected = UniformReference(bits[i], ranges[r][0], ranges[r][1]);
+                BENCH_EXPECT(state, floats[i] == expected, "RandomFillF32 %llu in [%g, %g), value %llu: %.9g, expected %.9g", count, ranges[r][0], ranges[r][1], i, floats[i], expected);
+                BENCH_EXPECT(state, floats[i] < ranges[r][1], "RandomFillF32 %llu in [%g, %g), value %llu: %.9g reaches the end", count, ranges[r][0], ranges[r][1], i, floats[i]);
+            }
+            ExpectSameRng(state, "RandomFillF32", count, rng, expectedRng);
+        }
+
+        // A range of 2^31 + 1 rejects about half of the numbers, redrawn from stream 0 in order
+        // after each block. The whole i32 range takes the bits as they are.
+        const i32 intRanges[][2] = { { -1000, 1000 }, { -(1 << 30), 1 << 30 }, { INT32_MIN, INT32_MAX }, { 7, 7 } };
+        for(u32 r = 0; r < ARR_LEN(intRanges); r++)
+        {
+            i32 first = intRanges[r][0];
+            i32 last = intRanges[r][1];
+            u32 range = (u32)last - (u32)first + 1;
+            u32 threshold = range ? (0 - range) % range : 0;
+            math::Rng redraws = start;
+            ReferenceLanes intReference = MakeReferenceLanes(start);
+            u64 rejected = 0;
+            for(u64 offset = 0; offset < count; offset += TY_RANDOM_FILL_BLOCK)
+            {
+                u64 blockCount = MIN(count - offset, TY_RANDOM_FILL_BLOCK);
+                if(lanes) FillReference(&intReference, bits + offset, blockCount);
+                math::Rng* redraw = lanes ? &intReference.lanes[0] : &redraws;
+                for(u64 i = offset; i < offset + blockCount; i++)
+                {
+                    if(!lanes) bits[i] = (u32)(NextReference(&redraws) >> 32);
+                    u64 m = (u64)bits[i] * range;
+                    if(range && (u32)m < threshold)
+                    {
+                        // The scalar path keeps drawing from the same stream.
+                        bits[i] = (u32)first + BoundedReference(redraw, range);
+                        rejected++;
+                    }
+                    else
+                    {
+                        bits[i] = (u32)first + (range ? (u32)(m >> 32) : bits[i]);
+                    }
+                }
+            }
+
+            i32* ints = (i32*)values;
+            rng = start;
+            math::RandomFillI32(&rng, ints, count, first, last);
+            for(u64 i = 0; i < count; i++)
+            {
+                BENCH_EXPECT(state, ints[i] == (i32)bits[i], "RandomFillI32 %llu in [%d, %d], value %llu: %d, expected %d", count, first, last, i, ints[i], (i32)bits[i]);
+            }
+            ExpectSameRng(state, "RandomFillI32", count, rng, lanes ? intReference.lanes[0] : redraws);
+            if(r == 1) BENCH_EXPECT(state, rejected > 0, "RandomFillI32 %llu: no rejections to redraw", count);
+        }
+    }
+
+    // The largest number is 1 - 2^-24, single and through the fill's vector conversion. With
+    // s0 = 0 and s3 all ones the next number is all ones.
+    math::Rng ones = {};
+    ones.state[1] = 0x0123456789ABCDEFULL;
+    ones.state[2] = 0xFEDCBA9876543210ULL;
+    ones.state[3] = ~0ULL;
+    rng = ones;
+    BENCH_EXPECT(state, math::RandomU32(&rng) == 0xFFFFFFFFu, "forced state doesn't draw all ones");
+    rng = ones;
+    f32 largest = math::RandomUniformF32(&rng);
+    BENCH_EXPECT(state, largest < 1.f && largest == 1.f - ldexpf(1, -24), "RandomUniformF32 of all ones: %.9g", largest);
+    rng = ones;
+    math::RandomFillF32(&rng, (f32*)values, TY_RANDOM_FILL_MIN);
+    for(u32 i = 0; i < 2; i++)
+    {
+        f32 value = ((f32*)values)[i];
+        BENCH_EXPECT(state, value < 1.f && value == 1.f - ldexpf(1, -24), "RandomFillF32 of all ones, value %u: %.9g", i, value);
+    }
+    rng = math::MakeRng(seed);
+    for(u32 i = 0; i < 1000000; i++)
+    {
+        f32 value = math::RandomUniformF32(&rng);
+        BENCH_EXPECT(state, value >= 0 && value < 1.f, "RandomUniformF32 draw %u: %.9g", i, value);
+    }
+    mem::DestroyArena(arena);
+}
+
+// ========================================================
+// [APPROX]
+// libm loops against core/approx's arrays, over the same inputs.
+#define BENCH_APPROX_COUNT (16 * 1024)
+
+struct ApproxBuffers
+{
+    mem::Arena* arena;
+    f32* x;                     // Inputs.
+    f32* y;
+    f32* a;                     // Outputs.
+    f32* b;
+};
+
+ApproxBuffers MakeApproxBuffers(f32 start, f32 end)
+{
+    ApproxBuffers result;
+    result.arena = mem::MakeArena(BENCH_APPROX_COUNT * sizeof(f32) * 5 + KB(1));  // One spare buffer.
+    result.x = (f32*)mem::ArenaPush(result.arena, BENCH_APPROX_COUNT * sizeof(f32));
+    result.y = (f32*)mem::ArenaPush(result.arena, BENCH_APPROX_COUNT * sizeof(f32));
+    result.a = (f32*)mem::ArenaPush(result.arena, BENCH_APPROX_COUNT * sizeof(f32));
+    result.b = (f32*)mem::ArenaPush(result.arena, BENCH_APPROX_COUNT * sizeof(f32));
+    math::Rng rng = math::MakeRng(1);
+    math::RandomFillF32(&rng, result.x, BENCH_APPROX_COUNT, start, end);
+    math::RandomFillF32(&rng, result.y, BENCH_APPROX_COUNT, start, end);
+    return result;
+}
+
+BENCH("approx/sincos_libm")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(-100, 100);
+    BENCH_LOOP(state)
+    {
+        for(u64 i = 0; i < BENCH_APPROX_COUNT; i++)
+        {
+            buffers.a[i] = sinf(buffers.x[i]);
+            buffers.b[i] = cosf(buffers.x[i]);
+        }
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT;
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH("approx/sincos")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(-100, 100);
+    BENCH_LOOP(state)
+    {
+        approx::SinCos(buffers.x, buffers.a, buffers.b, BENCH_APPROX_COUNT);
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT;
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH("approx/exp_libm")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(-80, 80);
+    BENCH_LOOP(state)
+    {
+        for(u64 i = 0; i < BENCH_APPROX_COUNT; i++)
+        {
+            buffers.a[i] = expf(buffers.x[i]);
+        }
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT;
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH("approx/exp")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(-80, 80);
+    BENCH_LOOP(state)
+    {
+        approx::Exp(buffers.x, buffers.a, BENCH_APPROX_COUNT);
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT;
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH("approx/log_libm")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(0.001f, 1000);
+    BENCH_LOOP(state)
+    {
+        for(u64 i = 0; i < BENCH_APPROX_COUNT; i++)
+        {
+            buffers.a[i] = logf(buffers.x[i]);
+        }
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT;
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH("approx/log")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(0.001f, 1000);
+    BENCH_LOOP(state)
+    {
+        approx::Log(buffers.x, buffers.a, BENCH_APPROX_COUNT);
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT;
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH("approx/atan2_libm")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(-10, 10);
+    BENCH_LOOP(state)
+    {
+        for(u64 i = 0; i < BENCH_APPROX_COUNT; i++)
+        {
+            buffers.a[i] = atan2f(buffers.y[i], buffers.x[i]);
+        }
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT;
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH("approx/atan2")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(-10, 10);
+    BENCH_LOOP(state)
+    {
+        approx::Atan2(buffers.y, buffers.x, buffers.a, BENCH_APPROX_COUNT);
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT;
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH("approx/rsqrt_libm")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(0.001f, 1000);
+    BENCH_LOOP(state)
+    {
+        for(u64 i = 0; i < BENCH_APPROX_COUNT; i++)
+        {
+            buffers.a[i] = 1.f / sqrtf(buffers.x[i]);
+        }
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT;
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH("approx/rsqrt")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(0.001f, 1000);
+    BENCH_LOOP(state)
+    {
+        approx::Rsqrt(buffers.x, buffers.a, BENCH_APPROX_COUNT);
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT;
+    mem::DestroyArena(buffers.arena);
+}
+
+// Accuracy sweeps against double precision libm over the ranges documented in
+// core/approx.hpp, failing when an error goes over its table. Array results must also match
+// the scalar versions bit for bit, except with the scalar backend under fast-math, where the
+// compiler reorders each inlined copy of a kernel its own way.
+#define BENCH_APPROX_CHECK_COUNT (1024 * 1024)
+#if TY_SIMD_SCALAR && defined(__FAST_MATH__)
+#define BENCH_APPROX_MAX_ULPS 2
+#else
+#define BENCH_APPROX_MAX_ULPS 0
+#endif
+
+struct ApproxError
+{
+    f64 error = 0;
+    f32 x = 0;
+    f32 y = 0;
+};
+
+inline void TrackError(ApproxError* result, f64 error, f32 x, f32 y = 0)
+{
+    if(error > result->error)
+    {
+        result->error = error;
+        result->x = x;
+        result->y = y;
+    }
+}
+
+void ExpectMaxError(CheckState* state, const char* name, ApproxError error, f64 bound)
+{
+    BENCH_EXPECT(state, error.error <= bound, "%s error %.3g at x = %.9g, y = %.9g, documented %.3g",
+            name, error.error, error.x, error.y, bound);
+}
+
+void ExpectSameResults(CheckState* state, const char* name, const f32* array, const f32* scalar, u64 count)
+{
+    for(u64 i = 0; i < count; i++)
+    {
+        BENCH_EXPECT(state, UlpDistance(array[i], scalar[i]) <= BENCH_APPROX_MAX_ULPS, "%s array %.9g, scalar %.9g at %llu",
+                name, array[i], scalar[i], i);
+    }
+}
+
+// Positive floats spread evenly over exponents [minExponent, maxExponent].
+void FillLogUniform(math::Rng* rng, f32* result, u64 count, i32 minExponent, i32 maxExponent)
+{
+    for(u64 i = 0; i < count; i++)
+    {
+        i32 exponent = minExponent + (i32)math::RandomBoundedU32(rng, (u32)(maxExponent - minExponent + 1));
+        result[i] = ldexpf(math::RandomUniformF32(rng, 1, 2), exponent);
+    }
+}
+
+BENCH_CHECK("approx/sincos_accuracy")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(0, 1);
+    math::Rng rng = math::MakeRng(44);
+    f32 ranges[] = { 8192, 65536 };
+    f64 bounds[] = { 9.4e-8, 9.7e-7 };
+    for(u32 r = 0; r < ARR_LEN(ranges); r++)
+    {
+        ApproxError sinError = {};
+        ApproxError cosError = {};
+        for(u64 start = 0; start < BENCH_APPROX_CHECK_COUNT; start += BENCH_APPROX_COUNT)
+        {
+            math::RandomFillF32(&rng, buffers.x, BENCH_APPROX_COUNT, -ranges[r], ranges[r]);
+            approx::SinCos(buffers.x, buffers.a, buffers.b, BENCH_APPROX_COUNT);
+            approx::Sin(buffers.x, buffers.y, BENCH_APPROX_COUNT);
+            ExpectSameResults(state, "sin", buffers.y, buffers.a, BENCH_APPROX_COUNT);
+            approx::Cos(buffers.x, buffers.y, BENCH_APPROX_COUNT);
+            ExpectSameResults(state, "cos", buffers.y, buffers.b, BENCH_APPROX_COUNT);
+            for(u64 i = 0; i < BENCH_APPROX_COUNT; i++)
+            {
+                f32 x = buffers.x[i];
+                f32 s;
+                f32 c;
+                approx::SinCos(x, &s, &c);
+                BENCH_EXPECT(state, UlpDistance(s, buffers.a[i]) <= BENCH_APPROX_MAX_ULPS && UlpDistance(c, buffers.b[i]) <= BENCH_APPROX_MAX_ULPS,
+                        "sincos array %.9g %.9g, scalar %.9g %.9g at x = %.9g", buffers.a[i], buffers.b[i], s, c, x);
+                TrackError(&sinError, fabs((f64)s - sin((f64)x)), x);
+                TrackError(&cosError, fabs((f64)c - cos((f64)x)), x);
+            }
+        }
+        ExpectMaxError(state, "sin", sinError, bounds[r]);
+        ExpectMaxError(state, "cos", cosError, bounds[r]);
+    }
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH_CHECK("approx/exp_accuracy")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(0, 1);
+    math::Rng rng = math::MakeRng(44);
+    ApproxError error = {};
+    for(u64 start = 0; start < BENCH_APPROX_CHECK_COUNT; start += BENCH_APPROX_COUNT)
+    {
+        math::RandomFillF32(&rng, buffers.x, BENCH_APPROX_COUNT, -87.33f, 88.37f);
+        approx::Exp(buffers.x, buffers.a, BENCH_APPROX_COUNT);
+        for(u64 i = 0; i < BENCH_APPROX_COUNT; i++)
+        {
+            f32 x = buffers.x[i];
+            buffers.b[i] = approx::Exp(x);
+            f64 reference = exp((f64)x);
+            TrackError(&error, fabs((f64)buffers.b[i] - reference) / reference, x);
+        }
+        ExpectSameResults(state, "exp", buffers.a, buffers.b, BENCH_APPROX_COUNT);
+    }
+    ExpectMaxError(state, "exp", error, 1.2e-7);
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH_CHECK("approx/log_accuracy")
+{
+    // Relative error over the whole range, absolute around 1 where log goes to 0.
+    ApproxBuffers buffers = MakeApproxBuffers(0, 1);
+    math::Rng rng = math::MakeRng(44);
+    ApproxError relativeError = {};
+    ApproxError absoluteError = {};
+    for(u64 start = 0; start < BENCH_APPROX_CHECK_COUNT; start += BENCH_APPROX_COUNT)
+    {
+        if(start % (2 * BENCH_APPROX_COUNT))
+        {
+            math::RandomFillF32(&rng, buffers.x, BENCH_APPROX_COUNT, 0.5f, 2);
+        }
+        else
+        {
+            FillLogUniform(&rng, buffers.x, BENCH_APPROX_COUNT, -126, 127);
+        }
+        approx::Log(buffers.x, buffers.a, BENCH_APPROX_COUNT);
+        for(u64 i = 0; i < BENCH_APPROX_COUNT; i++)
+        {
+            f32 x = buffers.x[i];
+            buffers.b[i] = approx::Log(x);
+            f64 reference = log((f64)x);
+            f64 error = fabs((f64)buffers.b[i] - reference);
+            if(x >= 0.5f && x <= 2)
+            {
+                TrackError(&absoluteError, error, x);
+            }
+            else
+            {
+                TrackError(&relativeError, error / fabs(reference), x);
+            }
+        }
+        ExpectSameResults(state, "log", buffers.a, buffers.b, BENCH_APPROX_COUNT);
+    }
+    ExpectMaxError(state, "log relative", relativeError, 8.2e-8);
+    ExpectMaxError(state, "log absolute", absoluteError, 4.0e-8);
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH_CHECK("approx/atan2_accuracy")
+{
+    // Both signs, magnitudes from tiny to huge, so every octant and ratio is covered.
+    ApproxBuffers buffers = MakeApproxBuffers(0, 1);
+    math::Rng rng = math::MakeRng(44);
+    ApproxError error = {};
+    for(u64 start = 0; start < BENCH_APPROX_CHECK_COUNT; start += BENCH_APPROX_COUNT)
+    {
+        if(start % (2 * BENCH_APPROX_COUNT))
+        {
+            math::RandomFillF32(&rng, buffers.x, BENCH_APPROX_COUNT, -1, 1);
+            math::RandomFillF32(&rng, buffers.y, BENCH_APPROX_COUNT, -1, 1);
+        }
+        else
+        {
+            FillLogUniform(&rng, buffers.x, BENCH_APPROX_COUNT, -126, 127);
+            FillLogUniform(&rng, buffers.y, BENCH_APPROX_COUNT, -126, 127);
+            for(u64 i = 0; i < BENCH_APPROX_COUNT; i++)
+            {
+                if(i & 1) buffers.x[i] = -buffers.x[i];
+                if(i & 2) buffers.y[i] = -buffers.y[i];
+            }
+        }
+        approx::Atan2(buffers.y, buffers.x, buffers.a, BENCH_APPROX_COUNT);
+        for(u64 i = 0; i < BENCH_APPROX_COUNT; i++)
+        {
+            f32 x = buffers.x[i];
+            f32 y = buffers.y[i];
+            buffers.b[i] = approx::Atan2(y, x);
+            TrackError(&error, fabs((f64)buffers.b[i] - atan2((f64)y, (f64)x)), x, y);
+        }
+        ExpectSameResults(state, "atan2", buffers.a, buffers.b, BENCH_APPROX_COUNT);
+    }
+    ExpectMaxError(state, "atan2", error, 2.7e-7);
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH_CHECK("approx/rsqrt_accuracy")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(0, 1);
+    math::Rng rng = math::MakeRng(44);
+    ApproxError error = {};
+    for(u64 start = 0; start < BENCH_APPROX_CHECK_COUNT; start += BENCH_APPROX_COUNT)
+    {
+        FillLogUniform(&rng, buffers.x, BENCH_APPROX_COUNT, -126, 127);
+        approx::Rsqrt(buffers.x, buffers.a, BENCH_APPROX_COUNT);
+        for(u64 i = 0; i < BENCH_APPROX_COUNT; i++)
+        {
+            f32 x = buffers.x[i];
+            buffers.b[i] = approx::Rsqrt(x);
+            f64 reference = 1.0 / sqrt((f64)x);
+            TrackError(&error, fabs((f64)buffers.b[i] - reference) / reference, x);
+        }
+        ExpectSameResults(state, "rsqrt", buffers.a, buffers.b, BENCH_APPROX_COUNT);
+    }
+    ExpectMaxError(state, "rsqrt", error, 2.8e-7);
+    mem::DestroyArena(buffers.arena);
+}
+
+// ========================================================
+// [QUANTIZE]
+// Same buffers as [APPROX], read as scalars, xyz normals or xyzw vectors.
+BENCH("quantize/f32_to_f16_scalar")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(-1000, 1000);
+    u16* half = (u16*)mem::ArenaPush(buffers.arena, BENCH_APPROX_COUNT * sizeof(u16));
+    BENCH_LOOP(state)
+    {
+        for(u64 i = 0; i < BENCH_APPROX_COUNT; i++)
+        {
+            half[i] = quantize::F32ToF16(buffers.x[i]);
+        }
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT;
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH("quantize/f32_to_f16")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(-1000, 1000);
+    u16* half = (u16*)mem::ArenaPush(buffers.arena, BENCH_APPROX_COUNT * sizeof(u16));
+    BENCH_LOOP(state)
+    {
+        quantize::F32ToF16(buffers.x, half, BENCH_APPROX_COUNT);
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT;
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH("quantize/f16_to_f32")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(-1000, 1000);
+    u16* half = (u16*)mem::ArenaPush(buffers.arena, BENCH_APPROX_COUNT * sizeof(u16));
+    quantize::F32ToF16(buffers.x, half, BENCH_APPROX_COUNT);
+    BENCH_LOOP(state)
+    {
+        quantize::F16ToF32(half, buffers.a, BENCH_APPROX_COUNT);
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT;
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH("quantize/f32_to_snorm16")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(-1, 1);
+    i16* snorm = (i16*)mem::ArenaPush(buffers.arena, BENCH_APPROX_COUNT * sizeof(i16));
+    BENCH_LOOP(state)
+    {
+        quantize::F32ToSnorm16(buffers.x, snorm, BENCH_APPROX_COUNT);
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT;
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH("quantize/encode_normals")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(-1, 1);
+    i16* encoded = (i16*)mem::ArenaPush(buffers.arena, BENCH_APPROX_COUNT * sizeof(i16));
+    BENCH_LOOP(state)
+    {
+        quantize::EncodeNormals(buffers.x, encoded, BENCH_APPROX_COUNT / 3);
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT / 3;
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH("quantize/decode_normals")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(-1, 1);
+    i16* encoded = (i16*)mem::ArenaPush(buffers.arena, BENCH_APPROX_COUNT * sizeof(i16));
+    quantize::EncodeNormals(buffers.x, encoded, BENCH_APPROX_COUNT / 3);
+    BENCH_LOOP(state)
+    {
+        quantize::DecodeNormals(encoded, buffers.a, BENCH_APPROX_COUNT / 3);
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT / 3;
+    mem::DestroyArena(buffers.arena);
+}
+
+BENCH("quantize/pack_snorm_1010102")
+{
+    ApproxBuffers buffers = MakeApproxBuffers(-1, 1);
+    u32* packed = (u32*)mem::ArenaPush(buffers.arena, BENCH_APPROX_COUNT / 4 * sizeof(u32));
+    BENCH_LOOP(state)
+    {
+        quantize::PackSnorm1010102(buffers.x, packed, BENCH_APPROX_COUNT / 4);
+        ClobberMemory();
+    }
+    state->itemsPerIteration = BENCH_APPROX_COUNT / 4;
+    mem::DestroyArena(buffers.arena);
+}
+
+// Round trips against the error table in core/quantize.hpp. Array kernels also run one
+// element at a time, which only takes their scalar leftover loop, and must give the same bits.
+#define BENCH_QUANTIZE_CHECK_COUNT (16 * 1024)
+
+// Codes must also decode to exactly code / scale, but GCC's -ffast-math divides vectors by a
+// refined reciprocal estimate that lands an ulp off. Clang's -Ofast keeps the division.
+#if defined(__FAST_MATH__) && !defined(__clang__)
+#define BENCH_QUANTIZE_EXACT_DECODES 0
+#else
+#define BENCH_QUANTIZE_EXACT_DECODES 1
+#endif
+
+template <typename In, typename Out>
+void ExpectArrayMatchesScalar(CheckState* state, const char* name, const In* values, u64 inStride,
+        Out* array, Out* single, u64 outStride, u64 count, void (*kernel)(const In*, Out*, u64))
+{
+    kernel(values, array, count);
+    for(u64 i = 0; i < count; i++)
+    {
+        kernel(values + i * inStride, single + i * outStride, 1);
+    }
+    for(u64 i = 0; i < count; i++)
+    {
+        BENCH_EXPECT(state, !memcmp(array + i * outStride, single + i * outStride, outStride * sizeof(Out)),
+                "%s array differs from scalar at %llu", name, i);
+    }
+}
+
+// Infinities and NaNs are told apart on the bits, fast-math assumes floats are finite.
+inline u32 AbsBits(f32 x)
+{
+    u32 bits;
+    memcpy(&bits, &x, sizeof(f32));
+    return bits & 0x7FFFFFFF;
+}
+
+// Angle in degrees between a direction and its unit length decoding.
+f64 AngleError(const f32* direction, const f32* decoded)
+{
+    f64 a[3] = { direction[0], direction[1], direction[2] };
+    f64 b[3] = { decoded[0], decoded[1], decoded[2] };
+    f64 cross[3] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+    f64 crossLen = sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+    return atan2(crossLen, a[0] * b[0] + a[1] * b[1] + a[2] * b[2]) * (180 / 3.14159265358979323846);
+}
+
+// Random directions of random length, the first ones the axes and diagonals.
+void FillDirections(math::Rng* rng, f32* result, u64 stride, u64 count)
+{
+    for(u64 i = 0; i < count; i++)
+    {
+        f32* d = result + i * stride;
+        if(i < 27)
+        {
+            d[0] = (f32)(i % 3) - 1;
+            d[1] = (f32)(i / 3 % 3) - 1;
+            d[2] = (f32)(i / 9) - 1;
+        }
+        else
+        {
+            v3f v = math::RandomUniformV3F(rng, -1, 1) * math::RandomUniformF32(rng, 0.01f, 100);
+            d[0] = v.x;
+            d[1] = v.y;
+            d[2] = v.z;
+        }
+        if(d[0] == 0 && d[1] == 0 && d[2] == 0)
+        {
+            d[2] = 1;               // Zero maps to +z, checked on its own.
+        }
+    }
+}
+
+BENCH_CHECK("quantize/half_round_trip")
+{
+    mem::Arena* arena = mem::MakeArena(MB(2));
+    u64 count = BENCH_QUANTIZE_CHECK_COUNT;
+    f32* values = (f32*)mem::ArenaPush(arena, count * sizeof(f32));
+    f32* decoded = (f32*)mem::ArenaPush(arena, count * sizeof(f32));
+    f32* single = (f32*)mem::ArenaPush(arena, count * sizeof(f32));
+    u16* half = (u16*)mem::ArenaPush(arena, 65536 * sizeof(u16));
+    u16* singleHalf = (u16*)mem::ArenaPush(arena, 65536 * sizeof(u16));
+
+    // Ties, denormals, the largest half and its rounding to infinity, then a spread of
+    // magnitudes from below the smallest denormal to past the largest normal.
+    f32 special[] = { 0, -0.f, 1, -1, 65504, 65519.99f, 65520, -65520, MAX_F32, 1e-8f, 2.9802322e-8f,
+                      5.9604645e-8f, 8.940697e-8f, 6.097555e-5f, 6.1035156e-5f, 1.00048828f, 1.00146484f };
+    math::Rng rng = math::MakeRng(46);
+    for(u64 i = 0; i < count; i++)
+    {
+        if(i < ARR_LEN(special))
+        {
+            values[i] = special[i];
+        }
+        else
+        {
+            i32 exponent = (i32)math::RandomBoundedU32(&rng, 44) - 27;
+            values[i] = ldexpf(math::RandomUniformF32(&rng, 1, 2), exponent) * ((i & 1) ? -1.f : 1.f);
+        }
+    }
+    ExpectArrayMatchesScalar(state, "f32 to f16", values, 1, half, singleHalf, 1, count, quantize::F32ToF16);
+    ExpectArrayMatchesScalar(state, "f16 to f32", half, 1, decoded, single, 1, count, quantize::F16ToF32);
+    for(u64 i = 0; i < count; i++)
+    {
+        f32 x = values[i];
+        f32 error = fabsf(decoded[i] - x);
+        if(fabsf(x) >= 65520)
+        {
+            BENCH_EXPECT(state, AbsBits(decoded[i]) == 0x7F800000 && (decoded[i] < 0) == (x < 0), "f16 of %.9g is %.9g, not infinity", x, decoded[i]);
+        }
+        else if(fabsf(x) >= 6.1035156e-5f)
+        {
+            BENCH_EXPECT(state, error <= ldexpf(fabsf(x), -11), "f16 of %.9g is %.9g", x, decoded[i]);
+        }
+        else
+        {
+            BENCH_EXPECT(state, error <= 5.9604645e-8f, "f16 of %.9g is %.9g", x, decoded[i]);
+        }
+    }
+
+    // Every half but the NaNs goes to float and back unchanged. NaNs only need to stay NaNs,
+    // F16C and the scalar versions treat their payloads differently.
+    f32* codeValues = (f32*)mem::ArenaPush(arena, 65536 * sizeof(f32));
+    f32* singleValues = (f32*)mem::ArenaPush(arena, 65536 * sizeof(f32));
+    u16* codes = (u16*)mem::ArenaPush(arena, 65536 * sizeof(u16));
+    u16* nanCodes = (u16*)mem::ArenaPush(arena, 2048 * sizeof(u16));
+    u64 codeCount = 0;
+    u64 nanCount = 0;
+    for(u32 i = 0; i < 65536; i++)
+    {
+        if((i & 0x7C00) == 0x7C00 && (i & 0x3FF))
+        {
+            nanCodes[nanCount++] = (u16)i;
+        }
+        else
+        {
+            codes[codeCount++] = (u16)i;
+        }
+    }
+    ExpectArrayMatchesScalar(state, "f16 code to f32", codes, 1, codeValues, singleValues, 1, codeCount, quantize::F16ToF32);
+    ExpectArrayMatchesScalar(state, "f32 to f16 code", codeValues, 1, half, singleHalf, 1, codeCount, quantize::F32ToF16);
+    for(u64 i = 0; i < codeCount; i++)
+    {
+        BENCH_EXPECT(state, half[i] == codes[i], "half %04x comes back as %04x", codes[i], half[i]);
+    }
+    quantize::F16ToF32(nanCodes, codeValues, nanCount);
+    quantize::F32ToF16(codeValues, half, nanCount);
+    for(u64 i = 0; i < nanCount; i++)
+    {
+        f32 nan = quantize::F16ToF32(nanCodes[i]);
+        u16 scalarHalf = quantize::F32ToF16(nan);
+        bool kept = AbsBits(nan) > 0x7F800000 && AbsBits(codeValues[i]) > 0x7F800000 && (half[i] & 0x7FFF) > 0x7C00 && (scalarHalf & 0x7FFF) > 0x7C00;
+        BENCH_EXPECT(state, kept, "half NaN %04x not kept", nanCodes[i]);
+    }
+    mem::DestroyArena(arena);
+}
+
+// Encodes values in and past [lo, 1], expects every one within maxError of its clamped self
+// and every code (but SNORM's extra one for -1) to decode to its exact value, code / scale
+// rounded once as the GPU does, and encode back to itself.
+template <typename T>
+void CheckNormalized(CheckState* state, const char* name, f32 lo, f64 maxError,
+        void (*encode)(const f32*, T*, u64), void (*decode)(const T*, f32*, u64))
+{
+    mem::Arena* arena = mem::MakeArena(MB(2));
+    u64 count = BENCH_QUANTIZE_CHECK_COUNT;
+    f32* values = (f32*)mem::ArenaPush(arena, count * sizeof(f32));
+    f32* decoded = (f32*)mem::ArenaPush(arena, count * sizeof(f32));
+    f32* single = (f32*)mem::ArenaPush(arena, count * sizeof(f32));
+    T* codes = (T*)mem::ArenaPush(arena, count * sizeof(T));
+    T* singleCodes = (T*)mem::ArenaPush(arena, count * sizeof(T));
+    math::Rng rng = math::MakeRng(46);
+    math::RandomFillF32(&rng, values, count, lo - 0.25f, 1.25f);
+    values[0] = lo;
+    values[1] = 0;
+    values[2] = 1;
+    ExpectArrayMatchesScalar(state, name, values, 1, codes, singleCodes, 1, count, encode);
+    ExpectArrayMatchesScalar(state, name, codes, 1, decoded, single, 1, count, decode);
+    for(u64 i = 0; i < count; i++)
+    {
+        f32 x = CLAMP(values[i], lo, 1.f);
+        BENCH_EXPECT(state, fabs((f64)decoded[i] - x) <= maxError, "%s of %.9g is %.9g", name, x, decoded[i]);
+    }
+
+    // In chunks. Rounding the double quotient gives the exact one, no code / scale is close
+    // enough to halfway between two floats for its error to matter.
+    i64 firstCode = lo < 0 ? -((i64)1 << (sizeof(T) * 8 - 1)) + 1 : 0;
+    i64 codeCount = ((i64)1 << (sizeof(T) * 8)) - (lo < 0 ? 1 : 0);
+    f64 scale = (f64)(firstCode + codeCount - 1);
+    for(i64 start = 0; start < codeCount; start += count)
+    {
+        u64 n = (u64)MIN((i64)count, codeCount - start);
+        for(u64 i = 0; i < n; i++)
+        {
+            codes[i] = (T)(firstCode + start + (i64)i);
+        }
+        decode(codes, decoded, n);
+        encode(decoded, singleCodes, n);
+        for(u64 i = 0; i < n; i++)
+        {
+#if BENCH_QUANTIZE_EXACT_DECODES
+            f32 exact = (f32)(codes[i] / scale);
+            BENCH_EXPECT(state, UlpDistance(decoded[i], exact) == 0, "%s code %lld decodes to %.9g, not %.9g",
+                    name, (i64)codes[i], decoded[i], exact);
+#endif
+            BENCH_EXPECT(state, codes[i] == singleCodes[i], "%s code %lld comes back as %lld", name, (i64)codes[i], (i64)singleCodes[i]);
+        }
+    }
+    mem::DestroyArena(arena);
+}
+
+BENCH_CHECK("quantize/normalized_round_trip")
+{
+    CheckNormalized<i8>(state, "snorm8", -1, 1.0 / 254, quantize::F32ToSnorm8, quantize::Snorm8ToF32);
+    CheckNormalized<i16>(state, "snorm16", -1, 1.0 / 65534, quantize::F32ToSnorm16, quantize::Snorm16ToF32);
+    CheckNormalized<u8>(state, "unorm8", 0, 1.0 / 510, quantize::F32ToUnorm8, quantize::Unorm8ToF32);
+    CheckNormalized<u16>(state, "unorm16", 0, 1.0 / 131070, quantize::F32ToUnorm16, quantize::Unorm16ToF32);
+}
+
+template <typename T>
+void CheckOctahedralNormals(CheckState* state, const char* name, f64 maxDegrees)
+{
+    mem::Arena* arena = mem::MakeArena(MB(2));
+    u64 count = BENCH_QUANTIZE_CHECK_COUNT;
+    f32* normals = (f32*)mem::ArenaPush(arena, count * 3 * sizeof(f32));
+    f32* decoded = (f32*)mem::ArenaPush(arena, count * 3 * sizeof(f32));
+    f32* single = (f32*)mem::ArenaPush(arena, count * 3 * sizeof(f32));
+    T* encoded = (T*)mem::ArenaPush(arena, count * 2 * sizeof(T));
+    T* singleEncoded = (T*)mem::ArenaPush(arena, count * 2 * sizeof(T));
+    math::Rng rng = math::MakeRng(46);
+    FillDirections(&rng, normals, 3, count);
+    ExpectArrayMatchesScalar(state, name, normals, 3, encoded, singleEncoded, 2, count, quantize::EncodeNormals);
+    ExpectArrayMatchesScalar(state, name, encoded, 2, decoded, single, 3, count, quantize::DecodeNormals);
+    f64 maxError = 0;
+    for(u64 i = 0; i < count; i++)
+    {
+        maxError = MAX(maxError, AngleError(normals + i * 3, decoded + i * 3));
+    }
+    BENCH_EXPECT(state, maxError <= maxDegrees, "%s error %.3g degrees, documented %.3g", name, maxError, maxDegrees);
+    mem::DestroyArena(arena);
+}
+
+BENCH_CHECK("quantize/octahedral_round_trip")
+{
+    CheckOctahedralNormals<i16>(state, "normals16", 0.0037);
+    CheckOctahedralNormals<i8>(state, "normals8", 0.95);
+
+    v3f zero = quantize::OctDecode(quantize::OctEncode({ 0, 0, 0 }));
+    BENCH_EXPECT(state, zero.x == 0 && zero.y == 0 && zero.z > 0, "zero decodes to %g %g %g", zero.x, zero.y, zero.z);
+
+    mem::Arena* arena = mem::MakeArena(MB(2));
+    u64 count = BENCH_QUANTIZE_CHECK_COUNT;
+    f32* tangents = (f32*)mem::ArenaPush(arena, count * 4 * sizeof(f32));
+    f32* decoded = (f32*)mem::ArenaPush(arena, count * 4 * sizeof(f32));
+    f32* single = (f32*)mem::ArenaPush(arena, count * 4 * sizeof(f32));
+    i16* encoded = (i16*)mem::ArenaPush(arena, count * 2 * sizeof(i16));
+    i16* singleEncoded = (i16*)mem::ArenaPush(arena, count * 2 * sizeof(i16));
+    math::Rng rng = math::MakeRng(46);
+    FillDirections(&rng, tangents, 4, count);
+    for(u64 i = 0; i < count; i++)
+    {
+        tangents[i * 4 + 3] = (i / 27) & 1 ? -1.f : 1.f;
+    }
+    ExpectArrayMatchesScalar(state, "tangents", tangents, 4, encoded, singleEncoded, 2, count, quantize::EncodeTangents);
+    ExpectArrayMatchesScalar(state, "tangents", encoded, 2, decoded, single, 4, count, quantize::DecodeTangents);
+    f64 maxError = 0;
+    for(u64 i = 0; i < count; i++)
+    {
+        maxError = MAX(maxError, AngleError(tangents + i * 4, decoded + i * 4));
+        BENCH_EXPECT(state, decoded[i * 4 + 3] == tangents[i * 4 + 3], "tangent %llu handedness flipped", i);
+    }
+    BENCH_EXPECT(state, maxError <= 0.0077, "tangents error %.3g degrees, documented 0.0077", maxError);
+    mem::DestroyArena(arena);
+}
+
+BENCH_CHECK("quantize/1010102_round_trip")
+{
+    mem::Arena* arena = mem::MakeArena(MB(2));
+    u64 count = BENCH_QUANTIZE_CHECK_COUNT;
+    f32* values = (f32*)mem::ArenaPush(arena, count * 4 * sizeof(f32));
+    f32* decoded = (f32*)mem::ArenaPush(arena, count * 4 * sizeof(f32));
+    f32* single = (f32*)mem::ArenaPush(arena, count * 4 * sizeof(f32));
+    u32* packed = (u32*)mem::ArenaPush(arena, count * sizeof(u32));
+    u32* singlePacked = (u32*)mem::ArenaPush(arena, count * sizeof(u32));
+    math::Rng rng = math::MakeRng(46);
+
+    // Every component within half a step: 1/1022 for snorm xyz, 1/2 for its w of -1, 0 or 1.
+    math::RandomFillF32(&rng, values, count * 4, -1.25f, 1.25f);
+    ExpectArrayMatchesScalar(state, "pack snorm", values, 4, packed, singlePacked, 1, count, quantize::PackSnorm1010102);
+    ExpectArrayMatchesScalar(state, "unpack snorm", packed, 1, decoded, single, 4, count, quantize::UnpackSnorm1010102);
+    for(u64 i = 0; i < count * 4; i++)
+    {
+        f32 x = CLAMP(values[i], -1.f, 1.f);
+        f64 maxError = i % 4 == 3 ? 0.5 : 1.0 / 1022;
+        BENCH_EXPECT(state, fabs((f64)decoded[i] - x) <= maxError, "snorm 1010102 component %llu of %.9g is %.9g",
+                i % 4, x, decoded[i]);
+    }
+
+    // 1/2046 for unorm xyz, 1/6 for its w in thirds.
+    math::RandomFillF32(&rng, values, count * 4, -0.25f, 1.25f);
+    ExpectArrayMatchesScalar(state, "pack unorm", values, 4, packed, singlePacked, 1, count, quantize::PackUnorm1010102);
+    ExpectArrayMatchesScalar(state, "unpack unorm", packed, 1, decoded, single, 4, count, quantize::UnpackUnorm1010102);
+    for(u64 i = 0; i < count * 4; i++)
+    {
+        f32 x = CLAMP(values[i], 0.f, 1.f);
+        f64 maxError = i % 4 == 3 ? 1.0 / 6 : 1.0 / 2046;
+        BENCH_EXPECT(state, fabs((f64)decoded[i] - x) <= maxError, "unorm 1010102 component %llu of %.9g is %.9g",
+                i % 4, x, decoded[i]);
+    }
+
+    // Every 10 bit code in xyz, and every 2 bit one in w, decodes to its exact value.
+    u64 codeCount = 1024;
+    for(u32 c = 0; c < codeCount; c++)
+    {
+        packed[c] = c | c << 10 | c << 20 | (c & 3) << 30;
+    }
+    ExpectArrayMatchesScalar(state, "unpack snorm code", packed, 1, decoded, single, 4, codeCount, quantize::UnpackSnorm1010102);
+#if BENCH_QUANTIZE_EXACT_DECODES
+    for(u32 c = 0; c < codeCount; c++)
+    {
+        f32 xyz = MAX((f32)(((i32)(c << 22) >> 22) / 511.0), -1.f);
+        f32 w = MAX((f32)((i32)(c << 30) >> 30), -1.f);
+        BENCH_EXPECT(state, decoded[c * 4] == xyz && decoded[c * 4 + 1] == xyz && decoded[c * 4 + 2] == xyz,
+                "snorm 1010102 code %u decodes to %.9g, not %.9g", c, decoded[c * 4], xyz);
+        BENCH_EXPECT(state, decoded[c * 4 + 3] == w, "snorm 1010102 w code %u decodes to %.9g, not %.9g",
+                c & 3, decoded[c * 4 + 3], w);
+    }
+#endif
+    ExpectArrayMatchesScalar(state, "unpack unorm code", packed, 1, decoded, single, 4, codeCount, quantize::UnpackUnorm1010102);
+#if BENCH_QUANTIZE_EXACT_DECODES
+    for(u32 c = 0; c < codeCount; c++)
+    {
+        f32 xyz = (f32)(c / 1023.0);
+        f32 w = (f32)((c & 3) / 3.0);
+        BENCH_EXPECT(state, decoded[c * 4] == xyz && decoded[c * 4 + 1] == xyz && decoded[c * 4 + 2] == xyz,
+                "unorm 1010102 code %u decodes to %.9g, not %.9g", c, decoded[c * 4], xyz);
+        BENCH_EXPECT(state, decoded[c * 4 + 3] == w, "unorm 1010102 w code %u decodes to %.9g, not %.9g",
+                c & 3, decoded[c * 4 + 3], w);
+    }
+#endif
+    mem::DestroyArena(arena);
+}
+
+// ========================================================
+// [CULL]
+// Whole scene of objects per iteration, same distribution as above.
+#define BENCH_CULL_COUNT 100000
+
+f32* PushRandomF32(mem::Arena* arena, u64 count, f32 start, f32 end)
+{
+    f32* result = (f32*)mem::ArenaPush(arena, count * sizeof(f32));
+    for(u64 i = 0; i < count; i++)
+    {
+        result[i] = math::RandomUniformF32(start, end);
+    }
+    return result;
+}
+
+cull::BoxArrays MakeBenchBoxes(mem::Arena* arena)
+{
+    cull::BoxArrays result = {};
+    result.centerX = PushRandomF32(arena, BENCH_CULL_COUNT, -150, 150);
+    result.centerY = PushRandomF32(arena, BENCH_CULL_COUNT, -150, 150);
+    result.centerZ = PushRandomF32(arena, BENCH_CULL_COUNT, -150, 150);
+    result.extentX = PushRandomF32(arena, BENCH_CULL_COUNT, 0.5f, 5);
+    result.extentY = PushRandomF32(arena, BENCH_CULL_COUNT, 0.5f, 5);
+    result.extentZ = PushRandomF32(arena, BENCH_CULL_COUNT, 0.5f, 5);
+    result.count = BENCH_CULL_COUNT;
+    return result;
+}
+
+BENCH("cull/boxes_100k")
+{
+    mem::Arena* arena = mem::MakeArena(MB(4));
+    cull::BoxArrays boxes = MakeBenchBoxes(arena);
+    u64* mask = (u64*)mem::ArenaPush(arena, cull::GetMaskWordCount(BENCH_CULL_COUNT) * sizeof(u64));
+    cull::CullPlanes planes = cull::MakeCullPlanes(MakeBenchFrustum());
+    BENCH_LOOP(state)
+    {
+        cull::CullBoxes(planes, boxes, mask);
+        DoNotOptimize(mask[0]);
+    }
+    state->itemsPerIteration = BENCH_CULL_COUNT;
+    mem::DestroyArena(arena);
+}
+
+BENCH("cull/boxes_100k_parallel")
+{
+    mem::Arena* arena = mem::MakeArena(MB(4));
+    cull::BoxArrays boxes = MakeBenchBoxes(arena);
+    u64* mask = (u64*)mem::ArenaPush(arena, cull::GetMaskWordCount(BENCH_CULL_COUNT) * sizeof(u64));
+    cull::CullPlanes planes = cull::MakeCullPlanes(MakeBenchFrustum());
+    BENCH_LOOP(state)
+    {
+        cull::CullBoxes(planes, boxes, mask, true);
+        DoNotOptimize(mask[0]);
+    }
+    state->itemsPerIteration = BENCH_CULL_COUNT;
+    mem::DestroyArena(arena);
+}
+
+BENCH("cull/boxes_100k_compact")
+{
+    mem::Arena* arena = mem::MakeArena(MB(4));
+    cull::BoxArrays boxes = MakeBenchBoxes(arena);
+    u32* indices = (u32*)mem::ArenaPush(arena, BENCH_CULL_COUNT * sizeof(u32));
+    cull::CullPlanes planes = cull::MakeCullPlanes(MakeBenchFrustum());
+    BENCH_LOOP(state)
+    {
+        u64 visible = cull::CullBoxesCompact(planes, boxes, indices);
+        DoNotOptimize(visible);
+    }
+    state->itemsPerIteration = BENCH_CULL_COUNT;
+    mem::DestroyArena(arena);
+}
+
+BENCH("cull/spheres_100k")
+{
+    mem::Arena* arena = mem::MakeArena(MB(4));
+    cull::SphereArrays spheres = {};
+    spheres.centerX = PushRandomF32(arena, BENCH_CULL_COUNT, -150, 150);
+    spheres.centerY = PushRandomF32(arena, BENCH_CULL_COUNT, -150, 150);
+    spheres.centerZ = PushRandomF32(arena, BENCH_CULL_COUNT, -150, 150);
+    spheres.radius = PushRandomF32(arena, BENCH_CULL_COUNT, 0.5f, 5);
+    spheres.count = BENCH_CULL_COUNT;
+    u64* mask = (u64*)mem::ArenaPush(arena, cull::GetMaskWordCount(BENCH_CULL_COUNT) * sizeof(u64));
+    cull::CullPlanes planes = cull::MakeCullPlanes(MakeBenchFrustum());
+    BENCH_LOOP(state)
+    {
+        cull::CullSpheres(planes, spheres, mask);
+        DoNotOptimize(mask[0]);
+    }
+    state->itemsPerIteration = BENCH_CULL_COUNT;
+    mem::DestroyArena(arena);
+}
+
+// math::IsInFrustum takes the corner furthest along each plane normal, cull the center
+// distance plus the projected extent. Equal in exact math, so the two only disagree when the
+// nearest plane is within rounding of the object. Returns that plane's distance relative to
+// the magnitudes summed for it.
+f32 RelativePlaneSlack(const math::Frustum& frustum, v3f center, v3f extent, f32 radius)
+{
+    f32 result = MAX_F32;
+    for(u32 i = 0; i < 6; i++)
+    {
+        v3f n = frustum.planes[i].AsXYZ();
+        v3f absN = {fabsf(n.x), fabsf(n.y), fabsf(n.z)};
+        v3f absC = {fabsf(center.x), fabsf(center.y), fabsf(center.z)};
+        f32 distance = math::Dot(n, center) + frustum.planes[i].w + math::Dot(absN, extent) + radius;
+        f32 scale = math::Dot(absN, absC) + fabsf(frustum.planes[i].w) + math::Dot(absN, extent) + radius;
+        result = MIN(result, fabsf(distance) / MAX(scale, 1.f));
+    }
+    return result;
+}
+
+bool IsSphereInFrustum(const math::Frustum& frustum, v3f center, f32 radius)
+{
+    for(u32 i = 0; i < 6; i++)
+    {
+        if(math::Dot(frustum.planes[i].AsXYZ(), center) + frustum.planes[i].w + radius < 0) return false;
+    }
+    return true;
+}
+
+// Every path gives the same mask: serial, parallel, and the compacted lists.
+void ExpectCullPathsMatch(CheckState* state, const char* kind, u64 count,
+        const u64* mask, const u64* parallelMask, const u32* compact, u64 compactCount, u32* indices)
+{
+    u64 words = cull::GetMaskWordCount(count);
+    BENCH_EXPECT(state, !memcmp(mask, parallelMask, words * sizeof(u64)), "%s, count %llu: parallel mask differs", kind, count);
+    u64 maskCount = cull::MaskToIndices(mask, count, indices);
+    BENCH_EXPECT(state, maskCount == compactCount && !memcmp(indices, compact, compactCount * sizeof(u32)),
+            "%s, count %llu: compact list differs from the mask (%llu vs %llu visible)", kind, count, compactCount, maskCount);
+    if(words)
+    {
+        u64 tailBits = count % 64 ? ~0ull << (count % 64) : 0;
+        BENCH_EXPECT(state, !(mask[words - 1] & tailBits), "%s, count %llu: bits set past the end", kind, count);
+    }
+}
+
+BENCH_CHECK("cull/matches_is_in_frustum")
+{
+    // Counts off multiples of 8 and 64 so the single tests run, and the largest one over a
+    // few parallel batches. Zero extents put some boxes down to points.
+    const u64 counts[] = { 0, 5, 77, 3 * TY_CULL_PARALLEL_BATCH + 77 };
+    const u64 maxCount = 3 * TY_CULL_PARALLEL_BATCH + 77;
+    const f32 maxSlack = 1e-5f;
+    mem::Arena* arena = mem::MakeArena(MB(4));
+    math::Rng rng = math::MakeRng(40);
+    f32* data[7];
+    for(u32 i = 0; i < 7; i++)
+    {
+        data[i] = (f32*)mem::ArenaPush(arena, maxCount * sizeof(f32), 32);
+        f32 start = i < 3 ? -150.f : 0.f;
+        f32 end = i < 3 ? 150.f : 5.f;
+        math::RandomFillF32(&rng, data[i], maxCount, start, end);
+    }
+    for(u64 i = 0; i < maxCount; i += 7)
+    {
+        data[3][i] = data[4][i] = data[5][i] = data[6][i] = 0;
+    }
+    u64* mask = (u64*)mem::ArenaPush(arena, cull::GetMaskWordCount(maxCount) * sizeof(u64));
+    u64* parallelMask = (u64*)mem::ArenaPush(arena, cull::GetMaskWordCount(maxCount) * sizeof(u64));
+    u32* compact = (u32*)mem::ArenaPush(arena, maxCount * sizeof(u32));
+    u32* indices = (u32*)mem::ArenaPush(arena, maxCount * sizeof(u32));
+    math::Frustum frustum = MakeBenchFrustum();
+    cull::CullPlanes planes = cull::MakeCullPlanes(frustum);
+
+    for(u32 c = 0; c < ARR_LEN(counts); c++)
+    {
+        u64 count = counts[c];
+        cull::BoxArrays boxes = {};
+        boxes.centerX = data[0];
+        boxes.centerY = data[1];
+        boxes.centerZ = data[2];
+        boxes.extentX = data[3];
+        boxes.extentY = data[4];
+        boxes.extentZ = data[5];
+        boxes.count = count;
+        cull::CullBoxes(planes, boxes, mask);
+        cull::CullBoxes(planes, boxes, parallelMask, true);
+        u64 compactCount = cull::CullBoxesCompact(planes, boxes, compact);
+        ExpectCullPathsMatch(state, "boxes", count, mask, parallelMask, compact, compactCount, indices);
+        for(u64 i = 0; i < count; i++)
+        {
+            v3f center = {data[0][i], data[1][i], data[2][i]};
+            v3f extent = {data[3][i], data[4][i], data[5][i]};
+            bool expected = math::IsInFrustum(math::AABB{center - extent, center + extent}, frustum);
+            bool visible = (mask[i / 64] >> (i % 64)) & 1;
+            BENCH_EXPECT(state, visible == expected || RelativePlaneSlack(frustum, center, extent, 0) <= maxSlack,
+                    "box %llu of %llu: culled %d, IsInFrustum %d", i, count, !visible, expected);
+        }
+
+        cull::SphereArrays spheres = {};
+        spheres.centerX = data[0];
+        spheres.centerY = data[1];
+        spheres.centerZ = data[2];
+        spheres.radius = data[6];
+        spheres.count = count;
+        cull::CullSpheres(planes, spheres, mask);
+        cull::CullSpheres(planes, spheres, parallelMask, true);
+        compactCount = cull::CullSpheresCompact(planes, spheres, compact);
+        ExpectCullPathsMatch(state, "spheres", count, mask, parallelMask, compact, compactCount, indices);
+        for(u64 i = 0; i < count; i++)
+        {
+            v3f center = {data[0][i], data[1][i], data[2][i]};
+            bool expected = data[6][i] ? IsSphereInFrustum(frustum, center, data[6][i]) : math::IsInFrustum(center, frustum);
+            bool visible = (mask[i / 64] >> (i % 64)) & 1;
+            BENCH_EXPECT(state, visible == expected || RelativePlaneSlack(frustum, center, {}, data[6][i]) <= maxSlack,
+                    "sphere %llu of %llu: culled %d, expected %d", i, count, !visible, expected);
+        }
+    }
+    mem::DestroyArena(arena);
+}
+
+// ========================================================
+// [OCCLUSION]
+// Walls standing on a floor around the [CULL] camera, seen from 2 units above it.
+#define BENCH_OCCLUSION_WALLS 200
+
+struct BenchOccluders
+{
+    f32* positions;
+    u32* indices;
+    occlusion::Occluder occluder;
+    m4f viewProj;
+};
+
+BenchOccluders MakeBenchOccluders(mem::Arena* arena)
+{
+    BenchOccluders result = {};
+    u32 quadCount = BENCH_OCCLUSION_WALLS + 1;
+    result.positions = (f32*)mem::ArenaPush(arena, quadCount * 4 * 3 * sizeof(f32));
+    result.indices = (u32*)mem::ArenaPush(arena, quadCount * 6 * sizeof(u32));
+    math::Rng rng = math::MakeRng(1);
+    for(u32 i = 0; i < quadCount; i++)
+    {
+        v3f corners[4];
+        if(i < BENCH_OCCLUSION_WALLS)
+        {
+            v3f center = { math::RandomUniformF32(&rng, -150, 150), -2, math::RandomUniformF32(&rng, -150, 150) };
+            f32 angle = math::RandomUniformF32(&rng, 0, 2 * PI);
+            v3f side = v3f{ cosf(angle), 0, sinf(angle) } * math::RandomUniformF32(&rng, 2, 10);
+            v3f up = { 0, math::RandomUniformF32(&rng, 3, 15), 0 };
+            corners[0] = center - side;
+            corners[1] = center + side;
+            corners[2] = center + side + up;
+            corners[3] = center - side + up;
+        }
+        else
+        {
+            corners[0] = { -150, -2, 150 };
+            corners[1] = { 150, -2, 150 };
+            corners[2] = { 150, -2, -150 };
+            corners[3] = { -150, -2, -150 };
+        }
+        memcpy(result.positions + i * 12, corners, sizeof(corners));
+        u32 quad[6] = { 0, 1, 2, 0, 2, 3 };
+        for(u32 j = 0; j < 6; j++)
+        {
+            result.indices[i * 6 + j] = i * 4 + quad[j];
+        }
+    }
+    result.occluder.positions = result.positions;
+    result.occluder.indices = result.indices;
+    result.occluder.triangleCount = quadCount * 2;
+    m4f view = math::ViewRH({1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {0, 0, 0});
+    m4f proj = math::PerspectiveRH(TO_RAD(70.f), 16.f / 9.f, 0.1f, 200.f);
+    result.viewProj = proj * view;
+    return result;
+}
+
+BENCH("occlusion/render_200_walls")
+{
+    mem::Arena* arena = mem::MakeArena(MB(4));
+    BenchOccluders occluders = MakeBenchOccluders(arena);
+    occlusion::DepthBuffer buffer = occlusion::MakeDepthBuffer(arena, 320, 184, 1024);
+    BENCH_LOOP(state)
+    {
+        occlusion::Clear(&buffer, occluders.viewProj);
+        occlusion::RenderOccluders(&buffer, &occluders.occluder, 1);
+        ClobberMemory();
+    }
+    state->itemsPerIteration = occluders.occluder.triangleCount;
+    mem::DestroyArena(arena);
+}
+
+BENCH("occlusion/render_200_walls_parallel")
+{
+    mem::Arena* arena = mem::MakeArena(MB(4));
+    BenchOccluders occluders = MakeBenchOccluders(arena);
+    occlusion::DepthBuffer buffer = occlusion::MakeDepthBuffer(arena, 320, 184, 1024);
+    BENCH_LOOP(state)
+    {
+        occlusion::Clear(&buffer, occluders.viewProj);
+        occlusion::RenderOccluders(&buffer, &occluders.occluder, 1, true);
+        ClobberMemory();
+    }
+    state->itemsPerIteration = occluders.occluder.triangleCount;
+    mem::DestroyArena(arena);
+}
+
+// Boxes left by frustum culling, the mask restored every iteration.
+void BenchOcclusionCull(State* state, bool parallel)
+{
+    mem::Arena* arena = mem::MakeArena(MB(8));
+    BenchOccluders occluders = MakeBenchOccluders(arena);
+    occlusion::DepthBuffer buffer = occlusion::MakeDepthBuffer(arena, 320, 184, 1024);
+    occlusion::Clear(&buffer, occluders.viewProj);
+    occlusion::RenderOccluders(&buffer, &occluders.occluder, 1);
+    cull::BoxArrays boxes = MakeBenchBoxes(arena);
+    u64 wordCount = cull::GetMaskWordCount(BENCH_CULL_COUNT);
+    u64* frustumMask = (u64*)mem::ArenaPush(arena, wordCount * sizeof(u64));
+    u64* mask = (u64*)mem::ArenaPush(arena, wordCount * sizeof(u64));
+    cull::CullBoxes(cull::MakeCullPlanes(MakeBenchFrustum()), boxes, frustumMask);
+    BENCH_LOOP(state)
+    {
+        memcpy(mask, frustumMask, wordCount * sizeof(u64));
+        occlusion::CullBoxes(buffer, boxes, mask, parallel);
+        DoNotOptimize(mask[0]);
+    }
+    state->itemsPerIteration = cull::MaskToIndices(frustumMask, BENCH_CULL_COUNT, (u32*)mem::ArenaPush(arena, BENCH_CULL_COUNT * sizeof(u32)));
+    mem::DestroyArena(arena);
+}
+
+BENCH("occlusion/cull_boxes_100k")
+{
+    BenchOcclusionCull(state, false);
+}
+
+BENCH("occlusion/cull_boxes_100k_parallel")
+{
+    BenchOcclusionCull(state, true);
+}
+
+// Boxes on a 1/64 grid, so their AABBs give IsOccluded the same center and extent as the arrays.
+#define BENCH_OCCLUSION_CHECK_COUNT 5003
+
+inline f32 SnapToGrid(f32 x)
+{
+    return roundf(x * 64) / 64;
+}
+
+// Whether any occluder triangle crosses the segment from origin to a bit past target.
+bool IsSegmentBlocked(const BenchOccluders& occluders, v3f origin, v3f target)
+{
+    const f64 limit = 1.01;
+    f64 o[3] = { origin.x, origin.y, origin.z };
+    f64 d[3] = { (f64)target.x - origin.x, (f64)target.y - origin.y, (f64)target.z - origin.z };
+    for(u32 i = 0; i < occluders.occluder.triangleCount; i++)
+    {
+        f64 v[3][3];
+        for(u32 j = 0; j < 3; j++)
+        {
+            const f32* p = occluders.positions + occluders.indices[i * 3 + j] * 3;
+            v[j][0] = p[0];
+            v[j][1] = p[1];
+            v[j][2] = p[2];
+        }
+        f64 e1[3] = { v[1][0] - v[0][0], v[1][1] - v[0][1], v[1][2] - v[0][2] };
+        f64 e2[3] = { v[2][0] - v[0][0], v[2][1] - v[0][1], v[2][2] - v[0][2] };
+        f64 p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+        f64 det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+        if(fabs(det) < 1e-12) continue;
+        f64 s[3] = { o[0] - v[0][0], o[1] - v[0][1], o[2] - v[0][2] };
+        f64 u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / det;
+        if(u < 0 || u > 1) continue;
+        f64 q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+        f64 w = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) / det;
+        if(w < 0 || u + w > 1) continue;
+        f64 t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+        if(t > 0 && t < limit) return true;
+    }
+    return false;
+}
+
+// A point is clearly visible when it's well inside the view volume, and the segments to it and to
+// points around it, over a pixel away, reach it past every occluder.
+bool IsPointClearlyVisible(const BenchOccluders& occluders, v3f eye, v3f point, f32 pixelAngle)
+{
+    v4f clip = occluders.viewProj * v4f{ point.x, point.y, point.z, 1 };
+    if(!(clip.z > 0 && clip.z < clip.w) || fabsf(clip.x) > 0.98f * clip.w || fabsf(clip.y) > 0.98f * clip.w) return false;
+    f32 offset = 2 * pixelAngle * math::Len(point - eye);
+    v3f offsets[7] = { {}, { offset, 0, 0 }, { -offset, 0, 0 }, { 0, offset, 0 }, { 0, -offset, 0 }, { 0, 0, offset }, { 0, 0, -offset } };
+    for(u32 i = 0; i < ARR_LEN(offsets); i++)
+    {
+        if(IsSegmentBlocked(occluders, eye, point + offsets[i])) return false;
+    }
+    return true;
+}
+
+// The bench walls seen from the bench camera, then from above it turned to the side.
+#define BENCH_OCCLUSION_CHECK_VIEWS 2
+
+struct OcclusionCheckScene
+{
+    BenchOccluders occluders;
+    cull::BoxArrays boxes;
+    v3f eyes[BENCH_OCCLUSION_CHECK_VIEWS];
+    m4f viewProjs[BENCH_OCCLUSION_CHECK_VIEWS];
+    f32 pixelAngle;
+};
+
+OcclusionCheckScene MakeOcclusionCheckScene(mem::Arena* arena)
+{
+    OcclusionCheckScene result = {};
+    result.occluders = MakeBenchOccluders(arena);
+
+    // A third of the boxes anywhere, some of them around the bench camera, a third just behind
+    // a wall's top or side edge as seen from it, and a third just in front of a wall or through it.
+    const u64 n = BENCH_OCCLUSION_CHECK_COUNT;
+    f32* arrays[6];
+    for(u32 i = 0; i < ARR_LEN(arrays); i++)
+    {
+        arrays[i] = (f32*)mem::ArenaPush(arena, n * sizeof(f32));
+    }
+    math::Rng rng = math::MakeRng(47);
+    for(u64 i = 0; i < n; i++)
+    {
+        v3f center = { math::RandomUniformF32(&rng, -150, 150), math::RandomUniformF32(&rng, -2, 6), math::RandomUniformF32(&rng, -150, 20) };
+        if(i % 9 == 0) center = math::RandomUniformV3F(&rng, -3, 3);
+        f32 maxExtent = 3;
+        if(i % 3)
+        {
+            const v3f* corners = (const v3f*)(result.occluders.positions + math::RandomBoundedU32(&rng, BENCH_OCCLUSION_WALLS) * 12);
+            f32 t = math::RandomUniformF32(&rng);
+            v3f point = math::Lerp(corners[0], corners[1], math::RandomUniformF32(&rng));
+            point.y = math::Lerp(corners[0].y, corners[3].y, math::RandomUniformF32(&rng));
+            u32 edge = math::RandomBoundedU32(&rng, 3);
+            if(i % 3 == 1 && edge == 0) point = math::Lerp(corners[3], corners[2], t);
+            if(i % 3 == 1 && edge == 1) point = math::Lerp(corners[0], corners[3], t);
+            if(i % 3 == 1 && edge == 2) point = math::Lerp(corners[1], corners[2], t);
+            f32 distance = i % 3 == 1 ? math::RandomUniformF32(&rng, 0.5f, 8) : math::RandomUniformF32(&rng, -3, -0.2f);
+            center = point + math::Normalize(point) * distance;
+            maxExtent = 1;
+        }
+        arrays[0][i] = SnapToGrid(center.x);
+        arrays[1][i] = SnapToGrid(center.y);
+        arrays[2][i] = SnapToGrid(center.z);
+        for(u32 axis = 0; axis < 3; axis++)
+        {
+            arrays[3 + axis][i] = SnapToGrid(math::RandomUniformF32(&rng, 0.25f, maxExtent));
+        }
+    }
+    result.boxes.centerX = arrays[0];
+    result.boxes.centerY = arrays[1];
+    result.boxes.centerZ = arrays[2];
+    result.boxes.extentX = arrays[3];
+    result.boxes.extentY = arrays[4];
+    result.boxes.extentZ = arrays[5];
+    result.boxes.count = n;
+
+    const f32 fov = TO_RAD(70.f);
+    m4f proj = math::PerspectiveRH(fov, 16.f / 9.f, 0.1f, 200.f);
+    f32 yaw = TO_RAD(40.f);
+    result.eyes[0] = {};
+    result.eyes[1] = { 10, 4, 20 };
+    result.viewProjs[0] = proj * math::ViewRH({1, 0, 0}, {0, 1, 0}, {0, 0, 1}, result.eyes[0]);
+    result.viewProjs[1] = proj * math::ViewRH({cosf(yaw), 0, sinf(yaw)}, {0, 1, 0}, {-sinf(yaw), 0, cosf(yaw)}, result.eyes[1]);
+    result.pixelAngle = 2 * tanf(fov * 0.5f) / 184;
+    return result;
+}
+
+occlusion::DepthBuffer RenderOcclusionCheckView(mem::Arena* arena, OcclusionCheckScene* scene, u32 view, bool parallel)
+{
+    occlusion::DepthBuffer result = occlusion::MakeDepthBuffer(arena, 320, 184, 1024);
+    scene->occluders.viewProj = scene->viewProjs[view];
+    occlusion::Clear(&result, scene->viewProjs[view]);
+    occlusion::RenderOccluders(&result, &scene->occluders.occluder, 1, parallel);
+    return result;
+}
+
+BENCH_CHECK("occlusion/parallel_render_matches_serial")
+{
+    mem::Arena* arena = mem::MakeArena(MB(8));
+    OcclusionCheckScene scene = MakeOcclusionCheckScene(arena);
+    for(u32 v = 0; v < BENCH_OCCLUSION_CHECK_VIEWS; v++)
+    {
+        occlusion::DepthBuffer serial = RenderOcclusionCheckView(arena, &scene, v, false);
+        occlusion::DepthBuffer parallel = RenderOcclusionCheckView(arena, &scene, v, true);
+        BENCH_EXPECT(state, !memcmp(serial.depths.data, parallel.depths.data, serial.depths.count * sizeof(f32)), "view %u: parallel depths differ", v);
+        BENCH_EXPECT(state, !memcmp(serial.tileDepths.data, parallel.tileDepths.data, serial.tileDepths.count * sizeof(f32)), "view %u: parallel tile depths differ", v);
+
+        // Tests skip tiles by their farthest depth, so it must cover every pixel.
+        const u32 tilePixels = TY_OCCLUSION_TILE_SIZE * TY_OCCLUSION_TILE_SIZE;
+        for(u64 tile = 0; tile < serial.tileDepths.count; tile++)
+        {
+            f32 farthest = 0;
+            for(u32 i = 0; i < tilePixels; i++)
+            {
+                farthest = MAX(farthest, serial.depths.data[tile * tilePixels + i]);
+            }
+            BENCH_EXPECT(state, serial.tileDepths.data[tile] >= farthest, "view %u, tile %llu: depth %.9g, pixels up to %.9g", v, tile, serial.tileDepths.data[tile], farthest);
+        }
+    }
+    mem::DestroyArena(arena);
+}
+
+BENCH_CHECK("occlusion/cull_matches_single_boxes")
+{
+    mem::Arena* arena = mem::MakeArena(MB(8));
+    OcclusionCheckScene scene = MakeOcclusionCheckScene(arena);
+    const cull::BoxArrays& boxes = scene.boxes;
+    const u64 n = boxes.count;
+
+    // Some boxes start culled, and the bits past the count are set so changes show.
+    u64 wordCount = cull::GetMaskWordCount(n);
+    u64* initial = (u64*)mem::ArenaPush(arena, wordCount * sizeof(u64));
+    u64* serialMask = (u64*)mem::ArenaPush(arena, wordCount * sizeof(u64));
+    u64* parallelMask = (u64*)mem::ArenaPush(arena, wordCount * sizeof(u64));
+    math::Rng rng = math::MakeRng(47);
+    for(u64 word = 0; word < wordCount; word++)
+    {
+        initial[word] = math::RandomU64(&rng) | math::RandomU64(&rng);
+    }
+    u64 occludedCount = 0;
+    for(u32 v = 0; v < BENCH_OCCLUSION_CHECK_VIEWS; v++)
+    {
+        occlusion::DepthBuffer buffer = RenderOcclusionCheckView(arena, &scene, v, false);
+        memcpy(serialMask, initial, wordCount * sizeof(u64));
+        memcpy(parallelMask, initial, wordCount * sizeof(u64));
+        occlusion::CullBoxes(buffer, boxes, serialMask);
+        occlusion::CullBoxes(buffer, boxes, parallelMask, true);
+        BENCH_EXPECT(state, !memcmp(serialMask, parallelMask, wordCount * sizeof(u64)), "view %u: parallel mask differs", v);
+        u64 tail = n % 64 ? ~0ULL << (n % 64) : 0;
+        BENCH_EXPECT(state, (serialMask[wordCount - 1] & tail) == (initial[wordCount - 1] & tail), "view %u: bits past the count changed", v);
+
+        for(u64 i = 0; i < n; i++)
+        {
+            v3f center = { boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i] };
+            v3f extent = { boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i] };
+            bool occluded = occlusion::IsOccluded(buffer, { center - extent, center + extent });
+            bool tested = initial[i / 64] & (1ULL << (i % 64));
+            bool kept = serialMask[i / 64] & (1ULL << (i % 64));
+            BENCH_EXPECT(state, kept == (tested && !occluded), "view %u, box %llu: kept %d, tested %d, IsOccluded %d", v, i, kept, tested, occluded);
+            occludedCount += occluded;
+        }
+    }
+    BENCH_EXPECT(state, occludedCount > 0 && occludedCount < BENCH_OCCLUSION_CHECK_VIEWS * n, "%llu of %llu boxes occluded", occludedCount, BENCH_OCCLUSION_CHECK_VIEWS * n);
+    mem::DestroyArena(arena);
+}
+
+BENCH_CHECK("occlusion/occluded_boxes_not_visible")
+{
+    mem::Arena* arena = mem::MakeArena(MB(8));
+    OcclusionCheckScene scene = MakeOcclusionCheckScene(arena);
+    const cull::BoxArrays& boxes = scene.boxes;
+    u64 occludedCount = 0;
+    for(u32 v = 0; v < BENCH_OCCLUSION_CHECK_VIEWS; v++)
+    {
+        occlusion::DepthBuffer buffer = RenderOcclusionCheckView(arena, &scene, v, false);
+        for(u64 i = 0; i < boxes.count; i++)
+        {
+            v3f center = { boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i] };
+            v3f extent = { boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i] };
+            if(!occlusion::IsOccluded(buffer, { center - extent, center + extent })) continue;
+
+            // Corners pulled slightly inside, face centers and the center.
+            occludedCount++;
+            v3f samples[15];
+            for(u32 c = 0; c < 8; c++)
+            {
+                v3f signs = { c & 1 ? 1.f : -1.f, c & 2 ? 1.f : -1.f, c & 4 ? 1.f : -1.f };
+                samples[c] = center + extent * signs * 0.98f;
+            }
+            for(u32 axis = 0; axis < 3; axis++)
+            {
+                v3f side = {};
+                side.data[axis] = extent.data[axis] * 0.98f;
+                samples[8 + axis * 2] = center + side;
+                samples[9 + axis * 2] = center - side;
+            }
+            samples[14] = center;
+            for(u32 s = 0; s < ARR_LEN(samples); s++)
+            {
+                bool visible = IsPointClearlyVisible(scene.occluders, scene.eyes[v], samples[s], scene.pixelAngle);
+                BENCH_EXPECT(state, !visible, "view %u, box %llu: occluded, but sample %u (%g, %g, %g) is visible", v, i, s, samples[s].x, samples[s].y, samples[s].z);
+            }
+        }
+    }
+    BENCH_EXPECT(state, occludedCount > 0, "no box occluded");
+    mem::DestroyArena(arena);
+}
+
+// ========================================================
+// [CLUSTER]
+// Small lights over the [OCCLUSION] level, 8k point and 2k spot, seen by its camera.
+#define BENCH_CLUSTER_POINTS 8000
+#define BENCH_CLUSTER_SPOTS 2000
+
+void BenchClusterAssign(State* state, bool parallel)
+{
+    mem::Arena* arena = mem::MakeArena(MB(16));
+    cluster::PointLight* points = (cluster::PointLight*)mem::ArenaPush(arena, BENCH_CLUSTER_POINTS * sizeof(cluster::PointLight));
+    cluster::SpotLight* spots = (cluster::SpotLight*)mem::ArenaPush(arena, BENCH_CLUSTER_SPOTS * sizeof(cluster::SpotLight));
+    math::Rng rng = math::MakeRng(1);
+    for(u32 i = 0; i < BENCH_CLUSTER_POINTS; i++)
+    {
+        points[i].position = { math::RandomUniformF32(&rng, -150, 150), math::RandomUniformF32(&rng, -2, 12), math::RandomUniformF32(&rng, -150, 150) };
+        points[i].radius = math::RandomUniformF32(&rng, 1, 6);
+    }
+    for(u32 i = 0; i < BENCH_CLUSTER_SPOTS; i++)
+    {
+        spots[i].position = { math::RandomUniformF32(&rng, -150, 150), math::RandomUniformF32(&rng, 2, 12), math::RandomUniformF32(&rng, -150, 150) };
+        spots[i].radius = math::RandomUniformF32(&rng, 4, 15);
+        spots[i].direction = math::Normalize(v3f{ math::RandomUniformF32(&rng, -0.5f, 0.5f), -1, math::RandomUniformF32(&rng, -0.5f, 0.5f) });
+        spots[i].angle = math::RandomUniformF32(&rng, 0.2f, 0.8f);
+    }
+    m4f view = math::ViewRH({1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {0, 0, 0});
+    m4f proj = math::PerspectiveRH(TO_RAD(70.f), 16.f / 9.f, 0.1f, 200.f);
+
+    cluster::ClusterDesc desc = {};
+    desc.maxLights = BENCH_CLUSTER_POINTS + BENCH_CLUSTER_SPOTS;
+    cluster::ClusterGrid grid = cluster::MakeClusterGrid(arena, desc);
+    BENCH_LOOP(state)
+    {
+        cluster::AssignLights(&grid, view, proj, points, BENCH_CLUSTER_POINTS, spots, BENCH_CLUSTER_SPOTS, parallel);
+        DoNotOptimize(grid.indices.count);
+    }
+    state->itemsPerIteration = BENCH_CLUSTER_POINTS + BENCH_CLUSTER_SPOTS;
+    mem::DestroyArena(arena);
+}
+
+BENCH("cluster/assign_10k_lights")
+{
+    BenchClusterAssign(state, false);
+}
+
+BENCH("cluster/assign_10k_lights_parallel")
+{
+    BenchClusterAssign(state, true);
+}
+
+// Every light holding a sampled view point is in that point's cluster, for random cameras and
+// an off-center projection. Lights are packed closer than in the bench so samples hit them.
+#define BENCH_CLUSTER_CHECK_POINTS 2000
+#define BENCH_CLUSTER_CHECK_SPOTS 500
+#define BENCH_CLUSTER_CHECK_CAMERAS 6
+#define BENCH_CLUSTER_CHECK_SAMPLES 3000
+
+bool IsInClusterList(const u32* indices, u32 count, u32 light)
+{
+    for(u32 i = 0; i < count; i++)
+    {
+        if(indices[i] == light) return true;
+    }
+    return false;
+}
+
+// Both lists of each cluster in increasing order, and the same output from two grids.
+void ExpectClusterLists(CheckState* state, u32 camera, const cluster::ClusterGrid& grid, const cluster::ClusterGrid& parallel)
+{
+    for(u64 c = 0; c < grid.clusters.count; c++)
+    {
+        const cluster::Cluster& cl = grid.clusters.data[c];
+        const u32* points = grid.indices.data + cl.offset;
+        const u32* spots = points + cl.pointCount;
+        for(u32 i = 1; i < cl.pointCount; i++)
+        {
+            BENCH_EXPECT(state, points[i - 1] < points[i], "camera %u, cluster %llu: point lights out of order", camera, c);
+        }
+        for(u32 i = 1; i < cl.spotCount; i++)
+        {
+            BENCH_EXPECT(state, spots[i - 1] < spots[i], "camera %u, cluster %llu: spot lights out of order", camera, c);
+        }
+    }
+    bool same = grid.indices.count == parallel.indices.count && grid.droppedCount == parallel.droppedCount
+        && !memcmp(grid.indices.data, parallel.indices.data, grid.indices.count * sizeof(u32))
+        && !memcmp(grid.clusters.data, parallel.clusters.data, grid.clusters.count * sizeof(cluster::Cluster));
+    BENCH_EXPECT(state, same, "camera %u: parallel output differs", camera);
+}
+
+BENCH_CHECK("cluster/assign_matches_sampled_points")
+{
+    const u32 pointCount = BENCH_CLUSTER_CHECK_POINTS;
+    const u32 spotCount = BENCH_CLUSTER_CHECK_SPOTS;
+    mem::Arena* arena = mem::MakeArena(MB(64));
+    cluster::PointLight* points = (cluster::PointLight*)mem::ArenaPush(arena, pointCount * sizeof(cluster::PointLight));
+    cluster::SpotLight* spots = (cluster::SpotLight*)mem::ArenaPush(arena, spotCount * sizeof(cluster::SpotLight));
+    math::Rng rng = math::MakeRng(49);
+    for(u32 i = 0; i < pointCount; i++)
+    {
+        points[i].position = { math::RandomUniformF32(&rng, -40, 40), math::RandomUniformF32(&rng, -5, 20), math::RandomUniformF32(&rng, -40, 40) };
+        points[i].radius = math::RandomUniformF32(&rng, 0.5f, 6);
+    }
+    for(u32 i = 0; i < spotCount; i++)
+    {
+        spots[i].position = { math::RandomUniformF32(&rng, -40, 40), math::RandomUniformF32(&rng, -5, 20), math::RandomUniformF32(&rng, -40, 40) };
+        spots[i].radius = math::RandomUniformF32(&rng, 1, 15);
+        spots[i].direction = math::Normalize(math::RandomUniformV3F(&rng, -1, 1) + v3f{0, 0.001f, 0});
+        spots[i].angle = math::RandomUniformF32(&rng, 0.05f, PI / 2);
+    }
+    cluster::ClusterDesc desc = {};
+    desc.tilesX = 17;
+    desc.tilesY = 9;
+    desc.maxLights = pointCount + spotCount;
+    cluster::ClusterGrid grid = cluster::MakeClusterGrid(arena, desc);
+    cluster::ClusterGrid parallel = cluster::MakeClusterGrid(arena, desc);
+
+    u64 contained = 0;
+    for(u32 camera = 0; camera < BENCH_CLUSTER_CHECK_CAMERAS; camera++)
+    {
+        v3f eye = { math::RandomUniformF32(&rng, -30, 30), math::RandomUniformF32(&rng, 1, 10), math::RandomUniformF32(&rng, -30, 30) };
+        v3f target = { math::RandomUniformF32(&rng, -30, 30), math::RandomUniformF32(&rng, 0, 5), math::RandomUniformF32(&rng, -30, 30) };
+        v3f axisZ = math::Normalize(eye - target);
+        v3f axisX = math::Normalize(math::Cross({0, 1, 0}, axisZ));
+        m4f view = math::ViewRH(axisX, math::Cross(axisZ, axisX), axisZ, eye);
+        f32 nearDepth = 0.1f + camera * 0.2f;
+        m4f proj = math::PerspectiveRH(TO_RAD(math::RandomUniformF32(&rng, 50, 90)), 16.f / 9.f, nearDepth, 300.f);
+        if(camera == BENCH_CLUSTER_CHECK_CAMERAS - 1)
+        {
+            proj.m02 = 0.2f;
+            proj.m12 = -0.1f;
+        }
+        cluster::AssignLights(&grid, view, proj, points, pointCount, spots, spotCount);
+        cluster::AssignLights(&parallel, view, proj, points, pointCount, spots, spotCount, true);
+        ExpectClusterLists(state, camera, grid, parallel);
+
+        // View points on random pixels, denser near the camera. Lights must hold them with a
+        // margin, so rounding at their boundary doesn't count.
+        m4f invView = math::Inverse(view);
+        for(u32 s = 0; s < BENCH_CLUSTER_CHECK_SAMPLES; s++)
+        {
+            f32 screenX = math::RandomUniformF32(&rng);
+            f32 screenY = math::RandomUniformF32(&rng);
+            f32 depth = nearDepth + powf(math::RandomUniformF32(&rng), 3) * 120;
+            v4f viewPoint = { depth * (screenX * 2 - 1 + proj.m02) / proj.m00, depth * (screenY * 2 - 1 + proj.m12) / proj.m11, -depth, 1 };
+            v4f world = invView * viewPoint;
+            v3f p = world.AsXYZ();
+            u32 index = cluster::GetClusterIndex(grid, screenX, screenY, depth);
+            const cluster::Cluster& cl = grid.clusters.data[index];
+            const u32* clusterPoints = grid.indices.data + cl.offset;
+            const u32* clusterSpots = clusterPoints + cl.pointCount;
+            for(u32 i = 0; i < pointCount; i++)
+            {
+                v3f d = p - points[i].position;
+                if(math::Dot(d, d) >= points[i].radius * points[i].radius * 0.9999f) continue;
+                contained++;
+                BENCH_EXPECT(state, IsInClusterList(clusterPoints, cl.pointCount, i), "camera %u, sample %u: point light %u missing from cluster %u", camera, s, i, index);
+            }
+            for(u32 i = 0; i < spotCount; i++)
+            {
+                v3f d = p - spots[i].position;
+                f32 distSq = math::Dot(d, d);
+                if(distSq >= spots[i].radius * spots[i].radius * 0.9999f) continue;
+                if(math::Dot(d, spots[i].direction) <= sqrtf(distSq) * cosf(spots[i].angle) * 1.0001f) continue;
+                contained++;
+                BENCH_EXPECT(state, IsInClusterList(clusterSpots, cl.spotCount, i), "camera %u, sample %u: spot light %u missing from cluster %u", camera, s, i, index);
+            }
+        }
+    }
+    BENCH_EXPECT(state, contained > 0, "no sample inside a light");
+
+    // Lists that don't fit drop their highest lights: each cluster keeps a prefix of its full
+    // list, and the dropped count makes up the difference.
+    desc.maxIndices = (u32)(grid.indices.count / 2);
+    cluster::ClusterGrid clipped = cluster::MakeClusterGrid(arena, desc);
+    cluster::AssignLights(&clipped, math::Identity(), grid.proj, points, pointCount, spots, spotCount, true);
+    cluster::AssignLights(&grid, math::Identity(), grid.proj, points, pointCount, spots, spotCount);
+    BENCH_EXPECT(state, clipped.droppedCount > 0 && clipped.indices.count + clipped.droppedCount == grid.indices.count,
+            "%llu references kept, %u dropped, %llu in all", clipped.indices.count, clipped.droppedCount, grid.indices.count);
+    for(u64 c = 0; c < clipped.clusters.count; c++)
+    {
+        const cluster::Cluster& kept = clipped.clusters.data[c];
+        const cluster::Cluster& full = grid.clusters.data[c];
+        bool prefix = kept.pointCount <= full.pointCount && kept.spotCount <= full.spotCount
+            && !memcmp(clipped.indices.data + kept.offset, grid.indices.data + full.offset, kept.pointCount * sizeof(u32))
+            && !memcmp(clipped.indices.data + kept.offset + kept.pointCount, grid.indices.data + full.offset + full.pointCount, kept.spotCount * sizeof(u32));
+        BENCH_EXPECT(state, prefix, "cluster %llu: kept lists aren't a prefix of the full ones", c);
+    }
+    mem::DestroyArena(arena);
+}
+
+// ========================================================
+// [SHADOW]
+// Four cascades over the [FRUSTUM] camera, sun at an angle, [CULL] boxes as casters.
+#define BENCH_SHADOW_CASCADES 4
+
+void MakeBenchCascades(shadow::Cascade* cascades)
+{
+    shadow::CascadeDesc desc = {};
+    desc.cascadeCount = BENCH_SHADOW_CASCADES;
+    desc.shadowDistance = 120;
+    shadow::ComputeCascades(MakeBenchFrustum(), math::Normalize(v3f{0.3f, -1, 0.2f}), desc, cascades);
+}
+
+BENCH("shadow/compute_cascades")
+{
+    math::Frustum frustum = MakeBenchFrustum();
+    shadow::CascadeDesc desc = {};
+    desc.cascadeCount = BENCH_SHADOW_CASCADES;
+    shadow::Cascade cascades[BENCH_SHADOW_CASCADES];
+    BENCH_LOOP(state)
+    {
+        shadow::ComputeCascades(frustum, math::Normalize(v3f{0.3f, -1, 0.2f}), desc, cascades);
+        DoNotOptimize(cascades[0].viewProj);
+    }
+}
+
+// Clip space point divided by w, tested against the expected NDC position.
+void ExpectProjects(CheckState* state, const char* name, const m4f& proj, v3f point, v3f expected)
+{
+    v4f clip = proj * v4f{ point.x, point.y, point.z, 1 };
+    v3f ndc = clip.AsXYZ() * (1.f / clip.w);
+    for(u32 i = 0; i < 3; i++)
+    {
+        BENCH_EXPECT(state, fabsf(ndc.data[i] - expected.data[i]) <= 1e-5f, "%s, (%g, %g, %g) element %u: %.9g, expected %g",
+                name, point.x, point.y, point.z, i, ndc.data[i], expected.data[i]);
+    }
+}
+
+// Whole to the rounding of a value that size, far from the origin texel counts run high.
+inline bool IsWholeTexel(f32 texels)
+{
+    return fabsf(texels - roundf(texels)) <= MAX(1e-3f, fabsf(texels) * 1e-6f);
+}
+
+// Corners of the camera slice between two distances from the camera (perspective) or from
+// its near plane (orthographic), from the camera parameters rather than the frustum.
+struct ShadowCheckCamera
+{
+    m4f view;
+    m4f proj;
+    bool ortho;
+    f32 halfWidth;      // Per unit of distance with a perspective, of the box with an orthographic.
+    f32 halfHeight;
+    f32 nearDepth;
+};
+
+void GetSliceCorners(const ShadowCheckCamera& camera, f32 splitNear, f32 splitFar, v3f* corners)
+{
+    m4f invView = math::Inverse(camera.view);
+    for(u32 i = 0; i < 8; i++)
+    {
+        f32 depth = i < 4 ? splitNear : splitFar;
+        if(camera.ortho) depth += camera.nearDepth;
+        f32 scale = camera.ortho ? 1 : depth;
+        v4f p = { (i & 1 ? 1 : -1) * camera.halfWidth * scale, (i & 2 ? 1 : -1) * camera.halfHeight * scale, -depth, 1 };
+        corners[i] = (invView * p).AsXYZ();
+    }
+}
+
+BENCH_CHECK("shadow/cascades_cover_slices")
+{
+    // OrthoRH maps its box like PerspectiveRH maps the frustum: left top near to (-1, -1, 0),
+    // right bottom far to (1, 1, 1).
+    const f32 l = -3, r = 5, b = -2, t = 7, n = 0.5f, f = 40;
+    m4f ortho = math::OrthoRH(l, r, b, t, n, f);
+    ExpectProjects(state, "OrthoRH", ortho, { l, t, -n }, { -1, -1, 0 });
+    ExpectProjects(state, "OrthoRH", ortho, { r, b, -f }, { 1, 1, 1 });
+    f32 fov = TO_RAD(70.f);
+    f32 aspect = 16.f / 9.f;
+    f32 tanHalf = tanf(fov * 0.5f);
+    m4f perspective = math::PerspectiveRH(fov, aspect, n, f);
+    ExpectProjects(state, "PerspectiveRH", perspective, { -n * tanHalf * aspect, n * tanHalf, -n }, { -1, -1, 0 });
+    ExpectProjects(state, "PerspectiveRH", perspective, { f * tanHalf * aspect, -f * tanHalf, -f }, { 1, 1, 1 });
+
+    // The bench camera, one turned and far from the origin, and an orthographic one, each
+    // under an angled light and one straight down.
+    ShadowCheckCamera cameras[3];
+    for(u32 i = 0; i < 2; i++)
+    {
+        cameras[i].proj = math::PerspectiveRH(fov, aspect, 0.1f, 200.f);
+        cameras[i].ortho = false;
+        cameras[i].halfWidth = tanHalf * aspect;
+        cameras[i].halfHeight = tanHalf;
+        cameras[i].nearDepth = 0.1f;
+    }
+    cameras[0].view = math::ViewRH({1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {0, 0, 0});
+    cameras[1].view = math::ViewRH(math::Normalize(v3f{1, 0, 1}), {0, 1, 0}, math::Normalize(v3f{-1, 0, 1}), {1000, 50, -2000});
+    cameras[2].view = math::ViewRH({0, 0, -1}, {0, 1, 0}, {1, 0, 0}, {20, 10, 5});
+    cameras[2].proj = math::OrthoRH(-40, 40, -25, 25, 1, 150);
+    cameras[2].ortho = true;
+    cameras[2].halfWidth = 40;
+    cameras[2].halfHeight = 25;
+    cameras[2].nearDepth = 1;
+    v3f lights[2] = { math::Normalize(v3f{0.3f, -1, 0.2f}), {0, -1, 0} };
+
+    shadow::CascadeDesc desc = {};
+    desc.cascadeCount = BENCH_SHADOW_CASCADES;
+    desc.shadowDistance = 120;
+    shadow::Cascade cascades[BENCH_SHADOW_CASCADES];
+    for(u32 c = 0; c < ARR_LEN(cameras); c++)
+    {
+        for(u32 light = 0; light < ARR_LEN(lights); light++)
+        {
+            shadow::ComputeCascades(math::GetFrustum(cameras[c].view, cameras[c].proj), lights[light], desc, cascades);
+            for(u32 i = 0; i < BENCH_SHADOW_CASCADES; i++)
+            {
+                const shadow::Cascade& cascade = cascades[i];
+                if(i > 0) BENCH_EXPECT(state, cascade.splitNear == cascades[i - 1].splitFar, "camera %u, cascade %u: split gap", c, i);
+
+                // Every slice corner inside the light space box and the cascade's clip volume,
+                // to rounding relative to the box.
+                v3f corners[8];
+                GetSliceCorners(cameras[c], cascade.splitNear, cascade.splitFar, corners);
+                f32 slack = 1e-4f * (cascade.maxX - cascade.minX);
+                for(u32 j = 0; j < 8; j++)
+                {
+                    v3f p = math::TransformPosition(corners[j], cascade.view);
+                    bool inside = WITHIN(cascade.minX - slack, p.x, cascade.maxX + slack)
+                        && WITHIN(cascade.minY - slack, p.y, cascade.maxY + slack)
+                        && WITHIN(cascade.minZ - slack, p.z, cascade.maxZ + slack);
+                    BENCH_EXPECT(state, inside, "camera %u, light %u, cascade %u: corner %u (%g, %g, %g) outside the box", c, light, i, j, p.x, p.y, p.z);
+                    v4f clip = cascade.viewProj * v4f{ corners[j].x, corners[j].y, corners[j].z, 1 };
+                    inside = fabsf(clip.x) <= 1 + 1e-4f && fabsf(clip.y) <= 1 + 1e-4f && WITHIN(-1e-4f, clip.z, 1 + 1e-4f);
+                    BENCH_EXPECT(state, inside, "camera %u, light %u, cascade %u: corner %u at clip (%g, %g, %g)", c, light, i, j, clip.x, clip.y, clip.z);
+                }
+
+                // Origins on whole texels, so the map doesn't shimmer as the camera moves.
+                f32 texelsX = cascade.minX / cascade.texelSize;
+                f32 texelsY = cascade.minY / cascade.texelSize;
+                BENCH_EXPECT(state, IsWholeTexel(texelsX) && IsWholeTexel(texelsY), "camera %u, light %u, cascade %u: origin at %.9g, %.9g texels", c, light, i, texelsX, texelsY);
+            }
+        }
+    }
+
+    // Moving the camera a fraction of a texel at a time keeps the texel size, and the origins
+    // move by whole texels.
+    shadow::Cascade first[BENCH_SHADOW_CASCADES];
+    for(u32 step = 0; step < 16; step++)
+    {
+        v3f position = v3f{ 0.37f, 0.05f, -0.21f } * (f32)step;
+        m4f view = math::ViewRH({1, 0, 0}, {0, 1, 0}, {0, 0, 1}, position);
+        shadow::ComputeCascades(math::GetFrustum(view, cameras[0].proj), lights[0], desc, step ? cascades : first);
+        for(u32 i = 0; i < BENCH_SHADOW_CASCADES && step; i++)
+        {
+            BENCH_EXPECT(state, cascades[i].texelSize == first[i].texelSize, "step %u, cascade %u: texel size %.9g, was %.9g", step, i, cascades[i].texelSize, first[i].texelSize);
+            f32 movedX = (cascades[i].minX - first[i].minX) / first[i].texelSize;
+            f32 movedY = (cascades[i].minY - first[i].minY) / first[i].texelSize;
+            BENCH_EXPECT(state, IsWholeTexel(movedX) && IsWholeTexel(movedY), "step %u, cascade %u: origin moved %.9g, %.9g texels", step, i, movedX, movedY);
+        }
+    }
+}
+
+BENCH("shadow/fit_depths_100k")
+{
+    mem::Arena* arena = mem::MakeArena(MB(4));
+    cull::BoxArrays boxes = MakeBenchBoxes(arena);
+    shadow::Cascade cascades[BENCH_SHADOW_CASCADES];
+    BENCH_LOOP(state)
+    {
+        MakeBenchCascades(cascades);
+        shadow::FitCascadeDepths(cascades, BENCH_SHADOW_CASCADES, boxes);
+        DoNotOptimize(cascades[0].viewProj);
+    }
+    state->itemsPerIteration = BENCH_CULL_COUNT;
+    mem::DestroyArena(arena);
+}
+
+void BenchCullCasters(State* state, bool parallel)
+{
+    mem::Arena* arena = mem::MakeArena(MB(8));
+    cull::BoxArrays boxes = MakeBenchBoxes(arena);
+    u64* masks[BENCH_SHADOW_CASCADES];
+    for(u32 i = 0; i < BENCH_SHADOW_CASCADES; i++)
+    {
+        masks[i] = (u64*)mem::ArenaPush(arena, cull::GetMaskWordCount(BENCH_CULL_COUNT) * sizeof(u64));
+    }
+    shadow::Cascade cascades[BENCH_SHADOW_CASCADES];
+    MakeBenchCascades(cascades);
+    shadow::FitCascadeDepths(cascades, BENCH_SHADOW_CASCADES, boxes);
+    BENCH_LOOP(state)
+    {
+        shadow::CullCasters(cascades, BENCH_SHADOW_CASCADES, boxes, masks, parallel);
+        DoNotOptimize(masks[0][0]);
+    }
+    state->itemsPerIteration = BENCH_CULL_COUNT;
+    mem::DestroyArena(arena);
+}
+
+BENCH("shadow/cull_casters_100k")
+{
+    BenchCullCasters(state, false);
+}
+
+BENCH("shadow/cull_casters_100k_parallel")
+{
+    BenchCullCasters(state, true);
+}
+
+// ========================================================
+// [BVH]
+// Primitive bounds like the ones of a loaded glTF scene: objects scattered in a level, each
+// made of a few primitives of different sizes close together.
+#define BENCH_BVH_COUNT 100000
+#define BENCH_BVH_QUERIES 1024
+
+math::AABB* MakeBenchPrimitiveBounds(mem::Arena* arena)
+{
+    math::AABB* result = (math::AABB*)mem::ArenaPush(arena, BENCH_BVH_COUNT * sizeof(math::AABB));
+    v3f objectCenter = {};
+    for(u32 i = 0; i < BENCH_BVH_COUNT; i++)
+    {
+        if(i % 8 == 0) objectCenter = math::RandomUniformV3F(-500, 500) * v3f{1, 0.1f, 1};
+        v3f center = objectCenter + math::RandomUniformV3F(-2, 2);
+        v3f extent = math::RandomUniformV3F(0.1f, 1) * math::RandomUniformF32(0.5f, 4);
+        result[i] = { center - extent, center + extent };
+    }
+    return result;
+}
+
+math::Ray* MakeBenchRays(mem::Arena* arena)
+{
+    math::Ray* result = (math::Ray*)mem::ArenaPush(arena, BENCH_BVH_QUERIES * sizeof(math::Ray));
+    for(u32 i = 0; i < BENCH_BVH_QUERIES; i++)
+    {
+        result[i].origin = math::RandomUniformV3F(-500, 500) * v3f{1, 0.1f, 1};
+        result[i].direction = math::Normalize(math::RandomUniformV3F(-1, 1) * v3f{1, 0.2f, 1});
+    }
+    return result;
+}
+
+void BenchBuildBVH(State* state, bool wide)
+{
+    mem::Arena* dataArena = mem::MakeArena(BENCH_BVH_COUNT * sizeof(math::AABB) + KB(1));
+    math::AABB* bounds = MakeBenchPrimitiveBounds(dataArena);
+    mem::Arena* arena = mem::MakeArena(MB(32));
+    bvh::BuildDesc desc = {};
+    desc.wide = wide;
+    BENCH_LOOP(state)
+    {
+        mem::ArenaClear(arena);
+        bvh::BVH result = bvh::Build(arena, bounds, BENCH_BVH_COUNT, desc);
+        DoNotOptimize(result);
+    }
+    state->itemsPerIteration = BENCH_BVH_COUNT;
+    mem::DestroyArena(arena);
+    mem::DestroyArena(dataArena);
+}
+
+BENCH("bvh/build_100k")         { BenchBuildBVH(state, false); }
+BENCH("bvh/build_100k_wide")    { BenchBuildBVH(state, true); }
+
+BENCH("bvh/refit_100k")
+{
+    mem::Arena* arena = mem::MakeArena(MB(32));
+    math::AABB* bounds = MakeBenchPrimitiveBounds(arena);
+    bvh::BuildDesc desc = {};
+    desc.wide = true;
+    bvh::BVH tree = bvh::Build(arena, bounds, BENCH_BVH_COUNT, desc);
+    BENCH_LOOP(state)
+    {
+        bvh::Refit(&tree, bounds);
+        DoNotOptimize(tree.nodes[0]);
+    }
+    state->itemsPerIteration = BENCH_BVH_COUNT;
+    mem::DestroyArena(arena);
+}
+
+void BenchRaycastBVH(State* state, bool wide)
+{
+    mem::Arena* arena = mem::MakeArena(MB(32));
+    math::AABB* bounds = MakeBenchPrimitiveBounds(arena);
+    math::Ray* rays = MakeBenchRays(arena);
+    bvh::BuildDesc desc = {};
+    desc.wide = wide;
+    bvh::BVH tree = bvh::Build(arena, bounds, BENCH_BVH_COUNT, desc);
+    BENCH_LOOP(state)
+    {
+        bvh::RayHit hit = bvh::Raycast(tree, rays[_benchIteration % BENCH_BVH_QUERIES], 1000);
+        DoNotOptimize(hit);
+    }
+    state->itemsPerIteration = 1;
+    mem::DestroyArena(arena);
+}
+
+BENCH("bvh/raycast")            { BenchRaycastBVH(state, false); }
+BENCH("bvh/raycast_wide")       { BenchRaycastBVH(state, true); }
+
+BENCH("bvh/query_aabb_wide")
+{
+    mem::Arena* arena = mem::MakeArena(MB(32));
+    math::AABB* bounds = MakeBenchPrimitiveBounds(arena);
+    math::AABB* queries = (math::AABB*)mem::ArenaPush(arena, BENCH_BVH_QUERIES * sizeof(math::AABB));
+    for(u32 i = 0; i < BENCH_BVH_QUERIES; i++)
+    {
+        v3f center = math::RandomUniformV3F(-500, 500) * v3f{1, 0.1f, 1};
+        queries[i] = { center - v3f{10, 10, 10}, center + v3f{10, 10, 10} };
+    }
+    u32* result = (u32*)mem::ArenaPush(arena, BENCH_BVH_COUNT * sizeof(u32));
+    bvh::BuildDesc desc = {};
+    desc.wide = true;
+    bvh::BVH tree = bvh::Build(arena, bounds, BENCH_BVH_COUNT, desc);
+    BENCH_LOOP(state)
+    {
+        u64 count = bvh::QueryAABB(tree, queries[_benchIteration % BENCH_BVH_QUERIES], result, BENCH_BVH_COUNT);
+        DoNotOptimize(count);
+    }
+    state->itemsPerIteration = 1;
+    mem::DestroyArena(arena);
+}
+
+BENCH("bvh/query_frustum_wide")
+{
+    mem::Arena* arena = mem::MakeArena(MB(32));
+    math::AABB* bounds = MakeBenchPrimitiveBounds(arena);
+    u32* result = (u32*)mem::ArenaPush(arena, BENCH_BVH_COUNT * sizeof(u32));
+    bvh::BuildDesc desc = {};
+    desc.wide = true;
+    bvh::BVH tree = bvh::Build(arena, bounds, BENCH_BVH_COUNT, desc);
+    math::Frustum frustum = MakeBenchFrustum();
+    BENCH_LOOP(state)
+    {
+        u64 count = bvh::QueryFrustum(tree, frustum, result, BENCH_BVH_COUNT);
+        DoNotOptimize(count);
+    }
+    state->itemsPerIteration = 1;
+    mem::DestroyArena(arena);
+}
+
+// Queries return exactly the primitives a linear scan over the same bounds finds, on binary and
+// 4-wide trees, serial and parallel builds, and after a refit. Rays include axis-parallel ones,
+// whose zero direction components make the slab distances infinite.
+#define BENCH_BVH_CHECK_COUNT 5003
+
+struct BVHCheckData
+{
+    math::AABB* bounds;
+    math::AABB queries[64];
+    math::Frustum frusta[2];
+    math::Ray rays[128];
+    f32 rayTMax[128];
+    u32* result;
+    u32* expected;
+    u8* marks;
+};
+
+// Sets match when every result is expected, none repeats, and the counts are equal.
+void ExpectSameSet(CheckState* state, const char* label, const char* query, u32 index,
+        const u32* result, u64 count, const u32* expected, u64 expectedCount, u8* marks)
+{
+    memset(marks, 0, BENCH_BVH_CHECK_COUNT);
+    for(u64 i = 0; i < expectedCount; i++)
+    {
+        marks[expected[i]] = 1;
+    }
+    u64 found = 0;
+    for(u64 i = 0; i < count; i++)
+    {
+        u32 primitive = result[i];
+        if(primitive < BENCH_BVH_CHECK_COUNT && marks[primitive] == 1)
+        {
+            marks[primitive] = 2;
+            found++;
+        }
+    }
+    BENCH_EXPECT(state, found == expectedCount && count == expectedCount,
+            "%s, %s %u: %llu results, %llu of the %llu expected", label, query, index, count, found, expectedCount);
+}
+
+bool AABBOverlaps(const math::AABB& a, const math::AABB& b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x
+        && a.min.y <= b.max.y && a.max.y >= b.min.y
+        && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+void CheckBVHQueries(CheckState* state, const char* label, const bvh::BVH& tree, BVHCheckData* data)
+{
+    const u32 n = BENCH_BVH_CHECK_COUNT;
+    for(u32 q = 0; q < ARR_LEN(data->queries); q++)
+    {
+        u64 expectedCount = 0;
+        for(u32 i = 0; i < n; i++)
+        {
+            if(AABBOverlaps(data->bounds[i], data->queries[q])) data->expected[expectedCount++] = i;
+        }
+        u64 count = bvh::QueryAABB(tree, data->queries[q], data->result, n);
+        ExpectSameSet(state, label, "aabb", q, data->result, count, data->expected, expectedCount, data->marks);
+        // Short result arrays still get the full count.
+        u64 clipped = bvh::QueryAABB(tree, data->queries[q], data->result, 1);
+        BENCH_EXPECT(state, clipped == count, "%s, aabb %u: %llu matches with capacity 1, %llu without", label, q, clipped, count);
+    }
+
+    for(u32 q = 0; q < ARR_LEN(data->frusta); q++)
+    {
+        u64 expectedCount = 0;
+        for(u32 i = 0; i < n; i++)
+        {
+            if(math::IsInFrustum(data->bounds[i], data->frusta[q])) data->expected[expectedCount++] = i;
+        }
+        u64 count = bvh::QueryFrustum(tree, data->frusta[q], data->result, n);
+        ExpectSameSet(state, label, "frustum", q, data->result, count, data->expected, expectedCount, data->marks);
+    }
+
+    // Reference is the slab test the leaves use, with the exit distance grown, for boxes
+    // starting within tMax. It must also keep every box math::IntersectRayAABB hits.
+    for(u32 q = 0; q < ARR_LEN(data->rays); q++)
+    {
+        const math::Ray& ray = data->rays[q];
+        f32 tMax = data->rayTMax[q];
+        bvh::RayQuery leaf = {};
+        leaf.Init(ray, tMax);
+        u64 expectedCount = 0;
+        u32 nearest = HANDLE_INVALID;
+        f32 nearestT = MAX_F32;
+        for(u32 i = 0; i < n; i++)
+        {
+            f32 t;
+            bool hit = leaf.Test(data->bounds[i], &t);
+            f32 exactT;
+            bool exactHit = math::IntersectRayAABB(ray, data->bounds[i], tMax, &exactT);
+            BENCH_EXPECT(state, hit || !exactHit, "%s, ray %u: slab test misses box %u", label, q, i);
+            if(!hit || t > tMax) continue;
+            data->expected[expectedCount++] = i;
+            if(t < nearestT)
+            {
+                nearest = i;
+                nearestT = t;
+            }
+        }
+        u64 count = bvh::QueryRay(tree, ray, tMax, data->result, n);
+        ExpectSameSet(state, label, "ray", q, data->result, count, data->expected, expectedCount, data->marks);
+
+        bvh::RayHit hit = bvh::Raycast(tree, ray, tMax);
+        BENCH_EXPECT(state, hit.IsValid() == (nearest != HANDLE_INVALID) && (!hit.IsValid() || hit.t == nearestT),
+                "%s, ray %u: nearest hit %u at %.9g, expected %u at %.9g", label, q, hit.primitive, hit.t, nearest, nearestT);
+        bvh::RayHit any = bvh::RaycastAny(tree, ray, tMax);
+        f32 anyT = -1;
+        bool anyHit = any.IsValid() && any.primitive < n && leaf.Test(data->bounds[any.primitive], &anyT);
+        BENCH_EXPECT(state, any.IsValid() == (nearest != HANDLE_INVALID) && (!any.IsValid() || (anyHit && anyT <= tMax && any.t == anyT)),
+                "%s, ray %u: any hit %u at %.9g, expected one when %u is hit", label, q, any.primitive, any.t, nearest);
+    }
+}
+
+BENCH_CHECK("bvh/queries_match_linear_scan")
+{
+    const u32 n = BENCH_BVH_CHECK_COUNT;
+    mem::Arena* dataArena = mem::MakeArena(MB(1));
+    mem::Arena* arena = mem::MakeArena(MB(8));
+    math::Rng rng = math::MakeRng(41);
+    BVHCheckData data = {};
+    data.bounds = (math::AABB*)mem::ArenaPush(dataArena, n * sizeof(math::AABB));
+    math::AABB* original = (math::AABB*)mem::ArenaPush(dataArena, n * sizeof(math::AABB));
+    data.result = (u32*)mem::ArenaPush(dataArena, n * sizeof(u32));
+    data.expected = (u32*)mem::ArenaPush(dataArena, n * sizeof(u32));
+    data.marks = (u8*)mem::ArenaPush(dataArena, n);
+
+    // Objects of a few primitives each, some flat or down to points.
+    v3f objectCenter = {};
+    for(u32 i = 0; i < n; i++)
+    {
+        if(i % 8 == 0) objectCenter = math::RandomUniformV3F(&rng, -200, 200) * v3f{1, 0.1f, 1};
+        v3f center = objectCenter + math::RandomUniformV3F(&rng, -2, 2);
+        v3f extent = math::RandomUniformV3F(&rng, 0.1f, 2);
+        if(i % 13 == 0) extent.y = 0;
+        if(i % 29 == 0) extent = {};
+        original[i] = { center - extent, center + extent };
+    }
+
+    for(u32 q = 0; q < ARR_LEN(data.queries); q++)
+    {
+        v3f center = math::RandomUniformV3F(&rng, -200, 200) * v3f{1, 0.1f, 1};
+        v3f extent = math::RandomUniformV3F(&rng, 0, 30);
+        data.queries[q] = { center - extent, center + extent };
+    }
+    data.queries[0] = { {-1000, -1000, -1000}, {1000, 1000, 1000} };
+    data.queries[1] = { {1000, 1000, 1000}, {1001, 1001, 1001} };
+    data.queries[2] = original[7];
+    m4f proj = math::PerspectiveRH(TO_RAD(70.f), 16.f / 9.f, 0.1f, 200.f);
+    data.frusta[0] = math::GetFrustum(math::ViewRH({1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {0, 0, 0}), proj);
+    data.frusta[1] = math::GetFrustum(math::ViewRH({0, 0, -1}, {0, 1, 0}, {1, 0, 0}, {100, 5, -50}), proj);
+
+    // Random rays, then rays along each axis aimed at a primitive, some from a point on its
+    // min face so the slab of the zero components starts exactly at the origin.
+    for(u32 q = 0; q < ARR_LEN(data.rays); q++)
+    {
+        math::Ray& ray = data.rays[q];
+        data.rayTMax[q] = q % 2 ? MAX_F32 : 150.f;
+        if(q < 64)
+        {
+            ray.origin = math::RandomUniformV3F(&rng, -200, 200) * v3f{1, 0.1f, 1};
+            ray.direction = math::Normalize(math::RandomUniformV3F(&rng, -1, 1) * v3f{1, 0.2f, 1});
+            if(q % 4 == 0) ray.direction.y = 0;
+            continue;
+        }
+        const math::AABB& target = original[math::RandomU32(&rng) % n];
+        u32 axis = q % 3;
+        f32 sign = (q / 3) % 2 ? -1.f : 1.f;
+        ray.origin = math::GetAABBCenter(target);
+        if(q % 5 == 0) ray.origin.data[(axis + 1) % 3] = target.min.data[(axis + 1) % 3];
+        ray.origin.data[axis] -= sign * 40;
+        ray.direction = {};
+        ray.direction.data[axis] = sign;
+    }
+
+    for(u32 wide = 0; wide < 2; wide++)
+    {
+        for(u32 parallel = 0; parallel < 2; parallel++)
+        {
+            mem::ArenaClear(arena);
+            memcpy(data.bounds, original, n * sizeof(math::AABB));
+            bvh::BuildDesc desc = {};
+            desc.wide = wide;
+            desc.parallel = parallel;
+            bvh::BVH tree = bvh::Build(arena, data.bounds, n, desc);
+            char label[64];
+            snprintf(label, sizeof(label), "%s %s", wide ? "wide" : "binary", parallel ? "parallel" : "serial");
+            CheckBVHQueries(state, label, tree, &data);
+
+            // Objects moved and resized, same tree.
+            for(u32 i = 0; i < n; i++)
+            {
+                v3f move = math::RandomUniformV3F(&rng, -20, 20);
+                v3f grow = math::RandomUniformV3F(&rng, 0, 1);
+                data.bounds[i] = { original[i].min + move - grow, original[i].max + move + grow };
+            }
+            bvh::Refit(&tree, data.bounds);
+            snprintf(label, sizeof(label), "%s %s refit", wide ? "wide" : "binary", parallel ? "parallel" : "serial");
+            CheckBVHQueries(state, label, tree, &data);
+        }
+    }
+    mem::DestroyArena(arena);
+    mem::DestroyArena(dataArena);
+}
+
+// ========================================================
+// [RAYCAST]
+// Terrain heightfield with props scattered on it, seen by a camera from above. Camera rays are
+// ordered in 2x2 pixel quads so each 4 consecutive rays make a coherent packet, shadow rays
+// start where camera rays hit and go towards the sun. Throughput is in rays per second.
+#define BENCH_RAYCAST_GRID 256
+#define BENCH_RAYCAST_PROPS 512
+#define BENCH_RAYCAST_IMAGE 128
+#define BENCH_RAYCAST_RAYS (BENCH_RAYCAST_IMAGE * BENCH_RAYCAST_IMAGE)
+
+f32 GetBenchTerrainHeight(f32 x, f32 z)
+{
+    return sinf(x * 0.05f) * cosf(z * 0.07f) * 8 + sinf(x * 0.31f + z * 0.17f);
+}
+
+#define BENCH_RAYCAST_MESHES (BENCH_RAYCAST_PROPS + 1)
+
+raycast::Mesh* MakeBenchRaycastMeshes(mem::Arena* arena)
+{
+    const u32 vertexCount = (BENCH_RAYCAST_GRID + 1) * (BENCH_RAYCAST_GRID + 1);
+    f32* terrainPositions = (f32*)mem::ArenaPush(arena, vertexCount * 3 * sizeof(f32));
+    u32* terrainIndices = (u32*)mem::ArenaPush(arena, BENCH_RAYCAST_GRID * BENCH_RAYCAST_GRID * 6 * sizeof(u32));
+    for(u32 z = 0; z <= BENCH_RAYCAST_GRID; z++)
+    {
+        for(u32 x = 0; x <= BENCH_RAYCAST_GRID; x++)
+        {
+            f32* p = terrainPositions + (z * (BENCH_RAYCAST_GRID + 1) + x) * 3;
+            p[0] = (f32)x - BENCH_RAYCAST_GRID / 2;
+            p[2] = (f32)z - BENCH_RAYCAST_GRID / 2;
+            p[1] = GetBenchTerrainHeight(p[0], p[2]);
+        }
+    }
+    u32* index = terrainIndices;
+    for(u32 z = 0; z < BENCH_RAYCAST_GRID; z++)
+    {
+        for(u32 x = 0; x < BENCH_RAYCAST_GRID; x++)
+        {
+            u32 v = z * (BENCH_RAYCAST_GRID + 1) + x;
+            u32 quad[6] = { v, v + BENCH_RAYCAST_GRID + 1, v + 1, v + 1, v + BENCH_RAYCAST_GRID + 1, v + BENCH_RAYCAST_GRID + 2 };
+            memcpy(index, quad, sizeof(quad));
+            index += 6;
+        }
+    }
+
+    static const f32 cubePositions[] =
+    {
+        -1, -1, -1,     1, -1, -1,      1, 1, -1,       -1, 1, -1,
+        -1, -1, 1,      1, -1, 1,       1, 1, 1,        -1, 1, 1,
+    };
+    static const u32 cubeIndices[] =
+    {
+        0, 2, 1, 0, 3, 2,   4, 5, 6, 4, 6, 7,   0, 1, 5, 0, 5, 4,
+        3, 6, 2, 3, 7, 6,   0, 4, 7, 0, 7, 3,   1, 2, 6, 1, 6, 5,
+    };
+
+    raycast::Mesh* meshes = (raycast::Mesh*)mem::ArenaPush(arena, BENCH_RAYCAST_MESHES * sizeof(raycast::Mesh));
+    meshes[0] = {};
+    meshes[0].positions = terrainPositions;
+    meshes[0].indices = terrainIndices;
+    meshes[0].vertexCount = vertexCount;
+    meshes[0].triangleCount = BENCH_RAYCAST_GRID * BENCH_RAYCAST_GRID * 2;
+    for(u32 i = 1; i < BENCH_RAYCAST_MESHES; i++)
+    {
+        v3f position = math::RandomUniformV3F(-100, 100);
+        position.y = GetBenchTerrainHeight(position.x, position.z);
+        v3f axis = math::Normalize(math::RandomUniformV3F(-1, 1) + v3f{0, 0.001f, 0});
+        meshes[i] = {};
+        meshes[i].positions = cubePositions;
+        meshes[i].indices = cubeIndices;
+        meshes[i].vertexCount = 8;
+        meshes[i].triangleCount = 12;
+        meshes[i].transform = math::TranslationMatrix(position)
+            * math::RotationMatrix(math::RandomUniformF32(0, 6.28f), axis)
+            * math::ScaleMatrix(math::RandomUniformV3F(0.5f, 4));
+    }
+    return meshes;
+}
+
+math::Ray* MakeBenchCameraRays(mem::Arena* arena)
+{
+    math::Ray* result = (math::Ray*)mem::ArenaPush(arena, BENCH_RAYCAST_RAYS * sizeof(math::Ray));
+    v3f origin = {0, 60, -140};
+    v3f forward = math::Normalize(v3f{0, 0, 0} - origin);
+    v3f right = math::Normalize(math::Cross(v3f{0, 1, 0}, forward));
+    v3f up = math::Cross(forward, right);
+    f32 halfSize = tanf(TO_RAD(30.f));
+    u32 i = 0;
+    for(u32 y = 0; y < BENCH_RAYCAST_IMAGE; y += 2)
+    {
+        for(u32 x = 0; x < BENCH_RAYCAST_IMAGE; x += 2)
+        {
+            for(u32 j = 0; j < 4; j++)
+            {
+                f32 px = ((f32)(x + j % 2) + 0.5f) / BENCH_RAYCAST_IMAGE * 2 - 1;
+                f32 py = ((f32)(y + j / 2) + 0.5f) / BENCH_RAYCAST_IMAGE * 2 - 1;
+                result[i].origin = origin;
+                result[i].direction = math::Normalize(forward + right * (px * halfSize) - up * (py * halfSize));
+                i++;
+            }
+        }
+    }
+    return result;
+}
+
+math::Ray* MakeBenchShadowRays(mem::Arena* arena, const raycast::Scene& scene, const math::Ray* cameraRays)
+{
+    math::Ray* result = (math::Ray*)mem::ArenaPush(arena, BENCH_RAYCAST_RAYS * sizeof(math::Ray));
+    v3f sun = math::Normalize(v3f{0.4f, 1, 0.3f});
+    for(u32 i = 0; i < BENCH_RAYCAST_RAYS; i++)
+    {
+        raycast::Hit hit = raycast::RaycastClosest(scene, cameraRays[i]);
+        result[i].origin = hit.IsValid() ? cameraRays[i].origin + cameraRays[i].direction * hit.t + sun * 0.01f : cameraRays[i].origin;
+        result[i].direction = sun;
+    }
+    return result;
+}
+
+BENCH("raycast/build")
+{
+    mem::Arena* dataArena = mem::MakeArena(MB(8));
+    mem::Arena* arena = mem::MakeArena(MB(64));
+    raycast::Mesh* meshes = MakeBenchRaycastMeshes(dataArena);
+    bvh::BuildDesc desc = {};
+    desc.wide = true;
+    BENCH_LOOP(state)
+    {
+        mem::ArenaClear(arena);
+        raycast::Scene scene = raycast::Build(arena, meshes, BENCH_RAYCAST_MESHES, desc);
+        DoNotOptimize(scene);
+    }
+    state->itemsPerIteration = BENCH_RAYCAST_GRID * BENCH_RAYCAST_GRID * 2 + BENCH_RAYCAST_PROPS * 12;
+    mem::DestroyArena(arena);
+    mem::DestroyArena(dataArena);
+}
+
+void BenchRaycast(State* state, bool shadow, bool packet)
+{
+    mem::Arena* arena = mem::MakeArena(MB(64));
+    bvh::BuildDesc desc = {};
+    desc.wide = true;
+    raycast::Scene scene = raycast::Build(arena, MakeBenchRaycastMeshes(arena), BENCH_RAYCAST_MESHES, desc);
+    math::Ray* rays = MakeBenchCameraRays(arena);
+    if(shadow) rays = MakeBenchShadowRays(arena, scene, rays);
+    raycast::Hit hits[4];
+    BENCH_LOOP(state)
+    {
+        u32 hitCount = 0;
+        for(u32 i = 0; i < BENCH_RAYCAST_RAYS; i += 4)
+        {
+            if(shadow && packet)
+            {
+                hitCount += __builtin_popcount(raycast::RaycastAny4(scene, rays + i, MAX_F32));
+            }
+            else if(shadow)
+            {
+                for(u32 j = 0; j < 4; j++)
+                {
+                    hitCount += raycast::RaycastAny(scene, rays[i + j]);
+                }
+            }
+            else if(packet)
+            {
+                raycast::RaycastClosest4(scene, rays + i, MAX_F32, hits);
+                for(u32 j = 0; j < 4; j++)
+                {
+                    hitCount += hits[j].IsValid();
+                }
+            }
+            else
+            {
+                for(u32 j = 0; j < 4; j++)
+                {
+                    hitCount += raycast::RaycastClosest(scene, rays[i + j]).IsValid();
+                }
+            }
+        }
+        DoNotOptimize(hitCount);
+    }
+    state->itemsPerIteration = BENCH_RAYCAST_RAYS;
+    mem::DestroyArena(arena);
+}
+
+BENCH("raycast/closest")            { BenchRaycast(state, false, false); }
+BENCH("raycast/closest_packet4")    { BenchRaycast(state, false, true); }
+BENCH("raycast/any_shadow")         { BenchRaycast(state, true, false); }
+BENCH("raycast/any_shadow_packet4") { BenchRaycast(state, true, true); }
+
+// Rays through the vertices and edges inside a grid never miss it, one of the triangles
+// sharing an edge always reports the hit. Down the y axis, on a flat grid, every triangle
+// bounds is flat and the rays start on their slab planes. Then tilted, and on a transformed
+// heightfield.
+#define BENCH_RAYCAST_CHECK_GRID 24
+
+u32 PushGridTargets(const raycast::Mesh& mesh, v3f* targets)
+{
+    const u32 g = BENCH_RAYCAST_CHECK_GRID;
+    const v3f* p = (const v3f*)mesh.positions;
+    u32 result = 0;
+    for(u32 z = 0; z < g; z++)
+    {
+        for(u32 x = 0; x < g; x++)
+        {
+            u32 v = z * (g + 1) + x;
+            if(x && z) targets[result++] = p[v];
+            if(z) targets[result++] = (p[v] + p[v + 1]) * 0.5f;
+            if(x) targets[result++] = (p[v] + p[v + g + 1]) * 0.5f;
+            targets[result++] = (p[v + 1] + p[v + g + 1]) * 0.5f;
+        }
+    }
+    for(u32 i = 0; i < result; i++)
+    {
+        targets[i] = math::TransformPosition(targets[i], mesh.transform);
+    }
+    return result;
+}
+
+// Packet lanes report what single rays do: same mesh, triangle and distance, and the same rays
+// hit something. Returns the single ray misses. Fast-math builds rewrite the shear and the
+// divisions differently in the two tests, hits there get a bound relative to their distance.
+#if defined(__FAST_MATH__)
+#define BENCH_RAYCAST_PACKET_MAX_ERROR 1e-5f
+#else
+#define BENCH_RAYCAST_PACKET_MAX_ERROR 0
+#endif
+
+inline bool PacketValueMatches(f32 packet, f32 single, f32 scale)
+{
+    return packet == single || fabsf(packet - single) <= BENCH_RAYCAST_PACKET_MAX_ERROR * scale;
+}
+
+u32 ExpectPacketsMatchSingle(CheckState* state, const char* label, const raycast::Scene& scene,
+        const math::Ray* rays, u32 count, bool exact)
+{
+    u32 misses = 0;
+    for(u32 i = 0; i < count; i += 4)
+    {
+        raycast::Hit hits[4];
+        raycast::RaycastClosest4(scene, rays + i, MAX_F32, hits);
+        u32 any = raycast::RaycastAny4(scene, rays + i, MAX_F32);
+        for(u32 j = 0; j < 4; j++)
+        {
+            raycast::Hit single = raycast::RaycastClosest(scene, rays[i + j]);
+            bool singleAny = raycast::RaycastAny(scene, rays[i + j]);
+            misses += !single.IsValid();
+            BENCH_EXPECT(state, hits[j].IsValid() == single.IsValid() && singleAny == single.IsValid() && ((any >> j) & 1) == single.IsValid(),
+                    "%s, ray %u: closest %d, any %d, packet closest %d, packet any %d", label, i + j,
+                    single.IsValid(), singleAny, hits[j].IsValid(), (any >> j) & 1);
+            if(!exact || !single.IsValid()) continue;
+            BENCH_EXPECT(state, hits[j].mesh == single.mesh && hits[j].triangle == single.triangle
+                    && PacketValueMatches(hits[j].t, single.t, MAX(single.t, 1.f))
+                    && PacketValueMatches(hits[j].u, single.u, 1) && PacketValueMatches(hits[j].v, single.v, 1),
+                    "%s, ray %u: packet hit mesh %u triangle %u at %.9g, single mesh %u triangle %u at %.9g", label, i + j,
+                    hits[j].mesh, hits[j].triangle, hits[j].t, single.mesh, single.triangle, single.t);
+        }
+    }
+    return misses;
+}
+
+BENCH_CHECK("raycast/watertight_and_packets")
+{
+    const u32 g = BENCH_RAYCAST_CHECK_GRID;
+    const u32 vertexCount = (g + 1) * (g + 1);
+    const u32 maxTargets = 2 * 4 * g * g;
+    mem::Arena* arena = mem::MakeArena(MB(64));
+    v3f* flat = (v3f*)mem::ArenaPush(arena, vertexCount * sizeof(v3f));
+    v3f* terrain = (v3f*)mem::ArenaPush(arena, vertexCount * sizeof(v3f));
+    u32* indices = (u32*)mem::ArenaPush(arena, g * g * 6 * sizeof(u32));
+    for(u32 z = 0; z <= g; z++)
+    {
+        for(u32 x = 0; x <= g; x++)
+        {
+            f32 px = (f32)x * 0.37f - 3.1f;
+            f32 pz = (f32)z * 0.37f + 1.3f;
+            flat[z * (g + 1) + x] = { px, 0.25f, pz };
+            terrain[z * (g + 1) + x] = { px, GetBenchTerrainHeight(px * 10, pz * 10) * 0.05f, pz };
+        }
+    }
+    for(u32 z = 0; z < g; z++)
+    {
+        for(u32 x = 0; x < g; x++)
+        {
+            u32 v = z * (g + 1) + x;
+            u32 quad[6] = { v, v + g + 1, v + 1, v + 1, v + g + 1, v + g + 2 };
+            memcpy(indices + (z * g + x) * 6, quad, sizeof(quad));
+        }
+    }
+    raycast::Mesh meshes[2] = {};
+    meshes[0].positions = flat[0].data;
+    meshes[0].indices = indices;
+    meshes[0].vertexCount = vertexCount;
+    meshes[0].triangleCount = g * g * 2;
+    meshes[1] = meshes[0];
+    meshes[1].positions = terrain[0].data;
+    meshes[1].transform = math::TranslationMatrix({40, 3, -7}) * math::RotationMatrix(0.7f, math::Normalize(v3f{0.2f, 1, 0.1f}));
+
+    v3f* targets = (v3f*)mem::ArenaPush(arena, maxTargets * sizeof(v3f));
+    u32 targetCount = PushGridTargets(meshes[0], targets);
+    u32 flatCount = targetCount;
+    targetCount += PushGridTargets(meshes[1], targets + targetCount);
+    // Each target straight down, then from random points above it.
+    const u32 raysPerTarget = 4;
+    u32 rayCount = targetCount * raysPerTarget;
+    math::Ray* rays = (math::Ray*)mem::ArenaPush(arena, rayCount * sizeof(math::Ray));
+    math::Rng rng = math::MakeRng(42);
+    for(u32 i = 0; i < targetCount; i++)
+    {
+        math::Ray* targetRays = rays + i * raysPerTarget;
+        targetRays[0].origin = targets[i] + v3f{0, 20, 0};
+        targetRays[0].direction = {0, -1, 0};
+        for(u32 j = 1; j < raysPerTarget; j++)
+        {
+            v3f direction = math::Normalize(math::RandomUniformV3F(&rng, -1, 1) * v3f{1, 0, 1} - v3f{0, 1, 0});
+            targetRays[j].origin = targets[i] - direction * math::RandomUniformF32(&rng, 1, 50);
+            targetRays[j].direction = direction;
+        }
+    }
+
+    mem::Arena* benchArena = mem::MakeArena(MB(64));
+    raycast::Mesh* benchMeshes = MakeBenchRaycastMeshes(benchArena);
+    math::Ray* cameraRays = MakeBenchCameraRays(benchArena);
+    for(u32 wide = 0; wide < 2; wide++)
+    {
+        bvh::BuildDesc desc = {};
+        desc.wide = wide;
+        raycast::Scene scene = raycast::Build(arena, meshes, 2, desc);
+        u32 misses = ExpectPacketsMatchSingle(state, wide ? "grid wide" : "grid", scene, rays, rayCount, false);
+        BENCH_EXPECT(state, misses == 0, "%u of %u rays through grid vertices and edges miss (%u targets on the flat grid)",
+                misses, rayCount, flatCount);
+
+        // Rays through edges may report either triangle, compare on a scene seen by a camera.
+        raycast::Scene benchScene = raycast::Build(benchArena, benchMeshes, BENCH_RAYCAST_MESHES, desc);
+        ExpectPacketsMatchSingle(state, wide ? "camera wide" : "camera", benchScene, cameraRays, BENCH_RAYCAST_RAYS, true);
+        math::Ray* shadowRays = MakeBenchShadowRays(benchArena, benchScene, cameraRays);
+        ExpectPacketsMatchSingle(state, wide ? "shadow wide" : "shadow", benchScene, shadowRays, BENCH_RAYCAST_RAYS, true);
+    }
+    mem::DestroyArena(benchArena);
+    mem::DestroyArena(arena);
+}
+
+// ========================================================
+// [SPATIAL]
+// A frame of a crowd: every object moves a little, then a tenth of them look for their
+// neighbors. Against rebuilding a BVH over the same bounds every frame.
+#define BENCH_SPATIAL_COUNT 100000
+#define BENCH_SPATIAL_QUERIES 10000
+#define BENCH_SPATIAL_WORLD 100.f
+#define BENCH_SPATIAL_RADIUS 3.f
+
+struct BenchCrowd
+{
+    f32* x;
+    f32* y;
+    f32* z;
+    f32* vx;
+    f32* vy;
+    f32* vz;
+    handle* handles;
+    math::AABB* bounds;         // For the BVH.
+};
+
+BenchCrowd MakeBenchCrowd(mem::Arena* arena)
+{
+    BenchCrowd result;
+    f32** arrays[] = { &result.x, &result.y, &result.z, &result.vx, &result.vy, &result.vz };
+    math::Rng rng = math::MakeRng(1);
+    for(u32 i = 0; i < ARR_LEN(arrays); i++)
+    {
+        *arrays[i] = (f32*)mem::ArenaPush(arena, BENCH_SPATIAL_COUNT * sizeof(f32));
+        f32 range = i < 3 ? BENCH_SPATIAL_WORLD * 0.5f : 0.1f;
+        math::RandomFillF32(&rng, *arrays[i], BENCH_SPATIAL_COUNT, -range, range);
+    }
+    result.handles = (handle*)mem::ArenaPush(arena, BENCH_SPATIAL_COUNT * sizeof(handle));
+    result.bounds = (math::AABB*)mem::ArenaPush(arena, BENCH_SPATIAL_COUNT * sizeof(math::AABB));
+    return result;
+}
+
+void StepBenchCrowd(BenchCrowd* crowd)
+{
+    const f32 half = BENCH_SPATIAL_WORLD * 0.5f;
+    for(u32 i = 0; i < BENCH_SPATIAL_COUNT; i++)
+    {
+        crowd->x[i] += crowd->vx[i];
+        crowd->y[i] += crowd->vy[i];
+        crowd->z[i] += crowd->vz[i];
+        if(ABS(crowd->x[i]) > half) crowd->vx[i] = -crowd->vx[i];
+        if(ABS(crowd->y[i]) > half) crowd->vy[i] = -crowd->vy[i];
+        if(ABS(crowd->z[i]) > half) crowd->vz[i] = -crowd->vz[i];
+    }
+}
+
+enum BenchSpatialMode
+{
+    BENCH_SPATIAL_MOVE,
+    BENCH_SPATIAL_MOVE_PARALLEL,
+    BENCH_SPATIAL_QUERY,
+    BENCH_SPATIAL_FRAME,
+    BENCH_SPATIAL_FRAME_BVH,
+};
+
+void BenchSpatial(State* state, BenchSpatialMode mode)
+{
+    mem::Arena* arena = mem::MakeArena(MB(64));
+    mem::Arena* bvhArena = mem::MakeArena(MB(64));
+    BenchCrowd crowd = MakeBenchCrowd(arena);
+    spatial::GridDesc desc = {};
+    desc.cellSize = BENCH_SPATIAL_RADIUS;
+    spatial::HashGrid grid = spatial::MakeHashGrid(arena, BENCH_SPATIAL_COUNT, desc);
+    const v3f extent = { 0.5f, 0.5f, 0.5f };
+    for(u32 i = 0; i < BENCH_SPATIAL_COUNT; i++)
+    {
+        v3f center = { crowd.x[i], crowd.y[i], crowd.z[i] };
+        crowd.handles[i] = spatial::Insert(&grid, { center - extent, center + extent });
+    }
+    u32* result = (u32*)mem::ArenaPush(arena, BENCH_SPATIAL_COUNT * sizeof(u32));
+
+    BENCH_LOOP(state)
+    {
+        if(mode != BENCH_SPATIAL_QUERY)
+        {
+            StepBenchCrowd(&crowd);
+        }
+        if(mode == BENCH_SPATIAL_MOVE || mode == BENCH_SPATIAL_MOVE_PARALLEL || mode == BENCH_SPATIAL_FRAME)
+        {
+            spatial::MoveBatch(&grid, crowd.handles, crowd.x, crowd.y, crowd.z, BENCH_SPATIAL_COUNT, mode != BENCH_SPATIAL_MOVE);
+        }
+
+        u64 found = 0;
+        if(mode == BENCH_SPATIAL_QUERY || mode == BENCH_SPATIAL_FRAME)
+        {
+            for(u32 i = 0; i < BENCH_SPATIAL_QUERIES; i++)
+            {
+                u32 object = i * (BENCH_SPATIAL_COUNT / BENCH_SPATIAL_QUERIES);
+                v3f center = { crowd.x[object], crowd.y[object], crowd.z[object] };
+                found += spatial::QueryRadius(grid, center, BENCH_SPATIAL_RADIUS, result, BENCH_SPATIAL_COUNT);
+            }
+        }
+        else if(mode == BENCH_SPATIAL_FRAME_BVH)
+        {
+            for(u32 i = 0; i < BENCH_SPATIAL_COUNT; i++)
+            {
+                v3f center = { crowd.x[i], crowd.y[i], crowd.z[i] };
+                crowd.bounds[i] = { center - extent, center + extent };
+            }
+            mem::ArenaClear(bvhArena);
+            bvh::BVH tree = bvh::Build(bvhArena, crowd.bounds, BENCH_SPATIAL_COUNT);
+            const v3f radius = { BENCH_SPATIAL_RADIUS, BENCH_SPATIAL_RADIUS, BENCH_SPATIAL_RADIUS };
+            for(u32 i = 0; i < BENCH_SPATIAL_QUERIES; i++)
+            {
+                u32 object = i * (BENCH_SPATIAL_COUNT / BENCH_SPATIAL_QUERIES);
+                v3f center = { crowd.x[object], crowd.y[object], crowd.z[object] };
+                found += bvh::QueryAABB(tree, { center - radius, center + radius }, result, BENCH_SPATIAL_COUNT);
+            }
+        }
+        DoNotOptimize(found);
+    }
+    state->itemsPerIteration = mode == BENCH_SPATIAL_QUERY ? BENCH_SPATIAL_QUERIES : BENCH_SPATIAL_COUNT;
+    mem::DestroyArena(bvhArena);
+    mem::DestroyArena(arena);
+}
+
+BENCH("spatial/move_100k")                  { BenchSpatial(state, BENCH_SPATIAL_MOVE); }
+BENCH("spatial/move_100k_parallel")         { BenchSpatial(state, BENCH_SPATIAL_MOVE_PARALLEL); }
+BENCH("spatial/query_radius_10k")           { BenchSpatial(state, BENCH_SPATIAL_QUERY); }
+BENCH("spatial/frame_100k_move_10k_query")  { BenchSpatial(state, BENCH_SPATIAL_FRAME); }
+BENCH("spatial/frame_bvh_rebuild")          { BenchSpatial(state, BENCH_SPATIAL_FRAME_BVH); }
+
+// A random sequence of inserts, updates, removes and batch moves, with every query compared
+// against a scan of the objects' bounds. Four levels and 256 buckets: objects over 8 units go
+// to the large object list, and queries over a few units take the bucket scan at level 0.
+#define BENCH_SPATIAL_CHECK_CAPACITY 6000
+#define BENCH_SPATIAL_CHECK_STEPS 200
+
+struct SpatialCheckData
+{
+    math::AABB* bounds;         // Indexed by handle, like the grid's objects.
+    v3f* halfSizes;
+    bool* alive;
+    handle* moved;
+    f32* x;
+    f32* y;
+    f32* z;
+    u32* result;
+    u8* expected;               // 1 must be found, 2 may be, 0 must not.
+    u64 largeFound;
+};
+
+math::AABB MakeSpatialCheckBounds(math::Rng* rng, v3f center)
+{
+    u32 kind = math::RandomBoundedU32(rng, 20);
+    f32 size = kind < 5 ? 0 : kind < 13 ? 0.5f : kind < 18 ? 4 : 10;
+    v3f extent = math::RandomUniformV3F(rng, size * 0.5f, size);
+    return { center - extent, center + extent };
+}
+
+handle PickAliveObject(math::Rng* rng, const spatial::HashGrid& grid, const SpatialCheckData& data)
+{
+    for(;;)
+    {
+        handle object = math::RandomBoundedU32(rng, (u32)grid.objects.count);
+        if(data.alive[object]) return object;
+    }
+}
+
+// The sphere test computes the distance in f32, objects within rounding of the radius may go
+// either way.
+u8 ExpectInRadius(const math::AABB& bounds, v3f center, f32 radius)
+{
+    f64 distSq = 0;
+    f64 scale = 1;
+    for(u32 axis = 0; axis < 3; axis++)
+    {
+        f64 c = center.data[axis];
+        f64 d = c - MIN(MAX(c, (f64)bounds.min.data[axis]), (f64)bounds.max.data[axis]);
+        distSq += d * d;
+        scale = MAX(scale, fabs(c));
+    }
+    f64 slack = 1e-5 * scale * MAX(scale, (f64)radius);
+    if(distSq <= (f64)radius * radius - slack) return 1;
+    return distSq <= (f64)radius * radius + slack ? 2 : 0;
+}
+
+void ExpectSpatialResults(CheckState* state, u32 step, const char* query, u32 index, const spatial::HashGrid& grid,
+        SpatialCheckData* data, u64 count)
+{
+    u64 wrong = 0;
+    for(u64 i = 0; i < count; i++)
+    {
+        u32 object = data->result[i];
+        bool valid = object < grid.objects.count && (data->expected[object] == 1 || data->expected[object] == 2);
+        BENCH_EXPECT(state, valid, "step %u, %s %u: object %u reported wrongly or twice", step, query, index, object);
+        if(!valid) continue;
+        data->expected[object] = 3;
+        if(spatial::GetLevel(grid, data->halfSizes[object]) == grid.levelCount) data->largeFound++;
+    }
+    for(u64 i = 0; i < grid.objects.count; i++)
+    {
+        wrong += data->expected[i] == 1;
+    }
+    BENCH_EXPECT(state, wrong == 0, "step %u, %s %u: %llu objects missing from %llu results", step, query, index, wrong, count);
+}
+
+void CheckSpatialQueries(CheckState* state, math::Rng* rng, u32 step, const spatial::HashGrid& grid, SpatialCheckData* data)
+{
+    const u64 n = grid.objects.count;
+    for(u32 q = 0; q < 8; q++)
+    {
+        // Small and large queries, now and then around an object that went far away.
+        v3f center = math::RandomUniformV3F(rng, -35, 35);
+        if(q == 7)
+        {
+            const math::AABB& bounds = data->bounds[PickAliveObject(rng, grid, *data)];
+            center = (bounds.min + bounds.max) * 0.5f;
+        }
+        f32 size = q % 4 < 2 ? math::RandomUniformF32(rng, 0, 1) : math::RandomUniformF32(rng, 5, 30);
+        u64 count = 0;
+        const char* query = q % 2 ? "radius" : "aabb";
+        if(q % 2)
+        {
+            for(u64 i = 0; i < n; i++)
+            {
+                data->expected[i] = data->alive[i] ? ExpectInRadius(data->bounds[i], center, size) : 0;
+            }
+            count = spatial::QueryRadius(grid, center, size, data->result, BENCH_SPATIAL_CHECK_CAPACITY);
+        }
+        else
+        {
+            v3f extent = math::RandomUniformV3F(rng, 0, size);
+            math::AABB aabb = { center - extent, center + extent };
+            for(u64 i = 0; i < n; i++)
+            {
+                data->expected[i] = data->alive[i] && AABBOverlaps(data->bounds[i], aabb);
+            }
+            // Short result arrays still get the full count.
+            u64 clipped = spatial::QueryAABB(grid, aabb, data->result, 1);
+            count = spatial::QueryAABB(grid, aabb, data->result, BENCH_SPATIAL_CHECK_CAPACITY);
+            BENCH_EXPECT(state, clipped == count, "step %u, aabb %u: %llu matches with capacity 1, %llu without", step, q, clipped, count);
+        }
+        ExpectSpatialResults(state, step, query, q, grid, data, count);
+    }
+}
+
+BENCH_CHECK("spatial/queries_match_brute_force")
+{
+    const u32 capacity = BENCH_SPATIAL_CHECK_CAPACITY;
+    mem::Arena* arena = mem::MakeArena(MB(8));
+    spatial::GridDesc desc = {};
+    desc.cellSize = 1;
+    desc.levelCount = 4;
+    desc.bucketCount = 256;
+    spatial::HashGrid grid = spatial::MakeHashGrid(arena, capacity, desc);
+    SpatialCheckData data = {};
+    data.bounds = (math::AABB*)mem::ArenaPush(arena, capacity * sizeof(math::AABB));
+    data.halfSizes = (v3f*)mem::ArenaPush(arena, capacity * sizeof(v3f));
+    data.alive = (bool*)mem::ArenaPush(arena, capacity * sizeof(bool));
+    data.moved = (handle*)mem::ArenaPush(arena, capacity * sizeof(handle));
+    data.x = (f32*)mem::ArenaPush(arena, capacity * sizeof(f32));
+    data.y = (f32*)mem::ArenaPush(arena, capacity * sizeof(f32));
+    data.z = (f32*)mem::ArenaPush(arena, capacity * sizeof(f32));
+    data.result = (u32*)mem::ArenaPush(arena, capacity * sizeof(u32));
+    data.expected = (u8*)mem::ArenaPush(arena, capacity);
+    memset(data.alive, 0, capacity * sizeof(bool));
+
+    // Enough objects for a parallel batch of several tasks.
+    math::Rng rng = math::MakeRng(45);
+    u64 levelChanges = 0;
+    u64 parallelMoves = 0;
+    for(u32 step = 0; step < BENCH_SPATIAL_CHECK_STEPS; step++)
+    {
+        u32 op = step == 0 ? 0 : math::RandomBoundedU32(&rng, 8);
+        if(op < 2)
+        {
+            u32 inserts = step == 0 ? 5000 : math::RandomBoundedU32(&rng, 50);
+            for(u32 i = 0; i < inserts && grid.count < capacity; i++)
+            {
+                math::AABB bounds = MakeSpatialCheckBounds(&rng, math::RandomUniformV3F(&rng, -30, 30));
+                handle object = spatial::Insert(&grid, bounds);
+                data.bounds[object] = bounds;
+                data.halfSizes[object] = (bounds.max - bounds.min) * 0.5f;
+                data.alive[object] = true;
+            }
+        }
+        else if(op == 2)
+        {
+            for(u32 i = 0; i < 40 && grid.count > 0; i++)
+            {
+                handle object = PickAliveObject(&rng, grid, data);
+                spatial::Remove(&grid, object);
+                data.alive[object] = false;
+            }
+        }
+        else if(op < 5)
+        {
+            // New bounds around the same center, mostly at another level, or somewhere else.
+            for(u32 i = 0; i < 100; i++)
+            {
+                handle object = PickAliveObject(&rng, grid, data);
+                v3f center = (data.bounds[object].min + data.bounds[object].max) * 0.5f;
+                if(i % 2) center = math::RandomUniformV3F(&rng, -30, 30);
+                math::AABB bounds = MakeSpatialCheckBounds(&rng, center);
+                v3f halfSize = (bounds.max - bounds.min) * 0.5f;
+                levelChanges += spatial::GetLevel(grid, halfSize) != spatial::GetLevel(grid, data.halfSizes[object]);
+                spatial::Update(&grid, object, bounds);
+                data.bounds[object] = bounds;
+                data.halfSizes[object] = halfSize;
+            }
+        }
+        else
+        {
+            // Most objects jitter within their cell, some cross cells, a few go far away or
+            // come back.
+            u32 percent = op == 5 ? 100 : math::RandomBoundedU32(&rng, 100);
+            u64 count = 0;
+            for(u32 object = 0; object < grid.objects.count; object++)
+            {
+                if(!data.alive[object] || math::RandomBoundedU32(&rng, 100) >= percent) continue;
+                v3f center = (data.bounds[object].min + data.bounds[object].max) * 0.5f;
+                u32 kind = math::RandomBoundedU32(&rng, 100);
+                if(kind < 70) center = center + math::RandomUniformV3F(&rng, -0.1f, 0.1f);
+                else if(kind < 98) center = center + math::RandomUniformV3F(&rng, -5, 5);
+                else if(kind == 98) center = math::RandomUniformV3F(&rng, -1e7f, 1e7f);
+                else center = math::RandomUniformV3F(&rng, -30, 30);
+                data.moved[count] = object;
+                data.x[count] = center.x;
+                data.y[count] = center.y;
+                data.z[count] = center.z;
+                const v3f& halfSize = data.halfSizes[object];
+                data.bounds[object] = { center - halfSize, center + halfSize };
+                count++;
+            }
+            bool parallel = step % 2;
+            parallelMoves += parallel && count > TY_SPATIAL_PARALLEL_BATCH;
+            spatial::MoveBatch(&grid, data.moved, data.x, data.y, data.z, count, parallel);
+        }
+
+        u64 aliveCount = 0;
+        for(u32 object = 0; object < grid.objects.count; object++)
+        {
+            if(!data.alive[object]) continue;
+            aliveCount++;
+            math::AABB bounds = spatial::GetBounds(grid, object);
+            BENCH_EXPECT(state, !memcmp(&bounds, &data.bounds[object], sizeof(bounds)), "step %u: object %u has other bounds", step, object);
+        }
+        BENCH_EXPECT(state, grid.count == aliveCount, "step %u: %u objects, expected %llu", step, grid.count, aliveCount);
+        CheckSpatialQueries(state, &rng, step, grid, &data);
+    }
+    BENCH_EXPECT(state, levelChanges > 0, "no update changed level");
+    BENCH_EXPECT(state, parallelMoves > 0, "no parallel batch over %u objects", TY_SPATIAL_PARALLEL_BATCH);
+    BENCH_EXPECT(state, data.largeFound > 0, "no query found a large object");
+    mem::DestroyArena(arena);
+}
+
+};
+};
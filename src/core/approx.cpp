@@ -0,0 +1,107 @@
+#include "./approx.hpp"
+
+namespace ty
+{
+namespace approx
+{
+
+// ========================================================
+// [ARRAYS]
+// 8 lanes at a time, the leftovers one by one through the 4-wide versions.
+
+void Sin(const f32* x, f32* result, u64 count)
+{
+    u64 i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        simd::Store8(result + i, SinT(simd::Load8(x + i)));
+    }
+    for(; i < count; i++)
+    {
+        result[i] = Sin(x[i]);
+    }
+}
+
+void Cos(const f32* x, f32* result, u64 count)
+{
+    u64 i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        simd::Store8(result + i, CosT(simd::Load8(x + i)));
+    }
+    for(; i < count; i++)
+    {
+        result[i] = Cos(x[i]);
+    }
+}
+
+void SinCos(const f32* x, f32* sin, f32* cos, u64 count)
+{
+    u64 i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        simd::f32x8 s, c;
+        SinCosT(simd::Load8(x + i), &s, &c);
+        simd::Store8(sin + i, s);
+        simd::Store8(cos + i, c);
+    }
+    for(; i < count; i++)
+    {
+        SinCos(x[i], &sin[i], &cos[i]);
+    }
+}
+
+void Exp(const f32* x, f32* result, u64 count)
+{
+    u64 i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        simd::Store8(result + i, ExpT(simd::Load8(x + i)));
+    }
+    for(; i < count; i++)
+    {
+        result[i] = Exp(x[i]);
+    }
+}
+
+void Log(const f32* x, f32* result, u64 count)
+{
+    u64 i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        simd::Store8(result + i, LogT(simd::Load8(x + i)));
+    }
+    for(; i < count; i++)
+    {
+        result[i] = Log(x[i]);
+    }
+}
+
+void Atan2(const f32* y, const f32* x, f32* result, u64 count)
+{
+    u64 i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        simd::Store8(result + i, Atan2T(simd::Load8(y + i), simd::Load8(x + i)));
+    }
+    for(; i < count; i++)
+    {
+        result[i] = Atan2(y[i], x[i]);
+    }
+}
+
+void Rsqrt(const f32* x, f32* result, u64 count)
+{
+    u64 i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        simd::Store8(result + i, RsqrtT(simd::Load8(x + i)));
+    }
+    for(; i < count; i++)
+    {
+        result[i] = Rsqrt(x[i]);
+    }
+}
+
+};
+};
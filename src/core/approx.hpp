@@ -0,0 +1,266 @@
+// ========================================================
+// APPROX
+// Fast approximations of sin, cos, exp, log, atan2 and 1/sqrt for batch work (particles,
+// procedural placement, animation), where libm's scalar calls dominate.
+// Every function comes 4-wide, 8-wide (core/simd) and scalar, all sharing one
+// implementation so a value gives the same result at every width (within a couple of ulps
+// for the scalar backend under -Ofast, which reorders each copy its own way). Polynomials
+// are the Cephes single precision ones, after range reduction done with integer lane tricks
+// instead of branches. Array versions run 8 lanes at a time. Reductions by split constants
+// keep their order behind simd::Barrier, so -Ofast can't fold the constants back together.
+// Max errors against double precision libm, over every float in the documented ranges
+// (random pairs for atan2), in SSE, AVX2 with FMA and scalar builds, with and without -Ofast:
+//   Sin, Cos, SinCos   |x| <= 8192         9.4e-8 absolute (9.7e-7 at 65536)
+//   Exp                [-87.33, 88.37]     1.2e-7 relative
+//   Log                [FLT_MIN, FLT_MAX]  8.2e-8 relative, 4.0e-8 absolute in [0.5, 2]
+//   Atan2              finite y, x         2.7e-7 absolute
+//   Rsqrt              [FLT_MIN, FLT_MAX]  2.8e-7 relative (one Newton step on the estimate)
+// The bench executable checks them (bench --check --filter approx).
+// Outside them: sin/cos lose accuracy as |x| grows, exp clamps its input, log of x <= 0
+// gives log(FLT_MIN), atan2(0, -0) gives 0 instead of pi and rsqrt(0) is NaN. Infinities
+// and NaNs are not handled. Use libm where these cases matter.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./debug.hpp"
+#include "./simd.hpp"
+#include "./math.hpp"
+
+namespace ty
+{
+namespace approx
+{
+
+// ========================================================
+// [LANES]
+// Splats for the vector widths, so each algorithm is written once.
+template <typename V>
+struct Lanes;
+
+template <>
+struct Lanes<simd::f32x4>
+{
+    typedef simd::i32x4 I;
+    static simd::f32x4 Splat(f32 a) { return simd::Set1(a); }
+    static I SplatI(i32 a) { return simd::Set1I32(a); }
+};
+
+template <>
+struct Lanes<simd::f32x8>
+{
+    typedef simd::i32x8 I;
+    static simd::f32x8 Splat(f32 a) { return simd::Splat8(a); }
+    static I SplatI(i32 a) { return simd::Splat8I32(a); }
+};
+
+// ========================================================
+// [KERNELS]
+
+// x reduced to r in [-pi/4, pi/4] with x = r + q * pi/2, the subtraction split in three
+// (Cody-Waite) so it stays exact for large q. Returns the sin and cos polynomials of r.
+template <typename V>
+inline void SinCosKernel(V x, typename Lanes<V>::I* q, V* sinR, V* cosR)
+{
+    typedef Lanes<V> L;
+    *q = simd::ConvertToI32(simd::Mul(x, L::Splat(0.636619772367581343f)));
+    V fq = simd::ConvertToF32(*q);
+    V r = simd::Barrier(simd::MulAdd(fq, L::Splat(-1.5703125f), x));
+    r = simd::Barrier(simd::MulAdd(fq, L::Splat(-4.837512969970703125e-4f), r));
+    r = simd::MulAdd(fq, L::Splat(-7.54978995489188216e-8f), r);
+    V z = simd::Mul(r, r);
+
+    V s = simd::MulAdd(L::Splat(-1.9515295891e-4f), z, L::Splat(8.3321608736e-3f));
+    s = simd::MulAdd(s, z, L::Splat(-1.6666654611e-1f));
+    *sinR = simd::MulAdd(simd::Mul(s, z), r, r);
+
+    V c = simd::MulAdd(L::Splat(2.443315711809948e-5f), z, L::Splat(-1.388731625493765e-3f));
+    c = simd::MulAdd(c, z, L::Splat(4.166664568298827e-2f));
+    c = simd::Mul(simd::Mul(c, z), z);
+    *cosR = simd::Add(simd::MulAdd(z, L::Splat(-0.5f), L::Splat(1.f)), c);
+}
+
+// Quadrant q of the reduction: odd ones swap the polynomials, bit 1 flips the sign.
+template <typename V>
+inline V SinQuadrant(typename Lanes<V>::I q, V sinR, V cosR)
+{
+    V swap = simd::CastToF32(simd::ShiftRight<31>(simd::ShiftLeft<31>(q)));
+    V sign = simd::And(simd::CastToF32(simd::ShiftLeft<30>(q)), Lanes<V>::Splat(-0.f));
+    return simd::Xor(simd::Select(swap, cosR, sinR), sign);
+}
+
+template <typename V>
+inline V SinT(V x)
+{
+    typename Lanes<V>::I q;
+    V sinR, cosR;
+    SinCosKernel(x, &q, &sinR, &cosR);
+    return SinQuadrant(q, sinR, cosR);
+}
+
+template <typename V>
+inline V CosT(V x)
+{
+    typename Lanes<V>::I q;
+    V sinR, cosR;
+    SinCosKernel(x, &q, &sinR, &cosR);
+    return SinQuadrant(simd::Add(q, Lanes<V>::SplatI(1)), sinR, cosR);     // cos(x) = sin(x + pi/2).
+}
+
+template <typename V>
+inline void SinCosT(V x, V* sin, V* cos)
+{
+    typename Lanes<V>::I q;
+    V sinR, cosR;
+    SinCosKernel(x, &q, &sinR, &cosR);
+    *sin = SinQuadrant(q, sinR, cosR);
+    *cos = SinQuadrant(simd::Add(q, Lanes<V>::SplatI(1)), sinR, cosR);
+}
+
+// exp(x) = 2^n * exp(r) with n = round(x / ln 2), 2^n built directly in the exponent bits.
+template <typename V>
+inline V ExpT(V x)
+{
+    typedef Lanes<V> L;
+    x = simd::Min(simd::Max(x, L::Splat(-87.3365447505531f)), L::Splat(88.3762626647949f));
+    typename L::I n = simd::ConvertToI32(simd::Mul(x, L::Splat(1.44269504088896341f)));
+    V fn = simd::ConvertToF32(n);
+    V r = simd::Barrier(simd::MulAdd(fn, L::Splat(-0.693359375f), x));
+    r = simd::MulAdd(fn, L::Splat(2.12194440e-4f), r);
+
+    V p = simd::MulAdd(L::Splat(1.9875691500e-4f), r, L::Splat(1.3981999507e-3f));
+    p = simd::MulAdd(p, r, L::Splat(8.3334519073e-3f));
+    p = simd::MulAdd(p, r, L::Splat(4.1665795894e-2f));
+    p = simd::MulAdd(p, r, L::Splat(1.6666665459e-1f));
+    p = simd::MulAdd(p, r, L::Splat(5.0000001201e-1f));
+    p = simd::MulAdd(p, simd::Mul(r, r), simd::Add(r, L::Splat(1.f)));
+
+    V scale = simd::CastToF32(simd::ShiftLeft<23>(simd::Add(n, L::SplatI(127))));
+    return simd::Mul(p, scale);
+}
+
+// x = m * 2^e with m in [sqrt(1/2), sqrt(2)), log(x) = log(m) + e * ln 2.
+template <typename V>
+inline V LogT(V x)
+{
+    typedef Lanes<V> L;
+    x = simd::Max(x, L::Splat(FLT_MIN));
+    V e = simd::ConvertToF32(simd::Add(simd::ShiftRight<23>(simd::CastToI32(x)), L::SplatI(-126)));
+    V m = simd::And(x, simd::CastToF32(L::SplatI(~0x7F800000)));
+    m = simd::Or(m, L::Splat(0.5f));        // [0.5, 1)
+
+    V small = simd::CmpLT(m, L::Splat(0.707106781186547524f));
+    e = simd::Sub(e, simd::And(small, L::Splat(1.f)));
+    m = simd::Add(simd::Sub(m, L::Splat(1.f)), simd::And(small, m));
+    V z = simd::Mul(m, m);
+
+    V p = simd::MulAdd(L::Splat(7.0376836292e-2f), m, L::Splat(-1.1514610310e-1f));
+    p = simd::MulAdd(p, m, L::Splat(1.1676998740e-1f));
+    p = simd::MulAdd(p, m, L::Splat(-1.2420140846e-1f));
+    p = simd::MulAdd(p, m, L::Splat(1.4249322787e-1f));
+    p = simd::MulAdd(p, m, L::Splat(-1.6668057665e-1f));
+    p = simd::MulAdd(p, m, L::Splat(2.0000714765e-1f));
+    p = simd::MulAdd(p, m, L::Splat(-2.4999993993e-1f));
+    p = simd::MulAdd(p, m, L::Splat(3.3333331174e-1f));
+    p = simd::Mul(simd::Mul(p, m), z);
+
+    p = simd::Barrier(simd::MulAdd(e, L::Splat(-2.12194440e-4f), p));
+    p = simd::Barrier(simd::MulAdd(z, L::Splat(-0.5f), p));
+    return simd::MulAdd(e, L::Splat(0.693359375f), simd::Barrier(simd::Add(m, p)));
+}
+
+// atan of t = min(|y|, |x|) / max(|y|, |x|) in [0, 1], reduced to [0, tan(pi/8)] with
+// atan(t) = pi/4 + atan((t - 1) / (t + 1)), then moved to the right octant.
+template <typename V>
+inline V Atan2T(V y, V x)
+{
+    typedef Lanes<V> L;
+    V ax = simd::Abs(x);
+    V ay = simd::Abs(y);
+    // Both scaled by a power of 2 away from the ends of the range, so mn + mx can't overflow
+    // and mn - mx can't go denormal (flushed to 0 with -Ofast).
+    V mx = simd::Max(ax, ay);
+    V small = L::Splat(5.42101086e-20f);       // 2^-64
+    V large = L::Splat(1.84467441e19f);        // 2^64
+    V scale = simd::Select(simd::CmpLT(mx, small), large, L::Splat(1.f));
+    scale = simd::Select(simd::CmpLT(large, mx), small, scale);
+    V mn = simd::Mul(simd::Min(ax, ay), scale);
+    mx = simd::Mul(mx, scale);
+
+    V big = simd::CmpLT(simd::Mul(mx, L::Splat(0.414213562373095f)), mn);
+    V num = simd::Select(big, simd::Sub(mn, mx), mn);
+    V den = simd::Max(simd::Select(big, simd::Add(mn, mx), mx), L::Splat(FLT_MIN));   // 0 / 0 gives 0.
+    V t = simd::Div(num, den);
+    V z = simd::Mul(t, t);
+
+    V p = simd::MulAdd(L::Splat(8.05374449538e-2f), z, L::Splat(-1.38776856032e-1f));
+    p = simd::MulAdd(p, z, L::Splat(1.99777106478e-1f));
+    p = simd::MulAdd(p, z, L::Splat(-3.33329491539e-1f));
+    p = simd::MulAdd(simd::Mul(p, z), t, t);
+    V r = simd::Add(p, simd::And(big, L::Splat(0.785398163397448310f)));
+
+    r = simd::Select(simd::CmpLT(ax, ay), simd::Sub(L::Splat(1.57079632679489662f), r), r);
+    r = simd::Select(simd::CmpLT(x, L::Splat(0.f)), simd::Sub(L::Splat(3.14159265358979324f), r), r);
+    return simd::Or(r, simd::And(y, L::Splat(-0.f)));
+}
+
+template <typename V>
+inline V RsqrtT(V x)
+{
+    typedef Lanes<V> L;
+    V e = simd::RsqrtEstimate(x);
+    V xe = simd::Barrier(simd::Mul(x, e));      // Near sqrt(x), keeps x * e * e clear of denormals.
+    return simd::Mul(e, simd::Sub(L::Splat(1.5f), simd::Mul(xe, simd::Mul(e, L::Splat(0.5f)))));
+}
+
+// ========================================================
+// [4-WIDE]
+inline simd::f32x4 Sin(simd::f32x4 x)                   { return SinT(x); }
+inline simd::f32x4 Cos(simd::f32x4 x)                   { return CosT(x); }
+inline void SinCos(simd::f32x4 x, simd::f32x4* sin, simd::f32x4* cos) { SinCosT(x, sin, cos); }
+inline simd::f32x4 Exp(simd::f32x4 x)                   { return ExpT(x); }
+inline simd::f32x4 Log(simd::f32x4 x)                   { return LogT(x); }
+inline simd::f32x4 Atan2(simd::f32x4 y, simd::f32x4 x)  { return Atan2T(y, x); }
+inline simd::f32x4 Rsqrt(simd::f32x4 x)                 { return RsqrtT(x); }
+
+// ========================================================
+// [8-WIDE]
+inline simd::f32x8 Sin(simd::f32x8 x)                   { return SinT(x); }
+inline simd::f32x8 Cos(simd::f32x8 x)                   { return CosT(x); }
+inline void SinCos(simd::f32x8 x, simd::f32x8* sin, simd::f32x8* cos) { SinCosT(x, sin, cos); }
+inline simd::f32x8 Exp(simd::f32x8 x)                   { return ExpT(x); }
+inline simd::f32x8 Log(simd::f32x8 x)                   { return LogT(x); }
+inline simd::f32x8 Atan2(simd::f32x8 y, simd::f32x8 x)  { return Atan2T(y, x); }
+inline simd::f32x8 Rsqrt(simd::f32x8 x)                 { return RsqrtT(x); }
+
+// ========================================================
+// [SCALAR]
+// One lane of the 4-wide versions, for the odd value that must match a batch.
+inline f32 Sin(f32 x)                   { return simd::GetLane<0>(SinT(simd::Set1(x))); }
+inline f32 Cos(f32 x)                   { return simd::GetLane<0>(CosT(simd::Set1(x))); }
+inline void SinCos(f32 x, f32* sin, f32* cos)
+{
+    simd::f32x4 s, c;
+    SinCosT(simd::Set1(x), &s, &c);
+    *sin = simd::GetLane<0>(s);
+    *cos = simd::GetLane<0>(c);
+}
+inline f32 Exp(f32 x)                   { return simd::GetLane<0>(ExpT(simd::Set1(x))); }
+inline f32 Log(f32 x)                   { return simd::GetLane<0>(LogT(simd::Set1(x))); }
+inline f32 Atan2(f32 y, f32 x)          { return simd::GetLane<0>(Atan2T(simd::Set1(y), simd::Set1(x))); }
+inline f32 Rsqrt(f32 x)                 { return simd::GetLane<0>(RsqrtT(simd::Set1(x))); }
+
+// ========================================================
+// [ARRAYS]
+// count elements from x to result, which may be the same array.
+void Sin(const f32* x, f32* result, u64 count);
+void Cos(const f32* x, f32* result, u64 count);
+void SinCos(const f32* x, f32* sin, f32* cos, u64 count);
+void Exp(const f32* x, f32* result, u64 count);
+void Log(const f32* x, f32* result, u64 count);
+void Atan2(const f32* y, const f32* x, f32* result, u64 count);
+void Rsqrt(const f32* x, f32* result, u64 count);
+
+};
+};
@@ -0,0 +1,194 @@
+#include "./async.hpp"
+
+namespace ty
+{
+namespace async
+{
+
+struct WorkerPool
+{
+    bool initialized = false;
+    bool quit = false;
+    u32 workerCount = 0;
+    HANDLE threads[TY_ASYNC_MAX_WORKERS];
+
+    SRWLOCK lock;
+    CONDITION_VARIABLE wakeWorkers;
+    CONDITION_VARIABLE wakeCaller;
+    volatile LONG dispatching = 0;
+
+    // Current dispatch. Workers run it once per generation.
+    u64 generation = 0;
+    u32 pendingWorkers = 0;
+    TaskProc proc = NULL;
+    void* data = NULL;
+};
+
+static WorkerPool workerPool;
+static thread_local u32 workerThreadIndex = 0;
+
+DWORD WINAPI WorkerThreadProc(LPVOID param)
+{
+    workerThreadIndex = (u32)(u64)param;
+    u64 lastGeneration = 0;
+    while(true)
+    {
+        AcquireSRWLockExclusive(&workerPool.lock);
+        while(!workerPool.quit && workerPool.generation == lastGeneration)
+        {
+            SleepConditionVariableSRW(&workerPool.wakeWorkers, &workerPool.lock, INFINITE, 0);
+        }
+        if(workerPool.quit)
+        {
+            ReleaseSRWLockExclusive(&workerPool.lock);
+            break;
+        }
+        lastGeneration = workerPool.generation;
+        TaskProc proc = workerPool.proc;
+        void* data = workerPool.data;
+        ReleaseSRWLockExclusive(&workerPool.lock);
+
+        proc(data, workerThreadIndex);
+
+        AcquireSRWLockExclusive(&workerPool.lock);
+        workerPool.pendingWorkers--;
+        if(workerPool.pendingWorkers == 0)
+        {
+            WakeConditionVariable(&workerPool.wakeCaller);
+        }
+        ReleaseSRWLockExclusive(&workerPool.lock);
+    }
+    return 0;
+}
+
+void InitWorkers(u32 workerCount)
+{
+    // NOTE: Not thread-safe, expected to be called (or first triggered) from the main thread.
+    if(workerPool.initialized) return;
+    if(workerCount == 0)
+    {
+        SYSTEM_INFO systemInfo = {};
+        GetSystemInfo(&systemInfo);
+        workerCount = systemInfo.dwNumberOfProcessors > 1 ? systemInfo.dwNumberOfProcessors - 1 : 0;
+    }
+    workerCount = MIN(workerCount, TY_ASYNC_MAX_WORKERS);
+
+    InitializeSRWLock(&workerPool.lock);
+    InitializeConditionVariable(&workerPool.wakeWorkers);
+    InitializeConditionVariable(&workerPool.wakeCaller);
+    workerPool.workerCount = workerCount;
+    for(u32 i = 0; i < workerCount; i++)
+    {
+        workerPool.threads[i] = CreateThread(NULL, 0, WorkerThreadProc, (LPVOID)(u64)(i + 1), 0, NULL);
+        ASSERT(workerPool.threads[i]);
+    }
+    workerPool.initialized = true;
+}
+
+void DestroyWorkers()
+{
+    if(!workerPool.initialized) return;
+    AcquireSRWLockExclusive(&workerPool.lock);
+    workerPool.quit = true;
+    WakeAllConditionVariable(&workerPool.wakeWorkers);
+    ReleaseSRWLockExclusive(&workerPool.lock);
+    for(u32 i = 0; i < workerPool.workerCount; i++)
+    {
+        WaitForSingleObject(workerPool.threads[i], INFINITE);
+        CloseHandle(workerPool.threads[i]);
+    }
+    workerPool = {};
+}
+
+u32 GetWorkerCount()
+{
+    InitWorkers();
+    return workerPool.workerCount;
+}
+
+u32 GetThreadCount()
+{
+    return GetWorkerCount() + 1;
+}
+
+u32 GetThreadIndex()
+{
+    return workerThreadIndex;
+}
+
+void RunOnAllThreads(TaskProc proc, void* data)
+{
+    ASSERT(proc);
+    InitWorkers();
+
+    // Nested or concurrent dispatches run on the calling thread only.
+    if(workerThreadIndex != 0
+            || workerPool.workerCount == 0
+            || InterlockedCompareExchange(&workerPool.dispatching, 1, 0) != 0)
+    {
+        proc(data, workerThreadIndex);
+        return;
+    }
+
+    AcquireSRWLockExclusive(&workerPool.lock);
+    workerPool.proc = proc;
+    workerPool.data = data;
+    workerPool.pendingWorkers = workerPool.workerCount;
+    workerPool.generation++;
+    WakeAllConditionVariable(&workerPool.wakeWorkers);
+    ReleaseSRWLockExclusive(&workerPool.lock);
+
+    proc(data, workerThreadIndex);
+
+    AcquireSRWLockExclusive(&workerPool.lock);
+    while(workerPool.pendingWorkers > 0)
+    {
+        SleepConditionVariableSRW(&workerPool.wakeCaller, &workerPool.lock, INFINITE, 0);
+    }
+    ReleaseSRWLockExclusive(&workerPool.lock);
+
+    InterlockedExchange(&workerPool.dispatching, 0);
+}
+
+struct ParallelForData
+{
+    RangeProc proc = NULL;
+    void* data = NULL;
+    u64 count = 0;
+    u64 batchSize = 0;
+    volatile LONGLONG cursor = 0;
+};
+
+void ParallelForTask(void* data, u32 threadIndex)
+{
+    ParallelForData* pf = (ParallelForData*)data;
+    while(true)
+    {
+        u64 start = (u64)InterlockedExchangeAdd64(&pf->cursor, (LONGLONG)pf->batchSize);
+        if(start >= pf->count) break;
+        u64 end = MIN(start + pf->batchSize, pf->count);
+        pf->proc(pf->data, start, end, threadIndex);
+    }
+}
+
+void ParallelFor(u64 count, u64 batchSize, RangeProc proc, void* data)
+{
+    ASSERT(proc);
+    ASSERT(batchSize > 0);
+    if(count == 0) return;
+    if(count <= batchSize)
+    {
+        proc(data, 0, count, workerThreadIndex);
+        return;
+    }
+
+    ParallelForData pf = {};
+    pf.proc = proc;
+    pf.data = data;
+    pf.count = count;
+    pf.batchSize = batchSize;
+    RunOnAllThreads(ParallelForTask, &pf);
+}
+
+};
+};
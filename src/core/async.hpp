@@ -0,0 +1,39 @@
+// ========================================================
+// ASYNC
+// Worker thread pool and parallel execution primitives.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./debug.hpp"
+
+namespace ty
+{
+namespace async
+{
+
+// ========================================================
+// [WORKERS]
+// A fixed pool of worker threads is created on first use (or explicitly with InitWorkers).
+// Only one parallel dispatch runs at a time. Dispatches issued from inside a worker run
+// serially on the calling thread instead of deadlocking on the pool.
+#define TY_ASYNC_MAX_WORKERS 64
+
+typedef void (*TaskProc)(void* data, u32 threadIndex);
+typedef void (*RangeProc)(void* data, u64 start, u64 end, u32 threadIndex);
+
+void InitWorkers(u32 workerCount = 0);  // 0 uses (hardware threads - 1)
+void DestroyWorkers();
+
+u32 GetWorkerCount();
+u32 GetThreadCount();   // Workers + calling thread. Use for sizing per-thread data.
+u32 GetThreadIndex();   // 0 for the calling (non-worker) thread, [1, workerCount] for workers.
+
+// Runs proc once on every thread (workers + caller), blocks until all return.
+void RunOnAllThreads(TaskProc proc, void* data);
+// Splits [0, count) into batches of batchSize, distributed dynamically across all threads.
+void ParallelFor(u64 count, u64 batchSize, RangeProc proc, void* data);
+
+};
+};
@@ -0,0 +1,762 @@
+#include "./bvh.hpp"
+
+namespace ty
+{
+namespace bvh
+{
+
+STATIC_ASSERT(sizeof(Node) == 32);
+
+inline math::AABB EmptyAABB()
+{
+    return { {MAX_F32, MAX_F32, MAX_F32}, {-MAX_F32, -MAX_F32, -MAX_F32} };
+}
+
+inline void Grow(math::AABB* aabb, const math::AABB& other)
+{
+    aabb->min.x = MIN(aabb->min.x, other.min.x);
+    aabb->min.y = MIN(aabb->min.y, other.min.y);
+    aabb->min.z = MIN(aabb->min.z, other.min.z);
+    aabb->max.x = MAX(aabb->max.x, other.max.x);
+    aabb->max.y = MAX(aabb->max.y, other.max.y);
+    aabb->max.z = MAX(aabb->max.z, other.max.z);
+}
+
+inline void Grow(math::AABB* aabb, v3f p)
+{
+    Grow(aabb, {p, p});
+}
+
+inline f32 HalfArea(const math::AABB& aabb)
+{
+    v3f size = aabb.max - aabb.min;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+// ========================================================
+// [BUILD]
+
+// Primitives are moved around during the build rather than indexed, so every pass over a
+// node range reads memory sequentially.
+struct PrimRef
+{
+    math::AABB bounds;
+    u32 index = 0;
+    u32 pad = 0;
+};
+
+struct BuildNode
+{
+    math::AABB bounds;
+    math::AABB centroidBounds;
+    u32 start = 0;              // Primitive range in refs.
+    u32 count = 0;
+    u32 left = 0;               // Children, 0 for leaves (the root is never a child).
+    u32 right = 0;
+    u32 depth = 0;
+};
+
+// Bounds kept in vectors: min in lanes 0-2 of lo, max in lanes 1-3 of hi (see LoadBounds).
+struct Bin
+{
+    simd::f32x4 lo;
+    simd::f32x4 hi;
+    u32 count = 0;
+};
+
+// Two overlapping loads of an AABB: min.x min.y min.z max.x | min.z max.x max.y max.z
+inline void LoadBounds(const math::AABB& aabb, simd::f32x4* lo, simd::f32x4* hi)
+{
+    *lo = simd::Load(&aabb.min.x);
+    *hi = simd::Load(&aabb.min.z);
+}
+
+inline f32 HalfArea(simd::f32x4 lo, simd::f32x4 hi)
+{
+    f32 size[4];
+    simd::Store(size, simd::Sub(hi, simd::Shuffle<0, 0, 1, 2>(lo, lo)));
+    return size[1] * size[2] + size[2] * size[3] + size[3] * size[1];
+}
+
+struct Builder
+{
+    BuildDesc desc = {};
+    PrimRef* refs = NULL;
+    BuildNode* nodes = NULL;
+    volatile LONG nodeCount = 0;
+
+    // Subtrees with at most this many primitives are left as jobs for the workers, 0 builds serially.
+    u32 parallelThreshold = 0;
+    SArray<u32> jobs;
+};
+
+inline u32 GetBin(f32 centroid, f32 start, f32 scale, u32 binCount)
+{
+    return MIN((u32)((centroid - start) * scale), binCount - 1);
+}
+
+// Binned SAH over the 3 axes. Returns false if all centroids fall in the same bin.
+bool FindSplit(Builder* b, const BuildNode& node, u32* splitAxis, u32* splitBin, f32* splitScale)
+{
+    u32 binCount = b->desc.binCount;
+    const math::AABB& centroidBounds = node.centroidBounds;
+    Bin bins[3][TY_BVH_MAX_BINS];
+    f32 scale[3];
+    simd::f32x4 emptyLo = simd::Set1(MAX_F32);
+    simd::f32x4 emptyHi = simd::Set1(-MAX_F32);
+    for(u32 axis = 0; axis < 3; axis++)
+    {
+        f32 extent = centroidBounds.max.data[axis] - centroidBounds.min.data[axis];
+        scale[axis] = extent > 0 ? binCount / extent : 0;
+        for(u32 i = 0; i < binCount; i++)
+        {
+            bins[axis][i].lo = emptyLo;
+            bins[axis][i].hi = emptyHi;
+            bins[axis][i].count = 0;
+        }
+    }
+    for(u32 i = node.start; i < node.start + node.count; i++)
+    {
+        const PrimRef& ref = b->refs[i];
+        v3f centroid = math::GetAABBCenter(ref.bounds);
+        simd::f32x4 lo, hi;
+        LoadBounds(ref.bounds, &lo, &hi);
+        for(u32 axis = 0; axis < 3; axis++)
+        {
+            Bin& bin = bins[axis][GetBin(centroid.data[axis], centroidBounds.min.data[axis], scale[axis], binCount)];
+            bin.lo = simd::Min(bin.lo, lo);
+            bin.hi = simd::Max(bin.hi, hi);
+            bin.count++;
+        }
+    }
+
+    // Sweep from the right storing the cost of each right side, then from the left.
+    f32 bestCost = MAX_F32;
+    for(u32 axis = 0; axis < 3; axis++)
+    {
+        if(scale[axis] == 0) continue;
+        f32 rightCost[TY_BVH_MAX_BINS];
+        simd::f32x4 rightLo = emptyLo;
+        simd::f32x4 rightHi = emptyHi;
+        u32 rightCount = 0;
+        for(u32 i = binCount - 1; i > 0; i--)
+        {
+            rightLo = simd::Min(rightLo, bins[axis][i].lo);
+            rightHi = simd::Max(rightHi, bins[axis][i].hi);
+            rightCount += bins[axis][i].count;
+            rightCost[i] = rightCount ? HalfArea(rightLo, rightHi) * rightCount : MAX_F32;
+        }
+        simd::f32x4 leftLo = emptyLo;
+        simd::f32x4 leftHi = emptyHi;
+        u32 leftCount = 0;
+        for(u32 i = 0; i < binCount - 1; i++)
+        {
+            leftLo = simd::Min(leftLo, bins[axis][i].lo);
+            leftHi = simd::Max(leftHi, bins[axis][i].hi);
+            leftCount += bins[axis][i].count;
+            if(!leftCount || rightCost[i + 1] == MAX_F32) continue;
+            f32 cost = HalfArea(leftLo, leftHi) * leftCount + rightCost[i + 1];
+            if(cost < bestCost)
+            {
+                bestCost = cost;
+                *splitAxis = axis;
+                *splitBin = i;
+                *splitScale = scale[axis];
+            }
+        }
+    }
+    return bestCost < MAX_F32;
+}
+
+inline void GrowChild(BuildNode* child, const PrimRef& ref, v3f centroid)
+{
+    Grow(&child->bounds, ref.bounds);
+    Grow(&child->centroidBounds, centroid);
+}
+
+// Node bounds are set by the parent. Splits the node and recurses into its children.
+void BuildRecursive(Builder* b, u32 nodeIndex, bool spawn)
+{
+    BuildNode& node = b->nodes[nodeIndex];
+    if(node.count <= b->desc.maxLeafSize) return;
+    if(spawn && node.count <= b->parallelThreshold)
+    {
+        b->jobs.Push(nodeIndex);
+        return;
+    }
+
+    u32 children = (u32)InterlockedExchangeAdd(&b->nodeCount, 2);
+    node.left = children;
+    node.right = children + 1;
+    BuildNode& left = b->nodes[children];
+    BuildNode& right = b->nodes[children + 1];
+    left = {};
+    left.bounds = EmptyAABB();
+    left.centroidBounds = EmptyAABB();
+    left.depth = node.depth + 1;
+    right = left;
+
+    // Partition around the SAH split, growing the children bounds on the way. In halves when
+    // there is no split or the tree is too deep.
+    u32 mid = node.start + node.count / 2;
+    u32 axis = 0;
+    u32 splitBin = 0;
+    f32 scale = 0;
+    if(node.depth < TY_BVH_MAX_DEPTH / 2 && FindSplit(b, node, &axis, &splitBin, &scale))
+    {
+        u32 i = node.start;
+        u32 j = node.start + node.count;
+        f32 binStart = node.centroidBounds.min.data[axis];
+        while(i < j)
+        {
+            v3f centroid = math::GetAABBCenter(b->refs[i].bounds);
+            if(GetBin(centroid.data[axis], binStart, scale, b->desc.binCount) <= splitBin)
+            {
+                GrowChild(&left, b->refs[i], centroid);
+                i++;
+            }
+            else
+            {
+                j--;
+                GrowChild(&right, b->refs[i], centroid);
+                PrimRef temp = b->refs[i];
+                b->refs[i] = b->refs[j];
+                b->refs[j] = temp;
+            }
+        }
+        mid = i;
+    }
+    else
+    {
+        for(u32 i = node.start; i < node.start + node.count; i++)
+        {
+            GrowChild(i < mid ? &left : &right, b->refs[i], math::GetAABBCenter(b->refs[i].bounds));
+        }
+    }
+    ASSERT(mid > node.start && mid < node.start + node.count);
+    left.start = node.start;
+    left.count = mid - node.start;
+    right.start = mid;
+    right.count = node.start + node.count - mid;
+    BuildRecursive(b, node.left, spawn);
+    BuildRecursive(b, node.right, spawn);
+}
+
+void BuildJobsProc(void* data, u64 start, u64 end, u32 threadIndex)
+{
+    Builder* b = (Builder*)data;
+    for(u64 i = start; i < end; i++)
+    {
+        BuildRecursive(b, b->jobs[i], false);
+    }
+}
+
+// Copies the build tree to nodes in depth-first order.
+void Flatten(const Builder* b, BVH* bvh, u32 buildIndex)
+{
+    const BuildNode& src = b->nodes[buildIndex];
+    Node node = {};
+    node.bounds = src.bounds;
+    if(!src.left)
+    {
+        node.offset = src.start;
+        node.count = src.count;
+        bvh->nodes.Push(node);
+        return;
+    }
+    u32 index = (u32)bvh->nodes.Push(node);
+    Flatten(b, bvh, src.left);
+    bvh->nodes[index].offset = (u32)bvh->nodes.count;
+    Flatten(b, bvh, src.right);
+}
+
+inline void SetChild(Node4* node, u32 slot, const math::AABB& bounds, u32 child, u32 count)
+{
+    node->minX[slot] = bounds.min.x;
+    node->minY[slot] = bounds.min.y;
+    node->minZ[slot] = bounds.min.z;
+    node->maxX[slot] = bounds.max.x;
+    node->maxY[slot] = bounds.max.y;
+    node->maxZ[slot] = bounds.max.z;
+    node->child[slot] = child;
+    node->count[slot] = count;
+}
+
+inline math::AABB GetChildBounds(const Node4& node, u32 slot)
+{
+    return { {node.minX[slot], node.minY[slot], node.minZ[slot]}, {node.maxX[slot], node.maxY[slot], node.maxZ[slot]} };
+}
+
+// Pulls up to 4 descendants of a binary node into one wide node, opening the largest inner
+// children first.
+u32 Collapse(BVH* bvh, u32 nodeIndex)
+{
+    u32 children[4];
+    u32 childCount = 0;
+    const Node& node = bvh->nodes[nodeIndex];
+    if(node.IsLeaf())
+    {
+        children[childCount++] = nodeIndex;
+    }
+    else
+    {
+        children[childCount++] = nodeIndex + 1;
+        children[childCount++] = node.offset;
+        while(childCount < 4)
+        {
+            u32 open = HANDLE_INVALID;
+            f32 openArea = -1;
+            for(u32 i = 0; i < childCount; i++)
+            {
+                const Node& child = bvh->nodes[children[i]];
+                if(!child.IsLeaf() && HalfArea(child.bounds) > openArea)
+                {
+                    open = i;
+                    openArea = HalfArea(child.bounds);
+                }
+            }
+            if(open == HANDLE_INVALID) break;
+            u32 opened = children[open];
+            children[open] = opened + 1;
+            children[childCount++] = bvh->nodes[opened].offset;
+        }
+    }
+
+    u32 result = (u32)bvh->nodes4.Push({});
+    Node4 node4 = {};
+    for(u32 i = 0; i < 4; i++)
+    {
+        if(i >= childCount)
+        {
+            SetChild(&node4, i, EmptyAABB(), HANDLE_INVALID, 0);
+            continue;
+        }
+        const Node& child = bvh->nodes[children[i]];
+        if(child.IsLeaf()) SetChild(&node4, i, child.bounds, child.offset, child.count);
+        else SetChild(&node4, i, child.bounds, Collapse(bvh, children[i]), 0);
+    }
+    bvh->nodes4[result] = node4;
+    return result;
+}
+
+BVH Build(mem::Arena* arena, const math::AABB* bounds, u32 count, BuildDesc desc)
+{
+    ASSERT(desc.binCount >= 2 && desc.binCount <= TY_BVH_MAX_BINS);
+    ASSERT(desc.maxLeafSize > 0);
+    BVH result = {};
+    result.indices = MakeSArray<u32>(arena, MAX(count, 1));
+    result.bounds = MakeSArray<math::AABB>(arena, MAX(count, 1));
+    result.nodes = MakeSArray<Node>(arena, MAX(count * 2, 1));
+    if(desc.wide) result.nodes4 = MakeSArray<Node4>(arena, MAX(count, 1));
+    if(!count) return result;
+
+    u64 scratchSize = count * (sizeof(PrimRef) + sizeof(BuildNode) * 2 + sizeof(u32)) + KB(4);
+    mem::Arena* scratch = mem::MakeArena(scratchSize);
+    Builder b = {};
+    b.desc = desc;
+    b.refs = (PrimRef*)mem::ArenaPush(scratch, count * sizeof(PrimRef));
+    b.nodes = (BuildNode*)mem::ArenaPush(scratch, count * 2 * sizeof(BuildNode));
+    b.jobs = MakeSArray<u32>(scratch, count / (desc.maxLeafSize + 1) + 1);
+    BuildNode& root = b.nodes[0];
+    root = {};
+    root.bounds = EmptyAABB();
+    root.centroidBounds = EmptyAABB();
+    root.count = count;
+    for(u32 i = 0; i < count; i++)
+    {
+        b.refs[i].bounds = bounds[i];
+        b.refs[i].index = i;
+        GrowChild(&root, b.refs[i], math::GetAABBCenter(bounds[i]));
+    }
+    b.nodeCount = 1;
+
+    // Top levels are split on the calling thread until subtrees are small enough to spread
+    // over a few jobs per thread.
+    if(desc.parallel) b.parallelThreshold = MAX(count / (async::GetThreadCount() * 8), 1024);
+    BuildRecursive(&b, 0, desc.parallel);
+    if(b.jobs.count) async::ParallelFor(b.jobs.count, 1, BuildJobsProc, &b);
+
+    Flatten(&b, &result, 0);
+    for(u32 i = 0; i < count; i++)
+    {
+        result.indices.Push(b.refs[i].index);
+        result.bounds.Push(b.refs[i].bounds);
+    }
+    if(desc.wide) Collapse(&result, 0);
+    mem::DestroyArena(scratch);
+    return result;
+}
+
+void Refit(BVH* bvh, const math::AABB* bounds)
+{
+    for(u64 i = 0; i < bvh->indices.count; i++)
+    {
+        bvh->bounds.data[i] = bounds[bvh->indices.data[i]];
+    }
+    // Children are always stored after their parent.
+    for(i64 i = (i64)bvh->nodes.count - 1; i >= 0; i--)
+    {
+        Node& node = bvh->nodes.data[i];
+        if(node.IsLeaf())
+        {
+            node.bounds = EmptyAABB();
+            for(u32 j = 0; j < node.count; j++)
+            {
+                Grow(&node.bounds, bvh->bounds.data[node.offset + j]);
+            }
+        }
+        else
+        {
+            node.bounds = bvh->nodes.data[i + 1].bounds;
+            Grow(&node.bounds, bvh->nodes.data[node.offset].bounds);
+        }
+    }
+    for(i64 i = (i64)bvh->nodes4.count - 1; i >= 0; i--)
+    {
+        Node4& node = bvh->nodes4.data[i];
+        for(u32 slot = 0; slot < 4; slot++)
+        {
+            if(node.child[slot] == HANDLE_INVALID) continue;
+            math::AABB childBounds = EmptyAABB();
+            if(node.count[slot])
+            {
+                for(u32 j = 0; j < node.count[slot]; j++)
+                {
+                    Grow(&childBounds, bvh->bounds.data[node.child[slot] + j]);
+                }
+            }
+            else
+            {
+                const Node4& child = bvh->nodes4.data[node.child[slot]];
+                for(u32 j = 0; j < 4; j++)
+                {
+                    Grow(&childBounds, GetChildBounds(child, j));
+                }
+            }
+            SetChild(&node, slot, childBounds, node.child[slot], node.count[slot]);
+        }
+    }
+}
+
+math::AABB GetBounds(const BVH& bvh)
+{
+    return bvh.nodes.count ? bvh.nodes[0].bounds : EmptyAABB();
+}
+
+// ========================================================
+// [QUERIES]
+// Traversal is shared, queries provide the node tests (binary and 4-wide, with a distance
+// used for ordering), the leaf visit and the pruning of stacked nodes.
+
+struct QueryResults
+{
+    u32* data = NULL;
+    u64 capacity = 0;
+    u64 count = 0;
+
+    void Add(u32 primitive)
+    {
+        if(count < capacity) data[count] = primitive;
+        count++;
+    }
+};
+
+struct StackEntry
+{
+    u32 node;
+    f32 t;
+};
+
+template <typename Query>
+void Traverse(const BVH& bvh, Query* query)
+{
+    if(!bvh.nodes.count) return;
+    f32 rootT = 0;
+    if(!query->Test(bvh.nodes[0].bounds, &rootT)) return;
+
+    if(bvh.nodes4.count)
+    {
+        StackEntry stack[3 * TY_BVH_MAX_DEPTH + 1];
+        u32 top = 0;
+        stack[top++] = { 0, rootT };
+        while(top)
+        {
+            StackEntry entry = stack[--top];
+            if(query->Prune(entry.t)) continue;
+            const Node4& node = bvh.nodes4.data[entry.node];
+            f32 t[4];
+            u32 mask = query->Test4(node, t);
+
+            // Hit children sorted near to far. Leaves are visited right away, inner children
+            // are pushed far first so the nearest is popped next.
+            u32 order[4];
+            u32 hitCount = 0;
+            while(mask)
+            {
+                u32 slot = __builtin_ctz(mask);
+                mask &= mask - 1;
+                if(node.child[slot] == HANDLE_INVALID) continue;
+                u32 i = hitCount++;
+                while(i > 0 && t[order[i - 1]] > t[slot])
+                {
+                    order[i] = order[i - 1];
+                    i--;
+                }
+                order[i] = slot;
+            }
+            for(u32 i = 0; i < hitCount; i++)
+            {
+                u32 slot = order[i];
+                if(node.count[slot] && !query->Prune(t[slot])) query->Leaf(bvh, node.child[slot], node.count[slot]);
+            }
+            for(i32 i = (i32)hitCount - 1; i >= 0; i--)
+            {
+                u32 slot = order[i];
+                if(!node.count[slot]) stack[top++] = { node.child[slot], t[slot] };
+            }
+        }
+    }
+    else
+    {
+        StackEntry stack[TY_BVH_MAX_DEPTH + 1];
+        u32 top = 0;
+        stack[top++] = { 0, rootT };
+        while(top)
+        {
+            StackEntry entry = stack[--top];
+            if(query->Prune(entry.t)) continue;
+            const Node& node = bvh.nodes.data[entry.node];
+            if(node.IsLeaf())
+            {
+                query->Leaf(bvh, node.offset, node.count);
+                continue;
+            }
+            StackEntry left = { entry.node + 1, 0 };
+            StackEntry right = { node.offset, 0 };
+            bool hitLeft = query->Test(bvh.nodes.data[left.node].bounds, &left.t);
+            bool hitRight = query->Test(bvh.nodes.data[right.node].bounds, &right.t);
+            if(hitLeft && hitRight)
+            {
+                if(left.t <= right.t)
+                {
+                    stack[top++] = right;
+                    stack[top++] = left;
+                }
+                else
+                {
+                    stack[top++] = left;
+                    stack[top++] = right;
+                }
+            }
+            else if(hitLeft) stack[top++] = left;
+            else if(hitRight) stack[top++] = right;
+        }
+    }
+}
+
+struct AABBQuery
+{
+    math::AABB aabb;
+    QueryResults results;
+
+    bool Test(const math::AABB& bounds, f32* t)
+    {
+        *t = 0;
+        return bounds.min.x <= aabb.max.x && bounds.max.x >= aabb.min.x
+            && bounds.min.y <= aabb.max.y && bounds.max.y >= aabb.min.y
+            && bounds.min.z <= aabb.max.z && bounds.max.z >= aabb.min.z;
+    }
+
+    u32 Test4(const Node4& node, f32* t)
+    {
+        simd::f32x4 x = simd::And(simd::CmpLE(simd::Load(node.minX), simd::Set1(aabb.max.x)),
+                simd::CmpGE(simd::Load(node.maxX), simd::Set1(aabb.min.x)));
+        simd::f32x4 y = simd::And(simd::CmpLE(simd::Load(node.minY), simd::Set1(aabb.max.y)),
+                simd::CmpGE(simd::Load(node.maxY), simd::Set1(aabb.min.y)));
+        simd::f32x4 z = simd::And(simd::CmpLE(simd::Load(node.minZ), simd::Set1(aabb.max.z)),
+                simd::CmpGE(simd::Load(node.maxZ), simd::Set1(aabb.min.z)));
+        simd::Store(t, simd::Zero());
+        return simd::MoveMask(simd::And(simd::And(x, y), z));
+    }
+
+    void Leaf(const BVH& bvh, u32 start, u32 count)
+    {
+        f32 t;
+        for(u32 i = start; i < start + count; i++)
+        {
+            if(Test(bvh.bounds.data[i], &t)) results.Add(bvh.indices.data[i]);
+        }
+    }
+
+    bool Prune(f32 t) { return false; }
+};
+
+struct FrustumQuery
+{
+    const math::Frustum* frustum;
+    QueryResults results;
+
+    bool Test(const math::AABB& bounds, f32* t)
+    {
+        *t = 0;
+        return math::IsInFrustum(bounds, *frustum);
+    }
+
+    // Corner furthest along each plane normal, as in math::IsInFrustum.
+    u32 Test4(const Node4& node, f32* t)
+    {
+        simd::f32x4 inside;
+        for(u32 i = 0; i < 6; i++)
+        {
+            const math::plane& plane = frustum->planes[i];
+            simd::f32x4 x = simd::Load(plane.x < 0.f ? node.minX : node.maxX);
+            simd::f32x4 y = simd::Load(plane.y < 0.f ? node.minY : node.maxY);
+            simd::f32x4 z = simd::Load(plane.z < 0.f ? node.minZ : node.maxZ);
+            simd::f32x4 distance = simd::MulAdd(simd::Set1(plane.x), x, simd::Set1(plane.w));
+            distance = simd::MulAdd(simd::Set1(plane.y), y, distance);
+            distance = simd::MulAdd(simd::Set1(plane.z), z, distance);
+            simd::f32x4 planeInside = simd::CmpGE(distance, simd::Zero());
+            inside = i ? simd::And(inside, planeInside) : planeInside;
+        }
+        simd::Store(t, simd::Zero());
+        return simd::MoveMask(inside);
+    }
+
+    void Leaf(const BVH& bvh, u32 start, u32 count)
+    {
+        for(u32 i = start; i < start + count; i++)
+        {
+            if(math::IsInFrustum(bvh.bounds.data[i], *frustum)) results.Add(bvh.indices.data[i]);
+        }
+    }
+
+    bool Prune(f32 t) { return false; }
+};
+
+struct RayQuery
+{
+    math::Ray ray;
+    v3f invDirection;
+    f32 tMax = MAX_F32;
+    bool nearest = false;       // Otherwise all hits go to results.
+    bool any = false;           // With nearest, stop at the first hit.
+    RayHitProc proc = NULL;
+    void* userData = NULL;
+    RayHit hit;
+    QueryResults results;
+
+    void Init(const math::Ray& r, f32 maxDistance)
+    {
+        ray = r;
+        invDirection = math::GetInverseDirection(r);
+        tMax = maxDistance;
+    }
+
+    bool Test(const math::AABB& bounds, f32* t)
+    {
+        f32 tNear = 0;
+        f32 tFar = tMax;
+        for(u32 i = 0; i < 3; i++)
+        {
+            f32 t0 = (bounds.min.data[i] - ray.origin.data[i]) * invDirection.data[i];
+            f32 t1 = (bounds.max.data[i] - ray.origin.data[i]) * invDirection.data[i];
+            tNear = MAX(tNear, MIN(t0, t1));
+            tFar = MIN(tFar, MAX(t0, t1));
+        }
+        *t = tNear;
+        return tNear <= tFar * TY_BVH_RAY_EXIT_SCALE;
+    }
+
+    u32 Test4(const Node4& node, f32* t)
+    {
+        simd::f32x4 x0 = simd::Mul(simd::Sub(simd::Load(node.minX), simd::Set1(ray.origin.x)), simd::Set1(invDirection.x));
+        simd::f32x4 x1 = simd::Mul(simd::Sub(simd::Load(node.maxX), simd::Set1(ray.origin.x)), simd::Set1(invDirection.x));
+        simd::f32x4 y0 = simd::Mul(simd::Sub(simd::Load(node.minY), simd::Set1(ray.origin.y)), simd::Set1(invDirection.y));
+        simd::f32x4 y1 = simd::Mul(simd::Sub(simd::Load(node.maxY), simd::Set1(ray.origin.y)), simd::Set1(invDirection.y));
+        simd::f32x4 z0 = simd::Mul(simd::Sub(simd::Load(node.minZ), simd::Set1(ray.origin.z)), simd::Set1(invDirection.z));
+        simd::f32x4 z1 = simd::Mul(simd::Sub(simd::Load(node.maxZ), simd::Set1(ray.origin.z)), simd::Set1(invDirection.z));
+        simd::f32x4 tNear = simd::Max(simd::Max(simd::Min(x0, x1), simd::Min(y0, y1)), simd::Max(simd::Min(z0, z1), simd::Zero()));
+        simd::f32x4 tFar = simd::Min(simd::Min(simd::Max(x0, x1), simd::Max(y0, y1)), simd::Min(simd::Max(z0, z1), simd::Set1(tMax)));
+        simd::Store(t, tNear);
+        return simd::MoveMask(simd::CmpLE(tNear, simd::Mul(tFar, simd::Set1(TY_BVH_RAY_EXIT_SCALE))));
+    }
+
+    void Leaf(const BVH& bvh, u32 start, u32 count)
+    {
+        for(u32 i = start; i < start + count; i++)
+        {
+            f32 t;
+            if(!Test(bvh.bounds.data[i], &t)) continue;
+            u32 primitive = bvh.indices.data[i];
+            // The grown exit distance can pass a box starting just past tMax.
+            if(proc) t = proc(userData, primitive, ray, tMax);
+            if(t < 0 || t > tMax) continue;
+            if(nearest)
+            {
+                hit.primitive = primitive;
+                hit.t = t;
+                tMax = t;
+                if(any) return;
+            }
+            else
+            {
+                results.Add(primitive);
+            }
+        }
+    }
+
+    bool Prune(f32 t) { return nearest && (t > tMax || (any && hit.primitive != HANDLE_INVALID)); }
+};
+
+u64 QueryAABB(const BVH& bvh, math::AABB aabb, u32* result, u64 capacity)
+{
+    AABBQuery query = {};
+    query.aabb = aabb;
+    query.results = { result, capacity, 0 };
+    Traverse(bvh, &query);
+    return query.results.count;
+}
+
+u64 QueryFrustum(const BVH& bvh, const math::Frustum& frustum, u32* result, u64 capacity)
+{
+    FrustumQuery query = {};
+    query.frustum = &frustum;
+    query.results = { result, capacity, 0 };
+    Traverse(bvh, &query);
+    return query.results.count;
+}
+
+u64 QueryRay(const BVH& bvh, const math::Ray& ray, f32 tMax, u32* result, u64 capacity)
+{
+    RayQuery query = {};
+    query.Init(ray, tMax);
+    query.results = { result, capacity, 0 };
+    Traverse(bvh, &query);
+    return query.results.count;
+}
+
+RayHit Raycast(const BVH& bvh, const math::Ray& ray, f32 tMax, RayHitProc proc, void* userData)
+{
+    RayQuery query = {};
+    query.Init(ray, tMax);
+    query.nearest = true;
+    query.proc = proc;
+    query.userData = userData;
+    Traverse(bvh, &query);
+    return query.hit;
+}
+
+RayHit RaycastAny(const BVH& bvh, const math::Ray& ray, f32 tMax, RayHitProc proc, void* userData)
+{
+    RayQuery query = {};
+    query.Init(ray, tMax);
+    query.nearest = true;
+    query.any = true;
+    query.proc = proc;
+    query.userData = userData;
+    Traverse(bvh, &query);
+    return query.hit;
+}
+
+};
+};
@@ -0,0 +1,104 @@
+// ========================================================
+// BVH
+// Bounding volume hierarchy over AABBs, so overlap, ray and frustum queries visit
+// O(log n) nodes instead of every primitive.
+// Built top-down with binned SAH: primitive centroids are sorted into bins along each axis
+// and the split with the lowest surface area cost is kept. Below the first levels subtrees
+// are built in parallel on the async workers. Nodes are 32 bytes in depth-first order (a
+// left child follows its parent). The tree can also be collapsed into 4-wide nodes (BVH4)
+// whose children are tested at once with core/simd, queries use them when present.
+// Refit updates bounds in place for moving primitives, keeping the tree.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./debug.hpp"
+#include "./memory.hpp"
+#include "./simd.hpp"
+#include "./math.hpp"
+#include "./async.hpp"
+#include "./ds.hpp"
+
+namespace ty
+{
+namespace bvh
+{
+
+#define TY_BVH_MAX_BINS 32
+#define TY_BVH_MAX_DEPTH 64     // Splits are forced to halves past depth 32, to bound traversal stacks.
+// Slab distances are rounded, a ray through the face shared by two boxes can miss both. Ray
+// exit distances are grown by the worst case error so box tests stay conservative (Ize,
+// "Robust BVH Ray Traversal", 2013).
+#define TY_BVH_RAY_EXIT_SCALE (1.f + 3.f * EPSILON_F32)
+
+struct Node
+{
+    math::AABB bounds;
+    u32 offset = 0;             // Leaf: first entry in BVH::indices. Inner: right child, the left one is the next node.
+    u32 count = 0;              // Primitives in a leaf, 0 for inner nodes.
+
+    bool IsLeaf() const { return count > 0; }
+};
+
+// Children bounds as one array per component. Unused slots have inverted bounds (never hit)
+// and child HANDLE_INVALID.
+struct Node4
+{
+    f32 minX[4];
+    f32 minY[4];
+    f32 minZ[4];
+    f32 maxX[4];
+    f32 maxY[4];
+    f32 maxZ[4];
+    u32 child[4];               // Leaf: first entry in BVH::indices. Inner: index in BVH::nodes4.
+    u32 count[4];               // Primitives in a leaf, 0 for inner children.
+};
+
+struct BVH
+{
+    SArray<Node> nodes;
+    SArray<Node4> nodes4;       // Empty unless built with BuildDesc::wide.
+    SArray<u32> indices;        // Primitive indices, leaves reference ranges of them.
+    SArray<math::AABB> bounds;  // Primitive bounds in the same order as indices.
+};
+
+struct BuildDesc
+{
+    u32 binCount = 16;          // At most TY_BVH_MAX_BINS.
+    u32 maxLeafSize = 4;
+    bool parallel = true;
+    bool wide = false;          // Also build nodes4.
+};
+
+BVH Build(mem::Arena* arena, const math::AABB* bounds, u32 count, BuildDesc desc = {});
+void Refit(BVH* bvh, const math::AABB* bounds);    // Same primitives in the same order, new bounds.
+math::AABB GetBounds(const BVH& bvh);
+
+// ========================================================
+// [QUERIES]
+// Write up to capacity primitive indices to result and return how many matched, which can
+// be more than capacity.
+u64 QueryAABB(const BVH& bvh, math::AABB aabb, u32* result, u64 capacity);
+u64 QueryFrustum(const BVH& bvh, const math::Frustum& frustum, u32* result, u64 capacity);
+u64 QueryRay(const BVH& bvh, const math::Ray& ray, f32 tMax, u32* result, u64 capacity);
+
+// Exact ray test for a primitive whose bounds were hit (e.g. against its triangles).
+// Returns the hit distance, negative on a miss.
+typedef f32 (*RayHitProc)(void* userData, u32 primitive, const math::Ray& ray, f32 tMax);
+
+struct RayHit
+{
+    u32 primitive = HANDLE_INVALID;
+    f32 t = MAX_F32;
+
+    bool IsValid() { return primitive != HANDLE_INVALID; }
+};
+
+// Nearest hit within tMax. Without proc the primitive bounds are what's hit.
+RayHit Raycast(const BVH& bvh, const math::Ray& ray, f32 tMax = MAX_F32, RayHitProc proc = NULL, void* userData = NULL);
+// First hit found within tMax, not necessarily the nearest. Stops right away, for occlusion.
+RayHit RaycastAny(const BVH& bvh, const math::Ray& ray, f32 tMax = MAX_F32, RayHitProc proc = NULL, void* userData = NULL);
+
+};
+};
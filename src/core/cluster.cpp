@@ -0,0 +1,523 @@
+#include "./cluster.hpp"
+
+namespace ty
+{
+namespace cluster
+{
+
+ClusterGrid MakeClusterGrid(mem::Arena* arena, ClusterDesc desc)
+{
+    ASSERT(desc.tilesX > 0 && desc.tilesX <= TY_CLUSTER_MAX_TILES);
+    ASSERT(desc.tilesY > 0 && desc.tilesY <= TY_CLUSTER_MAX_TILES);
+    ASSERT(desc.slices > 0 && desc.slices <= TY_CLUSTER_MAX_TILES);
+    ASSERT(desc.maxLights > 0);
+
+    ClusterGrid result = {};
+    result.tilesX = desc.tilesX;
+    result.tilesY = desc.tilesY;
+    result.slices = desc.slices;
+    result.rowStride = (desc.tilesX + 3) & ~3u;
+    result.maxDepth = desc.farDepth;
+
+    u64 clusterCount = (u64)desc.tilesX * desc.tilesY * desc.slices;
+    u64 maxIndices = desc.maxIndices ? desc.maxIndices : clusterCount * 64;
+    result.clusters = MakeSArray<Cluster>(arena, clusterCount, clusterCount, {});
+    result.indices = MakeSArray<u32>(arena, maxIndices);
+
+    result.sliceDepths = MakeSArray<f32>(arena, desc.slices + 1, desc.slices + 1, 0.f);
+    result.minX = MakeSArray<f32>(arena, desc.slices * result.rowStride, desc.slices * result.rowStride, 0.f);
+    result.maxX = MakeSArray<f32>(arena, desc.slices * result.rowStride, desc.slices * result.rowStride, 0.f);
+    result.minY = MakeSArray<f32>(arena, desc.slices * desc.tilesY, desc.slices * desc.tilesY, 0.f);
+    result.maxY = MakeSArray<f32>(arena, desc.slices * desc.tilesY, desc.slices * desc.tilesY, 0.f);
+    u64 radiusCount = (u64)desc.slices * desc.tilesY * result.rowStride;
+    result.radii = MakeSArray<f32>(arena, radiusCount, radiusCount, 0.f);
+
+    result.lights = MakeSArray<LightBounds>(arena, desc.maxLights);
+    result.sliceLightOffsets = MakeSArray<u32>(arena, desc.slices + 1, desc.slices + 1, 0u);
+    result.sliceLights = MakeSArray<u32>(arena, (u64)desc.maxLights * desc.slices);
+    result.counts = MakeSArray<u32>(arena, clusterCount * 2, clusterCount * 2, 0u);
+    return result;
+}
+
+// ========================================================
+// [BOUNDS]
+// A view space point (x, y, -d) lands on ndc x = m00 * x / d - m02 (m02 = 0 when centered), so
+// the points of a tile edge at ndc n are x = d * (n + m02) / m00. Same for y.
+
+inline void UpdateBounds(ClusterGrid* grid, const m4f& proj)
+{
+    grid->proj = proj;
+
+    // m22 = f / (n - f) and m23 = n * f / (n - f) in math::PerspectiveRH.
+    f32 nearDepth = proj.m23 / proj.m22;
+    f32 farDepth = grid->maxDepth > 0 ? grid->maxDepth : proj.m23 / (proj.m22 + 1);
+    ASSERT(nearDepth > 0 && farDepth > nearDepth);
+    grid->nearDepth = nearDepth;
+    grid->farDepth = farDepth;
+    grid->sliceScale = grid->slices / logf(farDepth / nearDepth);
+    grid->sliceBias = -logf(nearDepth) * grid->sliceScale;
+    for(u32 i = 0; i <= grid->slices; i++)
+    {
+        grid->sliceDepths.data[i] = nearDepth * powf(farDepth / nearDepth, (f32)i / grid->slices);
+    }
+    grid->sliceDepths.data[grid->slices] = farDepth;
+
+    for(u32 slice = 0; slice < grid->slices; slice++)
+    {
+        f32 d0 = grid->sliceDepths.data[slice];
+        f32 d1 = grid->sliceDepths.data[slice + 1];
+        for(u32 x = 0; x < grid->tilesX; x++)
+        {
+            f32 a = (-1 + 2.f * x / grid->tilesX + proj.m02) / proj.m00;
+            f32 b = (-1 + 2.f * (x + 1) / grid->tilesX + proj.m02) / proj.m00;
+            grid->minX.data[slice * grid->rowStride + x] = MIN(MIN(a * d0, a * d1), MIN(b * d0, b * d1));
+            grid->maxX.data[slice * grid->rowStride + x] = MAX(MAX(a * d0, a * d1), MAX(b * d0, b * d1));
+        }
+        for(u32 y = 0; y < grid->tilesY; y++)
+        {
+            f32 a = (-1 + 2.f * y / grid->tilesY + proj.m12) / proj.m11;
+            f32 b = (-1 + 2.f * (y + 1) / grid->tilesY + proj.m12) / proj.m11;
+            grid->minY.data[slice * grid->tilesY + y] = MIN(MIN(a * d0, a * d1), MIN(b * d0, b * d1));
+            grid->maxY.data[slice * grid->tilesY + y] = MAX(MAX(a * d0, a * d1), MAX(b * d0, b * d1));
+        }
+        for(u32 y = 0; y < grid->tilesY; y++)
+        {
+            f32 halfY = (grid->maxY.data[slice * grid->tilesY + y] - grid->minY.data[slice * grid->tilesY + y]) * 0.5f;
+            f32 halfZ = (d1 - d0) * 0.5f;
+            for(u32 x = 0; x < grid->tilesX; x++)
+            {
+                f32 halfX = (grid->maxX.data[slice * grid->rowStride + x] - grid->minX.data[slice * grid->rowStride + x]) * 0.5f;
+                grid->radii.data[(slice * grid->tilesY + y) * grid->rowStride + x] = sqrtf(halfX * halfX + halfY * halfY + halfZ * halfZ);
+            }
+        }
+    }
+}
+
+inline u32 GetSlice(const ClusterGrid& grid, f32 depth)
+{
+    f32 slice = floorf(approx::Log(depth) * grid.sliceScale + grid.sliceBias);
+    return (u32)CLAMP(slice, 0.f, (f32)grid.slices - 1);
+}
+
+// Cell holding each value, clamped to [0, count - 1]. Rounding v - 0.5 to nearest is floor(v)
+// except on integers, which may go one lower: fine for the minimums, and the maximums have a
+// margin added so they never sit on the last cell they need.
+inline simd::i32x4 GetCells(simd::f32x4 value, f32 count)
+{
+    simd::f32x4 clamped = simd::Min(simd::Max(value, simd::Zero()), simd::Set1(count - 0.5f));
+    return simd::ConvertToI32(simd::Sub(clamped, simd::Set1(0.5f)));
+}
+
+inline void TransformLanes(const m4f& m, simd::f32x4* x, simd::f32x4* y, simd::f32x4* z, f32 w)
+{
+    simd::f32x4 rx = simd::MulAdd(simd::Set1(m.m00), *x, simd::MulAdd(simd::Set1(m.m01), *y, simd::MulAdd(simd::Set1(m.m02), *z, simd::Set1(m.m03 * w))));
+    simd::f32x4 ry = simd::MulAdd(simd::Set1(m.m10), *x, simd::MulAdd(simd::Set1(m.m11), *y, simd::MulAdd(simd::Set1(m.m12), *z, simd::Set1(m.m13 * w))));
+    simd::f32x4 rz = simd::MulAdd(simd::Set1(m.m20), *x, simd::MulAdd(simd::Set1(m.m21), *y, simd::MulAdd(simd::Set1(m.m22), *z, simd::Set1(m.m23 * w))));
+    *x = rx;
+    *y = ry;
+    *z = rz;
+}
+
+// Spheres and the tiles and slices they touch, for count lanes of 4 view space spheres.
+// Tiles come from each sphere's box: over it x / d is smallest at the lowest x and the
+// nearest or farthest depth, largest at the opposite side. Ranges are widened by a hundredth
+// of a cell against rounding, the cluster tests trim them.
+inline void BoundSpheres(const ClusterGrid& grid, simd::f32x4 x, simd::f32x4 y, simd::f32x4 z, simd::f32x4 radius,
+        LightBounds* lights, u32 count)
+{
+    const m4f& proj = grid.proj;
+    simd::f32x4 depth = simd::Sub(simd::Zero(), z);
+    simd::f32x4 minDepth = simd::Max(simd::Sub(depth, radius), simd::Set1(grid.nearDepth));
+    simd::f32x4 maxDepth = simd::Min(simd::Add(depth, radius), simd::Set1(grid.farDepth));
+    simd::f32x4 visible = simd::And(simd::CmpGT(radius, simd::Zero()), simd::CmpLE(minDepth, maxDepth));
+    simd::f32x4 invMinDepth = simd::Div(simd::Set1(1), minDepth);
+    simd::f32x4 invMaxDepth = simd::Div(simd::Set1(1), maxDepth);
+
+    simd::f32x4 lowX = simd::Sub(x, radius);
+    simd::f32x4 highX = simd::Add(x, radius);
+    simd::f32x4 lowY = simd::Sub(y, radius);
+    simd::f32x4 highY = simd::Add(y, radius);
+    simd::f32x4 ndcX0 = simd::MulAdd(simd::Set1(proj.m00), simd::Min(simd::Mul(lowX, invMinDepth), simd::Mul(lowX, invMaxDepth)), simd::Set1(-proj.m02));
+    simd::f32x4 ndcX1 = simd::MulAdd(simd::Set1(proj.m00), simd::Max(simd::Mul(highX, invMinDepth), simd::Mul(highX, invMaxDepth)), simd::Set1(-proj.m02));
+    simd::f32x4 ndcY0 = simd::MulAdd(simd::Set1(proj.m11), simd::Min(simd::Mul(lowY, invMinDepth), simd::Mul(lowY, invMaxDepth)), simd::Set1(-proj.m12));
+    simd::f32x4 ndcY1 = simd::MulAdd(simd::Set1(proj.m11), simd::Max(simd::Mul(highY, invMinDepth), simd::Mul(highY, invMaxDepth)), simd::Set1(-proj.m12));
+    simd::f32x4 minNdcX = simd::Min(ndcX0, ndcX1);
+    simd::f32x4 maxNdcX = simd::Max(ndcX0, ndcX1);
+    simd::f32x4 minNdcY = simd::Min(ndcY0, ndcY1);
+    simd::f32x4 maxNdcY = simd::Max(ndcY0, ndcY1);
+    visible = simd::And(visible, simd::And(simd::CmpLE(minNdcX, simd::Set1(1)), simd::CmpGE(maxNdcX, simd::Set1(-1))));
+    visible = simd::And(visible, simd::And(simd::CmpLE(minNdcY, simd::Set1(1)), simd::CmpGE(maxNdcY, simd::Set1(-1))));
+
+    // Tile of an ndc value n is floor((n * 0.5 + 0.5) * tiles).
+    f32 halfTilesX = grid.tilesX * 0.5f;
+    f32 halfTilesY = grid.tilesY * 0.5f;
+    i32 minTileX[4], maxTileX[4], minTileY[4], maxTileY[4], minSlice[4], maxSlice[4];
+    simd::Store(minTileX, GetCells(simd::MulAdd(minNdcX, simd::Set1(halfTilesX), simd::Set1(halfTilesX - 0.01f)), (f32)grid.tilesX));
+    simd::Store(maxTileX, GetCells(simd::MulAdd(maxNdcX, simd::Set1(halfTilesX), simd::Set1(halfTilesX + 0.01f)), (f32)grid.tilesX));
+    simd::Store(minTileY, GetCells(simd::MulAdd(minNdcY, simd::Set1(halfTilesY), simd::Set1(halfTilesY - 0.01f)), (f32)grid.tilesY));
+    simd::Store(maxTileY, GetCells(simd::MulAdd(maxNdcY, simd::Set1(halfTilesY), simd::Set1(halfTilesY + 0.01f)), (f32)grid.tilesY));
+    simd::Store(minSlice, GetCells(simd::MulAdd(approx::Log(minDepth), simd::Set1(grid.sliceScale), simd::Set1(grid.sliceBias - 0.01f)), (f32)grid.slices));
+    simd::Store(maxSlice, GetCells(simd::MulAdd(approx::Log(maxDepth), simd::Set1(grid.sliceScale), simd::Set1(grid.sliceBias + 0.01f)), (f32)grid.slices));
+
+    f32 sphereX[4], sphereY[4], sphereZ[4], sphereRadius[4];
+    simd::Store(sphereX, x);
+    simd::Store(sphereY, y);
+    simd::Store(sphereZ, z);
+    simd::Store(sphereRadius, radius);
+    u32 visibleMask = simd::MoveMask(visible);
+    for(u32 i = 0; i < count; i++)
+    {
+        LightBounds& light = lights[i];
+        light.x = sphereX[i];
+        light.y = sphereY[i];
+        light.z = sphereZ[i];
+        light.radius = sphereRadius[i];
+        if(visibleMask & (1 << i))
+        {
+            light.minTileX = (u16)minTileX[i];
+            light.maxTileX = (u16)maxTileX[i];
+            light.minTileY = (u16)minTileY[i];
+            light.maxTileY = (u16)maxTileY[i];
+            light.minSlice = (u16)minSlice[i];
+            light.maxSlice = (u16)maxSlice[i];
+        }
+        else
+        {
+            light.minSlice = 1;
+            light.maxSlice = 0;
+        }
+    }
+}
+
+// Lights are read 4 at a time, both structs being whole vectors. The last group is copied out
+// and padded with zero radius lights.
+STATIC_ASSERT(sizeof(PointLight) == 4 * sizeof(f32));
+STATIC_ASSERT(sizeof(SpotLight) == 8 * sizeof(f32));
+
+inline void SetupPoints(ClusterGrid* grid, const m4f& view, const PointLight* points, u64 start, u64 end)
+{
+    for(u64 i = start; i < end; i += 4)
+    {
+        u32 count = (u32)MIN(end - i, 4);
+        PointLight group[4];
+        memcpy(group, points + i, count * sizeof(PointLight));
+
+        simd::f32x4 x = simd::Load(&group[0].position.x);
+        simd::f32x4 y = simd::Load(&group[1].position.x);
+        simd::f32x4 z = simd::Load(&group[2].position.x);
+        simd::f32x4 radius = simd::Load(&group[3].position.x);
+        simd::Transpose4(x, y, z, radius);
+        TransformLanes(view, &x, &y, &z, 1);
+        BoundSpheres(*grid, x, y, z, radius, &grid->lights.data[i], count);
+    }
+}
+
+inline void SetupSpots(ClusterGrid* grid, const m4f& view, const SpotLight* spots, u32 pointCount, u64 start, u64 end)
+{
+    for(u64 i = start; i < end; i += 4)
+    {
+        u32 count = (u32)MIN(end - i, 4);
+        SpotLight group[4];
+        memcpy(group, spots + i, count * sizeof(SpotLight));
+        for(u32 j = 0; j < count; j++)
+        {
+            ASSERT(group[j].angle >= 0 && group[j].angle <= PI / 2 + 1e-6f);
+        }
+
+        simd::f32x4 x = simd::Load(&group[0].position.x);
+        simd::f32x4 y = simd::Load(&group[1].position.x);
+        simd::f32x4 z = simd::Load(&group[2].position.x);
+        simd::f32x4 range = simd::Load(&group[3].position.x);
+        simd::f32x4 dirX = simd::Load(&group[0].direction.x);
+        simd::f32x4 dirY = simd::Load(&group[1].direction.x);
+        simd::f32x4 dirZ = simd::Load(&group[2].direction.x);
+        simd::f32x4 angle = simd::Load(&group[3].direction.x);
+        simd::Transpose4(x, y, z, range);
+        simd::Transpose4(dirX, dirY, dirZ, angle);
+        TransformLanes(view, &x, &y, &z, 1);
+        TransformLanes(view, &dirX, &dirY, &dirZ, 0);
+        simd::f32x4 sin, cos;
+        approx::SinCos(angle, &sin, &cos);
+        sin = simd::Min(simd::Max(sin, simd::Zero()), simd::Set1(1));
+        cos = simd::Min(simd::Max(cos, simd::Zero()), simd::Set1(1));
+
+        // Tightest sphere around the cone: the cap's circle for wide cones, else the one
+        // through the apex and that circle.
+        simd::f32x4 wide = simd::CmpGT(angle, simd::Set1(PI / 4));
+        simd::f32x4 narrowDistance = simd::Div(range, simd::Add(cos, cos));
+        simd::f32x4 centerDistance = simd::Select(wide, simd::Mul(cos, range), narrowDistance);
+        simd::f32x4 radius = simd::Select(wide, simd::Mul(sin, range), narrowDistance);
+        LightBounds* lights = &grid->lights.data[pointCount + i];
+        BoundSpheres(*grid, simd::MulAdd(dirX, centerDistance, x), simd::MulAdd(dirY, centerDistance, y),
+                simd::MulAdd(dirZ, centerDistance, z), radius, lights, count);
+
+        f32 cone[9][4];
+        simd::Store(cone[0], x);
+        simd::Store(cone[1], y);
+        simd::Store(cone[2], z);
+        simd::Store(cone[3], dirX);
+        simd::Store(cone[4], dirY);
+        simd::Store(cone[5], dirZ);
+        simd::Store(cone[6], cos);
+        simd::Store(cone[7], sin);
+        simd::Store(cone[8], range);
+        for(u32 j = 0; j < count; j++)
+        {
+            lights[j].apexX = cone[0][j];
+            lights[j].apexY = cone[1][j];
+            lights[j].apexZ = cone[2][j];
+            lights[j].dirX = cone[3][j];
+            lights[j].dirY = cone[4][j];
+            lights[j].dirZ = cone[5][j];
+            lights[j].cosAngle = cone[6][j];
+            lights[j].sinAngle = cone[7][j];
+            lights[j].range = cone[8][j];
+        }
+    }
+}
+
+struct SetupTask
+{
+    ClusterGrid* grid = NULL;
+    const m4f* view = NULL;
+    const PointLight* points = NULL;
+    u32 pointCount = 0;
+    const SpotLight* spots = NULL;
+};
+
+// Lights [start, end), points first then spots.
+inline void SetupRange(ClusterGrid* grid, const m4f& view, const PointLight* points, u32 pointCount, const SpotLight* spots,
+        u64 start, u64 end)
+{
+    if(start < pointCount) SetupPoints(grid, view, points, start, MIN(end, (u64)pointCount));
+    if(end > pointCount) SetupSpots(grid, view, spots, pointCount, MAX(start, (u64)pointCount) - pointCount, end - pointCount);
+}
+
+void SetupTaskProc(void* data, u64 start, u64 end, u32 threadIndex)
+{
+    SetupTask* task = (SetupTask*)data;
+    SetupRange(task->grid, *task->view, task->points, task->pointCount, task->spots, start, end);
+}
+
+// ========================================================
+// [ASSIGN]
+
+// Tests the lights of a slice against the rows of its clusters they may touch, counting the
+// hits or, once the clusters have their ranges, writing them.
+inline void AssignSlice(ClusterGrid* grid, u32 slice, u32 pointCount, bool write)
+{
+    f32 d0 = grid->sliceDepths.data[slice];
+    f32 d1 = grid->sliceDepths.data[slice + 1];
+    const f32* minX = &grid->minX.data[slice * grid->rowStride];
+    const f32* maxX = &grid->maxX.data[slice * grid->rowStride];
+    f32 clusterZ = -(d0 + d1) * 0.5f;       // Cluster sphere centers for the cone tests.
+    simd::f32x4 zero = simd::Zero();
+    simd::f32x4 half = simd::Set1(0.5f);
+
+    for(u32 i = grid->sliceLightOffsets.data[slice]; i < grid->sliceLightOffsets.data[slice + 1]; i++)
+    {
+        u32 lightIndex = grid->sliceLights.data[i];
+        const LightBounds& light = grid->lights.data[lightIndex];
+        bool isSpot = lightIndex >= pointCount;
+        f32 depth = -light.z;
+        f32 dz = MAX(MAX(d0 - depth, depth - d1), 0.f);
+        f32 radius2 = light.radius * light.radius;
+        simd::f32x4 x = simd::Set1(light.x);
+        simd::f32x4 r2 = simd::Set1(radius2);
+
+        for(u32 y = light.minTileY; y <= light.maxTileY; y++)
+        {
+            u32 row = slice * grid->tilesY + y;
+            u32 clusterRow = row * grid->tilesX;
+            f32 minY = grid->minY.data[row];
+            f32 maxY = grid->maxY.data[row];
+            const f32* radii = &grid->radii.data[row * grid->rowStride];
+
+            // Squared distance from the sphere center to the box, y and z are the same on the row.
+            f32 dy = MAX(MAX(minY - light.y, light.y - maxY), 0.f);
+            f32 distanceYZ = dy * dy + dz * dz;
+            if(distanceYZ > radius2) continue;
+
+            f32 clusterY = (minY + maxY) * 0.5f;
+            simd::f32x4 base = simd::Set1(distanceYZ);
+            for(u32 x0 = light.minTileX & ~3u; x0 <= light.maxTileX; x0 += 4)
+            {
+                simd::f32x4 boxMin = simd::Load(minX + x0);
+                simd::f32x4 boxMax = simd::Load(maxX + x0);
+                simd::f32x4 dx = simd::Max(simd::Max(simd::Sub(boxMin, x), simd::Sub(x, boxMax)), zero);
+                simd::f32x4 hit = simd::CmpLE(simd::MulAdd(dx, dx, base), r2);
+                if(isSpot)
+                {
+                    // Cone against the cluster's sphere: cull when the sphere is past the range,
+                    // behind the apex, or farther from the axis than the cone's side. The side
+                    // distance cos * sqrt(len2 - along^2) - along * sin > R is compared squared.
+                    simd::f32x4 clusterRadius = simd::Load(radii + x0);
+                    simd::f32x4 vx = simd::Sub(simd::Mul(simd::Add(boxMin, boxMax), half), simd::Set1(light.apexX));
+                    f32 vy = clusterY - light.apexY;
+                    f32 vz = clusterZ - light.apexZ;
+                    simd::f32x4 len2 = simd::MulAdd(vx, vx, simd::Set1(vy * vy + vz * vz));
+                    simd::f32x4 along = simd::MulAdd(vx, simd::Set1(light.dirX), simd::Set1(vy * light.dirY + vz * light.dirZ));
+                    simd::f32x4 side = simd::MulAdd(along, simd::Set1(light.sinAngle), clusterRadius);
+                    simd::f32x4 axis2 = simd::Mul(simd::Sub(len2, simd::Mul(along, along)), simd::Set1(light.cosAngle * light.cosAngle));
+                    hit = simd::And(hit, simd::CmpGE(side, zero));
+                    hit = simd::And(hit, simd::CmpLE(axis2, simd::Mul(side, side)));
+                    hit = simd::And(hit, simd::CmpLE(along, simd::Add(clusterRadius, simd::Set1(light.range))));
+                    hit = simd::And(hit, simd::CmpGE(simd::Add(along, clusterRadius), zero));
+                }
+
+                u32 lo = light.minTileX > x0 ? light.minTileX - x0 : 0;
+                u32 hi = MIN(light.maxTileX - x0, 3u);
+                u32 bits = simd::MoveMask(hit) & ((2u << hi) - 1) & ~((1u << lo) - 1);
+                while(bits)
+                {
+                    u32 cluster = clusterRow + x0 + __builtin_ctz(bits);
+                    bits &= bits - 1;
+                    u32* count = &grid->counts.data[cluster * 2 + isSpot];
+                    if(write)
+                    {
+                        const Cluster& c = grid->clusters.data[cluster];
+                        if(isSpot && *count < c.spotCount)
+                        {
+                            grid->indices.data[c.offset + c.pointCount + *count] = lightIndex - pointCount;
+                        }
+                        else if(!isSpot && *count < c.pointCount)
+                        {
+                            grid->indices.data[c.offset + *count] = lightIndex;
+                        }
+                    }
+                    (*count)++;
+                }
+            }
+        }
+    }
+}
+
+struct AssignTask
+{
+    ClusterGrid* grid = NULL;
+    u32 pointCount = 0;
+    bool write = false;
+};
+
+void AssignTaskProc(void* data, u64 start, u64 end, u32 threadIndex)
+{
+    AssignTask* task = (AssignTask*)data;
+    for(u64 slice = start; slice < end; slice++)
+    {
+        AssignSlice(task->grid, (u32)slice, task->pointCount, task->write);
+    }
+}
+
+inline void AssignSlices(ClusterGrid* grid, u32 pointCount, bool write, bool parallel)
+{
+    if(parallel)
+    {
+        AssignTask task = {};
+        task.grid = grid;
+        task.pointCount = pointCount;
+        task.write = write;
+        async::ParallelFor(grid->slices, 1, AssignTaskProc, &task);
+    }
+    else
+    {
+        for(u32 slice = 0; slice < grid->slices; slice++)
+        {
+            AssignSlice(grid, slice, pointCount, write);
+        }
+    }
+}
+
+void AssignLights(ClusterGrid* grid, const m4f& view, const m4f& proj,
+        const PointLight* points, u32 pointCount, const SpotLight* spots, u32 spotCount, bool parallel)
+{
+    ASSERT(grid);
+    ASSERT(points || !pointCount);
+    ASSERT(spots || !spotCount);
+    u32 lightCount = pointCount + spotCount;
+    ASSERT(lightCount <= grid->lights.capacity);
+
+    if(memcmp(&grid->proj, &proj, sizeof(m4f))) UpdateBounds(grid, proj);
+
+    grid->lights.count = lightCount;
+    if(parallel)
+    {
+        SetupTask task = {};
+        task.grid = grid;
+        task.view = &view;
+        task.points = points;
+        task.pointCount = pointCount;
+        task.spots = spots;
+        async::ParallelFor(lightCount, TY_CLUSTER_PARALLEL_BATCH, SetupTaskProc, &task);
+    }
+    else
+    {
+        SetupRange(grid, view, points, pointCount, spots, 0, lightCount);
+    }
+
+    // Lights of each slice, in light order.
+    u32* sliceOffsets = grid->sliceLightOffsets.data;
+    memset(sliceOffsets, 0, (grid->slices + 1) * sizeof(u32));
+    for(u32 i = 0; i < lightCount; i++)
+    {
+        const LightBounds& light = grid->lights.data[i];
+        for(u32 slice = light.minSlice; slice <= light.maxSlice; slice++)
+        {
+            sliceOffsets[slice + 1]++;
+        }
+    }
+    for(u32 slice = 0; slice < grid->slices; slice++)
+    {
+        sliceOffsets[slice + 1] += sliceOffsets[slice];
+    }
+    grid->sliceLights.count = sliceOffsets[grid->slices];
+    for(u32 i = 0; i < lightCount; i++)
+    {
+        const LightBounds& light = grid->lights.data[i];
+        for(u32 slice = light.minSlice; slice <= light.maxSlice; slice++)
+        {
+            grid->sliceLights.data[sliceOffsets[slice]++] = i;
+        }
+    }
+    for(u32 slice = grid->slices; slice > 0; slice--)
+    {
+        sliceOffsets[slice] = sliceOffsets[slice - 1];
+    }
+    sliceOffsets[0] = 0;
+
+    memset(grid->counts.data, 0, grid->counts.count * sizeof(u32));
+    AssignSlices(grid, pointCount, false, parallel);
+
+    // Cluster ranges, the last lights of the last clusters are dropped when out of space.
+    u64 offset = 0;
+    u64 capacity = grid->indices.capacity;
+    grid->droppedCount = 0;
+    for(u64 i = 0; i < grid->clusters.count; i++)
+    {
+        u32 wantedPoints = grid->counts.data[i * 2];
+        u32 wantedSpots = grid->counts.data[i * 2 + 1];
+        u32 pointsInCluster = (u32)MIN(MIN(wantedPoints, (u32)MAX_U16), capacity - offset);
+        u32 spotsInCluster = (u32)MIN(MIN(wantedSpots, (u32)MAX_U16), capacity - offset - pointsInCluster);
+        grid->droppedCount += wantedPoints - pointsInCluster + wantedSpots - spotsInCluster;
+
+        Cluster& cluster = grid->clusters.data[i];
+        cluster.offset = (u32)offset;
+        cluster.pointCount = (u16)pointsInCluster;
+        cluster.spotCount = (u16)spotsInCluster;
+        offset += pointsInCluster + spotsInCluster;
+    }
+    grid->indices.count = offset;
+
+    memset(grid->counts.data, 0, grid->counts.count * sizeof(u32));
+    AssignSlices(grid, pointCount, true, parallel);
+}
+
+u32 GetClusterIndex(const ClusterGrid& grid, f32 screenX, f32 screenY, f32 viewDepth)
+{
+    u32 x = (u32)CLAMP(screenX * grid.tilesX, 0.f, (f32)grid.tilesX - 1);
+    u32 y = (u32)CLAMP(screenY * grid.tilesY, 0.f, (f32)grid.tilesY - 1);
+    u32 slice = GetSlice(grid, MAX(viewDepth, grid.nearDepth));
+    return (slice * grid.tilesY + y) * grid.tilesX + x;
+}
+
+};
+};
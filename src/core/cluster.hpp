@@ -0,0 +1,141 @@
+// ========================================================
+// CLUSTER
+// Clustered light assignment (forward+): the view frustum is split in a grid of clusters,
+// screen tiles times depth slices, and each cluster gets the list of point and spot lights
+// that can reach it. Shaders find their pixel's cluster and loop over its lights only, so
+// scenes can hold thousands of small lights at the cost of a handful each.
+// Slices are spaced exponentially in view depth (Olsson et al., "Clustered Deferred and
+// Forward Shading", 2012), so clusters stay roughly cubic. Each cluster is tested as its
+// view space AABB: spheres against the box, spot cones against the box's bounding sphere
+// (Wronski, "Cull that cone!", 2016).
+// Lights are first bounded by the tiles and slices they may touch, 4 at a time with
+// core/simd, then binned by slice. Each slice tests its lights against the clusters in
+// their bounds, 4 at a time along a row of tiles, once to count and once to write, so the
+// output is compact and in light order without atomics. Light setup and slices run across
+// the async workers.
+// The output is one Cluster per cluster and one index list, as they go to storage buffers.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./debug.hpp"
+#include "./memory.hpp"
+#include "./simd.hpp"
+#include "./math.hpp"
+#include "./approx.hpp"
+#include "./async.hpp"
+#include "./ds.hpp"
+
+namespace ty
+{
+namespace cluster
+{
+
+#define TY_CLUSTER_MAX_TILES 1024           // Per axis, and slices.
+#define TY_CLUSTER_PARALLEL_BATCH 1024      // Lights per parallel setup task.
+
+struct PointLight
+{
+    v3f position = {};
+    f32 radius = 0;                         // Range, no light beyond it.
+};
+
+struct SpotLight
+{
+    v3f position = {};
+    f32 radius = 0;
+    v3f direction = {0, 0, -1};             // Normalized.
+    f32 angle = 0;                          // Outer half angle in radians, up to PI / 2.
+};
+
+// What a shader reads for its cluster: indices[offset, offset + pointCount) are point lights,
+// then spotCount spot lights, each in increasing order.
+struct Cluster
+{
+    u32 offset = 0;
+    u16 pointCount = 0;
+    u16 spotCount = 0;
+};
+
+// View space bounding sphere, apex and cone of a light, and the clusters it may touch.
+struct LightBounds
+{
+    f32 x;
+    f32 y;
+    f32 z;
+    f32 radius;
+    f32 apexX;                              // Spot lights only.
+    f32 apexY;
+    f32 apexZ;
+    f32 dirX;
+    f32 dirY;
+    f32 dirZ;
+    f32 cosAngle;
+    f32 sinAngle;
+    f32 range;
+    u16 minTileX;                           // minSlice > maxSlice when off screen.
+    u16 maxTileX;
+    u16 minTileY;
+    u16 maxTileY;
+    u16 minSlice;
+    u16 maxSlice;
+};
+
+struct ClusterDesc
+{
+    u32 tilesX = 16;
+    u32 tilesY = 9;
+    u32 slices = 24;
+    f32 farDepth = 0;                       // View distance of the last slice, 0 uses the projection's far plane.
+    u32 maxLights = 0;                      // Point and spot lights per AssignLights call.
+    u32 maxIndices = 0;                     // Light references over all clusters, 0 uses 64 per cluster.
+};
+
+struct ClusterGrid
+{
+    u32 tilesX = 0;
+    u32 tilesY = 0;
+    u32 slices = 0;
+    u32 rowStride = 0;                      // tilesX rounded up to a multiple of 4.
+    f32 maxDepth = 0;                       // ClusterDesc::farDepth.
+
+    // Slice of a view depth d is floor(log(d) * sliceScale + sliceBias), as shaders compute it.
+    f32 nearDepth = 0;
+    f32 farDepth = 0;
+    f32 sliceScale = 0;
+    f32 sliceBias = 0;
+
+    SArray<Cluster> clusters;               // x first, then y, then slice.
+    SArray<u32> indices;
+    u32 droppedCount = 0;                   // References that didn't fit maxIndices in the last call, highest lights first.
+
+    // Cluster bounds, rebuilt when the projection changes.
+    m4f proj = {};
+    SArray<f32> sliceDepths;                // slices + 1 view distances.
+    SArray<f32> minX;                       // View space x of each tile column per slice, rowStride per slice.
+    SArray<f32> maxX;
+    SArray<f32> minY;                       // tilesY per slice.
+    SArray<f32> maxY;
+    SArray<f32> radii;                      // Bounding sphere radius of each cluster, rowStride per row.
+
+    // Scratch for AssignLights.
+    SArray<LightBounds> lights;
+    SArray<u32> sliceLightOffsets;          // slices + 1.
+    SArray<u32> sliceLights;
+    SArray<u32> counts;                     // Point and spot references per cluster.
+};
+
+ClusterGrid MakeClusterGrid(mem::Arena* arena, ClusterDesc desc);
+
+// Fills the clusters for a camera. proj is a math::PerspectiveRH style projection (Vulkan
+// clip space, depth 0 to 1), possibly off center.
+void AssignLights(ClusterGrid* grid, const m4f& view, const m4f& proj,
+        const PointLight* points, u32 pointCount, const SpotLight* spots, u32 spotCount, bool parallel = false);
+
+// Cluster of a point on screen, x and y in [0, 1] from the top left as gl_FragCoord / size,
+// at a view distance. Same as the shader side lookup.
+u32 GetClusterIndex(const ClusterGrid& grid, f32 screenX, f32 screenY, f32 viewDepth);
+
+};
+};
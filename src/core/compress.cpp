@@ -0,0 +1,486 @@
+#include "./compress.hpp"
+#include "./async.hpp"
+
+namespace ty
+{
+namespace compress
+{
+
+inline u32 Read32(const byte* p)
+{
+    u32 result;
+    memcpy(&result, p, sizeof(u32));
+    return result;
+}
+
+inline u64 Read64(const byte* p)
+{
+    u64 result;
+    memcpy(&result, p, sizeof(u64));
+    return result;
+}
+
+inline u32 RotateLeft32(u32 v, u32 r)
+{
+    return (v << r) | (v >> (32 - r));
+}
+
+// ========================================================
+// [CHECKSUM]
+#define XXH32_P1 2654435761U
+#define XXH32_P2 2246822519U
+#define XXH32_P3 3266489917U
+#define XXH32_P4 668265263U
+#define XXH32_P5 374761393U
+
+inline u32 Xxh32Round(u32 acc, u32 input)
+{
+    acc += input * XXH32_P2;
+    acc = RotateLeft32(acc, 13);
+    return acc * XXH32_P1;
+}
+
+u32 Checksum32(const void* data, u64 size, u32 seed)
+{
+    const byte* p = (const byte*)data;
+    const byte* end = p + size;
+    u32 h;
+    if(size >= 16)
+    {
+        const byte* limit = end - 16;
+        u32 v1 = seed + XXH32_P1 + XXH32_P2;
+        u32 v2 = seed + XXH32_P2;
+        u32 v3 = seed;
+        u32 v4 = seed - XXH32_P1;
+        do
+        {
+            v1 = Xxh32Round(v1, Read32(p));
+            v2 = Xxh32Round(v2, Read32(p + 4));
+            v3 = Xxh32Round(v3, Read32(p + 8));
+            v4 = Xxh32Round(v4, Read32(p + 12));
+            p += 16;
+        } while(p <= limit);
+        h = RotateLeft32(v1, 1) + RotateLeft32(v2, 7) + RotateLeft32(v3, 12) + RotateLeft32(v4, 18);
+    }
+    else
+    {
+        h = seed + XXH32_P5;
+    }
+    h += (u32)size;
+    while(p + 4 <= end)
+    {
+        h += Read32(p) * XXH32_P3;
+        h = RotateLeft32(h, 17) * XXH32_P4;
+        p += 4;
+    }
+    while(p < end)
+    {
+        h += (*p) * XXH32_P5;
+        h = RotateLeft32(h, 11) * XXH32_P1;
+        p++;
+    }
+    h ^= h >> 15;
+    h *= XXH32_P2;
+    h ^= h >> 13;
+    h *= XXH32_P3;
+    h ^= h >> 16;
+    return h;
+}
+
+// ========================================================
+// [BLOCK]
+// Sequence: [token][literal length ext][literals][offset u16][match length ext]
+// Token high nibble is literal length, low nibble is match length - LZ_MIN_MATCH, 15 means
+// the length continues in extension bytes (255 = keep reading). The last sequence has
+// only literals. Matches never start within LZ_MF_LIMIT bytes of the end and never cover
+// the last LZ_LAST_LITERALS bytes, which leaves room for the decoder to copy in wide chunks.
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 5
+#define LZ_MF_LIMIT 12
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_LOG 14
+#define LZ_SKIP_TRIGGER 6               // Search step grows every 2^N failed attempts.
+#define LZ_WILD_COPY 16
+
+inline u32 LzHash(u32 v)
+{
+    return (v * 2654435761U) >> (32 - LZ_HASH_LOG);
+}
+
+inline u64 LzCountMatch(const byte* a, const byte* b, const byte* aLimit)
+{
+    const byte* start = a;
+    while(a + 8 <= aLimit)
+    {
+        u64 diff = Read64(a) ^ Read64(b);
+        if(diff) return (a - start) + (__builtin_ctzll(diff) >> 3);
+        a += 8;
+        b += 8;
+    }
+    while(a < aLimit && *a == *b)
+    {
+        a++;
+        b++;
+    }
+    return a - start;
+}
+
+inline byte* LzWriteLength(byte* op, u64 len)
+{
+    while(len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (byte)len;
+    return op;
+}
+
+inline byte* LzWriteLiterals(byte* op, byte* token, const byte* literals, u64 len)
+{
+    *token = (byte)(MIN(len, 15) << 4);
+    if(len >= 15) op = LzWriteLength(op, len - 15);
+    memcpy(op, literals, len);
+    return op + len;
+}
+
+u64 GetMaxCompressedSize(u64 srcSize)
+{
+    return srcSize + srcSize / 255 + 16;
+}
+
+u64 CompressBlock(const byte* src, u64 srcSize, byte* dst, u64 dstCapacity)
+{
+    ASSERT(srcSize <= MAX_U32);
+    if(dstCapacity < GetMaxCompressedSize(srcSize)) return 0;
+
+    const byte* ip = src;
+    const byte* anchor = src;
+    const byte* iend = src + srcSize;
+    byte* op = dst;
+    if(srcSize > LZ_MF_LIMIT)
+    {
+        const byte* mfLimit = iend - LZ_MF_LIMIT;
+        const byte* matchLimit = iend - LZ_LAST_LITERALS;
+        u32 hashTable[1 << LZ_HASH_LOG];    // Positions relative to src.
+        memset(hashTable, 0, sizeof(hashTable));
+        ip++;
+        while(true)
+        {
+            // Find a match, stepping faster through data that doesn't compress.
+            const byte* match = NULL;
+            u32 searchCount = 1 << LZ_SKIP_TRIGGER;
+            while(true)
+            {
+                if(ip > mfLimit) goto lastLiterals;
+                u32 h = LzHash(Read32(ip));
+                match = src + hashTable[h];
+                hashTable[h] = (u32)(ip - src);
+                if(ip - match <= LZ_MAX_OFFSET && Read32(match) == Read32(ip)) break;
+                ip += searchCount++ >> LZ_SKIP_TRIGGER;
+            }
+            while(ip > anchor && match > src && ip[-1] == match[-1])
+            {
+                ip--;
+                match--;
+            }
+
+            u64 matchLen = LzCountMatch(ip + LZ_MIN_MATCH, match + LZ_MIN_MATCH, matchLimit);
+            byte* token = op++;
+            op = LzWriteLiterals(op, token, anchor, ip - anchor);
+            u16 offset = (u16)(ip - match);
+            op[0] = (byte)(offset & 0xFF);
+            op[1] = (byte)(offset >> 8);
+            op += 2;
+            *token |= (byte)MIN(matchLen, 15);
+            if(matchLen >= 15) op = LzWriteLength(op, matchLen - 15);
+
+            ip += matchLen + LZ_MIN_MATCH;
+            anchor = ip;
+            if(ip <= mfLimit) hashTable[LzHash(Read32(ip - 2))] = (u32)(ip - 2 - src);
+        }
+    }
+
+lastLiterals:
+    byte* token = op++;
+    op = LzWriteLiterals(op, token, anchor, iend - anchor);
+    return op - dst;
+}
+
+inline void LzWildCopy16(byte* dst, const byte* src, u64 len)
+{
+    // Fixed size copies compile to single unaligned vector loads/stores.
+    // May write up to 15 bytes past dst + len.
+    byte* end = dst + len;
+    do
+    {
+        memcpy(dst, src, 16);
+        dst += 16;
+        src += 16;
+    } while(dst < end);
+}
+
+inline void LzWildCopy8(byte* dst, const byte* src, u64 len)
+{
+    byte* end = dst + len;
+    do
+    {
+        memcpy(dst, src, 8);
+        dst += 8;
+        src += 8;
+    } while(dst < end);
+}
+
+inline bool LzReadLength(const byte** ip, const byte* iend, u64* len)
+{
+    byte b;
+    do
+    {
+        if(*ip >= iend) return false;
+        b = *(*ip)++;
+        *len += b;
+    } while(b == 255);
+    return true;
+}
+
+u64 DecompressBlock(const byte* src, u64 srcSize, byte* dst, u64 dstCapacity)
+{
+    const byte* ip = src;
+    const byte* iend = src + srcSize;
+    byte* op = dst;
+    byte* oend = dst + dstCapacity;
+    while(true)
+    {
+        if(ip >= iend) return MAX_U64;
+        byte token = *ip++;
+
+        // Literals
+        u64 litLen = token >> 4;
+        if(litLen < 15 && iend - ip >= LZ_WILD_COPY + 2 && oend - op >= 2 * LZ_WILD_COPY)
+        {
+            // Short sequence fast path, most sequences end up here. With enough room left in
+            // both buffers, copy fixed sizes and skip the per-length checks.
+            memcpy(op, ip, 16);
+            op += litLen;
+            ip += litLen;
+            u64 offset = ip[0] | ((u64)ip[1] << 8);
+            u64 matchLen = token & 15;
+            if(matchLen < 15 && offset >= 8 && offset <= (u64)(op - dst))
+            {
+                const byte* match = op - offset;
+                memcpy(op, match, 8);
+                memcpy(op + 8, match + 8, 8);
+                memcpy(op + 16, match + 16, 2);
+                op += matchLen + LZ_MIN_MATCH;
+                ip += 2;
+                continue;
+            }
+        }
+        else
+        {
+            if(litLen == 15 && !LzReadLength(&ip, iend, &litLen)) return MAX_U64;
+            if(litLen > (u64)(iend - ip) || litLen > (u64)(oend - op)) return MAX_U64;
+            if(litLen + LZ_WILD_COPY <= (u64)(oend - op) && litLen + LZ_WILD_COPY <= (u64)(iend - ip))
+            {
+                LzWildCopy16(op, ip, litLen);
+            }
+            else
+            {
+                memcpy(op, ip, litLen);
+            }
+            op += litLen;
+            ip += litLen;
+            if(ip == iend) break;   // Last sequence
+        }
+
+        // Match
+        if(iend - ip < 2) return MAX_U64;
+        u64 offset = ip[0] | ((u64)ip[1] << 8);
+        ip += 2;
+        if(offset == 0 || offset > (u64)(op - dst)) return MAX_U64;
+        u64 matchLen = token & 15;
+        if(matchLen == 15 && !LzReadLength(&ip, iend, &matchLen)) return MAX_U64;
+        matchLen += LZ_MIN_MATCH;
+        if(matchLen > (u64)(oend - op)) return MAX_U64;
+
+        const byte* match = op - offset;
+        if(matchLen + LZ_WILD_COPY > (u64)(oend - op))
+        {
+            // Near the end of output, copy exactly. Byte order handles overlap.
+            for(u64 i = 0; i < matchLen; i++)
+            {
+                op[i] = match[i];
+            }
+        }
+        else if(offset >= 16)
+        {
+            LzWildCopy16(op, match, matchLen);
+        }
+        else if(offset >= 8)
+        {
+            LzWildCopy8(op, match, matchLen);
+        }
+        else
+        {
+            // Short repeating pattern: expand the first 8 bytes, then continue with a
+            // multiple of offset that is at least 8, which the chunked copy can handle.
+            for(u64 i = 0; i < 8; i++)
+            {
+                op[i] = match[i];
+            }
+            if(matchLen > 8)
+            {
+                u64 patternOffset = offset * ((8 + offset - 1) / offset);
+                LzWildCopy8(op + 8, op + 8 - patternOffset, matchLen - 8);
+            }
+        }
+        op += matchLen;
+    }
+    return op - dst;
+}
+
+// ========================================================
+// [FRAME]
+u64 GetMaxFrameSize(u64 srcSize, CompressDesc desc)
+{
+    ASSERT(desc.blockSize > 0 && desc.blockSize < TY_LZ_BLOCK_STORED);
+    u64 blockCount = (srcSize + desc.blockSize - 1) / desc.blockSize;
+    return sizeof(FrameHeader)
+        + blockCount * sizeof(BlockHeader)
+        + srcSize + srcSize / 255 + blockCount * 16;
+}
+
+struct FrameCompressData
+{
+    const byte* src = NULL;
+    u64 srcSize = 0;
+    byte* dst = NULL;
+    u64 blockSize = 0;
+    u64 blockSlotSize = 0;
+};
+
+void CompressFrameBlocks(void* data, u64 start, u64 end, u32 threadIndex)
+{
+    // Each block goes to its own worst-case sized slot in dst, compacted afterwards.
+    FrameCompressData* frame = (FrameCompressData*)data;
+    for(u64 i = start; i < end; i++)
+    {
+        const byte* blockSrc = frame->src + i * frame->blockSize;
+        u64 blockRawSize = MIN(frame->blockSize, frame->srcSize - i * frame->blockSize);
+        byte* slot = frame->dst + sizeof(FrameHeader) + i * frame->blockSlotSize;
+        byte* blockDst = slot + sizeof(BlockHeader);
+
+        BlockHeader header = {};
+        u64 size = CompressBlock(blockSrc, blockRawSize, blockDst, GetMaxCompressedSize(blockRawSize));
+        if(size == 0 || size >= blockRawSize)
+        {
+            memcpy(blockDst, blockSrc, blockRawSize);
+            size = blockRawSize;
+            header.size = (u32)size | TY_LZ_BLOCK_STORED;
+        }
+        else
+        {
+            header.size = (u32)size;
+        }
+        header.checksum = Checksum32(blockDst, size);
+        memcpy(slot, &header, sizeof(BlockHeader));
+    }
+}
+
+u64 CompressFrame(const byte* src, u64 srcSize, byte* dst, u64 dstCapacity, CompressDesc desc)
+{
+    if(dstCapacity < GetMaxFrameSize(srcSize, desc)) return 0;
+
+    FrameHeader header = {};
+    header.rawSize = srcSize;
+    header.blockSize = desc.blockSize;
+    memcpy(dst, &header, sizeof(FrameHeader));
+
+    u64 blockCount = (srcSize + desc.blockSize - 1) / desc.blockSize;
+    FrameCompressData frame = {};
+    frame.src = src;
+    frame.srcSize = srcSize;
+    frame.dst = dst;
+    frame.blockSize = desc.blockSize;
+    frame.blockSlotSize = sizeof(BlockHeader) + GetMaxCompressedSize(desc.blockSize);
+    if(desc.parallel && blockCount > 1)
+    {
+        async::ParallelFor(blockCount, 1, CompressFrameBlocks, &frame);
+    }
+    else
+    {
+        CompressFrameBlocks(&frame, 0, blockCount, async::GetThreadIndex());
+    }
+
+    // Compact block slots. Slots only move towards the start, in order.
+    byte* cursor = dst + sizeof(FrameHeader);
+    for(u64 i = 0; i < blockCount; i++)
+    {
+        byte* slot = dst + sizeof(FrameHeader) + i * frame.blockSlotSize;
+        BlockHeader blockHeader;
+        memcpy(&blockHeader, slot, sizeof(BlockHeader));
+        u64 size = sizeof(BlockHeader) + (blockHeader.size & ~TY_LZ_BLOCK_STORED);
+        if(cursor != slot) memmove(cursor, slot, size);
+        cursor += size;
+    }
+    return cursor - dst;
+}
+
+bool IsFrame(const byte* src, u64 srcSize)
+{
+    if(srcSize < sizeof(FrameHeader)) return false;
+    FrameHeader header;
+    memcpy(&header, src, sizeof(FrameHeader));
+    return header.magic == TY_LZ_FRAME_MAGIC
+        && header.version == TY_LZ_FRAME_VERSION
+        && header.blockSize > 0
+        && header.blockSize < TY_LZ_BLOCK_STORED;
+}
+
+u64 GetFrameRawSize(const byte* src, u64 srcSize)
+{
+    if(!IsFrame(src, srcSize)) return 0;
+    FrameHeader header;
+    memcpy(&header, src, sizeof(FrameHeader));
+    return header.rawSize;
+}
+
+bool DecompressFrame(const byte* src, u64 srcSize, byte* dst, u64 dstSize)
+{
+    if(!IsFrame(src, srcSize)) return false;
+    FrameHeader header;
+    memcpy(&header, src, sizeof(FrameHeader));
+    if(header.rawSize != dstSize) return false;
+
+    const byte* ip = src + sizeof(FrameHeader);
+    const byte* iend = src + srcSize;
+    u64 written = 0;
+    while(written < dstSize)
+    {
+        if((u64)(iend - ip) < sizeof(BlockHeader)) return false;
+        BlockHeader blockHeader;
+        memcpy(&blockHeader, ip, sizeof(BlockHeader));
+        ip += sizeof(BlockHeader);
+
+        u64 size = blockHeader.size & ~TY_LZ_BLOCK_STORED;
+        u64 blockRawSize = MIN((u64)header.blockSize, dstSize - written);
+        if(size > (u64)(iend - ip)) return false;
+        if(Checksum32(ip, size) != blockHeader.checksum) return false;
+        if(blockHeader.size & TY_LZ_BLOCK_STORED)
+        {
+            if(size != blockRawSize) return false;
+            memcpy(dst + written, ip, size);
+        }
+        else
+        {
+            u64 decompressedSize = DecompressBlock(ip, size, dst + written, blockRawSize);
+            if(decompressedSize != blockRawSize) return false;
+        }
+        ip += size;
+        written += blockRawSize;
+    }
+    return ip == iend;
+}
+
+};
+};
@@ -0,0 +1,74 @@
+// ========================================================
+// COMPRESS
+// Fast LZ block compression (LZ4 block format) and a framed format with independent,
+// checksummed blocks. Tuned for decompression speed over compression ratio.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./debug.hpp"
+
+namespace ty
+{
+namespace compress
+{
+
+// ========================================================
+// [CHECKSUM]
+u32 Checksum32(const void* data, u64 size, u32 seed = 0);     // xxHash32
+
+// ========================================================
+// [BLOCK]
+// Raw LZ blocks. Carry no size information, the caller keeps track of both sizes.
+// Blocks must be smaller than 4GB.
+u64 GetMaxCompressedSize(u64 srcSize);
+
+// Returns compressed size, or 0 if dstCapacity is smaller than GetMaxCompressedSize(srcSize).
+u64 CompressBlock(const byte* src, u64 srcSize, byte* dst, u64 dstCapacity);
+// Returns decompressed size, or MAX_U64 if the block is malformed or doesn't fit in dst.
+// Never reads or writes out of bounds, even for corrupt input.
+u64 DecompressBlock(const byte* src, u64 srcSize, byte* dst, u64 dstCapacity);
+
+// ========================================================
+// [FRAME]
+// Layout: [FrameHeader][BlockHeader][block data][BlockHeader][block data]...
+// Blocks are compressed independently (so they can be compressed in parallel) and
+// each one is checksummed. Blocks that don't compress are stored raw.
+#define TY_LZ_FRAME_MAGIC 0x5A4C5954       // 'TYLZ'
+#define TY_LZ_FRAME_VERSION 1
+#define TY_LZ_DEFAULT_BLOCK_SIZE KB(256)
+#define TY_LZ_BLOCK_STORED 0x80000000      // BlockHeader size flag, data is uncompressed.
+
+struct FrameHeader
+{
+    u32 magic = TY_LZ_FRAME_MAGIC;
+    u32 version = TY_LZ_FRAME_VERSION;
+    u64 rawSize = 0;
+    u32 blockSize = 0;
+    u32 reserved = 0;
+};
+
+struct BlockHeader
+{
+    u32 size = 0;           // Stored size, with TY_LZ_BLOCK_STORED if uncompressed.
+    u32 checksum = 0;       // Checksum32 of stored data.
+};
+
+struct CompressDesc
+{
+    u32 blockSize = TY_LZ_DEFAULT_BLOCK_SIZE;
+    bool parallel = true;   // Compress blocks on async workers.
+};
+
+u64 GetMaxFrameSize(u64 srcSize, CompressDesc desc = {});
+// Returns frame size, or 0 if dstCapacity is smaller than GetMaxFrameSize.
+u64 CompressFrame(const byte* src, u64 srcSize, byte* dst, u64 dstCapacity, CompressDesc desc = {});
+
+bool IsFrame(const byte* src, u64 srcSize);
+u64 GetFrameRawSize(const byte* src, u64 srcSize);      // 0 if src is not a valid frame.
+// dstSize must match the frame's raw size. Fails on any checksum or format error.
+bool DecompressFrame(const byte* src, u64 srcSize, byte* dst, u64 dstSize);
+
+};
+};
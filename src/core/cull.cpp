@@ -0,0 +1,230 @@
+#include "./cull.hpp"
+
+namespace ty
+{
+namespace cull
+{
+
+// ========================================================
+// [PLANES]
+
+CullPlanes MakeCullPlanes(const math::Frustum& frustum)
+{
+    CullPlanes result;
+    for(u32 i = 0; i < 6; i++)
+    {
+        const math::plane& plane = frustum.planes[i];
+        for(u32 lane = 0; lane < 8; lane++)
+        {
+            result.x[i][lane] = plane.x;
+            result.y[i][lane] = plane.y;
+            result.z[i][lane] = plane.z;
+            result.w[i][lane] = plane.w;
+            result.absX[i][lane] = fabsf(plane.x);
+            result.absY[i][lane] = fabsf(plane.y);
+            result.absZ[i][lane] = fabsf(plane.z);
+        }
+    }
+    return result;
+}
+
+// ========================================================
+// [TESTS]
+// A box is inside a plane when its center distance plus the extent projected on the normal
+// is positive, a sphere when the center distance plus the radius is. Same as testing the box
+// corner furthest along the normal (math::IsInFrustum). The single versions handle the
+// leftovers, in the same order of operations.
+
+inline simd::f32x8 PlaneDistance8(const CullPlanes& planes, u32 i, simd::f32x8 x, simd::f32x8 y, simd::f32x8 z)
+{
+    simd::f32x8 result = simd::MulAdd(simd::Load8(planes.x[i]), x, simd::Load8(planes.w[i]));
+    result = simd::MulAdd(simd::Load8(planes.y[i]), y, result);
+    return simd::MulAdd(simd::Load8(planes.z[i]), z, result);
+}
+
+inline f32 PlaneDistance(const CullPlanes& planes, u32 i, f32 x, f32 y, f32 z)
+{
+    f32 result = planes.x[i][0] * x + planes.w[i][0];
+    result = planes.y[i][0] * y + result;
+    return planes.z[i][0] * z + result;
+}
+
+inline u32 Test8(const CullPlanes& planes, const BoxArrays& boxes, u64 start)
+{
+    simd::f32x8 cx = simd::Load8(boxes.centerX + start);
+    simd::f32x8 cy = simd::Load8(boxes.centerY + start);
+    simd::f32x8 cz = simd::Load8(boxes.centerZ + start);
+    simd::f32x8 ex = simd::Load8(boxes.extentX + start);
+    simd::f32x8 ey = simd::Load8(boxes.extentY + start);
+    simd::f32x8 ez = simd::Load8(boxes.extentZ + start);
+    simd::f32x8 zero = simd::Splat8(0);
+    simd::f32x8 inside;
+    for(u32 i = 0; i < 6; i++)
+    {
+        simd::f32x8 radius = simd::Mul(simd::Load8(planes.absX[i]), ex);
+        radius = simd::MulAdd(simd::Load8(planes.absY[i]), ey, radius);
+        radius = simd::MulAdd(simd::Load8(planes.absZ[i]), ez, radius);
+        simd::f32x8 planeInside = simd::CmpGE(simd::Add(PlaneDistance8(planes, i, cx, cy, cz), radius), zero);
+        inside = i ? simd::And(inside, planeInside) : planeInside;
+    }
+    return simd::MoveMask(inside);
+}
+
+inline bool Test(const CullPlanes& planes, const BoxArrays& boxes, u64 index)
+{
+    bool result = true;
+    for(u32 i = 0; i < 6; i++)
+    {
+        f32 radius = planes.absX[i][0] * boxes.extentX[index];
+        radius = planes.absY[i][0] * boxes.extentY[index] + radius;
+        radius = planes.absZ[i][0] * boxes.extentZ[index] + radius;
+        f32 distance = PlaneDistance(planes, i, boxes.centerX[index], boxes.centerY[index], boxes.centerZ[index]);
+        result &= distance + radius >= 0;
+    }
+    return result;
+}
+
+inline u32 Test8(const CullPlanes& planes, const SphereArrays& spheres, u64 start)
+{
+    simd::f32x8 cx = simd::Load8(spheres.centerX + start);
+    simd::f32x8 cy = simd::Load8(spheres.centerY + start);
+    simd::f32x8 cz = simd::Load8(spheres.centerZ + start);
+    simd::f32x8 radius = simd::Load8(spheres.radius + start);
+    simd::f32x8 zero = simd::Splat8(0);
+    simd::f32x8 inside;
+    for(u32 i = 0; i < 6; i++)
+    {
+        simd::f32x8 planeInside = simd::CmpGE(simd::Add(PlaneDistance8(planes, i, cx, cy, cz), radius), zero);
+        inside = i ? simd::And(inside, planeInside) : planeInside;
+    }
+    return simd::MoveMask(inside);
+}
+
+inline bool Test(const CullPlanes& planes, const SphereArrays& spheres, u64 index)
+{
+    bool result = true;
+    for(u32 i = 0; i < 6; i++)
+    {
+        f32 distance = PlaneDistance(planes, i, spheres.centerX[index], spheres.centerY[index], spheres.centerZ[index]);
+        result &= distance + spheres.radius[index] >= 0;
+    }
+    return result;
+}
+
+// ========================================================
+// [CULL]
+
+// Fills the mask words covering [start, end). start must be a multiple of 64.
+template <typename Bounds>
+void CullRange(const CullPlanes& planes, const Bounds& bounds, u64 start, u64 end, u64* mask)
+{
+    ASSERT(start % 64 == 0);
+    for(u64 base = start; base < end; base += 64)
+    {
+        u64 wordEnd = MIN(base + 64, end);
+        u64 bits = 0;
+        u64 i = base;
+        for(; i + 8 <= wordEnd; i += 8)
+        {
+            bits |= (u64)Test8(planes, bounds, i) << (i - base);
+        }
+        for(; i < wordEnd; i++)
+        {
+            bits |= (u64)Test(planes, bounds, i) << (i - base);
+        }
+        mask[base / 64] = bits;
+    }
+}
+
+template <typename Bounds>
+struct CullTask
+{
+    const CullPlanes* planes = NULL;
+    const Bounds* bounds = NULL;
+    u64* mask = NULL;
+};
+
+template <typename Bounds>
+void CullTaskProc(void* data, u64 start, u64 end, u32 threadIndex)
+{
+    CullTask<Bounds>* task = (CullTask<Bounds>*)data;
+    CullRange(*task->planes, *task->bounds, start, end, task->mask);
+}
+
+template <typename Bounds>
+void Cull(const CullPlanes& planes, const Bounds& bounds, u64* mask, bool parallel)
+{
+    ASSERT(mask);
+    if(parallel)
+    {
+        CullTask<Bounds> task = {};
+        task.planes = &planes;
+        task.bounds = &bounds;
+        task.mask = mask;
+        async::ParallelFor(bounds.count, TY_CULL_PARALLEL_BATCH, CullTaskProc<Bounds>, &task);
+    }
+    else
+    {
+        CullRange(planes, bounds, 0, bounds.count, mask);
+    }
+}
+
+template <typename Bounds>
+u64 CullCompact(const CullPlanes& planes, const Bounds& bounds, u32* indices)
+{
+    ASSERT(indices);
+    u64 result = 0;
+    u64 i = 0;
+    for(; i + 8 <= bounds.count; i += 8)
+    {
+        u32 bits = Test8(planes, bounds, i);
+        while(bits)
+        {
+            indices[result++] = (u32)(i + __builtin_ctz(bits));
+            bits &= bits - 1;
+        }
+    }
+    for(; i < bounds.count; i++)
+    {
+        if(Test(planes, bounds, i)) indices[result++] = (u32)i;
+    }
+    return result;
+}
+
+void CullBoxes(const CullPlanes& planes, const BoxArrays& boxes, u64* mask, bool parallel)
+{
+    Cull(planes, boxes, mask, parallel);
+}
+
+void CullSpheres(const CullPlanes& planes, const SphereArrays& spheres, u64* mask, bool parallel)
+{
+    Cull(planes, spheres, mask, parallel);
+}
+
+u64 CullBoxesCompact(const CullPlanes& planes, const BoxArrays& boxes, u32* indices)
+{
+    return CullCompact(planes, boxes, indices);
+}
+
+u64 CullSpheresCompact(const CullPlanes& planes, const SphereArrays& spheres, u32* indices)
+{
+    return CullCompact(planes, spheres, indices);
+}
+
+u64 MaskToIndices(const u64* mask, u64 count, u32* indices)
+{
+    u64 result = 0;
+    for(u64 word = 0; word < GetMaskWordCount(count); word++)
+    {
+        u64 bits = mask[word];
+        while(bits)
+        {
+            indices[result++] = (u32)(word * 64 + __builtin_ctzll(bits));
+            bits &= bits - 1;
+        }
+    }
+    return result;
+}
+
+};
+};
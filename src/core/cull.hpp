@@ -0,0 +1,79 @@
+// ========================================================
+// CULL
+// Bulk frustum culling of bounding volumes. Bounds are stored as one array per component
+// (SoA) and tested 8 at a time against planes broadcast up front, with no branches per
+// object. Results are a visibility bitmask, optionally computed in chunks across the async
+// workers, or a compacted list of visible indices.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./debug.hpp"
+#include "./simd.hpp"
+#include "./math.hpp"
+#include "./async.hpp"
+
+namespace ty
+{
+namespace cull
+{
+
+#define TY_CULL_PARALLEL_BATCH 4096     // Objects per parallel task. Multiple of 64, so mask words aren't shared.
+
+// ========================================================
+// [PLANES]
+// Frustum planes with every value repeated across 8 lanes, plus absolute normals for
+// box extents.
+struct CullPlanes
+{
+    f32 x[6][8];
+    f32 y[6][8];
+    f32 z[6][8];
+    f32 w[6][8];
+    f32 absX[6][8];
+    f32 absY[6][8];
+    f32 absZ[6][8];
+};
+
+CullPlanes MakeCullPlanes(const math::Frustum& frustum);
+
+// ========================================================
+// [BOUNDS]
+// count elements per array.
+struct BoxArrays
+{
+    const f32* centerX = NULL;
+    const f32* centerY = NULL;
+    const f32* centerZ = NULL;
+    const f32* extentX = NULL;          // Half size.
+    const f32* extentY = NULL;
+    const f32* extentZ = NULL;
+    u64 count = 0;
+};
+
+struct SphereArrays
+{
+    const f32* centerX = NULL;
+    const f32* centerY = NULL;
+    const f32* centerZ = NULL;
+    const f32* radius = NULL;
+    u64 count = 0;
+};
+
+// ========================================================
+// [CULL]
+// Bit (i % 64) of mask[i / 64] is set when object i is at least partially inside the frustum.
+// Masks hold GetMaskWordCount(count) words.
+inline u64 GetMaskWordCount(u64 count) { return (count + 63) / 64; }
+
+void CullBoxes(const CullPlanes& planes, const BoxArrays& boxes, u64* mask, bool parallel = false);
+void CullSpheres(const CullPlanes& planes, const SphereArrays& spheres, u64* mask, bool parallel = false);
+
+// Visible indices in increasing order, indices must hold count entries. Return the visible count.
+u64 CullBoxesCompact(const CullPlanes& planes, const BoxArrays& boxes, u32* indices);
+u64 CullSpheresCompact(const CullPlanes& planes, const SphereArrays& spheres, u32* indices);
+u64 MaskToIndices(const u64* mask, u64 count, u32* indices);
+
+};
+};
@@ -1,4 +1,5 @@
 #include "./debug.hpp"
+#include "./time.hpp"
 
 namespace ty
 {
@@ -7,6 +8,7 @@ namespace ty
 void Assert(u64 expr, const char* msg)
 {
     if(expr) return;
+    FlushLog();
     MessageBoxExA(
             NULL,
             msg,
@@ -24,6 +26,7 @@ void AssertFormat(u64 expr, const char* fmt, ...)
     char buf[2048];
     vsprintf(buf, fmt, args);
     if(expr) return;
+    FlushLog();
     MessageBoxExA(
             NULL,
             buf,
@@ -37,17 +40,527 @@ void AssertFormat(u64 expr, const char* fmt, ...)
 
 #endif
 
-#ifndef _NOLOGGING
-void LogFormat(const char* label, const char* fmt, ...)
+// ========================================================
+// [LOGGING]
+
+struct LogRing
 {
-    va_list args;
-    va_start(args, fmt);
-    char buf[2048];
-    vsprintf(buf, fmt, args);
-    printf("[%s]: %s\n", label, buf);
-    va_end(args);
+    byte* data = NULL;
+    u64 mask = 0;
+    volatile u64 writeIndex = 0;        // Only written by the owning thread.
+    volatile u64 readIndex = 0;         // Only written by the log thread.
+    volatile u64 dropped = 0;           // Only written by the owning thread.
+    u64 reportedDropped = 0;            // Log thread.
+    u32 threadIndex = 0;
+};
+
+enum LoggerState
+{
+    LOGGER_STOPPED,
+    LOGGER_STARTING,
+    LOGGER_RUNNING,
+    LOGGER_SHUTDOWN,                    // Explicitly stopped, messages are written synchronously.
+};
+
+struct Logger
+{
+    volatile LONG state = LOGGER_STOPPED;
+    LogDesc desc = {};
+    u64 startTimestamp = 0;
+
+    LogRing* volatile rings[TY_LOG_MAX_THREADS] = {};
+    volatile LONG ringCount = 0;
+    volatile LONG droppedOversized = 0;
+
+    HANDLE hThread = NULL;
+    HANDLE hWakeEvent = NULL;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    volatile bool quit = false;
+
+    // Guards the flush counters and synchronous console writes.
+    SRWLOCK lock = SRWLOCK_INIT;
+    CONDITION_VARIABLE flushed = CONDITION_VARIABLE_INIT;
+    u64 flushRequested = 0;
+    u64 flushCompleted = 0;
+
+    // Log thread output buffers.
+    char consoleBuffer[KB(16)];
+    u64 consoleLen = 0;
+    char fileBuffer[KB(16)];
+    u64 fileLen = 0;
+};
+
+static Logger logger;
+static bool loggerAtExit = false;
+static thread_local LogRing* logRing = NULL;
+static thread_local LogRecord* logPending = NULL;
+static thread_local u64 logPendingEnd = 0;
+static thread_local bool isLogThread = false;
+static thread_local u64 logScratch[TY_LOG_MAX_RECORD / sizeof(u64)];
+
+static const char* logLevelNames[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+
+struct LogArg
+{
+    LogArgType type = LOG_ARG_I64;
+    union
+    {
+        i64 i;
+        u64 u;
+        f64 f;
+        const void* p;
+    };
+    const char* str = NULL;
+};
+
+static const byte* ReadLogArg(const byte* src, LogArg* arg)
+{
+    arg->type = (LogArgType)src[0];
+    if(arg->type == LOG_ARG_STR)
+    {
+        u32 len;
+        memcpy(&len, src + 1, sizeof(u32));
+        arg->str = (const char*)(src + 1 + sizeof(u32));
+        arg->u = len;
+        return src + 1 + sizeof(u32) + len + 1;
+    }
+    memcpy(&arg->u, src + 1, sizeof(u64));
+    return src + 1 + sizeof(u64);
 }
 
-#endif
+static i64 LogArgToI64(const LogArg& arg)
+{
+    return arg.type == LOG_ARG_F64 ? (i64)arg.f : arg.i;
+}
+
+static f64 LogArgToF64(const LogArg& arg)
+{
+    if(arg.type == LOG_ARG_F64) return arg.f;
+    return arg.type == LOG_ARG_I64 ? (f64)arg.i : (f64)arg.u;
+}
+
+// printf-style formatting from the recorded arguments. Each conversion is handed to snprintf
+// on its own, length modifiers are replaced to match the recorded argument types.
+u64 FormatLogRecord(const LogRecord* record, char* dst, u64 capacity)
+{
+    ASSERT(capacity > 0);
+    const byte* src = (const byte*)(record + 1);
+    u32 argsLeft = record->argCount;
+    const char* fmt = record->fmt;
+    u64 len = 0;
+    while(*fmt && len < capacity - 1)
+    {
+        if(*fmt != '%' || fmt[1] == '%')
+        {
+            dst[len++] = *fmt;
+            fmt += *fmt == '%' ? 2 : 1;
+            continue;
+        }
+
+        char spec[48];
+        u32 specLen = 0;
+        spec[specLen++] = *fmt++;
+        while(*fmt && strchr("-+ #0123456789.*", *fmt))
+        {
+            if(*fmt == '*')
+            {
+                // Width and precision arguments are folded into the spec.
+                LogArg arg;
+                i64 value = 0;
+                if(argsLeft)
+                {
+                    src = ReadLogArg(src, &arg);
+                    argsLeft--;
+                    value = LogArgToI64(arg);
+                }
+                if(value < 0 && specLen && spec[specLen - 1] == '.') specLen--;
+                else specLen += snprintf(spec + specLen, sizeof(spec) - 8 - specLen, "%lld", (long long)value);
+            }
+            else if(specLen < sizeof(spec) - 8)
+            {
+                spec[specLen++] = *fmt;
+            }
+            fmt++;
+        }
+        while(*fmt && strchr("hljztqL", *fmt))
+        {
+            fmt++;
+        }
+        char conversion = *fmt;
+        if(!conversion) break;
+        fmt++;
+
+        if(!argsLeft)
+        {
+            len += snprintf(dst + len, capacity - len, "<missing>");
+            continue;
+        }
+        LogArg arg;
+        src = ReadLogArg(src, &arg);
+        argsLeft--;
+
+        i32 written = 0;
+        u64 left = capacity - len;
+        switch(conversion)
+        {
+            case 'd': case 'i':
+                memcpy(spec + specLen, "ll", 2);
+                spec[specLen + 2] = conversion;
+                spec[specLen + 3] = 0;
+                written = snprintf(dst + len, left, spec, (long long)LogArgToI64(arg));
+                break;
+            case 'u': case 'x': case 'X': case 'o':
+                memcpy(spec + specLen, "ll", 2);
+                spec[specLen + 2] = conversion;
+                spec[specLen + 3] = 0;
+                written = snprintf(dst + len, left, spec, (unsigned long long)LogArgToI64(arg));
+                break;
+            case 'c':
+                spec[specLen] = 'c';
+                spec[specLen + 1] = 0;
+                written = snprintf(dst + len, left, spec, (int)LogArgToI64(arg));
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                spec[specLen] = conversion;
+                spec[specLen + 1] = 0;
+                written = snprintf(dst + len, left, spec, LogArgToF64(arg));
+                break;
+            case 's':
+                spec[specLen] = 's';
+                spec[specLen + 1] = 0;
+                written = snprintf(dst + len, left, spec, arg.type == LOG_ARG_STR ? arg.str : "(null)");
+                break;
+            case 'p':
+                spec[specLen] = 'p';
+                spec[specLen + 1] = 0;
+                written = snprintf(dst + len, left, spec, arg.p);
+                break;
+            default:
+                break;
+        }
+        if(written > 0) len += MIN((u64)written, left - 1);
+    }
+    dst[len] = 0;
+    return len;
+}
+
+static void FlushLogOutput()
+{
+    if(logger.consoleLen)
+    {
+        fwrite(logger.consoleBuffer, 1, logger.consoleLen, stdout);
+        fflush(stdout);
+        logger.consoleLen = 0;
+    }
+    if(logger.fileLen)
+    {
+        DWORD written;
+        WriteFile(logger.hFile, logger.fileBuffer, (DWORD)logger.fileLen, &written, NULL);
+        logger.fileLen = 0;
+    }
+}
+
+static u64 FormatConsoleLine(const LogRecord* record, const char* message, char* dst, u64 capacity)
+{
+    i32 len = record->level >= LOG_LEVEL_WARN
+        ? snprintf(dst, capacity, "[%s] %s: %s\n", record->label, logLevelNames[record->level], message)
+        : snprintf(dst, capacity, "[%s]: %s\n", record->label, message);
+    return MIN((u64)len, capacity - 1);
+}
+
+static void WriteLogRecord(const LogRecord* record)
+{
+    char message[TY_LOG_MAX_MESSAGE];
+    FormatLogRecord(record, message, sizeof(message));
+    const u64 maxLine = TY_LOG_MAX_MESSAGE + 128;
+    if(logger.desc.console && record->level >= logger.desc.consoleLevel)
+    {
+        if(logger.consoleLen + maxLine > sizeof(logger.consoleBuffer)) FlushLogOutput();
+        logger.consoleLen += FormatConsoleLine(record, message,
+                logger.consoleBuffer + logger.consoleLen, sizeof(logger.consoleBuffer) - logger.consoleLen);
+    }
+    if(logger.hFile != INVALID_HANDLE_VALUE)
+    {
+        if(logger.fileLen + maxLine > sizeof(logger.fileBuffer)) FlushLogOutput();
+        f64 seconds = record->timestamp > logger.startTimestamp
+            ? time::TimestampToNSec(record->timestamp - logger.startTimestamp) / 1000000000.0
+            : 0;
+        char* dst = logger.fileBuffer + logger.fileLen;
+        u64 left = sizeof(logger.fileBuffer) - logger.fileLen;
+        i32 len = snprintf(dst, left, "%12.6f T%-2u %-5s [%s]: %s\n",
+                seconds, record->threadIndex, logLevelNames[record->level], record->label, message);
+        logger.fileLen += MIN((u64)len, left - 1);
+    }
+}
+
+// Next record in the ring below end, skipping padding. NULL if there is none.
+static LogRecord* PeekLogRecord(LogRing* ring, u64 end)
+{
+    while(ring->readIndex < end)
+    {
+        u64 offset = ring->readIndex & ring->mask;
+        u64 tail = ring->mask + 1 - offset;
+        LogRecord* record = (LogRecord*)(ring->data + offset);
+        if(tail >= sizeof(LogRecord) && record->fmt) return record;
+        ring->readIndex += tail;
+    }
+    return NULL;
+}
+
+// Writes everything published so far, merging rings by timestamp.
+static void DrainLog()
+{
+    u32 ringCount = MIN((u32)logger.ringCount, TY_LOG_MAX_THREADS);
+    LogRing* rings[TY_LOG_MAX_THREADS];
+    u64 ends[TY_LOG_MAX_THREADS];
+    u32 activeCount = 0;
+    for(u32 i = 0; i < ringCount; i++)
+    {
+        LogRing* ring = logger.rings[i];
+        if(!ring) continue;
+        rings[activeCount] = ring;
+        ends[activeCount] = ring->writeIndex;
+        activeCount++;
+    }
+    // Indices must be read before the records they publish.
+    _ReadWriteBarrier();
+
+    while(true)
+    {
+        LogRecord* next = NULL;
+        u32 nextRing = 0;
+        for(u32 i = 0; i < activeCount; i++)
+        {
+            LogRecord* record = PeekLogRecord(rings[i], ends[i]);
+            if(record && (!next || record->timestamp < next->timestamp))
+            {
+                next = record;
+                nextRing = i;
+            }
+        }
+        if(!next) break;
+        WriteLogRecord(next);
+        // Record must be consumed before the space is handed back to the writer.
+        _ReadWriteBarrier();
+        rings[nextRing]->readIndex += next->size;
+    }
+
+    for(u32 i = 0; i < activeCount; i++)
+    {
+        LogRing* ring = rings[i];
+        u64 dropped = ring->dropped;
+        if(dropped == ring->reportedDropped) continue;
+        LogRecord record = {};
+        record.fmt = "Dropped %llu messages from thread %u, ring size is too small.";
+        record.label = "LOG";
+        record.timestamp = time::GetTimestamp();
+        record.threadIndex = ring->threadIndex;
+        record.level = LOG_LEVEL_WARN;
+        record.argCount = 2;
+        byte buffer[sizeof(LogRecord) + 2 * (1 + sizeof(u64))];
+        memcpy(buffer, &record, sizeof(LogRecord));
+        byte* args = LogArgWrite(buffer + sizeof(LogRecord), dropped - ring->reportedDropped);
+        LogArgWrite(args, ring->threadIndex);
+        WriteLogRecord((LogRecord*)buffer);
+        ring->reportedDropped = dropped;
+    }
+    FlushLogOutput();
+}
+
+static DWORD WINAPI LogThreadProc(LPVOID param)
+{
+    isLogThread = true;
+    while(true)
+    {
+        WaitForSingleObject(logger.hWakeEvent, logger.desc.flushIntervalMs);
+        bool quit = logger.quit;
+        AcquireSRWLockExclusive(&logger.lock);
+        u64 flushRequested = logger.flushRequested;
+        ReleaseSRWLockExclusive(&logger.lock);
+
+        DrainLog();
+
+        AcquireSRWLockExclusive(&logger.lock);
+        logger.flushCompleted = flushRequested;
+        ReleaseSRWLockExclusive(&logger.lock);
+        WakeAllConditionVariable(&logger.flushed);
+        if(quit) break;
+    }
+    return 0;
+}
+
+static void StartLog(LogDesc desc, LONG fromState)
+{
+    ASSERT(desc.ringSize >= TY_LOG_MAX_RECORD * 2 && IS_POW2(desc.ringSize));
+    if(InterlockedCompareExchange(&logger.state, LOGGER_STARTING, fromState) != fromState)
+    {
+        // Someone else is starting the logger.
+        while(logger.state == LOGGER_STARTING)
+        {
+            Sleep(0);
+        }
+        return;
+    }
+    logger.desc = desc;
+    logger.startTimestamp = time::GetTimestamp();
+    logger.quit = false;
+    logger.consoleLen = 0;
+    logger.fileLen = 0;
+    if(desc.filePath)
+    {
+        logger.hFile = CreateFile(desc.filePath, GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    }
+    logger.hWakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    logger.hThread = CreateThread(NULL, 0, LogThreadProc, NULL, 0, NULL);
+    if(!loggerAtExit)
+    {
+        loggerAtExit = true;
+        atexit(ShutdownLog);
+    }
+    _ReadWriteBarrier();
+    logger.state = LOGGER_RUNNING;
+}
+
+void InitLog(LogDesc desc)
+{
+    if(logger.state == LOGGER_RUNNING) ShutdownLog();
+    StartLog(desc, logger.state == LOGGER_SHUTDOWN ? LOGGER_SHUTDOWN : LOGGER_STOPPED);
+}
+
+void ShutdownLog()
+{
+    if(InterlockedCompareExchange(&logger.state, LOGGER_SHUTDOWN, LOGGER_RUNNING) != LOGGER_RUNNING) return;
+    logger.quit = true;
+    SetEvent(logger.hWakeEvent);
+    WaitForSingleObject(logger.hThread, INFINITE);
+    CloseHandle(logger.hThread);
+    CloseHandle(logger.hWakeEvent);
+    if(logger.hFile != INVALID_HANDLE_VALUE) CloseHandle(logger.hFile);
+    logger.hThread = NULL;
+    logger.hWakeEvent = NULL;
+    logger.hFile = INVALID_HANDLE_VALUE;
+}
+
+void FlushLog()
+{
+    if(logger.state != LOGGER_RUNNING || isLogThread) return;
+    AcquireSRWLockExclusive(&logger.lock);
+    u64 ticket = ++logger.flushRequested;
+    SetEvent(logger.hWakeEvent);
+    while(logger.flushCompleted < ticket && logger.state == LOGGER_RUNNING)
+    {
+        SleepConditionVariableSRW(&logger.flushed, &logger.lock, 100, 0);
+    }
+    ReleaseSRWLockExclusive(&logger.lock);
+}
+
+u64 GetLogDroppedCount()
+{
+    u64 result = (u64)logger.droppedOversized;
+    u32 ringCount = MIN((u32)logger.ringCount, TY_LOG_MAX_THREADS);
+    for(u32 i = 0; i < ringCount; i++)
+    {
+        if(logger.rings[i]) result += logger.rings[i]->dropped;
+    }
+    return result;
+}
+
+static LogRing* RegisterLogThread()
+{
+    LONG slot = InterlockedIncrement(&logger.ringCount) - 1;
+    if(slot >= TY_LOG_MAX_THREADS)
+    {
+        // Out of rings, this thread logs synchronously.
+        InterlockedDecrement(&logger.ringCount);
+        return NULL;
+    }
+    u64 ringSize = logger.desc.ringSize;
+    LogRing* ring = (LogRing*)malloc(sizeof(LogRing) + ringSize);
+    *ring = {};
+    ring->data = (byte*)(ring + 1);
+    ring->mask = ringSize - 1;
+    ring->threadIndex = (u32)slot;
+    logRing = ring;
+    _ReadWriteBarrier();
+    logger.rings[slot] = ring;
+    return ring;
+}
+
+byte* BeginLogRecord(LogLevel level, const char* label, const char* fmt, u32 argCount, u64 argSize)
+{
+    u64 size = ALIGN_TO(sizeof(LogRecord) + argSize, sizeof(u64));
+    if(size > TY_LOG_MAX_RECORD || argCount > MAX_U8)
+    {
+        InterlockedIncrement(&logger.droppedOversized);
+        return NULL;
+    }
+    if(logger.state == LOGGER_STOPPED || logger.state == LOGGER_STARTING) StartLog({}, LOGGER_STOPPED);
+
+    LogRecord* record = (LogRecord*)logScratch;
+    LogRing* ring = logRing;
+    if(!ring && logger.state == LOGGER_RUNNING) ring = RegisterLogThread();
+    if(ring && logger.state == LOGGER_RUNNING)
+    {
+        // Records never wrap around, the space left at the end of the ring is skipped instead.
+        u64 writeIndex = ring->writeIndex;
+        u64 capacity = ring->mask + 1;
+        u64 offset = writeIndex & ring->mask;
+        u64 padding = capacity - offset < size ? capacity - offset : 0;
+        if(capacity - (writeIndex - ring->readIndex) < size + padding)
+        {
+            ring->dropped++;
+            return NULL;
+        }
+        if(padding)
+        {
+            if(padding >= sizeof(LogRecord)) ((LogRecord*)(ring->data + offset))->fmt = NULL;
+            writeIndex += padding;
+            offset = 0;
+        }
+        record = (LogRecord*)(ring->data + offset);
+        logPendingEnd = writeIndex + size;
+    }
+    else
+    {
+        ring = NULL;
+        logPendingEnd = 0;
+    }
+    record->fmt = fmt;
+    record->label = label;
+    record->timestamp = time::GetTimestamp();
+    record->size = (u32)size;
+    record->threadIndex = ring ? (u16)ring->threadIndex : 0;
+    record->level = level;
+    record->argCount = (u8)argCount;
+    logPending = record;
+    return (byte*)(record + 1);
+}
+
+void EndLogRecord()
+{
+    LogRecord* record = logPending;
+    logPending = NULL;
+    if(!logPendingEnd)
+    {
+        // No ring or logger shut down, write directly.
+        if(!logger.desc.console || record->level < logger.desc.consoleLevel) return;
+        char message[TY_LOG_MAX_MESSAGE];
+        char line[TY_LOG_MAX_MESSAGE + 128];
+        FormatLogRecord(record, message, sizeof(message));
+        u64 len = FormatConsoleLine(record, message, line, sizeof(line));
+        AcquireSRWLockExclusive(&logger.lock);
+        fwrite(line, 1, len, stdout);
+        fflush(stdout);
+        ReleaseSRWLockExclusive(&logger.lock);
+        return;
+    }
+    LogRing* ring = logRing;
+    // Record must be visible before the index that publishes it.
+    _ReadWriteBarrier();
+    ring->writeIndex = logPendingEnd;
+    // Wake the log thread early if the ring is filling up.
+    if(logPendingEnd - ring->readIndex > (ring->mask + 1) / 2) SetEvent(logger.hWakeEvent);
+}
 
 };
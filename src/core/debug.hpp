@@ -30,19 +30,167 @@ void AssertFormat(u64 expr, const char* fmt, ...);
 
 // ========================================================
 // [LOGGING]
+// Asynchronous binary logger. Call sites copy the format pointer, a timestamp and the raw
+// arguments into a per-thread ring buffer, with no locks and no formatting. A background
+// thread merges the rings in timestamp order, formats the records and writes them to the
+// console and an optional log file. If a ring is full the message is dropped and counted.
+// Formats and labels must be static strings (literals), only the pointer is recorded.
+// String arguments are copied. Messages below TY_LOG_LEVEL compile to nothing.
 
-#if _NOLOGGING
-#define LOG(MSG)
-#define LOGL(LABEL, MSG)
-#define LOGF(FMT, ...)
-#define LOGLF(LABEL, FMT, ...)
+enum LogLevel : u8
+{
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR,
+};
+
+#ifndef TY_LOG_LEVEL
+#if TY_DEBUG
+#define TY_LOG_LEVEL 0
 #else
+#define TY_LOG_LEVEL 1
+#endif
+#endif
+
+#define TY_LOG_MAX_THREADS 64
+#define TY_LOG_MAX_RECORD KB(8)         // Bigger messages are dropped.
+#define TY_LOG_MAX_STRING_ARG 1024      // Longer string arguments are truncated.
+#define TY_LOG_MAX_MESSAGE 2048         // Formatted message length.
+
+struct LogDesc
+{
+    bool console = true;
+    LogLevel consoleLevel = LOG_LEVEL_DEBUG;    // Lower levels only go to the log file.
+    const char* filePath = NULL;        // Optional log file, truncated on init.
+    u32 ringSize = KB(64);              // Bytes per thread, power of 2.
+    u32 flushIntervalMs = 10;           // How often the log thread wakes up to drain.
+};
+
+// Optional, the first message starts the logger with default settings.
+// Rings are allocated once per thread and kept until the process exits.
+void InitLog(LogDesc desc = {});
+void ShutdownLog();                     // Writes pending messages and stops the log thread, runs at exit.
+void FlushLog();                        // Blocks until all messages logged so far are written.
+u64 GetLogDroppedCount();
+
+enum LogArgType : u8
+{
+    LOG_ARG_I64,
+    LOG_ARG_U64,
+    LOG_ARG_F64,
+    LOG_ARG_PTR,
+    LOG_ARG_STR,                        // u32 length, chars, null terminator.
+};
+
+struct LogRecord
+{
+    const char* fmt = NULL;             // NULL marks padding up to the end of the ring.
+    const char* label = NULL;
+    u64 timestamp = 0;
+    u32 size = 0;                       // Including arguments, multiple of 8.
+    u16 threadIndex = 0;
+    u8 level = 0;
+    u8 argCount = 0;
+};
+
+// Returns where to write the arguments or NULL if the message is dropped.
+byte* BeginLogRecord(LogLevel level, const char* label, const char* fmt, u32 argCount, u64 argSize);
+void EndLogRecord();
+
+// Arguments are stored as a type tag followed by the value.
+#define TY_LOG_SCALAR_ARG(TYPE, TAG, STORAGE) \
+    inline u64 LogArgSize(TYPE) { return 1 + sizeof(u64); } \
+    inline byte* LogArgWrite(byte* dst, TYPE value) \
+    { \
+        STORAGE v = (STORAGE)value; \
+        dst[0] = TAG; \
+        memcpy(dst + 1, &v, sizeof(u64)); \
+        return dst + 1 + sizeof(u64); \
+    }
+
+TY_LOG_SCALAR_ARG(bool, LOG_ARG_I64, i64)
+TY_LOG_SCALAR_ARG(char, LOG_ARG_I64, i64)
+TY_LOG_SCALAR_ARG(signed char, LOG_ARG_I64, i64)
+TY_LOG_SCALAR_ARG(short, LOG_ARG_I64, i64)
+TY_LOG_SCALAR_ARG(int, LOG_ARG_I64, i64)
+TY_LOG_SCALAR_ARG(long, LOG_ARG_I64, i64)
+TY_LOG_SCALAR_ARG(long long, LOG_ARG_I64, i64)
+TY_LOG_SCALAR_ARG(unsigned char, LOG_ARG_U64, u64)
+TY_LOG_SCALAR_ARG(unsigned short, LOG_ARG_U64, u64)
+TY_LOG_SCALAR_ARG(unsigned int, LOG_ARG_U64, u64)
+TY_LOG_SCALAR_ARG(unsigned long, LOG_ARG_U64, u64)
+TY_LOG_SCALAR_ARG(unsigned long long, LOG_ARG_U64, u64)
+TY_LOG_SCALAR_ARG(float, LOG_ARG_F64, f64)
+TY_LOG_SCALAR_ARG(double, LOG_ARG_F64, f64)
 
-void LogFormat(const char* label, const char* fmt, ...);
-#define LOG(MSG) STMT(LogFormat("LOG", "%s", MSG))
-#define LOGL(LABEL, MSG) STMT(LogFormat(LABEL, "%s", MSG))
-#define LOGF(FMT, ...) STMT(LogFormat("LOG", FMT, __VA_ARGS__))
-#define LOGLF(LABEL, FMT, ...) STMT(LogFormat(LABEL, FMT, __VA_ARGS__))
+template <typename T>
+inline u64 LogArgSize(T*) { return 1 + sizeof(u64); }
 
+template <typename T>
+inline byte* LogArgWrite(byte* dst, T* value)
+{
+    dst[0] = LOG_ARG_PTR;
+    memcpy(dst + 1, &value, sizeof(u64));
+    return dst + 1 + sizeof(u64);
+}
+
+inline u64 LogArgSize(const char* str)
+{
+    if(!str) return 1 + sizeof(u64);
+    return 1 + sizeof(u32) + strnlen(str, TY_LOG_MAX_STRING_ARG) + 1;
+}
+
+inline byte* LogArgWrite(byte* dst, const char* str)
+{
+    if(!str) return LogArgWrite(dst, (const void*)NULL);
+    u32 len = (u32)strnlen(str, TY_LOG_MAX_STRING_ARG);
+    dst[0] = LOG_ARG_STR;
+    memcpy(dst + 1, &len, sizeof(u32));
+    memcpy(dst + 1 + sizeof(u32), str, len);
+    dst[1 + sizeof(u32) + len] = 0;
+    return dst + 1 + sizeof(u32) + len + 1;
+}
+
+inline u64 LogArgSize(char* str) { return LogArgSize((const char*)str); }
+inline byte* LogArgWrite(byte* dst, char* str) { return LogArgWrite(dst, (const char*)str); }
+
+template <typename... Args>
+inline void LogWrite(LogLevel level, const char* label, const char* fmt, Args... args)
+{
+    u64 argSize = (0 + ... + LogArgSize(args));
+    byte* dst = BeginLogRecord(level, label, fmt, sizeof...(Args), argSize);
+    if(!dst) return;
+    ((dst = LogArgWrite(dst, args)), ...);
+    EndLogRecord();
+}
+
+#if _NOLOGGING
+#define LOG_AT(LEVEL, LABEL, FMT, ...)
+#else
+#define LOG_AT(LEVEL, LABEL, FMT, ...) STMT(ty::LogWrite(LEVEL, LABEL, FMT, ##__VA_ARGS__))
+#endif
+
+#if TY_LOG_LEVEL <= 0
+#define LOG_DEBUG(LABEL, FMT, ...) LOG_AT(ty::LOG_LEVEL_DEBUG, LABEL, FMT, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(LABEL, FMT, ...)
+#endif
+#if TY_LOG_LEVEL <= 1
+#define LOG_INFO(LABEL, FMT, ...) LOG_AT(ty::LOG_LEVEL_INFO, LABEL, FMT, ##__VA_ARGS__)
+#else
+#define LOG_INFO(LABEL, FMT, ...)
+#endif
+#if TY_LOG_LEVEL <= 2
+#define LOG_WARN(LABEL, FMT, ...) LOG_AT(ty::LOG_LEVEL_WARN, LABEL, FMT, ##__VA_ARGS__)
+#else
+#define LOG_WARN(LABEL, FMT, ...)
 #endif
+#define LOG_ERROR(LABEL, FMT, ...) LOG_AT(ty::LOG_LEVEL_ERROR, LABEL, FMT, ##__VA_ARGS__)
+
+#define LOG(MSG) LOG_INFO("LOG", "%s", MSG)
+#define LOGL(LABEL, MSG) LOG_INFO(LABEL, "%s", MSG)
+#define LOGF(FMT, ...) LOG_INFO("LOG", FMT, __VA_ARGS__)
+#define LOGLF(LABEL, FMT, ...) LOG_INFO(LABEL, FMT, __VA_ARGS__)
+
 };
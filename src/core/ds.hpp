@@ -196,6 +196,8 @@ DArray<T> MakeDArray(mem::Arena* arena, u64 initialCount, T initialValue)
 // [HASH MAP]
 // Fixed capacity bucket array, linear probing
 // Requires Key type to implement Hash() and operator==()
+// Removed buckets are kept as tombstones (used && !valid), so probing can stop at the
+// first bucket that was never used.
 
 // This macro calls implemented hash function overloaded for the value's type.
 // Will raise compile error if there's no hash implemented for the type.
@@ -209,58 +211,53 @@ struct HashMap
     struct Bucket
     {
         bool valid = false;
+        bool used = false;
         Tk key;
         Tv value;
     };
     SArray<Bucket> buckets;
 
-    Tv& operator[](Tk key)
+    i64 Find(const Tk& key) const
     {
         u32 keyHash = HASH(key);
         for(u32 i = 0; i < buckets.count; i++)
         {
             u32 pos = (keyHash + i) % buckets.count;
-            Bucket& bucket = buckets[pos];
-            if(bucket.valid && bucket.key == key) return bucket.value;
+            const Bucket& bucket = buckets[pos];
+            if(!bucket.used) return -1;
+            if(bucket.valid && bucket.key == key) return pos;
         }
-        ASSERT(0);      // Linear probing failed, hash map too small.
-        return buckets[0].value;
+        return -1;
+    }
+
+    Tv& operator[](Tk key)
+    {
+        i64 pos = Find(key);
+        ASSERT(pos != -1);      // Key not present in the hash map.
+        return buckets[pos].value;
     };
 
     const Tv& operator[](Tk key) const
     {
-        u32 keyHash = HASH(key);
-        for(u32 i = 0; i < buckets.count; i++)
-        {
-            u32 pos = (keyHash + i) % buckets.count;
-            Bucket& bucket = buckets[pos];
-            if(bucket.valid && bucket.key == key) return bucket.value;
-        }
-        ASSERT(0);      // Linear probing failed, hash map too small.
-        return buckets[0].value;
+        i64 pos = Find(key);
+        ASSERT(pos != -1);      // Key not present in the hash map.
+        return buckets[pos].value;
     };
 
     bool HasKey(Tk key)
     {
-        u32 keyHash = HASH(key);
-        for(u32 i = 0; i < buckets.count; i++)
-        {
-            u32 pos = (keyHash + i) % buckets.count;
-            Bucket& bucket = buckets[pos];
-            if(bucket.valid && bucket.key == key) return true;
-        }
-        return false;
+        return Find(key) != -1;
     }
 
     void Insert(const Tk& key, const Tv& value)
     {
-        u64 keyHash = HASH(key);
+        u32 keyHash = HASH(key);
         for(u32 i = 0; i < buckets.count; i++)
         {
             u32 pos = (keyHash + i) % buckets.count;
-            if(!buckets[i].valid)
+            if(!buckets[pos].valid)
             {
-                buckets[i] = { true, key, value };
+                buckets[pos] = { true, true, key, value };
                 return;
             }
         }
@@ -269,17 +266,18 @@ struct HashMap
 
     void Remove(const Tk& key)
     {
-        u64 keyHash = HASH(key);
-        for(u32 i = 0; i < buckets.count; i++)
+        i64 pos = Find(key);
+        ASSERT(pos != -1);      // Key not present in the hash map, invalid op.
+        buckets[pos].valid = false;
+    }
+
+    void Clear()
+    {
+        for(u64 i = 0; i < buckets.count; i++)
         {
-            u32 pos = (keyHash + i) % buckets.count;
-            if(buckets[i].valid && buckets[i].key == key)
-            {
-                buckets[i].valid = false;
-                return;
-            }
+            buckets[i].valid = false;
+            buckets[i].used = false;
         }
-        ASSERT(0);      // Key not present in the hash map, invalid op.
     }
 };
 
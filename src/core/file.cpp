@@ -1,4 +1,6 @@
 #include "./file.hpp"
+#include "./async.hpp"
+#include "./pack.hpp"
 
 namespace ty
 {
@@ -7,14 +9,17 @@ namespace file
 
 bool PathExists(String path)
 {
+    if(pack::FindEntry(path)) return true;
     DWORD fileAttributes = GetFileAttributes(path.CStr());
     return fileAttributes != INVALID_FILE_ATTRIBUTES;
 }
 
 bool PathIsDir(String path)
 {
+    if(pack::FindEntry(path)) return false;
     DWORD fileAttributes = GetFileAttributes(path.CStr());
-    return fileAttributes & FILE_ATTRIBUTE_DIRECTORY;
+    return fileAttributes != INVALID_FILE_ATTRIBUTES
+        && (fileAttributes & FILE_ATTRIBUTE_DIRECTORY);
 }
 
 String PathExt(String path)
@@ -67,8 +72,26 @@ String PathFileDir(String path)
     return Substr(path, 0, lastSlash + 1);
 }
 
+String PathCanonical(mem::Arena* arena, String path)
+{
+    char fullPath[MAX_PATH];
+    DWORD len = GetFullPathName(path.CStr(), MAX_PATH, fullPath, NULL);
+    ASSERT(len > 0 && len < MAX_PATH);
+    for(DWORD i = 0; i < len; i++)
+    {
+        char c = fullPath[i];
+        if(c == '\\') c = '/';
+        else if(c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        fullPath[i] = c;
+    }
+    return Str(arena, Str((byte*)fullPath, len));
+}
+
 u64 GetFileSize(String path)
 {
+    pack::PackEntry* entry = pack::FindEntry(path);
+    if(entry) return entry->rawSize;
+
     ASSERT(PathExists(path));
     ASSERT(!PathIsDir(path));
 
@@ -87,15 +110,711 @@ u64 GetFileSize(String path)
     return (u64)fSize;
 }
 
+#define TY_FILE_DIR_MAX_FILES (1 << 14)         // A single directory rarely nears it, and temp stays at 512KB.
+
 SArray<String> GetFilesInDir(mem::Arena* arena, String dirPath)
 {
-    // TODO(caio): Implement me!
-    ASSERT(0);
-    return {};
+    DirWalkOptions options = {};
+    options.recursive = false;
+    options.parallel = false;
+    options.maxEntries = TY_FILE_DIR_MAX_FILES;
+    MEM_ARENA_SCRATCH_START(scratch);
+    SArray<DirEntry> entries = WalkDir(scratch, dirPath, options);
+    SArray<String> result = {};
+    if(entries.count)
+    {
+        result = MakeSArray<String>(arena, entries.count);
+        for(u64 i = 0; i < entries.count; i++)
+        {
+            result.Push(Str(arena, entries[i].path));
+        }
+    }
+    MEM_ARENA_SCRATCH_END(scratch);
+    return result;
+}
+
+SArray<String> GetPaths(mem::Arena* arena, SArray<DirEntry> entries)
+{
+    if(!entries.count) return {};
+    SArray<String> result = MakeSArray<String>(arena, entries.count);
+    for(u64 i = 0; i < entries.count; i++)
+    {
+        result.Push(entries[i].path);
+    }
+    return result;
+}
+
+bool MatchGlob(String s, String pattern)
+{
+    // Iterative wildcard match, backtracks only to the last '*'.
+    u64 si = 0;
+    u64 pi = 0;
+    i64 starPi = -1;
+    u64 starSi = 0;
+    while(si < s.len)
+    {
+        if(pi < pattern.len && (pattern[pi] == '?' || pattern[pi] == s[si]))
+        {
+            si++;
+            pi++;
+        }
+        else if(pi < pattern.len && pattern[pi] == '*')
+        {
+            starPi = pi++;
+            starSi = si;
+        }
+        else if(starPi != -1)
+        {
+            pi = starPi + 1;
+            si = ++starSi;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while(pi < pattern.len && pattern[pi] == '*')
+    {
+        pi++;
+    }
+    return pi == pattern.len;
+}
+
+// ========================================================
+// [DIRECTORY WALK]
+
+#define TY_FILE_DIR_CACHE_MAGIC 0x43445954     // 'TYDC'
+#define TY_FILE_DIR_CACHE_VERSION 1
+#define TY_FILE_DIR_WALK_BATCH 64
+
+inline u64 FileTimeToU64(FILETIME ft)
+{
+    return ((u64)ft.dwHighDateTime << 32) | (u64)ft.dwLowDateTime;
+}
+
+bool GetDirWriteTime(String dirPath, u64* mtime)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attributes = {};
+    if(!GetFileAttributesEx(dirPath.CStr(), GetFileExInfoStandard, &attributes)) return false;
+    *mtime = FileTimeToU64(attributes.ftLastWriteTime);
+    return true;
+}
+
+String JoinPath(mem::Arena* arena, String dir, const char* name, u64 nameLen)
+{
+    bool hasSlash = dir.len && (dir[dir.len - 1] == '/' || dir[dir.len - 1] == '\\');
+    u64 len = dir.len + (hasSlash ? 0 : 1) + nameLen;
+    byte* buf = (byte*)mem::ArenaPush(arena, len + 1);
+    memcpy(buf, dir.data, dir.len);
+    if(!hasSlash) buf[dir.len] = '/';
+    memcpy(buf + len - nameLen, name, nameLen);
+    buf[len] = 0;   // Null terminator for c-string compatibility.
+    return Str(buf, len);
+}
+
+bool MatchExtension(String name, String ext)
+{
+    if(ext.len > name.len) return false;
+    for(u64 i = 0; i < ext.len; i++)
+    {
+        char a = name[name.len - ext.len + i];
+        char b = ext[i];
+        if(a >= 'A' && a <= 'Z') a += 'a' - 'A';
+        if(b >= 'A' && b <= 'Z') b += 'a' - 'A';
+        if(a != b) return false;
+    }
+    return true;
+}
+
+bool PassesDirWalkFilters(DirWalkOptions* options, String name)
+{
+    if(options->extensionCount)
+    {
+        bool match = false;
+        for(u32 i = 0; i < options->extensionCount && !match; i++)
+        {
+            match = MatchExtension(name, options->extensions[i]);
+        }
+        if(!match) return false;
+    }
+    if(options->glob.len && !MatchGlob(name, options->glob)) return false;
+    return true;
+}
+
+struct DirWalkPending
+{
+    String path;
+    u64 mtime = 0;
+    bool hasMtime = false;
+};
+
+struct DirWalkItem
+{
+    char name[MAX_PATH];
+    u64 nameLen = 0;
+    u64 size = 0;
+    u64 mtime = 0;
+    bool isDir = false;
+    bool hasMtime = false;
+};
+
+struct DirWalkCacheFile
+{
+    DirCacheFile file;
+    u32 dir = 0;
+};
+
+struct DirWalkCacheSubdir
+{
+    String name;
+    u32 dir = 0;
+};
+
+struct DirWalkState
+{
+    DirWalkOptions* options = NULL;
+    DirCache* cache = NULL;
+    mem::Arena* arena = NULL;       // Result paths.
+    mem::Arena* tempArena = NULL;   // Pending directories, result entries and new cache records.
+
+    SRWLOCK lock;
+    CONDITION_VARIABLE wake;
+    u32 activeDirs = 0;
+    SArray<DirWalkPending> pending;
+    SArray<DirEntry> entries;
+
+    SArray<DirCacheDir> cacheDirs;
+    SArray<DirWalkCacheFile> cacheFiles;
+    SArray<DirWalkCacheSubdir> cacheSubdirs;
+};
+
+void FlushDirWalkItems(DirWalkState* state, String dirPath, u32 dirRecord, DirWalkItem* items, u32 count)
+{
+    DirWalkOptions* options = state->options;
+    u32 newDirs = 0;
+    AcquireSRWLockExclusive(&state->lock);
+    for(u32 i = 0; i < count; i++)
+    {
+        DirWalkItem& item = items[i];
+        String name = Str((byte*)item.name, item.nameLen);
+        if(item.isDir)
+        {
+            if(options->recursive || options->includeDirs)
+            {
+                // Only pending directories need a temp copy, a flat walk joins straight into the result.
+                mem::Arena* pathArena = options->recursive ? state->tempArena : state->arena;
+                String childPath = JoinPath(pathArena, dirPath, item.name, item.nameLen);
+                if(options->recursive)
+                {
+                    DirWalkPending child = {};
+                    child.path = childPath;
+                    child.mtime = item.mtime;
+                    child.hasMtime = item.hasMtime;
+                    state->pending.Push(child);
+                    newDirs++;
+                }
+                if(options->includeDirs)
+                {
+                    DirEntry entry = {};
+                    entry.path = options->recursive ? Str(state->arena, childPath) : childPath;
+                    entry.mtime = item.mtime;
+                    state->entries.Push(entry);
+                }
+            }
+            if(state->cache)
+            {
+                DirWalkCacheSubdir subdir = {};
+                subdir.name = Str(state->tempArena, name);
+                subdir.dir = dirRecord;
+                state->cacheSubdirs.Push(subdir);
+            }
+        }
+        else
+        {
+            if(PassesDirWalkFilters(options, name))
+            {
+                DirEntry entry = {};
+                entry.path = JoinPath(state->arena, dirPath, item.name, item.nameLen);
+                entry.size = item.size;
+                entry.mtime = item.mtime;
+                state->entries.Push(entry);
+            }
+            if(state->cache)
+            {
+                DirWalkCacheFile file = {};
+                file.file.name = Str(state->tempArena, name);
+                file.file.size = item.size;
+                file.file.mtime = item.mtime;
+                file.dir = dirRecord;
+                state->cacheFiles.Push(file);
+            }
+        }
+    }
+    if(newDirs > 1) WakeAllConditionVariable(&state->wake);
+    else if(newDirs == 1) WakeConditionVariable(&state->wake);
+    ReleaseSRWLockExclusive(&state->lock);
+}
+
+void ProcessDirWalkDir(DirWalkState* state, DirWalkPending dir)
+{
+    DirWalkItem items[TY_FILE_DIR_WALK_BATCH];
+    u32 itemCount = 0;
+
+    // Cached listing is reused when the directory's write time is unchanged.
+    u32 dirRecord = 0;
+    DirCacheDir* cachedDir = NULL;
+    if(state->cache)
+    {
+        if(!dir.hasMtime && !GetDirWriteTime(dir.path, &dir.mtime)) return;
+        i64 lookup = state->cache->dirLookup.Find(dir.path);
+        if(lookup != -1)
+        {
+            cachedDir = &state->cache->dirs[state->cache->dirLookup.buckets[lookup].value];
+            if(cachedDir->mtime != dir.mtime) cachedDir = NULL;
+        }
+    }
+
+    // FindExInfoBasic skips short names and LARGE_FETCH batches entries per kernel call,
+    // and both size and write time come with each entry, so files never need a separate stat.
+    WIN32_FIND_DATA findData = {};
+    HANDLE hFind = INVALID_HANDLE_VALUE;
+    if(!cachedDir)
+    {
+        char pattern[MAX_PATH * 2];
+        snprintf(pattern, sizeof(pattern), "%.*s/*", (i32)dir.path.len, dir.path.CStr());
+        hFind = FindFirstFileEx(
+                pattern,
+                FindExInfoBasic,
+                &findData,
+                FindExSearchNameMatch,
+                NULL,
+                FIND_FIRST_EX_LARGE_FETCH);
+        // Unreadable directory, skip. It gets no cache record either, or later walks would
+        // list it as empty until its write time changes, which access changes don't do.
+        if(hFind == INVALID_HANDLE_VALUE) return;
+    }
+
+    if(state->cache)
+    {
+        DirCacheDir record = {};
+        record.mtime = dir.mtime;
+        AcquireSRWLockExclusive(&state->lock);
+        record.path = Str(state->tempArena, dir.path);
+        dirRecord = state->cacheDirs.Push(record);
+        ReleaseSRWLockExclusive(&state->lock);
+    }
+
+    if(cachedDir)
+    {
+        DirCache* cache = state->cache;
+        for(u32 i = 0; i < cachedDir->subdirCount; i++)
+        {
+            String name = cache->subdirs[cachedDir->subdirStart + i];
+            DirWalkItem& item = items[itemCount++];
+            memcpy(item.name, name.data, name.len);
+            item.nameLen = name.len;
+            item.size = 0;
+            item.mtime = 0;
+            item.isDir = true;
+            item.hasMtime = false;  // Subdirectories still need to be stat'd to validate their own cache.
+            if(itemCount == TY_FILE_DIR_WALK_BATCH)
+            {
+                FlushDirWalkItems(state, dir.path, dirRecord, items, itemCount);
+                itemCount = 0;
+            }
+        }
+        for(u32 i = 0; i < cachedDir->fileCount; i++)
+        {
+            DirCacheFile& file = cache->files[cachedDir->fileStart + i];
+            DirWalkItem& item = items[itemCount++];
+            memcpy(item.name, file.name.data, file.name.len);
+            item.nameLen = file.name.len;
+            item.size = file.size;
+            item.mtime = file.mtime;
+            item.isDir = false;
+            item.hasMtime = true;
+            if(itemCount == TY_FILE_DIR_WALK_BATCH)
+            {
+                FlushDirWalkItems(state, dir.path, dirRecord, items, itemCount);
+                itemCount = 0;
+            }
+        }
+    }
+    else
+    {
+        do
+        {
+            const char* name = findData.cFileName;
+            if(name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) continue;
+            bool isDir = findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY;
+            if(isDir && (findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) continue;     // Avoid link cycles.
+
+            DirWalkItem& item = items[itemCount++];
+            item.nameLen = strlen(name);
+            memcpy(item.name, name, item.nameLen);
+            item.size = isDir ? 0 : ((u64)findData.nFileSizeHigh << 32) | (u64)findData.nFileSizeLow;
+            item.mtime = FileTimeToU64(findData.ftLastWriteTime);
+            item.isDir = isDir;
+            item.hasMtime = true;
+            if(itemCount == TY_FILE_DIR_WALK_BATCH)
+            {
+                FlushDirWalkItems(state, dir.path, dirRecord, items, itemCount);
+                itemCount = 0;
+            }
+        } while(FindNextFile(hFind, &findData));
+        FindClose(hFind);
+    }
+
+    if(itemCount)
+    {
+        FlushDirWalkItems(state, dir.path, dirRecord, items, itemCount);
+    }
+}
+
+void DirWalkTask(void* data, u32 threadIndex)
+{
+    DirWalkState* state = (DirWalkState*)data;
+    while(true)
+    {
+        AcquireSRWLockExclusive(&state->lock);
+        while(state->pending.count == 0 && state->activeDirs > 0)
+        {
+            SleepConditionVariableSRW(&state->wake, &state->lock, INFINITE, 0);
+        }
+        if(state->pending.count == 0)
+        {
+            // No pending or active directories left, walk is done.
+            WakeAllConditionVariable(&state->wake);
+            ReleaseSRWLockExclusive(&state->lock);
+            break;
+        }
+        DirWalkPending dir = state->pending.Pop();
+        state->activeDirs++;
+        ReleaseSRWLockExclusive(&state->lock);
+
+        ProcessDirWalkDir(state, dir);
+
+        AcquireSRWLockExclusive(&state->lock);
+        state->activeDirs--;
+        if(state->activeDirs == 0 && state->pending.count == 0)
+        {
+            WakeAllConditionVariable(&state->wake);
+        }
+        ReleaseSRWLockExclusive(&state->lock);
+    }
+}
+
+void RebuildDirCache(DirCache* cache, DirWalkState* state)
+{
+    ClearDirCache(cache);
+    ASSERT(state->cacheDirs.count <= cache->maxDirs);
+    ASSERT(state->cacheFiles.count <= cache->maxFiles);
+
+    // Group files and subdirectories by directory (counting sort on record index).
+    for(u64 i = 0; i < state->cacheDirs.count; i++)
+    {
+        DirCacheDir dir = state->cacheDirs[i];
+        dir.path = Str(cache->arena, dir.path);
+        cache->dirs.Push(dir);
+    }
+    for(u64 i = 0; i < state->cacheFiles.count; i++)
+    {
+        cache->dirs[state->cacheFiles[i].dir].fileCount++;
+    }
+    for(u64 i = 0; i < state->cacheSubdirs.count; i++)
+    {
+        cache->dirs[state->cacheSubdirs[i].dir].subdirCount++;
+    }
+    u32 fileCursor = 0;
+    u32 subdirCursor = 0;
+    for(u64 i = 0; i < cache->dirs.count; i++)
+    {
+        DirCacheDir& dir = cache->dirs[i];
+        dir.fileStart = fileCursor;
+        dir.subdirStart = subdirCursor;
+        fileCursor += dir.fileCount;
+        subdirCursor += dir.subdirCount;
+        dir.fileCount = 0;
+        dir.subdirCount = 0;
+        cache->dirLookup.Insert(dir.path, (u32)i);
+    }
+    cache->files.count = fileCursor;
+    cache->subdirs.count = subdirCursor;
+    for(u64 i = 0; i < state->cacheFiles.count; i++)
+    {
+        DirCacheDir& dir = cache->dirs[state->cacheFiles[i].dir];
+        DirCacheFile file = state->cacheFiles[i].file;
+        file.name = Str(cache->arena, file.name);
+        cache->files[dir.fileStart + dir.fileCount++] = file;
+    }
+    for(u64 i = 0; i < state->cacheSubdirs.count; i++)
+    {
+        DirCacheDir& dir = cache->dirs[state->cacheSubdirs[i].dir];
+        cache->subdirs[dir.subdirStart + dir.subdirCount++] = Str(cache->arena, state->cacheSubdirs[i].name);
+    }
+}
+
+i32 CompareDirEntries(const void* a, const void* b)
+{
+    String pa = ((DirEntry*)a)->path;
+    String pb = ((DirEntry*)b)->path;
+    i32 cmp = memcmp(pa.data, pb.data, MIN(pa.len, pb.len));
+    if(cmp != 0) return cmp;
+    return pa.len < pb.len ? -1 : (pa.len > pb.len ? 1 : 0);
+}
+
+SArray<DirEntry> WalkDir(mem::Arena* arena, String dirPath, DirWalkOptions options)
+{
+    ASSERT(PathExists(dirPath) && PathIsDir(dirPath));
+    DirWalkState state = {};
+    state.options = &options;
+    state.cache = options.cache;
+    state.arena = arena;
+
+    // Sized for the walk asked for: a flat one only ever has the root pending.
+    u64 maxPending = options.recursive ? options.maxDirs : 1;
+    u64 tempSize = options.maxEntries * sizeof(DirEntry)
+        + maxPending * (sizeof(DirWalkPending) + MAX_PATH);
+    if(state.cache)
+    {
+        tempSize += state.cache->maxDirs * (sizeof(DirCacheDir) + sizeof(DirWalkCacheSubdir) + 2 * MAX_PATH)
+            + state.cache->maxFiles * (sizeof(DirWalkCacheFile) + 64);
+    }
+    state.tempArena = mem::MakeArena(tempSize);
+    state.pending = MakeSArray<DirWalkPending>(state.tempArena, maxPending);
+    state.entries = MakeSArray<DirEntry>(state.tempArena, options.maxEntries);
+    if(state.cache)
+    {
+        state.cacheDirs = MakeSArray<DirCacheDir>(state.tempArena, state.cache->maxDirs);
+        state.cacheFiles = MakeSArray<DirWalkCacheFile>(state.tempArena, state.cache->maxFiles);
+        state.cacheSubdirs = MakeSArray<DirWalkCacheSubdir>(state.tempArena, state.cache->maxDirs);
+    }
+    InitializeSRWLock(&state.lock);
+    InitializeConditionVariable(&state.wake);
+
+    // Strip trailing separators so joined paths stay canonical.
+    while(dirPath.len > 1 && (dirPath[dirPath.len - 1] == '/' || dirPath[dirPath.len - 1] == '\\'))
+    {
+        dirPath.len--;
+    }
+    DirWalkPending root = {};
+    root.path = Str(state.tempArena, dirPath);
+    state.pending.Push(root);
+
+    if(options.parallel)
+    {
+        async::RunOnAllThreads(DirWalkTask, &state);
+    }
+    else
+    {
+        DirWalkTask(&state, 0);
+    }
+
+    if(state.cache)
+    {
+        RebuildDirCache(state.cache, &state);
+    }
+
+    SArray<DirEntry> result = {};
+    if(state.entries.count)
+    {
+        result = MakeSArray<DirEntry>(arena, state.entries.count);
+        memcpy(result.data, state.entries.data, state.entries.count * sizeof(DirEntry));
+        result.count = state.entries.count;
+        if(options.sorted)
+        {
+            qsort(result.data, result.count, sizeof(DirEntry), CompareDirEntries);
+        }
+    }
+    mem::DestroyArena(state.tempArena);
+    return result;
+}
+
+// ========================================================
+// [DIRECTORY CACHE]
+
+DirCache* MakeDirCache(u64 arenaSize, u64 maxDirs, u64 maxFiles)
+{
+    mem::Arena* arena = mem::MakeArena(arenaSize);
+    DirCache* cache = (DirCache*)mem::ArenaPush(arena, sizeof(DirCache));
+    *cache = {};
+    cache->arena = arena;
+    cache->maxDirs = maxDirs;
+    cache->maxFiles = maxFiles;
+    ClearDirCache(cache);
+    return cache;
+}
+
+void DestroyDirCache(DirCache* cache)
+{
+    ASSERT(cache);
+    mem::DestroyArena(cache->arena);
+}
+
+void ClearDirCache(DirCache* cache)
+{
+    ASSERT(cache);
+    mem::ArenaFallback(cache->arena, sizeof(DirCache));
+    cache->dirs = MakeSArray<DirCacheDir>(cache->arena, cache->maxDirs);
+    cache->files = MakeSArray<DirCacheFile>(cache->arena, cache->maxFiles);
+    cache->subdirs = MakeSArray<String>(cache->arena, cache->maxDirs);
+    cache->dirLookup = MakeMap<String, u32>(cache->arena, cache->maxDirs * 2);
+}
+
+bool LoadDirCache(DirCache* cache, String path)
+{
+    ASSERT(cache);
+    if(!PathExists(path)) return false;
+    MEM_ARENA_SCRATCH_START(scratch);
+    u64 size = 0;
+    byte* data = ReadFileToBuffer(scratch, path, &size);
+    byte* cursor = data;
+    byte* end = data + size;
+    bool valid = true;
+
+#define DIR_CACHE_READ(DST, BYTES) \
+    if(valid && cursor + (BYTES) <= end) { memcpy((DST), cursor, (BYTES)); cursor += (BYTES); } else valid = false;
+
+    u32 magic = 0;
+    u32 version = 0;
+    u64 dirCount = 0;
+    u64 fileCount = 0;
+    u64 subdirCount = 0;
+    DIR_CACHE_READ(&magic, sizeof(u32));
+    DIR_CACHE_READ(&version, sizeof(u32));
+    DIR_CACHE_READ(&dirCount, sizeof(u64));
+    DIR_CACHE_READ(&fileCount, sizeof(u64));
+    DIR_CACHE_READ(&subdirCount, sizeof(u64));
+    valid = valid
+        && magic == TY_FILE_DIR_CACHE_MAGIC
+        && version == TY_FILE_DIR_CACHE_VERSION
+        && dirCount <= cache->maxDirs
+        && fileCount <= cache->maxFiles
+        && subdirCount <= cache->maxDirs;
+
+    ClearDirCache(cache);
+    for(u64 i = 0; valid && i < dirCount; i++)
+    {
+        DirCacheDir dir = {};
+        u32 len = 0;
+        DIR_CACHE_READ(&len, sizeof(u32));
+        if(!valid || len == 0 || cursor + len > end) { valid = false; break; }
+        dir.path = Str(cache->arena, Str(cursor, len));
+        cursor += len;
+        DIR_CACHE_READ(&dir.mtime, sizeof(u64));
+        DIR_CACHE_READ(&dir.fileStart, sizeof(u32));
+        DIR_CACHE_READ(&dir.fileCount, sizeof(u32));
+        DIR_CACHE_READ(&dir.subdirStart, sizeof(u32));
+        DIR_CACHE_READ(&dir.subdirCount, sizeof(u32));
+        valid = valid
+            && (u64)dir.fileStart + dir.fileCount <= fileCount
+            && (u64)dir.subdirStart + dir.subdirCount <= subdirCount;
+        if(!valid) break;
+        cache->dirLookup.Insert(dir.path, (u32)cache->dirs.Push(dir));
+    }
+    for(u64 i = 0; valid && i < fileCount; i++)
+    {
+        DirCacheFile file = {};
+        u32 len = 0;
+        DIR_CACHE_READ(&len, sizeof(u32));
+        if(!valid || len == 0 || len >= MAX_PATH || cursor + len > end) { valid = false; break; }
+        file.name = Str(cache->arena, Str(cursor, len));
+        cursor += len;
+        DIR_CACHE_READ(&file.size, sizeof(u64));
+        DIR_CACHE_READ(&file.mtime, sizeof(u64));
+        cache->files.Push(file);
+    }
+    for(u64 i = 0; valid && i < subdirCount; i++)
+    {
+        u32 len = 0;
+        DIR_CACHE_READ(&len, sizeof(u32));
+        if(!valid || len == 0 || len >= MAX_PATH || cursor + len > end) { valid = false; break; }
+        cache->subdirs.Push(Str(cache->arena, Str(cursor, len)));
+        cursor += len;
+    }
+#undef DIR_CACHE_READ
+
+    if(!valid) ClearDirCache(cache);   // Stale or corrupt cache files are discarded, next walk does a full scan.
+    MEM_ARENA_SCRATCH_END(scratch);
+    return valid;
+}
+
+bool SaveDirCache(DirCache* cache, String path)
+{
+    ASSERT(cache);
+    u64 size = sizeof(u32) * 2 + sizeof(u64) * 3;
+    for(u64 i = 0; i < cache->dirs.count; i++)
+    {
+        size += sizeof(u32) + cache->dirs[i].path.len + sizeof(u64) + sizeof(u32) * 4;
+    }
+    for(u64 i = 0; i < cache->files.count; i++)
+    {
+        size += sizeof(u32) + cache->files[i].name.len + sizeof(u64) * 2;
+    }
+    for(u64 i = 0; i < cache->subdirs.count; i++)
+    {
+        size += sizeof(u32) + cache->subdirs[i].len;
+    }
+
+    MEM_ARENA_SCRATCH_START(scratch);
+    byte* data = (byte*)mem::ArenaPush(scratch, size);
+    byte* cursor = data;
+
+#define DIR_CACHE_WRITE(SRC, BYTES) STMT(memcpy(cursor, (SRC), (BYTES)); cursor += (BYTES))
+
+    u32 magic = TY_FILE_DIR_CACHE_MAGIC;
+    u32 version = TY_FILE_DIR_CACHE_VERSION;
+    DIR_CACHE_WRITE(&magic, sizeof(u32));
+    DIR_CACHE_WRITE(&version, sizeof(u32));
+    DIR_CACHE_WRITE(&cache->dirs.count, sizeof(u64));
+    DIR_CACHE_WRITE(&cache->files.count, sizeof(u64));
+    DIR_CACHE_WRITE(&cache->subdirs.count, sizeof(u64));
+    for(u64 i = 0; i < cache->dirs.count; i++)
+    {
+        DirCacheDir& dir = cache->dirs[i];
+        u32 len = (u32)dir.path.len;
+        DIR_CACHE_WRITE(&len, sizeof(u32));
+        DIR_CACHE_WRITE(dir.path.data, len);
+        DIR_CACHE_WRITE(&dir.mtime, sizeof(u64));
+        DIR_CACHE_WRITE(&dir.fileStart, sizeof(u32));
+        DIR_CACHE_WRITE(&dir.fileCount, sizeof(u32));
+        DIR_CACHE_WRITE(&dir.subdirStart, sizeof(u32));
+        DIR_CACHE_WRITE(&dir.subdirCount, sizeof(u32));
+    }
+    for(u64 i = 0; i < cache->files.count; i++)
+    {
+        DirCacheFile& file = cache->files[i];
+        u32 len = (u32)file.name.len;
+        DIR_CACHE_WRITE(&len, sizeof(u32));
+        DIR_CACHE_WRITE(file.name.data, len);
+        DIR_CACHE_WRITE(&file.size, sizeof(u64));
+        DIR_CACHE_WRITE(&file.mtime, sizeof(u64));
+    }
+    for(u64 i = 0; i < cache->subdirs.count; i++)
+    {
+        u32 len = (u32)cache->subdirs[i].len;
+        DIR_CACHE_WRITE(&len, sizeof(u32));
+        DIR_CACHE_WRITE(cache->subdirs[i].data, len);
+    }
+#undef DIR_CACHE_WRITE
+    ASSERT(cursor == data + size);
+
+    bool result = WriteFile(path, data, size, true);
+    MEM_ARENA_SCRATCH_END(scratch);
+    return result;
 }
 
 u64 ReadFile(String path, byte* output)
 {
+    pack::Pack* pack = NULL;
+    pack::PackEntry* entry = pack::FindEntry(path, &pack);
+    if(entry)
+    {
+        bool ret = pack::ReadEntry(pack, entry, output);
+        ASSERT(ret);
+        return entry->rawSize;
+    }
+
     HANDLE hFile = CreateFile(
             path.CStr(),
             GENERIC_READ,
@@ -140,5 +859,484 @@ byte* ReadFileToBuffer(mem::Arena* arena, String path, u64* size)
     return result;
 }
 
+// ========================================================
+// [FILE WRITING]
+
+#define TY_FILE_MAX_WRITE_CHUNK MB(256)     // Single WriteFile calls are limited to DWORD sizes.
+
+bool WriteFileAt(HANDLE hFile, u64 offset, const void* data, u64 size)
+{
+    // Positional write through OVERLAPPED offsets (same as pwrite on a synchronous handle).
+    const byte* cursor = (const byte*)data;
+    while(size)
+    {
+        DWORD chunk = (DWORD)MIN(size, TY_FILE_MAX_WRITE_CHUNK);
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD bytesWritten = 0;
+        BOOL ret = ::WriteFile(hFile, cursor, chunk, &bytesWritten, &overlapped);
+        if(!ret || bytesWritten != chunk) return false;
+        cursor += chunk;
+        offset += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+void FlushFileWriterBuffer(FileWriter* writer, bool final)
+{
+    if(!writer->bufferUsed || writer->failed) return;
+
+    u64 flushSize = writer->bufferUsed;
+    if(writer->desc.unbuffered)
+    {
+        // Unbuffered handles only accept sector-aligned sizes. Partial sectors stay in the buffer
+        // until the final flush, which pads them (the file is truncated back on close).
+        if(final)
+        {
+            flushSize = ALIGN_TO(writer->bufferUsed, TY_FILE_SECTOR_SIZE);
+            memset(writer->buffer + writer->bufferUsed, 0, flushSize - writer->bufferUsed);
+        }
+        else
+        {
+            flushSize = writer->bufferUsed & ~(TY_FILE_SECTOR_SIZE - 1);
+            if(!flushSize) return;
+        }
+    }
+
+    if(!WriteFileAt(writer->hFile, writer->fileOffset, writer->buffer, flushSize))
+    {
+        writer->failed = true;
+        return;
+    }
+    writer->fileOffset += flushSize;
+    if(flushSize < writer->bufferUsed)
+    {
+        memmove(writer->buffer, writer->buffer + flushSize, writer->bufferUsed - flushSize);
+        writer->bufferUsed -= flushSize;
+    }
+    else
+    {
+        writer->bufferUsed = 0;
+    }
+
+    if(writer->desc.sync == FILE_SYNC_ON_FLUSH && !FlushFileBuffers(writer->hFile))
+    {
+        writer->failed = true;
+    }
+}
+
+FileWriter MakeFileWriter(mem::Arena* arena, String path, FileWriterDesc desc)
+{
+    ASSERT(desc.bufferSize > 0);
+    FileWriter result = {};
+    desc.bufferSize = ALIGN_TO(desc.bufferSize, TY_FILE_SECTOR_SIZE);
+    result.desc = desc;
+    result.path = Str(arena, path);
+    result.writePath = desc.atomic
+        ? StrFmt(arena, "%.*s.tmp", (i32)path.len, path.CStr())
+        : result.path;
+    result.buffer = (byte*)mem::ArenaPush(arena, desc.bufferSize, TY_FILE_SECTOR_SIZE);
+
+    DWORD flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN;
+    if(desc.unbuffered) flags |= FILE_FLAG_NO_BUFFERING;
+    result.hFile = CreateFile(
+            result.writePath.CStr(),
+            GENERIC_WRITE,
+            0,
+            NULL,
+            CREATE_ALWAYS,
+            flags,
+            NULL);
+    if(result.hFile == INVALID_HANDLE_VALUE)
+    {
+        result.failed = true;
+    }
+    return result;
+}
+
+void Write(FileWriter* writer, const void* data, u64 size)
+{
+    ASSERT(writer);
+    if(!writer->IsValid() || !size) return;
+    writer->size += size;
+
+    const byte* cursor = (const byte*)data;
+    if(!writer->desc.unbuffered && size >= writer->desc.bufferSize)
+    {
+        // Big blob: skip the copy into the buffer.
+        FlushFileWriterBuffer(writer, false);
+        if(writer->failed) return;
+        if(!WriteFileAt(writer->hFile, writer->fileOffset, cursor, size))
+        {
+            writer->failed = true;
+            return;
+        }
+        writer->fileOffset += size;
+        if(writer->desc.sync == FILE_SYNC_ON_FLUSH && !FlushFileBuffers(writer->hFile))
+        {
+            writer->failed = true;
+        }
+        return;
+    }
+
+    while(size && !writer->failed)
+    {
+        u64 copySize = MIN(size, writer->desc.bufferSize - writer->bufferUsed);
+        memcpy(writer->buffer + writer->bufferUsed, cursor, copySize);
+        writer->bufferUsed += copySize;
+        cursor += copySize;
+        size -= copySize;
+        if(writer->bufferUsed == writer->desc.bufferSize)
+        {
+            FlushFileWriterBuffer(writer, false);
+        }
+    }
+}
+
+void WriteV(FileWriter* writer, FileSlice* slices, u64 count)
+{
+    // Gathers slices into the write buffer, so a batch of small records costs one write call.
+    // (Win32 WriteFileGather requires page-sized unbuffered segments, which doesn't fit records.)
+    for(u64 i = 0; i < count && writer->IsValid(); i++)
+    {
+        Write(writer, slices[i].data, slices[i].size);
+    }
+}
+
+void FlushFileWriter(FileWriter* writer)
+{
+    ASSERT(writer);
+    if(!writer->IsValid()) return;
+    FlushFileWriterBuffer(writer, false);
+}
+
+bool CloseFileWriter(FileWriter* writer)
+{
+    ASSERT(writer);
+    if(writer->hFile == INVALID_HANDLE_VALUE) return false;
+
+    FlushFileWriterBuffer(writer, true);
+    if(!writer->failed && writer->desc.unbuffered && writer->fileOffset != writer->size)
+    {
+        // Drop the sector padding from the last flush.
+        LARGE_INTEGER end = {};
+        end.QuadPart = writer->size;
+        if(!SetFilePointerEx(writer->hFile, end, NULL, FILE_BEGIN) || !SetEndOfFile(writer->hFile))
+        {
+            writer->failed = true;
+        }
+    }
+    if(!writer->failed && (writer->desc.sync != FILE_SYNC_NONE || writer->desc.atomic))
+    {
+        if(!FlushFileBuffers(writer->hFile)) writer->failed = true;
+    }
+    CloseHandle(writer->hFile);
+    writer->hFile = INVALID_HANDLE_VALUE;
+
+    if(writer->desc.atomic)
+    {
+        if(writer->failed
+                || !MoveFileEx(writer->writePath.CStr(), writer->path.CStr(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        {
+            DeleteFile(writer->writePath.CStr());
+            writer->failed = true;
+        }
+    }
+    return !writer->failed;
+}
+
+void AbortFileWriter(FileWriter* writer)
+{
+    ASSERT(writer);
+    if(writer->hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(writer->hFile);
+        writer->hFile = INVALID_HANDLE_VALUE;
+    }
+    if(writer->desc.atomic)
+    {
+        DeleteFile(writer->writePath.CStr());
+    }
+    writer->failed = true;
+}
+
+bool WriteFile(String path, const void* data, u64 size, bool atomic)
+{
+    // Whole buffer is written at once, so the writer only needs a minimal internal buffer.
+    MEM_ARENA_SCRATCH_START(scratch);
+    FileWriterDesc desc = {};
+    desc.bufferSize = TY_FILE_SECTOR_SIZE;
+    desc.atomic = atomic;
+    FileWriter writer = MakeFileWriter(scratch, path, desc);
+    Write(&writer, data, size);
+    bool result = CloseFileWriter(&writer);
+    MEM_ARENA_SCRATCH_END(scratch);
+    return result;
+}
+
+// ========================================================
+// [FILE STREAMING]
+
+#define TY_FILE_MAX_READ_CHUNK MB(256)      // Single ReadFile calls are limited to DWORD sizes.
+
+bool ReadFileAt(HANDLE hFile, u64 offset, void* output, u64 size, u64* bytesRead)
+{
+    // Positional read through OVERLAPPED offsets (same as pread on a synchronous handle).
+    // Stops early at end of file.
+    byte* cursor = (byte*)output;
+    *bytesRead = 0;
+    while(size)
+    {
+        DWORD chunkSize = (DWORD)MIN(size, TY_FILE_MAX_READ_CHUNK);
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD chunkRead = 0;
+        if(!::ReadFile(hFile, cursor, chunkSize, &chunkRead, &overlapped))
+        {
+            return GetLastError() == ERROR_HANDLE_EOF;
+        }
+        *bytesRead += chunkRead;
+        if(chunkRead < chunkSize) break;
+        cursor += chunkRead;
+        offset += chunkRead;
+        size -= chunkRead;
+    }
+    return true;
+}
+
+inline u64 GetStreamBlockCount(StreamReader* reader)
+{
+    return (reader->size + reader->desc.blockSize - 1) / reader->desc.blockSize;
+}
+
+DWORD WINAPI StreamReaderThreadProc(LPVOID param)
+{
+    StreamReader* reader = (StreamReader*)param;
+    u64 blockTotal = GetStreamBlockCount(reader);
+    AcquireSRWLockExclusive(&reader->lock);
+    while(true)
+    {
+        if(reader->quit) break;
+
+        // Next block to read: first block in the read-ahead window that isn't loaded.
+        // Each block in the window maps to a distinct slot, so the slot can be overwritten.
+        u64 next = MAX_U64;
+        u64 windowEnd = MIN(reader->windowStart + reader->desc.blockCount, blockTotal);
+        for(u64 i = reader->windowStart; i < windowEnd; i++)
+        {
+            StreamBlock& block = reader->blocks[i % reader->desc.blockCount];
+            if(block.index != i)
+            {
+                next = i;
+                break;
+            }
+        }
+        if(next == MAX_U64)
+        {
+            SleepConditionVariableSRW(&reader->wakeReader, &reader->lock, INFINITE, 0);
+            continue;
+        }
+
+        u64 slot = next % reader->desc.blockCount;
+        StreamBlock& block = reader->blocks[slot];
+        block.index = next;
+        block.ready = false;
+        ReleaseSRWLockExclusive(&reader->lock);
+
+        u64 bytesRead = 0;
+        byte* data = reader->memory + slot * reader->desc.blockSize;
+        bool ret = ReadFileAt(reader->hFile, next * reader->desc.blockSize, data, reader->desc.blockSize, &bytesRead);
+
+        AcquireSRWLockExclusive(&reader->lock);
+        if(!ret) reader->failed = true;
+        if(next >= reader->windowStart && next < reader->windowStart + reader->desc.blockCount)
+        {
+            block.size = bytesRead;
+            block.ready = true;
+        }
+        else
+        {
+            block.index = MAX_U64;  // Seeked away while reading.
+        }
+        WakeAllConditionVariable(&reader->wakeConsumer);
+    }
+    ReleaseSRWLockExclusive(&reader->lock);
+    return 0;
+}
+
+StreamReader* MakeStreamReader(mem::Arena* arena, String path, StreamReaderDesc desc)
+{
+    ASSERT(desc.blockSize > 0);
+    ASSERT(desc.blockCount >= 2);
+    desc.blockSize = ALIGN_TO(desc.blockSize, TY_FILE_SECTOR_SIZE);
+
+    StreamReader* reader = (StreamReader*)mem::ArenaPush(arena, sizeof(StreamReader));
+    *reader = {};
+    reader->desc = desc;
+
+    pack::Pack* pack = NULL;
+    pack::PackEntry* entry = pack::FindEntry(path, &pack);
+    if(entry)
+    {
+        reader->mapped = pack::GetEntryData(pack, entry);
+        reader->size = entry->rawSize;
+        if(reader->mapped) return reader;
+        // Compressed entries can't be streamed, fall back to disk.
+    }
+
+    DWORD flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN;
+    if(desc.unbuffered) flags |= FILE_FLAG_NO_BUFFERING;
+    reader->hFile = CreateFile(
+            path.CStr(),
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            NULL,
+            OPEN_EXISTING,
+            flags,
+            NULL);
+    if(reader->hFile == INVALID_HANDLE_VALUE) return NULL;
+    LARGE_INTEGER fileSize = {};
+    if(!GetFileSizeEx(reader->hFile, &fileSize))
+    {
+        CloseHandle(reader->hFile);
+        return NULL;
+    }
+    reader->size = fileSize.QuadPart;
+
+    reader->memory = (byte*)mem::ArenaPush(arena, desc.blockSize * (desc.blockCount + 1), TY_FILE_SECTOR_SIZE);
+    reader->stitch = reader->memory + desc.blockSize * desc.blockCount;
+    reader->blocks = (StreamBlock*)mem::ArenaPush(arena, desc.blockCount * sizeof(StreamBlock));
+    for(u32 i = 0; i < desc.blockCount; i++)
+    {
+        reader->blocks[i] = {};
+    }
+    InitializeSRWLock(&reader->lock);
+    InitializeConditionVariable(&reader->wakeReader);
+    InitializeConditionVariable(&reader->wakeConsumer);
+    reader->hThread = CreateThread(NULL, 0, StreamReaderThreadProc, reader, 0, NULL);
+    ASSERT(reader->hThread);
+    return reader;
+}
+
+void CloseStreamReader(StreamReader* reader)
+{
+    ASSERT(reader);
+    if(reader->hThread)
+    {
+        AcquireSRWLockExclusive(&reader->lock);
+        reader->quit = true;
+        WakeAllConditionVariable(&reader->wakeReader);
+        ReleaseSRWLockExclusive(&reader->lock);
+        WaitForSingleObject(reader->hThread, INFINITE);
+        CloseHandle(reader->hThread);
+        reader->hThread = NULL;
+    }
+    if(reader->hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(reader->hFile);
+        reader->hFile = INVALID_HANDLE_VALUE;
+    }
+}
+
+byte* WaitStreamBlock(StreamReader* reader, u64 index, u64* size)
+{
+    // Returns block data once the read-ahead thread has loaded it, NULL on read error.
+    u64 slot = index % reader->desc.blockCount;
+    StreamBlock& block = reader->blocks[slot];
+    AcquireSRWLockExclusive(&reader->lock);
+    while(!(block.index == index && block.ready) && !reader->failed)
+    {
+        SleepConditionVariableSRW(&reader->wakeConsumer, &reader->lock, INFINITE, 0);
+    }
+    bool ready = block.index == index && block.ready;
+    *size = block.size;
+    ReleaseSRWLockExclusive(&reader->lock);
+    return ready ? reader->memory + slot * reader->desc.blockSize : NULL;
+}
+
+void SetStreamWindow(StreamReader* reader)
+{
+    u64 windowStart = reader->position / reader->desc.blockSize;
+    if(windowStart == reader->windowStart) return;
+    AcquireSRWLockExclusive(&reader->lock);
+    reader->windowStart = windowStart;
+    WakeConditionVariable(&reader->wakeReader);
+    ReleaseSRWLockExclusive(&reader->lock);
+}
+
+u64 Peek(StreamReader* reader, u64 size, byte** out)
+{
+    ASSERT(reader && out);
+    ASSERT(size <= reader->desc.blockSize);
+    *out = NULL;
+    size = MIN(size, reader->size - MIN(reader->position, reader->size));
+    if(!size) return 0;
+    if(reader->mapped)
+    {
+        *out = reader->mapped + reader->position;
+        return size;
+    }
+
+    u64 blockSize = reader->desc.blockSize;
+    u64 index = reader->position / blockSize;
+    u64 blockOffset = reader->position % blockSize;
+    u64 firstSize = 0;
+    byte* first = WaitStreamBlock(reader, index, &firstSize);
+    if(!first || blockOffset >= firstSize) return 0;
+    if(blockOffset + size <= firstSize)
+    {
+        *out = first + blockOffset;
+        return size;
+    }
+
+    // Window crosses into the next block, stitch both parts together.
+    u64 headSize = firstSize - blockOffset;
+    memcpy(reader->stitch, first + blockOffset, headSize);
+    u64 secondSize = 0;
+    byte* second = WaitStreamBlock(reader, index + 1, &secondSize);
+    u64 tailSize = second ? MIN(size - headSize, secondSize) : 0;
+    if(tailSize) memcpy(reader->stitch + headSize, second, tailSize);
+    *out = reader->stitch;
+    return headSize + tailSize;
+}
+
+void Consume(StreamReader* reader, u64 size)
+{
+    ASSERT(reader);
+    reader->position = MIN(reader->position + size, reader->size);
+    if(!reader->mapped) SetStreamWindow(reader);
+}
+
+u64 Read(StreamReader* reader, void* output, u64 size)
+{
+    ASSERT(reader);
+    byte* cursor = (byte*)output;
+    u64 result = 0;
+    while(size)
+    {
+        // Windows up to the end of the current block, so nothing needs stitching.
+        u64 blockRemaining = reader->desc.blockSize - reader->position % reader->desc.blockSize;
+        byte* window = NULL;
+        u64 windowSize = Peek(reader, MIN(size, blockRemaining), &window);
+        if(!windowSize) break;
+        memcpy(cursor, window, windowSize);
+        Consume(reader, windowSize);
+        cursor += windowSize;
+        size -= windowSize;
+        result += windowSize;
+    }
+    return result;
+}
+
+void Seek(StreamReader* reader, u64 offset)
+{
+    ASSERT(reader);
+    reader->position = MIN(offset, reader->size);
+    if(!reader->mapped) SetStreamWindow(reader);
+}
+
 };
 };
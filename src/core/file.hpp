@@ -20,15 +20,191 @@ String PathExt(String path);
 String PathNoExt(String path);
 String PathFileName(String path, bool extension = false);
 String PathFileDir(String path);
+String PathCanonical(mem::Arena* arena, String path);   // Absolute, lowercase, '/' separators. For comparing paths.
 
 u64 GetFileSize(String path);
-SArray<String> GetFilesInDir(mem::Arena* arena, String dirPath);
+SArray<String> GetFilesInDir(mem::Arena* arena, String dirPath);     // Files only, non-recursive, up to 16k.
+
+// ========================================================
+// [DIRECTORY WALK]
+// Recursive directory enumeration. Subdirectories are enumerated in parallel on the async workers.
+// Optionally uses a persistent DirCache: directories whose last write time did not change since
+// the previous scan reuse their cached listing, so a rescan of an unchanged tree only stats
+// directories. File edits that don't touch the directory's write time are NOT detected through
+// the cache (only additions, removals and renames are).
+
+struct DirEntry
+{
+    String path;
+    u64 size = 0;
+    u64 mtime = 0;      // Last write time (FILETIME, 100ns ticks since 1601).
+};
+
+struct DirCacheDir
+{
+    String path;
+    u64 mtime = 0;
+    u32 fileStart = 0;
+    u32 fileCount = 0;
+    u32 subdirStart = 0;
+    u32 subdirCount = 0;
+};
+
+struct DirCacheFile
+{
+    String name;
+    u64 size = 0;
+    u64 mtime = 0;
+};
+
+struct DirCache
+{
+    mem::Arena* arena = NULL;
+    SArray<DirCacheDir> dirs;
+    SArray<DirCacheFile> files;
+    SArray<String> subdirs;
+    HashMap<String, u32> dirLookup;
+    u64 maxDirs = 0;
+    u64 maxFiles = 0;
+};
+
+DirCache*   MakeDirCache(u64 arenaSize, u64 maxDirs = 1 << 16, u64 maxFiles = 1 << 20);
+void        DestroyDirCache(DirCache* cache);
+void        ClearDirCache(DirCache* cache);
+bool        LoadDirCache(DirCache* cache, String path);
+bool        SaveDirCache(DirCache* cache, String path);
+
+struct DirWalkOptions
+{
+    bool recursive = true;
+    bool parallel = true;
+    bool sorted = true;             // Sort results by path (enumeration order is not deterministic).
+    bool includeDirs = false;       // Also output directories as entries (size 0).
+    String* extensions = NULL;      // Case-insensitive extension filter (e.g. ".png"), any match passes.
+    u32 extensionCount = 0;
+    String glob;                    // Filename glob filter ('*' and '?'), applied to the file name only.
+    DirCache* cache = NULL;         // Read and updated by the walk when set.
+    u64 maxEntries = 1 << 20;       // Capacity of temp storage for results during the walk, 32MB by default.
+    u64 maxDirs = 1 << 16;          // Pending directories, only reserved for recursive walks.
+};
+
+SArray<DirEntry> WalkDir(mem::Arena* arena, String dirPath, DirWalkOptions options = {});
+SArray<String> GetPaths(mem::Arena* arena, SArray<DirEntry> entries);
+bool MatchGlob(String s, String pattern);
 
 u64     ReadFile(String path, byte* output);
 String  ReadFileToString(mem::Arena* arena, String path);
 byte*   ReadFileToBuffer(mem::Arena* arena, String path, u64* size = NULL);
 
-// TODO(caio): Implement file writing
+// ========================================================
+// [FILE WRITING]
+// Buffered file writer. Small writes are accumulated in a large sector-aligned buffer and
+// issued as positional writes. Writes bigger than the buffer bypass it.
+// Atomic writers write to "<path>.tmp" and rename it over the target on close, so readers
+// never observe a partially written file.
+#define TY_FILE_SECTOR_SIZE KB(4)
+
+enum FileSyncPolicy
+{
+    FILE_SYNC_NONE,         // Leave flushing to disk to the OS.
+    FILE_SYNC_ON_CLOSE,     // Flush to disk once, when closing.
+    FILE_SYNC_ON_FLUSH,     // Flush to disk every time the write buffer is flushed.
+};
+
+struct FileWriterDesc
+{
+    u64 bufferSize = MB(1);                 // Rounded up to TY_FILE_SECTOR_SIZE.
+    FileSyncPolicy sync = FILE_SYNC_NONE;
+    bool atomic = false;                    // Always synced to disk before the rename.
+    bool unbuffered = false;                // Bypass OS file cache (FILE_FLAG_NO_BUFFERING), for big blobs.
+};
+
+struct FileWriter
+{
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    String path;
+    String writePath;       // Same as path, or temp path for atomic writers.
+    FileWriterDesc desc;
+
+    byte* buffer = NULL;
+    u64 bufferUsed = 0;
+    u64 fileOffset = 0;     // Offset of the next write issued to the file.
+    u64 size = 0;           // Total bytes written through the writer.
+    bool failed = false;
+
+    bool IsValid() { return hFile != INVALID_HANDLE_VALUE && !failed; }
+};
+
+struct FileSlice
+{
+    const void* data = NULL;
+    u64 size = 0;
+};
+
+FileWriter  MakeFileWriter(mem::Arena* arena, String path, FileWriterDesc desc = {});
+void        Write(FileWriter* writer, const void* data, u64 size);
+void        WriteV(FileWriter* writer, FileSlice* slices, u64 count);
+void        FlushFileWriter(FileWriter* writer);
+bool        CloseFileWriter(FileWriter* writer);    // Returns false if any write failed (target is left untouched when atomic).
+void        AbortFileWriter(FileWriter* writer);    // Discards an atomic write, leaves the target untouched.
+
+bool WriteFile(String path, const void* data, u64 size, bool atomic = false);
+
+// ========================================================
+// [FILE STREAMING]
+// Sequential reader for files too big to load at once. A background thread reads ahead
+// fixed-size blocks into a ring of buffers while the caller parses the current one, so
+// memory use is constant (blockSize * (blockCount + 1)) regardless of file size.
+// Peek returns a contiguous window starting at the current position. Windows that
+// straddle two blocks are stitched into a separate buffer.
+// Uncompressed entries in mounted packs are served directly from the pack mapping.
+struct StreamReaderDesc
+{
+    u64 blockSize = MB(4);      // Rounded up to TY_FILE_SECTOR_SIZE. Max Peek size.
+    u32 blockCount = 3;         // Blocks in flight, at least 2.
+    bool unbuffered = false;    // Bypass OS file cache (FILE_FLAG_NO_BUFFERING), for one-pass reads of huge files.
+};
+
+struct StreamBlock
+{
+    u64 index = MAX_U64;        // Block index in file (offset / blockSize), MAX_U64 if empty.
+    u64 size = 0;
+    bool ready = false;
+};
+
+struct StreamReader
+{
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    HANDLE hThread = NULL;
+    StreamReaderDesc desc;
+    u64 size = 0;               // File size
+    u64 position = 0;
+    bool failed = false;
+    byte* mapped = NULL;        // Set when reading from a pack mapping instead of disk.
+
+    byte* memory = NULL;        // blockCount blocks + stitch buffer
+    StreamBlock* blocks = NULL;
+    byte* stitch = NULL;
+
+    // Shared with read-ahead thread
+    SRWLOCK lock;
+    CONDITION_VARIABLE wakeReader;
+    CONDITION_VARIABLE wakeConsumer;
+    u64 windowStart = 0;        // First block the thread may read (block of current position).
+    bool quit = false;
+};
+
+// Returns NULL if the file can't be opened. Must be closed with CloseStreamReader.
+StreamReader*   MakeStreamReader(mem::Arena* arena, String path, StreamReaderDesc desc = {});
+void            CloseStreamReader(StreamReader* reader);
+// Sets *out to a window of up to size (<= blockSize) bytes at the current position. Returns
+// the window size, which is only smaller than size at end of file or on read error.
+// The window is valid until the next call on the reader.
+u64             Peek(StreamReader* reader, u64 size, byte** out);
+void            Consume(StreamReader* reader, u64 size);
+u64             Read(StreamReader* reader, void* output, u64 size);     // Peek + copy + Consume, any size.
+void            Seek(StreamReader* reader, u64 offset);
+inline bool     IsEndOfStream(StreamReader* reader) { return reader->position >= reader->size; }
 
 };
 };
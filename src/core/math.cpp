@@ -138,8 +138,8 @@ v2i operator-(v2i a, v2i b)
     };
 }
 
-v4f v3f::AsDirection() { return { x, y, z, 0 }; }
-v4f v3f::AsPosition() { return { x, y, z, 1 }; }
+v4f v3f::AsDirection() const { return { x, y, z, 0 }; }
+v4f v3f::AsPosition() const { return { x, y, z, 1 }; }
 
 bool operator==(v3f a, v3f b)
 {
@@ -243,7 +243,7 @@ v3f Normalize(v3f v)
     return v * (1.f/l);
 }
 
-v3f v4f::AsXYZ() { return { x, y, z }; }
+v3f v4f::AsXYZ() const { return { x, y, z }; }
 
 bool operator==(v4f a, v4f b)
 {
@@ -472,7 +472,7 @@ m4f operator-(m4f a, m4f b)
     };
 }
 
-m4f operator*(m4f a, m4f b)
+m4f MulScalar(const m4f& a, const m4f& b)
 {
     return
     {
@@ -502,6 +502,49 @@ m4f operator*(m4f a, m4f b)
     };
 }
 
+#if TY_SIMD_SCALAR
+m4f operator*(const m4f& a, const m4f& b)
+{
+    return MulScalar(a, b);
+}
+
+#else
+// Row i of a product is the sum of the rows of b scaled by a[i][k]: broadcast and multiply-add.
+// Terms are added in the same order as the scalar version.
+inline simd::f32x4 MulRow(simd::f32x4 row, const simd::f32x4* b)
+{
+    simd::f32x4 result = simd::Mul(simd::Splat<0>(row), b[0]);
+    result = simd::MulAdd(simd::Splat<1>(row), b[1], result);
+    result = simd::MulAdd(simd::Splat<2>(row), b[2], result);
+    return simd::MulAdd(simd::Splat<3>(row), b[3], result);
+}
+
+// Dot product of each row with v, as one vector.
+inline simd::f32x4 MulVec(const simd::f32x4* rows, simd::f32x4 v)
+{
+    simd::f32x4 p0 = simd::Mul(rows[0], v);
+    simd::f32x4 p1 = simd::Mul(rows[1], v);
+    simd::f32x4 p2 = simd::Mul(rows[2], v);
+    simd::f32x4 p3 = simd::Mul(rows[3], v);
+    simd::Transpose4(p0, p1, p2, p3);
+    return simd::Add(simd::Add(simd::Add(p0, p1), p2), p3);
+}
+
+m4f operator*(const m4f& a, const m4f& b)
+{
+    simd::f32x4 rowsB[4] =
+    {
+        simd::Load(b.data + 0), simd::Load(b.data + 4), simd::Load(b.data + 8), simd::Load(b.data + 12),
+    };
+    m4f result;
+    for(u32 i = 0; i < 4; i++)
+    {
+        simd::Store(result.data + i * 4, MulRow(simd::Load(a.data + i * 4), rowsB));
+    }
+    return result;
+}
+
+#endif
 m4f operator*(f32 b, m4f a)
 {
     return
@@ -513,7 +556,7 @@ m4f operator*(f32 b, m4f a)
     };
 }
 
-v4f operator*(m4f a, v4f v)
+v4f MulScalar(const m4f& a, v4f v)
 {
     return
     {
@@ -524,6 +567,63 @@ v4f operator*(m4f a, v4f v)
     };
 }
 
+#if TY_SIMD_SCALAR
+v4f operator*(const m4f& a, v4f v)
+{
+    return MulScalar(a, v);
+}
+
+void MulAligned(m4f* result, const m4f* a, const m4f* b)
+{
+    *result = *a * *b;
+}
+
+void MulAligned(v4f* result, const m4f* a, const v4f* v)
+{
+    *result = *a * *v;
+}
+
+#else
+v4f operator*(const m4f& a, v4f v)
+{
+    simd::f32x4 rows[4] =
+    {
+        simd::Load(a.data + 0), simd::Load(a.data + 4), simd::Load(a.data + 8), simd::Load(a.data + 12),
+    };
+    v4f result;
+    simd::Store(result.data, MulVec(rows, simd::Load(v.data)));
+    return result;
+}
+
+void MulAligned(m4f* result, const m4f* a, const m4f* b)
+{
+    simd::f32x4 rowsB[4] =
+    {
+        simd::LoadAligned(b->data + 0), simd::LoadAligned(b->data + 4),
+        simd::LoadAligned(b->data + 8), simd::LoadAligned(b->data + 12),
+    };
+    simd::f32x4 rowsA[4] =
+    {
+        simd::LoadAligned(a->data + 0), simd::LoadAligned(a->data + 4),
+        simd::LoadAligned(a->data + 8), simd::LoadAligned(a->data + 12),
+    };
+    for(u32 i = 0; i < 4; i++)
+    {
+        simd::StoreAligned(result->data + i * 4, MulRow(rowsA[i], rowsB));
+    }
+}
+
+void MulAligned(v4f* result, const m4f* a, const v4f* v)
+{
+    simd::f32x4 rows[4] =
+    {
+        simd::LoadAligned(a->data + 0), simd::LoadAligned(a->data + 4),
+        simd::LoadAligned(a->data + 8), simd::LoadAligned(a->data + 12),
+    };
+    simd::StoreAligned(result->data, MulVec(rows, simd::LoadAligned(v->data)));
+}
+
+#endif
 f32 Determinant(m4f m)
 {
     return
@@ -541,7 +641,7 @@ f32 Determinant(m4f m)
         m.m01 * m.m10 * m.m22 * m.m33 + m.m00 * m.m11 * m.m22 * m.m33;
 }
 
-m4f Transpose(m4f m)
+m4f TransposeScalar(const m4f& m)
 {
     return
     {
@@ -552,7 +652,30 @@ m4f Transpose(m4f m)
     };
 }
 
-m4f Inverse(m4f m)
+#if TY_SIMD_SCALAR
+m4f Transpose(const m4f& m)
+{
+    return TransposeScalar(m);
+}
+
+#else
+m4f Transpose(const m4f& m)
+{
+    simd::f32x4 r0 = simd::Load(m.data + 0);
+    simd::f32x4 r1 = simd::Load(m.data + 4);
+    simd::f32x4 r2 = simd::Load(m.data + 8);
+    simd::f32x4 r3 = simd::Load(m.data + 12);
+    simd::Transpose4(r0, r1, r2, r3);
+    m4f result;
+    simd::Store(result.data + 0, r0);
+    simd::Store(result.data + 4, r1);
+    simd::Store(result.data + 8, r2);
+    simd::Store(result.data + 12, r3);
+    return result;
+}
+
+#endif
+m4f InverseScalar(const m4f& m)
 {
     f32 A2323 = m.m22 * m.m33 - m.m23 * m.m32;
     f32 A1323 = m.m21 * m.m33 - m.m23 * m.m31;
@@ -600,6 +723,73 @@ m4f Inverse(m4f m)
     };
 }
 
+#if TY_SIMD_SCALAR
+m4f Inverse(const m4f& m)
+{
+    return InverseScalar(m);
+}
+
+#else
+// Same cofactors as the scalar version, one result row per vector. Lanes of a minor vector
+// hold the 2x2 determinants of one column pair over rows (2, 3), (2, 3), (1, 3) and (1, 2),
+// and are scaled by entries of rows 1, 0, 0 and 0. Products and sums are done in the scalar
+// version's order, so both round the same.
+inline simd::f32x4 Minors(const simd::f32x4* lo, const simd::f32x4* hi, u32 c0, u32 c1)
+{
+    return simd::Sub(simd::Mul(lo[c0], hi[c1]), simd::Mul(lo[c1], hi[c0]));
+}
+
+inline simd::f32x4 Cofactors(simd::f32x4 a, simd::f32x4 p, simd::f32x4 b, simd::f32x4 q, simd::f32x4 c, simd::f32x4 r)
+{
+    return simd::Add(simd::Sub(simd::Mul(a, p), simd::Mul(b, q)), simd::Mul(c, r));
+}
+
+m4f Inverse(const m4f& m)
+{
+    simd::f32x4 col[4] =
+    {
+        simd::Load(m.data + 0), simd::Load(m.data + 4), simd::Load(m.data + 8), simd::Load(m.data + 12),
+    };
+    simd::Transpose4(col[0], col[1], col[2], col[3]);
+
+    // Rows of each minor per lane, and factors (m1c, m0c, m0c, m0c).
+    simd::f32x4 lo[4];
+    simd::f32x4 hi[4];
+    simd::f32x4 factor[4];
+    for(u32 c = 0; c < 4; c++)
+    {
+        lo[c] = simd::Swizzle<2, 2, 1, 1>(col[c]);
+        hi[c] = simd::Swizzle<3, 3, 3, 2>(col[c]);
+        factor[c] = simd::Swizzle<1, 0, 0, 0>(col[c]);
+    }
+    simd::f32x4 minors23 = Minors(lo, hi, 2, 3);
+    simd::f32x4 minors13 = Minors(lo, hi, 1, 3);
+    simd::f32x4 minors12 = Minors(lo, hi, 1, 2);
+    simd::f32x4 minors03 = Minors(lo, hi, 0, 3);
+    simd::f32x4 minors02 = Minors(lo, hi, 0, 2);
+    simd::f32x4 minors01 = Minors(lo, hi, 0, 1);
+
+    simd::f32x4 r0 = Cofactors(factor[1], minors23, factor[2], minors13, factor[3], minors12);
+    simd::f32x4 r1 = Cofactors(factor[0], minors23, factor[2], minors03, factor[3], minors02);
+    simd::f32x4 r2 = Cofactors(factor[0], minors13, factor[1], minors03, factor[3], minors01);
+    simd::f32x4 r3 = Cofactors(factor[0], minors12, factor[1], minors02, factor[2], minors01);
+
+    f32 det = m.m00 * simd::GetLane<0>(r0) - m.m01 * simd::GetLane<0>(r1)
+        + m.m02 * simd::GetLane<0>(r2) - m.m03 * simd::GetLane<0>(r3);
+    det = 1 / det;
+
+    // Cofactor signs folded into the reciprocal, negating is exact.
+    simd::f32x4 even = simd::Set(det, -det, det, -det);
+    simd::f32x4 odd = simd::Set(-det, det, -det, det);
+    m4f result;
+    simd::Store(result.data + 0, simd::Mul(r0, even));
+    simd::Store(result.data + 4, simd::Mul(r1, odd));
+    simd::Store(result.data + 8, simd::Mul(r2, even));
+    simd::Store(result.data + 12, simd::Mul(r3, odd));
+    return result;
+}
+
+#endif
 m4f Identity()
 {
     return
@@ -694,14 +884,14 @@ m4f TranslationMatrix(v3f move)
     };
 };
 
-v3f TransformPosition(v3f position, m4f transform)
+v3f TransformPosition(v3f position, const m4f& transform)
 {
     v4f v = position.AsPosition();
     v = transform * v;
     return v.AsXYZ();
 }
 
-v3f TransformDirection(v3f direction, m4f transform)
+v3f TransformDirection(v3f direction, const m4f& transform)
 {
     v4f v = direction.AsDirection();
     v = transform * v;
@@ -736,9 +926,9 @@ m4f OrthoRH(f32 l, f32 r, f32 b, f32 t, f32 n, f32 f)
     result.m11 = 2.f / (t - b);
     result.m11 = -result.m11;   // VK
     result.m22 = -1.f / (f - n);
-    result.m30 = - (r + l) / (r - l);
-    result.m31 = - (t + b) / (t - b);
-    result.m32 = - n / (f - n);
+    result.m03 = - (r + l) / (r - l);
+    result.m13 = (t + b) / (t - b); // VK, flipped along with m11
+    result.m23 = - n / (f - n);
     result.m33 = 1;
 
     return result;
@@ -759,6 +949,200 @@ m4f PerspectiveRH(f32 fov, f32 aspect, f32 zNear, f32 zFar)
     return result;
 }
 
+#if TY_SIMD_SCALAR
+affine3x4 operator*(const affine3x4& a, const affine3x4& b)
+{
+    return
+    {
+        // Row 0
+        a.m00 * b.m00 + a.m01 * b.m10 + a.m02 * b.m20,
+        a.m00 * b.m01 + a.m01 * b.m11 + a.m02 * b.m21,
+        a.m00 * b.m02 + a.m01 * b.m12 + a.m02 * b.m22,
+        a.m00 * b.m03 + a.m01 * b.m13 + a.m02 * b.m23 + a.m03,
+
+        // Row 1
+        a.m10 * b.m00 + a.m11 * b.m10 + a.m12 * b.m20,
+        a.m10 * b.m01 + a.m11 * b.m11 + a.m12 * b.m21,
+        a.m10 * b.m02 + a.m11 * b.m12 + a.m12 * b.m22,
+        a.m10 * b.m03 + a.m11 * b.m13 + a.m12 * b.m23 + a.m13,
+
+        // Row 2
+        a.m20 * b.m00 + a.m21 * b.m10 + a.m22 * b.m20,
+        a.m20 * b.m01 + a.m21 * b.m11 + a.m22 * b.m21,
+        a.m20 * b.m02 + a.m21 * b.m12 + a.m22 * b.m22,
+        a.m20 * b.m03 + a.m21 * b.m13 + a.m22 * b.m23 + a.m23,
+    };
+}
+
+#else
+affine3x4 operator*(const affine3x4& a, const affine3x4& b)
+{
+    // The implicit last row of b only adds a's translation.
+    simd::f32x4 rowsB[4] =
+    {
+        simd::Load(b.data + 0), simd::Load(b.data + 4), simd::Load(b.data + 8), simd::Set(0, 0, 0, 1),
+    };
+    affine3x4 result;
+    for(u32 i = 0; i < 3; i++)
+    {
+        simd::Store(result.data + i * 4, MulRow(simd::Load(a.data + i * 4), rowsB));
+    }
+    return result;
+}
+
+#endif
+affine3x4 IdentityAffine()
+{
+    return
+    {
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+    };
+}
+
+affine3x4 ToAffine(const m4f& m)
+{
+    affine3x4 result;
+    memcpy(result.data, m.data, sizeof(result.data));
+    return result;
+}
+
+affine3x4 ToAffine(trs t)
+{
+    m4f r = RotationMatrix(t.rotation);
+    return
+    {
+        r.m00 * t.scale.x, r.m01 * t.scale.y, r.m02 * t.scale.z, t.translation.x,
+        r.m10 * t.scale.x, r.m11 * t.scale.y, r.m12 * t.scale.z, t.translation.y,
+        r.m20 * t.scale.x, r.m21 * t.scale.y, r.m22 * t.scale.z, t.translation.z,
+    };
+}
+
+m4f ToMatrix(const affine3x4& a)
+{
+    m4f result;
+    memcpy(result.data, a.data, sizeof(a.data));
+    result.m30 = 0;
+    result.m31 = 0;
+    result.m32 = 0;
+    result.m33 = 1;
+    return result;
+}
+
+trs ToTRS(const affine3x4& a)
+{
+    v3f c0 = {a.m00, a.m10, a.m20};
+    v3f c1 = {a.m01, a.m11, a.m21};
+    v3f c2 = {a.m02, a.m12, a.m22};
+
+    trs result;
+    result.translation = {a.m03, a.m13, a.m23};
+    result.scale = {Len(c0), Len(c1), Len(c2)};
+    if(Dot(c0, Cross(c1, c2)) < 0) result.scale.x = -result.scale.x;
+    c0 = (1.f / result.scale.x) * c0;
+    c1 = (1.f / result.scale.y) * c1;
+    c2 = (1.f / result.scale.z) * c2;
+
+    // Shepperd's method: start from the largest of w, x, y and z, so the square root never
+    // gets close to zero.
+    // https://www.euclideanspace.com/maths/geometry/rotations/conversions/matrixToQuaternion/
+    f32 trace = c0.x + c1.y + c2.z;
+    quat q;
+    if(trace > 0)
+    {
+        f32 s = sqrtf(trace + 1) * 2;
+        q = { (c1.z - c2.y) / s, (c2.x - c0.z) / s, (c0.y - c1.x) / s, 0.25f * s };
+    }
+    else if(c0.x > c1.y && c0.x > c2.z)
+    {
+        f32 s = sqrtf(1 + c0.x - c1.y - c2.z) * 2;
+        q = { 0.25f * s, (c1.x + c0.y) / s, (c2.x + c0.z) / s, (c1.z - c2.y) / s };
+    }
+    else if(c1.y > c2.z)
+    {
+        f32 s = sqrtf(1 + c1.y - c0.x - c2.z) * 2;
+        q = { (c1.x + c0.y) / s, 0.25f * s, (c2.y + c1.z) / s, (c2.x - c0.z) / s };
+    }
+    else
+    {
+        f32 s = sqrtf(1 + c2.z - c0.x - c1.y) * 2;
+        q = { (c2.x + c0.z) / s, (c2.y + c1.z) / s, 0.25f * s, (c0.y - c1.x) / s };
+    }
+    result.rotation = Normalize(q);
+    return result;
+}
+
+// Inverse of [A | t] is [A' | -A't], A' being the inverse of the 3x3 part.
+inline affine3x4 InverseFromLinear(const affine3x4& a, affine3x4 result)
+{
+    result.m03 = -(result.m00 * a.m03 + result.m01 * a.m13 + result.m02 * a.m23);
+    result.m13 = -(result.m10 * a.m03 + result.m11 * a.m13 + result.m12 * a.m23);
+    result.m23 = -(result.m20 * a.m03 + result.m21 * a.m13 + result.m22 * a.m23);
+    return result;
+}
+
+affine3x4 InverseRigid(const affine3x4& a)
+{
+    return InverseFromLinear(a,
+    {
+        a.m00, a.m10, a.m20, 0,
+        a.m01, a.m11, a.m21, 0,
+        a.m02, a.m12, a.m22, 0,
+    });
+}
+
+affine3x4 InverseScaled(const affine3x4& a)
+{
+    // A = R * S, so A' = S' * R^T: row i is column i of A divided by its squared length.
+    f32 s0 = 1.f / (a.m00 * a.m00 + a.m10 * a.m10 + a.m20 * a.m20);
+    f32 s1 = 1.f / (a.m01 * a.m01 + a.m11 * a.m11 + a.m21 * a.m21);
+    f32 s2 = 1.f / (a.m02 * a.m02 + a.m12 * a.m12 + a.m22 * a.m22);
+    return InverseFromLinear(a,
+    {
+        a.m00 * s0, a.m10 * s0, a.m20 * s0, 0,
+        a.m01 * s1, a.m11 * s1, a.m21 * s1, 0,
+        a.m02 * s2, a.m12 * s2, a.m22 * s2, 0,
+    });
+}
+
+affine3x4 Inverse(const affine3x4& a)
+{
+    // Adjugate over determinant.
+    f32 c00 = a.m11 * a.m22 - a.m12 * a.m21;
+    f32 c10 = a.m12 * a.m20 - a.m10 * a.m22;
+    f32 c20 = a.m10 * a.m21 - a.m11 * a.m20;
+    f32 det = 1.f / (a.m00 * c00 + a.m01 * c10 + a.m02 * c20);
+    return InverseFromLinear(a,
+    {
+        det * c00, det * (a.m02 * a.m21 - a.m01 * a.m22), det * (a.m01 * a.m12 - a.m02 * a.m11), 0,
+        det * c10, det * (a.m00 * a.m22 - a.m02 * a.m20), det * (a.m02 * a.m10 - a.m00 * a.m12), 0,
+        det * c20, det * (a.m01 * a.m20 - a.m00 * a.m21), det * (a.m00 * a.m11 - a.m01 * a.m10), 0,
+    });
+}
+
+v3f TransformPosition(v3f position, const affine3x4& transform)
+{
+    const affine3x4& m = transform;
+    return
+    {
+        m.m00 * position.x + m.m01 * position.y + m.m02 * position.z + m.m03,
+        m.m10 * position.x + m.m11 * position.y + m.m12 * position.z + m.m13,
+        m.m20 * position.x + m.m21 * position.y + m.m22 * position.z + m.m23,
+    };
+}
+
+v3f TransformDirection(v3f direction, const affine3x4& transform)
+{
+    const affine3x4& m = transform;
+    return
+    {
+        m.m00 * direction.x + m.m01 * direction.y + m.m02 * direction.z,
+        m.m10 * direction.x + m.m11 * direction.y + m.m12 * direction.z,
+        m.m20 * direction.x + m.m21 * direction.y + m.m22 * direction.z,
+    };
+}
+
 f32 Lerp(f32 a, f32 b, f32 t)
 {
     return a + (b - a) * CLAMP(t, 0, 1);
@@ -783,101 +1167,429 @@ v3f Lerp(v3f a, v3f b, f32 t)
     };
 }
 
-u64 RandomU64()
+inline u64 RotateLeft(u64 x, u32 k)
 {
-    // Xorshift*64
-    static u64 x = __rdtsc();   // TODO(caio)#THREAD: This shouldn't be static when doing multithreading!
-    x ^= x >> 12;
-    x ^= x << 25;
-    x ^= x >> 27;
-    return x * 0x2545F4914F6CDD1DULL;
+    return (x << k) | (x >> (64 - k));
 }
 
-f32 RandomUniformF32()
+inline u64 SplitMix64(u64* x)
 {
-    return (f32)RandomU64()/(f32)MAX_U64;
+    u64 z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
 }
 
-f32 RandomUniformF32(f32 start, f32 end)
+inline u64 NextXoshiro(u64& s0, u64& s1, u64& s2, u64& s3)
 {
-    return start + RandomUniformF32() * (end - start);
+    u64 result = RotateLeft(s0 + s3, 23) + s0;
+    u64 t = s1 << 17;
+    s2 ^= s0;
+    s3 ^= s1;
+    s1 ^= s2;
+    s0 ^= s3;
+    s2 ^= t;
+    s3 = RotateLeft(s3, 45);
+    return result;
 }
 
-i32 RandomUniformI32(i32 start, i32 end)
+Rng MakeRng(u64 seed)
 {
-    // Random int between start (inclusive) and end (inclusive)
-    return start + RandomUniformF32() * (end + 1 - start);
+    Rng result;
+    for(u32 i = 0; i < 4; i++)
+    {
+        result.state[i] = SplitMix64(&seed);
+    }
+    return result;
 }
 
-v3f RandomUniformV3F()
+// Jumps are polynomials applied to the state: it's the xor of the states passed through at
+// the set bits of the polynomial.
+void JumpPolynomial(Rng* rng, const u64* polynomial)
+{
+    u64 s[4] = {};
+    for(u32 i = 0; i < 4; i++)
+    {
+        for(u32 bit = 0; bit < 64; bit++)
+        {
+            if(polynomial[i] & (1ULL << bit))
+            {
+                for(u32 j = 0; j < 4; j++)
+                {
+                    s[j] ^= rng->state[j];
+                }
+            }
+            RandomU64(rng);
+        }
+    }
+    for(u32 i = 0; i < 4; i++)
+    {
+        rng->state[i] = s[i];
+    }
+}
+
+void Jump(Rng* rng)
+{
+    static const u64 polynomial[] = { 0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL, 0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL };
+    JumpPolynomial(rng, polynomial);
+}
+
+void LongJump(Rng* rng)
+{
+    static const u64 polynomial[] = { 0x76E15D3EFEFDCBBFULL, 0xC5004E441C522FB3ULL, 0x77710069854EE241ULL, 0x39109BB02ACBE635ULL };
+    JumpPolynomial(rng, polynomial);
+}
+
+static thread_local Rng threadRng;
+static thread_local bool threadRngSeeded = false;
+
+Rng* GetThreadRng()
+{
+    if(!threadRngSeeded)
+    {
+        // Threads starting on the same tick still differ by the address of their state.
+        threadRng = MakeRng(__rdtsc() ^ (u64)&threadRng);
+        threadRngSeeded = true;
+    }
+    return &threadRng;
+}
+
+void SeedRandom(u64 seed)
+{
+    threadRng = MakeRng(seed);
+    threadRngSeeded = true;
+}
+
+u64 RandomU64(Rng* rng)
+{
+    return NextXoshiro(rng->state[0], rng->state[1], rng->state[2], rng->state[3]);
+}
+
+u32 RandomU32(Rng* rng)
+{
+    return (u32)(RandomU64(rng) >> 32);
+}
+
+// The high half of random * bound is in [0, bound). It's biased only when the low half falls
+// below 2^32 mod bound, which is rare and checked without dividing first.
+u32 RandomBoundedU32(Rng* rng, u32 bound)
+{
+    u64 m = (u64)RandomU32(rng) * bound;
+    if((u32)m < bound)
+    {
+        u32 threshold = (0 - bound) % bound;
+        while((u32)m < threshold)
+        {
+            m = (u64)RandomU32(rng) * bound;
+        }
+    }
+    return (u32)(m >> 32);
+}
+
+// 24 random bits, every float in [0, 1) that can be reached is equally likely. Converted as
+// i32, which SSE and AVX2 have instructions for (u32 needs AVX-512), so fill loops vectorize.
+inline f32 ToUniformF32(u32 bits)
+{
+    return (f32)(i32)(bits >> 8) * (1.f / 16777216.f);
+}
+
+f32 RandomUniformF32(Rng* rng)
+{
+    return ToUniformF32(RandomU32(rng));
+}
+
+f32 RandomUniformF32(Rng* rng, f32 start, f32 end)
+{
+    return start + RandomUniformF32(rng) * (end - start);
+}
+
+i32 RandomUniformI32(Rng* rng, i32 start, i32 end)
+{
+    ASSERT(start <= end);
+    u32 range = (u32)end - (u32)start + 1;      // 0 for the whole i32 range.
+    u32 offset = range ? RandomBoundedU32(rng, range) : RandomU32(rng);
+    return (i32)((u32)start + offset);
+}
+
+v3f RandomUniformV3F(Rng* rng)
 {
     return
     {
-        RandomUniformF32(),
-        RandomUniformF32(),
-        RandomUniformF32()
+        RandomUniformF32(rng),
+        RandomUniformF32(rng),
+        RandomUniformF32(rng)
     };
 }
 
-v3f RandomUniformV3F(f32 start, f32 end)
+v3f RandomUniformV3F(Rng* rng, f32 start, f32 end)
 {
     return
     {
-        RandomUniformF32(start, end),
-        RandomUniformF32(start, end),
-        RandomUniformF32(start, end)
+        RandomUniformF32(rng, start, end),
+        RandomUniformF32(rng, start, end),
+        RandomUniformF32(rng, start, end)
     };
 }
 
-AABB TransformAABB(AABB aabb, m4f transform)
+// Four streams with their state words interleaved, word i of every lane is one 4-wide vector.
+struct RngLanes
 {
-    // TODO(caio): This performs a lot of calculations that could be optimized to less
-    // transforming, and no idea if this works for non uniform scaling.
-    // Verify if this works
+    u64 state[4][4];
+};
 
-    // Compute all 8 vertices of AABB
-    v4f aabbVertices[8] =
+RngLanes MakeRngLanes(Rng rng)
+{
+    RngLanes result;
+    for(u32 lane = 0; lane < 4; lane++)
     {
-        {aabb.min.x, aabb.min.y, aabb.min.z, 1.f},
-        {aabb.max.x, aabb.min.y, aabb.min.z, 1.f},
-        {aabb.min.x, aabb.max.y, aabb.min.z, 1.f},
-        {aabb.max.x, aabb.max.y, aabb.min.z, 1.f},
-        {aabb.min.x, aabb.min.y, aabb.max.z, 1.f},
-        {aabb.max.x, aabb.min.y, aabb.max.z, 1.f},
-        {aabb.min.x, aabb.max.y, aabb.max.z, 1.f},
-        {aabb.max.x, aabb.max.y, aabb.max.z, 1.f},
-    };
+        for(u32 i = 0; i < 4; i++)
+        {
+            result.state[i][lane] = rng.state[i];
+        }
+        LongJump(&rng);
+    }
+    return result;
+}
 
-    // Transform all vertices
-    v4f aabbTransformedVertices[8] =
+Rng GetLane(const RngLanes& lanes, u32 lane)
+{
+    Rng result;
+    for(u32 i = 0; i < 4; i++)
     {
-        transform * aabbVertices[0],
-        transform * aabbVertices[1],
-        transform * aabbVertices[2],
-        transform * aabbVertices[3],
-        transform * aabbVertices[4],
-        transform * aabbVertices[5],
-        transform * aabbVertices[6],
-        transform * aabbVertices[7],
-    };
+        result.state[i] = lanes.state[i][lane];
+    }
+    return result;
+}
 
-    // Find min/max of new vertices and create new AABB
-    AABB result = {};
-    result.min = aabbTransformedVertices[0].AsXYZ();
-    result.max = aabbTransformedVertices[0].AsXYZ();
-    for(u32 i = 1; i < 8; i++)
+// Each step writes the 4 lanes' numbers in lane order, as 8 u32s (low half first).
+void FillLaneSteps(RngLanes* lanes, u32* result, u64 steps)
+{
+#if TY_SIMD_AVX2
+    __m256i s0 = _mm256_loadu_si256((__m256i*)lanes->state[0]);
+    __m256i s1 = _mm256_loadu_si256((__m256i*)lanes->state[1]);
+    __m256i s2 = _mm256_loadu_si256((__m256i*)lanes->state[2]);
+    __m256i s3 = _mm256_loadu_si256((__m256i*)lanes->state[3]);
+    for(u64 i = 0; i < steps; i++)
+    {
+        __m256i sum = _mm256_add_epi64(s0, s3);
+        __m256i r = _mm256_add_epi64(_mm256_or_si256(_mm256_slli_epi64(sum, 23), _mm256_srli_epi64(sum, 41)), s0);
+        __m256i t = _mm256_slli_epi64(s1, 17);
+        s2 = _mm256_xor_si256(s2, s0);
+        s3 = _mm256_xor_si256(s3, s1);
+        s1 = _mm256_xor_si256(s1, s2);
+        s0 = _mm256_xor_si256(s0, s3);
+        s2 = _mm256_xor_si256(s2, t);
+        s3 = _mm256_or_si256(_mm256_slli_epi64(s3, 45), _mm256_srli_epi64(s3, 19));
+        _mm256_storeu_si256((__m256i*)(result + i * 8), r);
+    }
+    _mm256_storeu_si256((__m256i*)lanes->state[0], s0);
+    _mm256_storeu_si256((__m256i*)lanes->state[1], s1);
+    _mm256_storeu_si256((__m256i*)lanes->state[2], s2);
+    _mm256_storeu_si256((__m256i*)lanes->state[3], s3);
+#else
+    for(u64 i = 0; i < steps; i++)
     {
-        result.min.x = MIN(result.min.x, aabbTransformedVertices[i].x);
-        result.min.y = MIN(result.min.y, aabbTransformedVertices[i].y);
-        result.min.z = MIN(result.min.z, aabbTransformedVertices[i].z);
+        u64 r[4];
+        for(u32 lane = 0; lane < 4; lane++)
+        {
+            r[lane] = NextXoshiro(lanes->state[0][lane], lanes->state[1][lane], lanes->state[2][lane], lanes->state[3][lane]);
+        }
+        memcpy(result + i * 8, r, sizeof(r));
+    }
+#endif
+}
 
-        result.max.x = MAX(result.max.x, aabbTransformedVertices[i].x);
-        result.max.y = MAX(result.max.y, aabbTransformedVertices[i].y);
-        result.max.z = MAX(result.max.z, aabbTransformedVertices[i].z);
+void FillLanes(RngLanes* lanes, u32* result, u64 count)
+{
+    FillLaneSteps(lanes, result, count / 8);
+    if(count % 8)
+    {
+        u32 tail[8];
+        FillLaneSteps(lanes, tail, 1);
+        memcpy(result + count / 8 * 8, tail, (count % 8) * sizeof(u32));
     }
+}
+
+#define TY_RANDOM_FILL_BLOCK 1024   // Converted fills go through a block of u32s kept in L1.
+
+void RandomFillU32(Rng* rng, u32* result, u64 count)
+{
+    if(count < TY_RANDOM_FILL_MIN)
+    {
+        for(u64 i = 0; i < count; i++)
+        {
+            result[i] = RandomU32(rng);
+        }
+        return;
+    }
+    RngLanes lanes = MakeRngLanes(*rng);
+    FillLanes(&lanes, result, count);
+    *rng = GetLane(lanes, 0);
+}
+
+void RandomFillF32(Rng* rng, f32* result, u64 count, f32 start, f32 end)
+{
+    if(count < TY_RANDOM_FILL_MIN)
+    {
+        for(u64 i = 0; i < count; i++)
+        {
+            result[i] = RandomUniformF32(rng, start, end);
+        }
+        return;
+    }
+    RngLanes lanes = MakeRngLanes(*rng);
+    u32 block[TY_RANDOM_FILL_BLOCK];
+    f32 range = end - start;
+    for(u64 offset = 0; offset < count; offset += TY_RANDOM_FILL_BLOCK)
+    {
+        u64 blockCount = MIN(count - offset, TY_RANDOM_FILL_BLOCK);
+        FillLanes(&lanes, block, blockCount);
+        for(u64 i = 0; i < blockCount; i++)
+        {
+            result[offset + i] = start + ToUniformF32(block[i]) * range;
+        }
+    }
+    *rng = GetLane(lanes, 0);
+}
+
+void RandomFillI32(Rng* rng, i32* result, u64 count, i32 start, i32 end)
+{
+    ASSERT(start <= end);
+    if(count < TY_RANDOM_FILL_MIN)
+    {
+        for(u64 i = 0; i < count; i++)
+        {
+            result[i] = RandomUniformI32(rng, start, end);
+        }
+        return;
+    }
+    RngLanes lanes = MakeRngLanes(*rng);
+    u32 block[TY_RANDOM_FILL_BLOCK];
+    u32 range = (u32)end - (u32)start + 1;
+    u32 threshold = range ? (0 - range) % range : 0;
+    for(u64 offset = 0; offset < count; offset += TY_RANDOM_FILL_BLOCK)
+    {
+        u64 blockCount = MIN(count - offset, TY_RANDOM_FILL_BLOCK);
+        FillLanes(&lanes, block, blockCount);
+        if(!range)
+        {
+            for(u64 i = 0; i < blockCount; i++)
+            {
+                result[offset + i] = (i32)((u32)start + block[i]);
+            }
+            continue;
+        }
+        u32 rejected = 0;
+        for(u64 i = 0; i < blockCount; i++)
+        {
+            u64 m = (u64)block[i] * range;
+            rejected |= (u32)m < threshold;
+            result[offset + i] = (i32)((u32)start + (u32)(m >> 32));
+        }
+        if(!rejected) continue;
+
+        // Rejected numbers are redrawn from stream 0 in order, so every backend agrees.
+        Rng lane = GetLane(lanes, 0);
+        for(u64 i = 0; i < blockCount; i++)
+        {
+            if((u32)((u64)block[i] * range) < threshold)
+            {
+                result[offset + i] = (i32)((u32)start + RandomBoundedU32(&lane, range));
+            }
+        }
+        for(u32 j = 0; j < 4; j++)
+        {
+            lanes.state[j][0] = lane.state[j];
+        }
+    }
+    *rng = GetLane(lanes, 0);
+}
+
+u64 RandomU64()
+{
+    return RandomU64(GetThreadRng());
+}
+
+f32 RandomUniformF32()
+{
+    return RandomUniformF32(GetThreadRng());
+}
+
+f32 RandomUniformF32(f32 start, f32 end)
+{
+    return RandomUniformF32(GetThreadRng(), start, end);
+}
+
+i32 RandomUniformI32(i32 start, i32 end)
+{
+    return RandomUniformI32(GetThreadRng(), start, end);
+}
+
+v3f RandomUniformV3F()
+{
+    return RandomUniformV3F(GetThreadRng());
+}
+
+v3f RandomUniformV3F(f32 start, f32 end)
+{
+    return RandomUniformV3F(GetThreadRng(), start, end);
+}
+
+// Transformed AABB columns (upper 3 rows of the matrix), the 4th one is the translation.
+inline void GetAABBColumns(const m4f& transform, simd::f32x4* columns)
+{
+    columns[0] = simd::Load(transform.data + 0);
+    columns[1] = simd::Load(transform.data + 4);
+    columns[2] = simd::Load(transform.data + 8);
+    columns[3] = simd::Load(transform.data + 12);
+    simd::Transpose4(columns[0], columns[1], columns[2], columns[3]);
+}
+
+// Arvo's method: each output axis is the translation plus, per input axis, the smaller/larger
+// of the column scaled by min and max. Terms are added in the same order as transforming the
+// 8 corners, so the result matches that exactly for affine transforms.
+inline AABB TransformAABB(const simd::f32x4* columns, const AABB& aabb)
+{
+    STATIC_ASSERT(sizeof(AABB) == 6 * sizeof(f32));
+    simd::f32x4 lo = simd::Load(&aabb.min.x);   // min.x min.y min.z max.x
+    simd::f32x4 hi = simd::Load(&aabb.min.z);   // min.z max.x max.y max.z
+    simd::f32x4 a = simd::Mul(columns[0], simd::Splat<0>(lo));
+    simd::f32x4 b = simd::Mul(columns[0], simd::Splat<1>(hi));
+    simd::f32x4 rMin = simd::Min(a, b);
+    simd::f32x4 rMax = simd::Max(a, b);
+    a = simd::Mul(columns[1], simd::Splat<1>(lo));
+    b = simd::Mul(columns[1], simd::Splat<2>(hi));
+    rMin = simd::Add(rMin, simd::Min(a, b));
+    rMax = simd::Add(rMax, simd::Max(a, b));
+    a = simd::Mul(columns[2], simd::Splat<2>(lo));
+    b = simd::Mul(columns[2], simd::Splat<3>(hi));
+    rMin = simd::Add(simd::Add(rMin, simd::Min(a, b)), columns[3]);
+    rMax = simd::Add(simd::Add(rMax, simd::Max(a, b)), columns[3]);
+
+    simd::f32x4 t = simd::Shuffle<2, 2, 0, 0>(rMin, rMax);     // min.z min.z max.x max.x
+    AABB result;
+    simd::Store(&result.min.x, simd::Shuffle<0, 1, 0, 2>(rMin, t));
+    simd::Store(&result.min.z, simd::Shuffle<0, 2, 1, 2>(t, rMax));
     return result;
 }
 
+AABB TransformAABB(AABB aabb, const m4f& transform)
+{
+    simd::f32x4 columns[4];
+    GetAABBColumns(transform, columns);
+    return TransformAABB(columns, aabb);
+}
+
+AABB TransformAABB(AABB aabb, const affine3x4& transform)
+{
+    simd::f32x4 columns[4] =
+    {
+        simd::Load(transform.data + 0), simd::Load(transform.data + 4), simd::Load(transform.data + 8), simd::Zero(),
+    };
+    simd::Transpose4(columns[0], columns[1], columns[2], columns[3]);
+    return TransformAABB(columns, aabb);
+}
+
 v3f GetAABBCenter(AABB aabb)
 {
     return aabb.min + 0.5f * GetAABBSize(aabb);
@@ -888,6 +1600,173 @@ v3f GetAABBSize(AABB aabb)
     return (aabb.max - aabb.min);
 }
 
+AABB GetAABB(const f32* positions, u64 count)
+{
+    // 12 floats (4 points) per step. Lanes of the 3 accumulators hold x y z x | y z x y | z x y z,
+    // sorted out at the end.
+    simd::f32x4 minA = simd::Set1(MAX_F32), minB = minA, minC = minA;
+    simd::f32x4 maxA = simd::Set1(-MAX_F32), maxB = maxA, maxC = maxA;
+    u64 i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        const f32* p = positions + i * 3;
+        simd::f32x4 a = simd::Load(p);
+        simd::f32x4 b = simd::Load(p + 4);
+        simd::f32x4 c = simd::Load(p + 8);
+        minA = simd::Min(minA, a); minB = simd::Min(minB, b); minC = simd::Min(minC, c);
+        maxA = simd::Max(maxA, a); maxB = simd::Max(maxB, b); maxC = simd::Max(maxC, c);
+    }
+    f32 mins[12];
+    f32 maxs[12];
+    simd::Store(mins, minA); simd::Store(mins + 4, minB); simd::Store(mins + 8, minC);
+    simd::Store(maxs, maxA); simd::Store(maxs + 4, maxB); simd::Store(maxs + 8, maxC);
+
+    AABB result = {};
+    result.min = {MAX_F32, MAX_F32, MAX_F32};
+    result.max = {-MAX_F32, -MAX_F32, -MAX_F32};
+    for(u32 j = 0; j < 12; j++)
+    {
+        result.min.data[j % 3] = MIN(result.min.data[j % 3], mins[j]);
+        result.max.data[j % 3] = MAX(result.max.data[j % 3], maxs[j]);
+    }
+    for(; i < count; i++)
+    {
+        for(u32 j = 0; j < 3; j++)
+        {
+            result.min.data[j] = MIN(result.min.data[j], positions[i * 3 + j]);
+            result.max.data[j] = MAX(result.max.data[j], positions[i * 3 + j]);
+        }
+    }
+    return result;
+}
+
+// ========================================================
+// [BATCH]
+// Matrix entries broadcast once, then 4 points per step with one vector per component.
+// Sums follow the same order as m4f * v4f. The products go through a barrier so the compiler
+// can't fuse them into the adds, which m4f * v4f never does, so results match it with FMA too.
+struct BatchTransform
+{
+    simd::f32x4 m[3][4];
+};
+
+inline BatchTransform MakeBatchTransform(const m4f& transform)
+{
+    BatchTransform result;
+    for(u32 i = 0; i < 3; i++)
+    {
+        for(u32 j = 0; j < 4; j++)
+        {
+            result.m[i][j] = simd::Set1(transform.data[i * 4 + j]);
+        }
+    }
+    return result;
+}
+
+template <bool Translate>
+inline void TransformXYZ4(const BatchTransform& t, simd::f32x4& x, simd::f32x4& y, simd::f32x4& z)
+{
+    simd::f32x4 r[3];
+    for(u32 i = 0; i < 3; i++)
+    {
+        simd::f32x4 px = simd::Barrier(simd::Mul(t.m[i][0], x));
+        simd::f32x4 py = simd::Barrier(simd::Mul(t.m[i][1], y));
+        simd::f32x4 pz = simd::Barrier(simd::Mul(t.m[i][2], z));
+        r[i] = simd::Add(simd::Add(px, py), pz);
+        if(Translate) r[i] = simd::Add(r[i], t.m[i][3]);
+    }
+    x = r[0];
+    y = r[1];
+    z = r[2];
+}
+
+template <bool Translate>
+void TransformPointsAoS(v3f* result, const v3f* points, u64 count, const m4f& transform)
+{
+    STATIC_ASSERT(sizeof(v3f) == 3 * sizeof(f32));
+    BatchTransform t = MakeBatchTransform(transform);
+    u64 i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        simd::f32x4 x, y, z;
+        simd::LoadXYZ4(points[i].data, x, y, z);
+        TransformXYZ4<Translate>(t, x, y, z);
+        simd::StoreXYZ4(result[i].data, x, y, z);
+    }
+    for(; i < count; i++)
+    {
+        result[i] = Translate ? TransformPosition(points[i], transform) : TransformDirection(points[i], transform);
+    }
+}
+
+template <bool Translate>
+void TransformPointsSoA(f32* resultX, f32* resultY, f32* resultZ,
+        const f32* x, const f32* y, const f32* z, u64 count, const m4f& transform)
+{
+    BatchTransform t = MakeBatchTransform(transform);
+    u64 i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        simd::f32x4 vx = simd::Load(x + i);
+        simd::f32x4 vy = simd::Load(y + i);
+        simd::f32x4 vz = simd::Load(z + i);
+        TransformXYZ4<Translate>(t, vx, vy, vz);
+        simd::Store(resultX + i, vx);
+        simd::Store(resultY + i, vy);
+        simd::Store(resultZ + i, vz);
+    }
+    for(; i < count; i++)
+    {
+        v3f p = {x[i], y[i], z[i]};
+        p = Translate ? TransformPosition(p, transform) : TransformDirection(p, transform);
+        resultX[i] = p.x;
+        resultY[i] = p.y;
+        resultZ[i] = p.z;
+    }
+}
+
+void TransformPositions(v3f* result, const v3f* positions, u64 count, const m4f& transform)
+{
+    TransformPointsAoS<true>(result, positions, count, transform);
+}
+
+void TransformDirections(v3f* result, const v3f* directions, u64 count, const m4f& transform)
+{
+    TransformPointsAoS<false>(result, directions, count, transform);
+}
+
+void TransformPositions(f32* resultX, f32* resultY, f32* resultZ,
+        const f32* x, const f32* y, const f32* z, u64 count, const m4f& transform)
+{
+    TransformPointsSoA<true>(resultX, resultY, resultZ, x, y, z, count, transform);
+}
+
+void TransformDirections(f32* resultX, f32* resultY, f32* resultZ,
+        const f32* x, const f32* y, const f32* z, u64 count, const m4f& transform)
+{
+    TransformPointsSoA<false>(resultX, resultY, resultZ, x, y, z, count, transform);
+}
+
+void TransformAABBs(AABB* result, const AABB* aabbs, u64 count, const m4f& transform)
+{
+    simd::f32x4 columns[4];
+    GetAABBColumns(transform, columns);
+    for(u64 i = 0; i < count; i++)
+    {
+        result[i] = TransformAABB(columns, aabbs[i]);
+    }
+}
+
+void TransformAABBs(AABB* result, const AABB* aabbs, const m4f* transforms, u64 count)
+{
+    for(u64 i = 0; i < count; i++)
+    {
+        simd::f32x4 columns[4];
+        GetAABBColumns(transforms[i], columns);
+        result[i] = TransformAABB(columns, aabbs[i]);
+    }
+}
+
 v3f ClipToWorldSpace(v3f p, m4f invView, m4f invProj)
 {
     v4f P = {p.x, p.y, p.z, 1};
@@ -937,7 +1816,7 @@ Frustum GetFrustum(m4f view, m4f proj)
     return result;
 }
 
-bool IsInFrustum(v3f p, Frustum f)
+bool IsInFrustum(v3f p, const Frustum& f)
 {
     // Point is in frustum if it's inside half-space of all planes (using SDF).
     for(i32 i = 0; i < 6; i++)
@@ -951,7 +1830,7 @@ bool IsInFrustum(v3f p, Frustum f)
     return true;
 }
 
-bool IsInFrustum(AABB aabb, Frustum f)
+bool IsInFrustum(AABB aabb, const Frustum& f)
 {
     // AABB is in frustum if, for each plane, the point furthest along the plane's normal
     // is inside its half-space.
@@ -970,6 +1849,33 @@ bool IsInFrustum(AABB aabb, Frustum f)
     return true;
 }
 
+v3f GetInverseDirection(const Ray& ray)
+{
+    v3f result;
+    for(i32 i = 0; i < 3; i++)
+    {
+        f32 d = ray.direction.data[i];
+        result.data[i] = d == 0.f ? copysignf(MAX_F32, d) : 1.f / d;
+    }
+    return result;
+}
+
+bool IntersectRayAABB(const Ray& ray, AABB aabb, f32 tMax, f32* t)
+{
+    f32 tNear = 0;
+    f32 tFar = tMax;
+    v3f invDirection = GetInverseDirection(ray);
+    for(i32 i = 0; i < 3; i++)
+    {
+        f32 t0 = (aabb.min.data[i] - ray.origin.data[i]) * invDirection.data[i];
+        f32 t1 = (aabb.max.data[i] - ray.origin.data[i]) * invDirection.data[i];
+        tNear = MAX(tNear, MIN(t0, t1));
+        tFar = MIN(tFar, MAX(t0, t1));
+    }
+    if(t) *t = tNear;
+    return tNear <= tFar;
+}
+
 v3f FromPolarCoordinates(f32 radius, f32 theta, f32 phi)
 {
     return
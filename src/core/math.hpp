@@ -6,6 +6,7 @@
 
 #pragma once
 #include "./base.hpp"
+#include "./simd.hpp"
 
 namespace ty
 {
@@ -90,8 +91,8 @@ struct v3f
         f32 data[3];
     };
 
-    v4f AsDirection();
-    v4f AsPosition();
+    v4f AsDirection() const;
+    v4f AsPosition() const;
 };
 bool operator==(v3f a, v3f b);
 bool operator!=(v3f a, v3f b);
@@ -123,7 +124,7 @@ struct v4f
         f32 data[4];
     };
 
-    v3f AsXYZ();
+    v3f AsXYZ() const;
 };
 bool operator==(v4f a, v4f b);
 bool operator!=(v4f a, v4f b);
@@ -158,6 +159,8 @@ plane GetPlane(v3f p0, v3f A, v3f B);
 // ========================================================
 // [MATRIX]
 // All matrix types have data stored in a contiguous array, and are row-major in memory.
+// Products, transpose and inverse use core/simd when available. Without FMA the SIMD
+// products round exactly like the scalar ones.
 
 // Matrix4f (f32)
 struct m4f
@@ -178,14 +181,25 @@ bool operator==(m4f a, m4f b);
 bool operator!=(m4f a, m4f b);
 m4f  operator+ (m4f a, m4f b);
 m4f  operator- (m4f a, m4f b);
-m4f  operator* (m4f a, m4f b);
+m4f  operator* (const m4f& a, const m4f& b);
 m4f  operator* (f32 a, m4f b);
-v4f  operator* (m4f a, v4f v);
+v4f  operator* (const m4f& a, v4f v);
+
+// 16-byte aligned variants, for arrays allocated with ArenaPush(arena, size, 16).
+void MulAligned(m4f* result, const m4f* a, const m4f* b);
+void MulAligned(v4f* result, const m4f* a, const v4f* v);
 
 m4f Identity();
 f32 Determinant     (m4f m);
-m4f Transpose       (m4f m);
-m4f Inverse         (m4f m);
+m4f Transpose       (const m4f& m);
+m4f Inverse         (const m4f& m);
+
+// Scalar products, transpose and inverse, built with or without SIMD. The versions above
+// give the same bits when compiled without FMA or fast-math.
+m4f MulScalar       (const m4f& a, const m4f& b);
+v4f MulScalar       (const m4f& a, v4f v);
+m4f TransposeScalar (const m4f& m);
+m4f InverseScalar   (const m4f& m);
 
 m4f ScaleMatrix         (v3f scale);
 m4f RotationMatrix      (quat q);
@@ -194,8 +208,8 @@ m4f TranslationMatrix   (v3f move);
 
 void GetAngleAxis(m4f rotation, f32* angle, v3f* axis);
 
-v3f TransformPosition   (v3f position,  m4f transform);
-v3f TransformDirection  (v3f direction, m4f transform);
+v3f TransformPosition   (v3f position,  const m4f& transform);
+v3f TransformDirection  (v3f direction, const m4f& transform);
 
 // NOTE(caio): Only implement RH coordinate system for consistency purposes.
 m4f ViewRH          (v3f axisX, v3f axisY, v3f axisZ, v3f position);
@@ -203,6 +217,46 @@ m4f OrthoRH         (f32 l, f32 r, f32 b, f32 t, f32 n, f32 f);
 m4f PerspectiveRH   (f32 fov, f32 aspect, f32 zNear, f32 zFar);
 v3f ClipToWorldSpace(v3f p, m4f invView, m4f invProj);
 
+// Affine3x4 (f32): the top 3 rows of a matrix whose last row is (0, 0, 0, 1), for transforms
+// that never project (objects, nodes, bones). Same layout as the first 12 values of an m4f,
+// 48 bytes instead of 64, and composing two takes 36 multiplies instead of 64.
+struct affine3x4
+{
+    union
+    {
+        struct
+        {
+            f32 m00 = 0; f32 m01 = 0; f32 m02 = 0; f32 m03 = 0;
+            f32 m10 = 0; f32 m11 = 0; f32 m12 = 0; f32 m13 = 0;
+            f32 m20 = 0; f32 m21 = 0; f32 m22 = 0; f32 m23 = 0;
+        };
+        f32 data[12];
+    };
+};
+affine3x4 operator*(const affine3x4& a, const affine3x4& b);   // b first, then a, as with m4f.
+
+// Translation, rotation and scale, applied scale first (glTF nodes).
+struct trs
+{
+    v3f translation = {0, 0, 0};
+    quat rotation = {0, 0, 0, 1};
+    v3f scale = {1, 1, 1};
+};
+
+affine3x4 IdentityAffine();
+affine3x4 ToAffine(const m4f& m);           // Drops the last row.
+affine3x4 ToAffine(trs t);
+m4f ToMatrix(const affine3x4& a);
+trs ToTRS(const affine3x4& a);              // Shear is lost. A mirroring transform gets a negative scale.x.
+
+// Inverses by what the transform may hold, cheapest first. Each is exact for its case only.
+affine3x4 InverseRigid  (const affine3x4& a);   // Rotation and translation.
+affine3x4 InverseScaled (const affine3x4& a);   // Rotation, translation and per-axis scale (any trs).
+affine3x4 Inverse       (const affine3x4& a);   // Any invertible affine transform.
+
+v3f TransformPosition   (v3f position,  const affine3x4& transform);
+v3f TransformDirection  (v3f direction, const affine3x4& transform);
+
 // ========================================================
 // [EASING]
 
@@ -214,11 +268,46 @@ v3f Lerp(v3f a, v3f b, f32 t);
 
 // ========================================================
 // [RANDOM]
+// xoshiro256++ generators (Blackman and Vigna). Seeding goes through splitmix64 and is
+// deterministic: a seed gives the same numbers on every machine and SIMD backend.
+// An Rng is not thread-safe. Give each thread its own, jumped from a common one so their
+// streams never overlap (2^128 numbers each).
+// Functions without an Rng use a per-thread default generator, seeded from the timestamp
+// counter unless SeedRandom is called on that thread.
+#define TY_RANDOM_FILL_MIN 256      // Shorter bulk fills skip the lane setup (3 long jumps).
+
+struct Rng
+{
+    u64 state[4] = {};
+};
+
+Rng MakeRng(u64 seed);
+void Jump(Rng* rng);                // Advances 2^128 numbers.
+void LongJump(Rng* rng);            // Advances 2^192 numbers, 2^64 jumps.
+void SeedRandom(u64 seed);          // Calling thread's default generator.
+
+u64 RandomU64(Rng* rng);
+u32 RandomU32(Rng* rng);
+u32 RandomBoundedU32(Rng* rng, u32 bound);  // [0, bound), unbiased (Lemire's multiply-shift).
+
+f32 RandomUniformF32(Rng* rng);             // [0, 1)
+f32 RandomUniformF32(Rng* rng, f32 start, f32 end);
+i32 RandomUniformI32(Rng* rng, i32 start, i32 end);
+
+v3f RandomUniformV3F(Rng* rng);
+v3f RandomUniformV3F(Rng* rng, f32 start, f32 end);
+
+// Bulk fills draw from 4 streams at once (8 u32s a step with AVX2): stream i starts i long
+// jumps after rng, and rng continues from stream 0 after the fill.
+void RandomFillU32(Rng* rng, u32* result, u64 count);
+void RandomFillF32(Rng* rng, f32* result, u64 count, f32 start = 0, f32 end = 1);
+void RandomFillI32(Rng* rng, i32* result, u64 count, i32 start, i32 end);
+
 u64 RandomU64();
 
 f32 RandomUniformF32();
 f32 RandomUniformF32(f32 start, f32 end);
-i32 RandomUniformI32(i32 start, i32 end);
+i32 RandomUniformI32(i32 start, i32 end);   // Inclusive.
 
 v3f RandomUniformV3F();
 v3f RandomUniformV3F(f32 start, f32 end);
@@ -233,9 +322,24 @@ struct AABB
     v3f max = {0,0,0};
 };
 
-AABB TransformAABB(AABB aabb, m4f transform);
+AABB TransformAABB(AABB aabb, const m4f& transform);
+AABB TransformAABB(AABB aabb, const affine3x4& transform);
 v3f GetAABBCenter(AABB aabb);
 v3f GetAABBSize(AABB aabb);
+AABB GetAABB(const f32* positions, u64 count);  // Packed xyz stream of count points.
+
+// ========================================================
+// [BATCH]
+// Array versions of the transforms above, 4 elements at a time. Results match the single
+// versions, and result arrays may alias the input ones.
+void TransformPositions(v3f* result, const v3f* positions, u64 count, const m4f& transform);
+void TransformDirections(v3f* result, const v3f* directions, u64 count, const m4f& transform);
+void TransformPositions(f32* resultX, f32* resultY, f32* resultZ,
+        const f32* x, const f32* y, const f32* z, u64 count, const m4f& transform);
+void TransformDirections(f32* resultX, f32* resultY, f32* resultZ,
+        const f32* x, const f32* y, const f32* z, u64 count, const m4f& transform);
+void TransformAABBs(AABB* result, const AABB* aabbs, u64 count, const m4f& transform);
+void TransformAABBs(AABB* result, const AABB* aabbs, const m4f* transforms, u64 count);  // One transform per AABB.
 
 // ========================================================
 // [FRUSTUM]
@@ -256,8 +360,22 @@ struct Frustum
 };
 
 Frustum GetFrustum(m4f view, m4f proj);
-bool IsInFrustum(v3f p, Frustum f);
-bool IsInFrustum(AABB aabb, Frustum f);
+bool IsInFrustum(v3f p, const Frustum& f);
+bool IsInFrustum(AABB aabb, const Frustum& f);   // For many objects use core/cull.
+
+// ========================================================
+// [RAY]
+struct Ray
+{
+    v3f origin = {0,0,0};
+    v3f direction = {0,0,1};
+};
+
+// 1 / direction for slab tests. Zero components give the largest finite value instead of
+// infinity, so an origin on a slab plane gives a distance of 0 instead of 0 * inf = NaN.
+v3f GetInverseDirection(const Ray& ray);
+// Slab test. On a hit within [0, tMax], t is the entry distance (0 if the origin is inside).
+bool IntersectRayAABB(const Ray& ray, AABB aabb, f32 tMax = MAX_F32, f32* t = NULL);
 
 // ========================================================
 // [MISC]
@@ -270,6 +388,7 @@ typedef math::v2i v2i;
 typedef math::v3f v3f;
 typedef math::v4f v4f;
 typedef math::m4f m4f;
+typedef math::affine3x4 affine3x4;
 typedef math::v3f Color3f;
 typedef math::v4f Color4f;
 };
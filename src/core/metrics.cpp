@@ -0,0 +1,303 @@
+#include "./metrics.hpp"
+
+namespace ty
+{
+namespace metrics
+{
+
+struct MetricInfo
+{
+    const char* name = NULL;
+    MetricType type = METRIC_COUNTER;
+    GaugeProc proc = NULL;
+    void* userData = NULL;
+};
+
+struct Exporter
+{
+    ExportDesc desc = {};
+    mem::Arena* arena = NULL;           // Writer buffer.
+    mem::Arena* snapshotArena = NULL;   // Cleared every snapshot.
+    file::FileWriter writer = {};
+    HANDLE hThread = NULL;
+    HANDLE hStopEvent = NULL;
+    bool wroteHeader = false;
+};
+
+struct Registry
+{
+    SRWLOCK lock = SRWLOCK_INIT;
+    MetricInfo metrics[TY_METRICS_MAX];
+    volatile LONG metricCount = 0;
+    volatile i64 gauges[TY_METRICS_MAX] = {};
+
+    // Counter slots, one array per thread. Threads past the limit share atomic slots.
+    volatile i64* volatile threadSlots[TY_METRICS_MAX_THREADS] = {};
+    volatile LONG threadCount = 0;
+    volatile LONGLONG sharedSlots[TY_METRICS_MAX] = {};
+
+    // Previous snapshot, for rates.
+    i64 previous[TY_METRICS_MAX] = {};
+    u64 previousTimestamp = 0;
+    u64 startTimestamp = 0;
+
+    Exporter exporter;
+};
+
+static Registry registry;
+static thread_local volatile i64* localSlots = NULL;
+static thread_local bool localSlotsFull = false;
+
+Metric Register(const char* name, MetricType type, GaugeProc proc, void* userData)
+{
+    ASSERT(name);
+    AcquireSRWLockExclusive(&registry.lock);
+    Metric result = HANDLE_INVALID;
+    for(u32 i = 0; i < (u32)registry.metricCount; i++)
+    {
+        if(strcmp(registry.metrics[i].name, name) == 0)
+        {
+            ASSERT(registry.metrics[i].type == type);
+            result = i;
+            break;
+        }
+    }
+    if(result == HANDLE_INVALID && registry.metricCount < TY_METRICS_MAX)
+    {
+        result = (Metric)registry.metricCount;
+        MetricInfo& info = registry.metrics[result];
+        info.name = name;
+        info.type = type;
+        info.proc = proc;
+        info.userData = userData;
+        // Metric must be complete before snapshots can see it.
+        _ReadWriteBarrier();
+        registry.metricCount++;
+    }
+    ReleaseSRWLockExclusive(&registry.lock);
+    if(result == HANDLE_INVALID) LOGLF("METRICS", "Registry is full, %s is not tracked.", name);
+    return result;
+}
+
+Metric RegisterCounter(const char* name)
+{
+    return Register(name, METRIC_COUNTER, NULL, NULL);
+}
+
+Metric RegisterGauge(const char* name, GaugeProc proc, void* userData)
+{
+    return Register(name, METRIC_GAUGE, proc, userData);
+}
+
+i64 ArenaUsedProc(void* userData)
+{
+    return (i64)((mem::Arena*)userData)->offset;
+}
+
+Metric TrackArena(const char* name, mem::Arena* arena)
+{
+    ASSERT(arena);
+    return RegisterGauge(name, ArenaUsedProc, arena);
+}
+
+volatile i64* RegisterThread()
+{
+    LONG slot = InterlockedIncrement(&registry.threadCount) - 1;
+    if(slot >= TY_METRICS_MAX_THREADS)
+    {
+        InterlockedDecrement(&registry.threadCount);
+        localSlotsFull = true;
+        return NULL;
+    }
+    // Slots are kept after the thread exits so its counts stay in the totals.
+    volatile i64* slots = (volatile i64*)calloc(TY_METRICS_MAX, sizeof(i64));
+    localSlots = slots;
+    _ReadWriteBarrier();
+    registry.threadSlots[slot] = slots;
+    return slots;
+}
+
+void Add(Metric counter, i64 value)
+{
+    if(counter >= TY_METRICS_MAX) return;
+    volatile i64* slots = localSlots;
+    if(!slots && !localSlotsFull) slots = RegisterThread();
+    if(slots) slots[counter] += value;
+    else InterlockedAdd64(&registry.sharedSlots[counter], value);
+}
+
+void Set(Metric gauge, i64 value)
+{
+    if(gauge >= TY_METRICS_MAX) return;
+    registry.gauges[gauge] = value;
+}
+
+i64 GetValue(Metric metric)
+{
+    if(metric >= (Metric)registry.metricCount) return 0;
+    MetricInfo& info = registry.metrics[metric];
+    if(info.type == METRIC_GAUGE)
+    {
+        return info.proc ? info.proc(info.userData) : registry.gauges[metric];
+    }
+    i64 result = registry.sharedSlots[metric];
+    u32 threadCount = MIN((u32)registry.threadCount, TY_METRICS_MAX_THREADS);
+    for(u32 i = 0; i < threadCount; i++)
+    {
+        volatile i64* slots = registry.threadSlots[i];
+        if(slots) result += slots[metric];
+    }
+    return result;
+}
+
+// ========================================================
+// [SNAPSHOT]
+
+Snapshot TakeSnapshot(mem::Arena* arena)
+{
+    Snapshot result = {};
+    AcquireSRWLockExclusive(&registry.lock);
+    u32 metricCount = (u32)registry.metricCount;
+    result.timestamp = time::GetTimestamp();
+    if(!registry.startTimestamp) registry.startTimestamp = result.timestamp;
+    result.seconds = time::TimestampToNSec(result.timestamp - registry.startTimestamp) / 1000000000.0;
+    f64 elapsed = registry.previousTimestamp
+        ? time::TimestampToNSec(result.timestamp - registry.previousTimestamp) / 1000000000.0
+        : 0;
+
+    result.values = MakeSArray<MetricValue>(arena, MAX(metricCount, 1));
+    for(u32 i = 0; i < metricCount; i++)
+    {
+        MetricValue value = {};
+        value.name = registry.metrics[i].name;
+        value.type = registry.metrics[i].type;
+        value.value = GetValue(i);
+        if(value.type == METRIC_COUNTER)
+        {
+            if(elapsed > 0) value.rate = (value.value - registry.previous[i]) / elapsed;
+            registry.previous[i] = value.value;
+        }
+        result.values.Push(value);
+    }
+    registry.previousTimestamp = result.timestamp;
+    ReleaseSRWLockExclusive(&registry.lock);
+    return result;
+}
+
+#define TY_METRICS_ENTRY_SIZE 192
+
+String SnapshotToJson(mem::Arena* arena, Snapshot* snapshot)
+{
+    stats::JsonWriter writer = {};
+    writer.capacity = snapshot->values.count * TY_METRICS_ENTRY_SIZE + 128;
+    writer.data = (char*)mem::ArenaPush(arena, writer.capacity);
+    stats::JsonAppend(&writer, "{\"time\":%.3f,\"counters\":{", snapshot->seconds);
+    u32 count = 0;
+    for(u64 i = 0; i < snapshot->values.count; i++)
+    {
+        MetricValue& value = snapshot->values[i];
+        if(value.type != METRIC_COUNTER) continue;
+        stats::JsonAppend(&writer, "%s\"%s\":{\"value\":%lld,\"rate\":%.3f}",
+                count++ ? "," : "", value.name, value.value, value.rate);
+    }
+    stats::JsonAppend(&writer, "},\"gauges\":{");
+    count = 0;
+    for(u64 i = 0; i < snapshot->values.count; i++)
+    {
+        MetricValue& value = snapshot->values[i];
+        if(value.type != METRIC_GAUGE) continue;
+        stats::JsonAppend(&writer, "%s\"%s\":%lld", count++ ? "," : "", value.name, value.value);
+    }
+    stats::JsonAppend(&writer, "}}");
+    return Str((byte*)writer.data, writer.len);
+}
+
+String SnapshotToCsv(mem::Arena* arena, Snapshot* snapshot, bool header)
+{
+    stats::JsonWriter writer = {};
+    writer.capacity = snapshot->values.count * TY_METRICS_ENTRY_SIZE + 128;
+    writer.data = (char*)mem::ArenaPush(arena, writer.capacity);
+    if(header) stats::JsonAppend(&writer, "time,name,type,value,rate\n");
+    for(u64 i = 0; i < snapshot->values.count; i++)
+    {
+        MetricValue& value = snapshot->values[i];
+        stats::JsonAppend(&writer, "%.3f,%s,%s,%lld,%.3f\n", snapshot->seconds, value.name,
+                value.type == METRIC_COUNTER ? "counter" : "gauge", value.value, value.rate);
+    }
+    return Str((byte*)writer.data, writer.len);
+}
+
+// ========================================================
+// [EXPORT]
+
+void ExportSnapshot(Exporter* exporter)
+{
+    mem::ArenaClear(exporter->snapshotArena);
+    Snapshot snapshot = TakeSnapshot(exporter->snapshotArena);
+    if(exporter->desc.format == METRICS_FORMAT_CSV)
+    {
+        String csv = SnapshotToCsv(exporter->snapshotArena, &snapshot, !exporter->wroteHeader);
+        exporter->wroteHeader = true;
+        file::Write(&exporter->writer, csv.data, csv.len);
+    }
+    else
+    {
+        String json = SnapshotToJson(exporter->snapshotArena, &snapshot);
+        file::Write(&exporter->writer, json.data, json.len);
+        file::Write(&exporter->writer, "\n", 1);
+    }
+    file::FlushFileWriter(&exporter->writer);
+}
+
+DWORD WINAPI ExportThreadProc(LPVOID param)
+{
+    Exporter* exporter = (Exporter*)param;
+    while(WaitForSingleObject(exporter->hStopEvent, exporter->desc.intervalMs) == WAIT_TIMEOUT)
+    {
+        ExportSnapshot(exporter);
+    }
+    ExportSnapshot(exporter);
+    return 0;
+}
+
+bool StartExport(ExportDesc desc)
+{
+    ASSERT(desc.path && desc.intervalMs > 0);
+    StopExport();
+    Exporter& exporter = registry.exporter;
+    exporter = {};
+    exporter.desc = desc;
+    exporter.arena = mem::MakeArena(KB(128));
+    exporter.snapshotArena = mem::MakeArena(TY_METRICS_MAX * (TY_METRICS_ENTRY_SIZE + sizeof(MetricValue)) + KB(4));
+    file::FileWriterDesc writerDesc = {};
+    writerDesc.bufferSize = KB(64);
+    exporter.writer = file::MakeFileWriter(exporter.arena, desc.path, writerDesc);
+    if(!exporter.writer.IsValid())
+    {
+        mem::DestroyArena(exporter.snapshotArena);
+        mem::DestroyArena(exporter.arena);
+        exporter = {};
+        return false;
+    }
+    exporter.hStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    exporter.hThread = CreateThread(NULL, 0, ExportThreadProc, &exporter, 0, NULL);
+    ASSERT(exporter.hThread);
+    return true;
+}
+
+void StopExport()
+{
+    Exporter& exporter = registry.exporter;
+    if(!exporter.hThread) return;
+    SetEvent(exporter.hStopEvent);
+    WaitForSingleObject(exporter.hThread, INFINITE);
+    CloseHandle(exporter.hThread);
+    CloseHandle(exporter.hStopEvent);
+    file::CloseFileWriter(&exporter.writer);
+    mem::DestroyArena(exporter.snapshotArena);
+    mem::DestroyArena(exporter.arena);
+    exporter = {};
+}
+
+};
+};
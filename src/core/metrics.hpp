@@ -0,0 +1,102 @@
+// ========================================================
+// METRICS
+// Named counters and gauges for observability without a profiler attached.
+// Counters are registered by name once and updated with a single add into a slot owned
+// by the calling thread, with no locks or atomics. Snapshots sum the slots of all threads.
+// Gauges hold one value that is either set directly or sampled through a callback when a
+// snapshot is taken (e.g. arena usage).
+// Snapshots export as JSON or CSV, and can be appended to a file at a fixed interval by
+// a background thread. Disabled with _NOMETRICS, the macros then compile to nothing.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./debug.hpp"
+#include "./memory.hpp"
+#include "./string.hpp"
+#include "./time.hpp"
+#include "./ds.hpp"
+#include "./file.hpp"
+#include "./stats.hpp"
+
+namespace ty
+{
+namespace metrics
+{
+
+#define TY_METRICS_MAX 256
+#define TY_METRICS_MAX_THREADS 64
+
+#if _NOMETRICS
+#define METRIC_ADD(NAME, VALUE)
+#define METRIC_SET(NAME, VALUE)
+#else
+// Registration runs once per call site.
+#define METRIC_ADD(NAME, VALUE) STMT( \
+        static ty::metrics::Metric CONCATENATE(_metric, __LINE__) = ty::metrics::RegisterCounter(NAME); \
+        ty::metrics::Add(CONCATENATE(_metric, __LINE__), (ty::i64)(VALUE)))
+#define METRIC_SET(NAME, VALUE) STMT( \
+        static ty::metrics::Metric CONCATENATE(_metric, __LINE__) = ty::metrics::RegisterGauge(NAME); \
+        ty::metrics::Set(CONCATENATE(_metric, __LINE__), (ty::i64)(VALUE)))
+#endif
+
+enum MetricType : u8
+{
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+};
+
+typedef u32 Metric;                     // Index in the registry, HANDLE_INVALID if the registry is full.
+typedef i64 (*GaugeProc)(void* userData);
+
+// Names must be static strings (literals). Registering a name again returns the same metric.
+Metric RegisterCounter(const char* name);
+Metric RegisterGauge(const char* name, GaugeProc proc = NULL, void* userData = NULL);
+Metric TrackArena(const char* name, mem::Arena* arena);    // Gauge of the arena bytes in use.
+
+void Add(Metric counter, i64 value = 1);
+void Set(Metric gauge, i64 value);
+i64 GetValue(Metric metric);            // Merged across threads, for counters.
+
+// ========================================================
+// [SNAPSHOT]
+struct MetricValue
+{
+    const char* name = NULL;
+    MetricType type = METRIC_COUNTER;
+    i64 value = 0;
+    f64 rate = 0;                       // Counters, change per second since the previous snapshot.
+};
+
+struct Snapshot
+{
+    u64 timestamp = 0;
+    f64 seconds = 0;                    // Since the first snapshot.
+    SArray<MetricValue> values;
+};
+
+Snapshot TakeSnapshot(mem::Arena* arena);
+String SnapshotToJson(mem::Arena* arena, Snapshot* snapshot);
+String SnapshotToCsv(mem::Arena* arena, Snapshot* snapshot, bool header = true);  // One row per metric.
+
+// ========================================================
+// [EXPORT]
+enum MetricsFormat
+{
+    METRICS_FORMAT_JSON,                // One JSON object per line.
+    METRICS_FORMAT_CSV,
+};
+
+struct ExportDesc
+{
+    const char* path = NULL;
+    MetricsFormat format = METRICS_FORMAT_JSON;
+    u32 intervalMs = 1000;
+};
+
+bool StartExport(ExportDesc desc);      // Truncates the file, then appends a snapshot every interval.
+void StopExport();                      // Writes a last snapshot.
+
+};
+};
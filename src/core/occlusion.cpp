@@ -0,0 +1,395 @@
+#include "./occlusion.hpp"
+
+namespace ty
+{
+namespace occlusion
+{
+
+#define TY_OCCLUSION_TILE_PIXELS (TY_OCCLUSION_TILE_SIZE * TY_OCCLUSION_TILE_SIZE)
+
+// Lanes of a tile row, and the 8 corners of a box.
+const f32 laneIndices[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+const f32 cornerSignsX[8] = { -1, 1, -1, 1, -1, 1, -1, 1 };
+const f32 cornerSignsY[8] = { -1, -1, 1, 1, -1, -1, 1, 1 };
+const f32 cornerSignsZ[8] = { -1, -1, -1, -1, 1, 1, 1, 1 };
+
+DepthBuffer MakeDepthBuffer(mem::Arena* arena, u32 width, u32 height, u32 maxTriangles)
+{
+    ASSERT(width > 0 && height > 0);
+    ASSERT(width % TY_OCCLUSION_TILE_SIZE == 0 && height % TY_OCCLUSION_TILE_SIZE == 0);
+    ASSERT(width / TY_OCCLUSION_TILE_SIZE <= MAX_U16 && height / TY_OCCLUSION_TILE_SIZE <= MAX_U16);
+
+    DepthBuffer result = {};
+    result.width = width;
+    result.height = height;
+    result.tilesX = width / TY_OCCLUSION_TILE_SIZE;
+    result.tilesY = height / TY_OCCLUSION_TILE_SIZE;
+    result.depths = MakeSArray<f32>(arena, (u64)width * height, (u64)width * height, 1.f);
+    result.tileDepths = MakeSArray<f32>(arena, result.tilesX * result.tilesY, result.tilesX * result.tilesY, 1.f);
+    result.triangles = MakeSArray<Triangle>(arena, maxTriangles);
+    result.viewProj = math::Identity();
+    return result;
+}
+
+void Clear(DepthBuffer* buffer, const m4f& viewProj)
+{
+    ASSERT(buffer);
+    for(u64 i = 0; i < buffer->depths.count; i++)
+    {
+        buffer->depths.data[i] = 1;
+    }
+    for(u64 i = 0; i < buffer->tileDepths.count; i++)
+    {
+        buffer->tileDepths.data[i] = 1;
+    }
+    buffer->viewProj = viewProj;
+}
+
+// ========================================================
+// [SETUP]
+
+inline v4f ClipLerp(v4f a, v4f b)
+{
+    f32 t = a.z / (a.z - b.z);          // Where z crosses 0.
+    return a + (b - a) * t;
+}
+
+inline void SetupTriangle(DepthBuffer* buffer, const v4f* clip, bool cullBackFaces)
+{
+    Triangle t;
+    f32 z[3];
+    for(u32 i = 0; i < 3; i++)
+    {
+        f32 invW = 1.f / clip[i].w;
+        t.x[i] = (clip[i].x * invW * 0.5f + 0.5f) * buffer->width;
+        t.y[i] = (clip[i].y * invW * 0.5f + 0.5f) * buffer->height;
+        z[i] = clip[i].z * invW;
+    }
+
+    // Counter-clockwise in world space is clockwise on screen, as math::PerspectiveRH flips y.
+    f32 area = (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (t.x[2] - t.x[0]) * (t.y[1] - t.y[0]);
+    if(!(area < 0 || area > 0)) return;             // Degenerate or NaN.
+    if(cullBackFaces && area > 0) return;
+    if(area < 0)
+    {
+        f32 x1 = t.x[1], y1 = t.y[1], z1 = z[1];
+        t.x[1] = t.x[2]; t.y[1] = t.y[2]; z[1] = z[2];
+        t.x[2] = x1; t.y[2] = y1; z[2] = z1;
+        area = -area;
+    }
+
+    // Pixels whose center is inside the bounds.
+    f32 minX = MIN(MIN(t.x[0], t.x[1]), t.x[2]);
+    f32 maxX = MAX(MAX(t.x[0], t.x[1]), t.x[2]);
+    f32 minY = MIN(MIN(t.y[0], t.y[1]), t.y[2]);
+    f32 maxY = MAX(MAX(t.y[0], t.y[1]), t.y[2]);
+    f32 pixelMinX = MAX(ceilf(minX - 0.5f), 0.f);
+    f32 pixelMaxX = MIN(floorf(maxX - 0.5f), (f32)buffer->width - 1);
+    f32 pixelMinY = MAX(ceilf(minY - 0.5f), 0.f);
+    f32 pixelMaxY = MIN(floorf(maxY - 0.5f), (f32)buffer->height - 1);
+    if(pixelMinX > pixelMaxX || pixelMinY > pixelMaxY) return;
+    t.minTileX = (u16)((u32)pixelMinX / TY_OCCLUSION_TILE_SIZE);
+    t.maxTileX = (u16)((u32)pixelMaxX / TY_OCCLUSION_TILE_SIZE);
+    t.minTileY = (u16)((u32)pixelMinY / TY_OCCLUSION_TILE_SIZE);
+    t.maxTileY = (u16)((u32)pixelMaxY / TY_OCCLUSION_TILE_SIZE);
+
+    for(u32 i = 0; i < 3; i++)
+    {
+        u32 j = (i + 1) % 3;
+        t.edgeX[i] = t.y[i] - t.y[j];
+        t.edgeY[i] = t.x[j] - t.x[i];
+    }
+    t.depth = z[0];
+    t.depthX = ((z[1] - z[0]) * (t.y[2] - t.y[0]) - (z[2] - z[0]) * (t.y[1] - t.y[0])) / area;
+    t.depthY = ((t.x[1] - t.x[0]) * (z[2] - z[0]) - (t.x[2] - t.x[0]) * (z[1] - z[0])) / area;
+    t.minDepth = MIN(MIN(z[0], z[1]), z[2]);
+    buffer->triangles.Push(t);
+}
+
+inline void SetupOccluder(DepthBuffer* buffer, const Occluder& occluder)
+{
+    ASSERT(occluder.positions && occluder.indices);
+    m4f transform = buffer->viewProj * occluder.transform;
+    for(u32 i = 0; i < occluder.triangleCount; i++)
+    {
+        v4f clip[3];
+        u32 outside = 0x3F;                         // Planes left, right, bottom, top, near, far that all vertices are out of.
+        u32 behind = 0;
+        for(u32 j = 0; j < 3; j++)
+        {
+            const f32* p = occluder.positions + occluder.indices[i * 3 + j] * 3;
+            clip[j] = transform * v4f{ p[0], p[1], p[2], 1 };
+            const v4f& c = clip[j];
+            outside &= (c.x < -c.w) | (c.x > c.w) << 1 | (c.y < -c.w) << 2 | (c.y > c.w) << 3 | (c.z < 0) << 4 | (c.z > c.w) << 5;
+            behind |= (c.z < 0) << j;
+        }
+        if(outside) continue;
+        if(!behind)
+        {
+            SetupTriangle(buffer, clip, occluder.cullBackFaces);
+            continue;
+        }
+
+        // Clip against the near plane, leaving a triangle or a quad to split in two.
+        v4f polygon[4];
+        u32 count = 0;
+        for(u32 j = 0; j < 3; j++)
+        {
+            u32 k = (j + 1) % 3;
+            bool inJ = !(behind & (1 << j));
+            bool inK = !(behind & (1 << k));
+            if(inJ) polygon[count++] = clip[j];
+            if(inJ != inK) polygon[count++] = ClipLerp(clip[j], clip[k]);
+        }
+        SetupTriangle(buffer, polygon, occluder.cullBackFaces);
+        if(count == 4)
+        {
+            v4f second[3] = { polygon[0], polygon[2], polygon[3] };
+            SetupTriangle(buffer, second, occluder.cullBackFaces);
+        }
+    }
+}
+
+// ========================================================
+// [RASTER]
+
+inline void RasterTile(DepthBuffer* buffer, const Triangle& t, u32 tileX, u32 tileY)
+{
+    u32 tile = tileY * buffer->tilesX + tileX;
+    f32* tileDepth = &buffer->tileDepths.data[tile];
+    if(t.minDepth >= *tileDepth) return;            // Behind everything in the tile.
+
+    // Edges at the first pixel center, and their range over the tile.
+    const f32 span = TY_OCCLUSION_TILE_SIZE - 1;
+    f32 originX = (f32)(tileX * TY_OCCLUSION_TILE_SIZE) + 0.5f;
+    f32 originY = (f32)(tileY * TY_OCCLUSION_TILE_SIZE) + 0.5f;
+    f32 edges[3];
+    bool covered = true;
+    for(u32 i = 0; i < 3; i++)
+    {
+        edges[i] = t.edgeX[i] * (originX - t.x[i]) + t.edgeY[i] * (originY - t.y[i]);
+        f32 hi = edges[i] + (MAX(t.edgeX[i], 0.f) + MAX(t.edgeY[i], 0.f)) * span;
+        f32 lo = edges[i] + (MIN(t.edgeX[i], 0.f) + MIN(t.edgeY[i], 0.f)) * span;
+        if(hi < 0) return;
+        covered &= lo >= 0;
+    }
+
+    simd::f32x8 lanes = simd::Load8(laneIndices);
+    simd::f32x8 zero = simd::Splat8(0);
+    simd::f32x8 e0 = simd::MulAdd(simd::Splat8(t.edgeX[0]), lanes, simd::Splat8(edges[0]));
+    simd::f32x8 e1 = simd::MulAdd(simd::Splat8(t.edgeX[1]), lanes, simd::Splat8(edges[1]));
+    simd::f32x8 e2 = simd::MulAdd(simd::Splat8(t.edgeX[2]), lanes, simd::Splat8(edges[2]));
+    simd::f32x8 stepY0 = simd::Splat8(t.edgeY[0]);
+    simd::f32x8 stepY1 = simd::Splat8(t.edgeY[1]);
+    simd::f32x8 stepY2 = simd::Splat8(t.edgeY[2]);
+    f32 rowDepth = t.depth + t.depthX * (originX - t.x[0]) + t.depthY * (originY - t.y[0]);
+    simd::f32x8 z = simd::MulAdd(simd::Splat8(t.depthX), lanes, simd::Splat8(rowDepth));
+    simd::f32x8 stepZ = simd::Splat8(t.depthY);
+    simd::f32x8 minZ = simd::Splat8(t.minDepth);   // Interpolation can't go nearer than the vertices.
+    simd::f32x8 inside = simd::CmpGE(zero, zero);
+    simd::f32x8 farthest = zero;
+
+    f32* depths = &buffer->depths.data[tile * TY_OCCLUSION_TILE_PIXELS];
+    for(u32 row = 0; row < TY_OCCLUSION_TILE_SIZE; row++)
+    {
+        if(!covered)
+        {
+            inside = simd::And(simd::And(simd::CmpGE(e0, zero), simd::CmpGE(e1, zero)), simd::CmpGE(e2, zero));
+            e0 = simd::Add(e0, stepY0);
+            e1 = simd::Add(e1, stepY1);
+            e2 = simd::Add(e2, stepY2);
+        }
+        f32* rowDepths = depths + row * TY_OCCLUSION_TILE_SIZE;
+        simd::f32x8 d = simd::Load8(rowDepths);
+        d = simd::Select(inside, simd::Min(d, simd::Max(z, minZ)), d);
+        simd::Store8(rowDepths, d);
+        farthest = simd::Max(farthest, d);
+        z = simd::Add(z, stepZ);
+    }
+
+    f32 lanesFarthest[8];
+    simd::Store8(lanesFarthest, farthest);
+    f32 result = lanesFarthest[0];
+    for(u32 i = 1; i < 8; i++)
+    {
+        result = MAX(result, lanesFarthest[i]);
+    }
+    *tileDepth = result;
+}
+
+inline void RasterTileRows(DepthBuffer* buffer, u64 start, u64 end)
+{
+    for(u64 tileY = start; tileY < end; tileY++)
+    {
+        for(u64 i = 0; i < buffer->triangles.count; i++)
+        {
+            const Triangle& t = buffer->triangles.data[i];
+            if(tileY < t.minTileY || tileY > t.maxTileY) continue;
+            for(u32 tileX = t.minTileX; tileX <= t.maxTileX; tileX++)
+            {
+                RasterTile(buffer, t, tileX, (u32)tileY);
+            }
+        }
+    }
+}
+
+void RasterTaskProc(void* data, u64 start, u64 end, u32 threadIndex)
+{
+    RasterTileRows((DepthBuffer*)data, start, end);
+}
+
+void RenderOccluders(DepthBuffer* buffer, const Occluder* occluders, u32 count, bool parallel)
+{
+    ASSERT(buffer);
+    ASSERT(occluders || count == 0);
+    buffer->triangles.Clear();
+    for(u32 i = 0; i < count; i++)
+    {
+        SetupOccluder(buffer, occluders[i]);
+    }
+    if(!buffer->triangles.count) return;
+
+    if(parallel)
+    {
+        async::ParallelFor(buffer->tilesY, 1, RasterTaskProc, buffer);
+    }
+    else
+    {
+        RasterTileRows(buffer, 0, buffer->tilesY);
+    }
+}
+
+// ========================================================
+// [TESTS]
+
+inline bool IsBoxOccluded(const DepthBuffer& buffer, f32 centerX, f32 centerY, f32 centerZ, f32 extentX, f32 extentY, f32 extentZ)
+{
+    // Corners to clip space, one per lane.
+    const m4f& m = buffer.viewProj;
+    simd::f32x8 x = simd::MulAdd(simd::Splat8(extentX), simd::Load8(cornerSignsX), simd::Splat8(centerX));
+    simd::f32x8 y = simd::MulAdd(simd::Splat8(extentY), simd::Load8(cornerSignsY), simd::Splat8(centerY));
+    simd::f32x8 z = simd::MulAdd(simd::Splat8(extentZ), simd::Load8(cornerSignsZ), simd::Splat8(centerZ));
+    simd::f32x8 clipX = simd::MulAdd(simd::Splat8(m.m00), x, simd::MulAdd(simd::Splat8(m.m01), y, simd::MulAdd(simd::Splat8(m.m02), z, simd::Splat8(m.m03))));
+    simd::f32x8 clipY = simd::MulAdd(simd::Splat8(m.m10), x, simd::MulAdd(simd::Splat8(m.m11), y, simd::MulAdd(simd::Splat8(m.m12), z, simd::Splat8(m.m13))));
+    simd::f32x8 clipZ = simd::MulAdd(simd::Splat8(m.m20), x, simd::MulAdd(simd::Splat8(m.m21), y, simd::MulAdd(simd::Splat8(m.m22), z, simd::Splat8(m.m23))));
+    simd::f32x8 clipW = simd::MulAdd(simd::Splat8(m.m30), x, simd::MulAdd(simd::Splat8(m.m31), y, simd::MulAdd(simd::Splat8(m.m32), z, simd::Splat8(m.m33))));
+    if(simd::MoveMask(simd::CmpLT(clipZ, simd::Splat8(0)))) return false;
+
+    simd::f32x8 invW = simd::Div(simd::Splat8(1), clipW);
+    f32 screenX[8], screenY[8], depth[8];
+    simd::Store8(screenX, simd::Mul(clipX, invW));
+    simd::Store8(screenY, simd::Mul(clipY, invW));
+    simd::Store8(depth, simd::Mul(clipZ, invW));
+    f32 minX = screenX[0], maxX = screenX[0];
+    f32 minY = screenY[0], maxY = screenY[0];
+    f32 nearest = depth[0];
+    for(u32 i = 1; i < 8; i++)
+    {
+        minX = MIN(minX, screenX[i]);
+        maxX = MAX(maxX, screenX[i]);
+        minY = MIN(minY, screenY[i]);
+        maxY = MAX(maxY, screenY[i]);
+        nearest = MIN(nearest, depth[i]);
+    }
+
+    // Every pixel the bounds touch, not only those whose center they cover.
+    f32 width = (f32)buffer.width;
+    f32 height = (f32)buffer.height;
+    i32 pixelMinX = (i32)floorf(CLAMP((minX * 0.5f + 0.5f) * width, -1.f, width + 1));
+    i32 pixelMaxX = (i32)ceilf(CLAMP((maxX * 0.5f + 0.5f) * width, -1.f, width + 1)) - 1;
+    i32 pixelMinY = (i32)floorf(CLAMP((minY * 0.5f + 0.5f) * height, -1.f, height + 1));
+    i32 pixelMaxY = (i32)ceilf(CLAMP((maxY * 0.5f + 0.5f) * height, -1.f, height + 1)) - 1;
+    pixelMinX = MAX(pixelMinX, 0);
+    pixelMinY = MAX(pixelMinY, 0);
+    pixelMaxX = MIN(pixelMaxX, (i32)buffer.width - 1);
+    pixelMaxY = MIN(pixelMaxY, (i32)buffer.height - 1);
+    if(pixelMinX > pixelMaxX || pixelMinY > pixelMaxY) return false;
+
+    simd::f32x8 lanes = simd::Load8(laneIndices);
+    simd::f32x8 nearest8 = simd::Splat8(nearest);
+    for(i32 tileY = pixelMinY / TY_OCCLUSION_TILE_SIZE; tileY <= pixelMaxY / TY_OCCLUSION_TILE_SIZE; tileY++)
+    {
+        i32 originY = tileY * TY_OCCLUSION_TILE_SIZE;
+        i32 rowStart = MAX(pixelMinY - originY, 0);
+        i32 rowEnd = MIN(pixelMaxY - originY, TY_OCCLUSION_TILE_SIZE - 1);
+        for(i32 tileX = pixelMinX / TY_OCCLUSION_TILE_SIZE; tileX <= pixelMaxX / TY_OCCLUSION_TILE_SIZE; tileX++)
+        {
+            u32 tile = tileY * buffer.tilesX + tileX;
+            if(buffer.tileDepths.data[tile] < nearest) continue;
+
+            i32 originX = tileX * TY_OCCLUSION_TILE_SIZE;
+            simd::f32x8 columns = simd::And(simd::CmpGE(lanes, simd::Splat8((f32)(pixelMinX - originX))),
+                                            simd::CmpLT(lanes, simd::Splat8((f32)(pixelMaxX - originX + 1))));
+            const f32* depths = &buffer.depths.data[tile * TY_OCCLUSION_TILE_PIXELS];
+            for(i32 row = rowStart; row <= rowEnd; row++)
+            {
+                simd::f32x8 visible = simd::CmpGE(simd::Load8(depths + row * TY_OCCLUSION_TILE_SIZE), nearest8);
+                if(simd::MoveMask(simd::And(visible, columns))) return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool IsOccluded(const DepthBuffer& buffer, math::AABB aabb)
+{
+    v3f center = (aabb.min + aabb.max) * 0.5f;
+    v3f extent = (aabb.max - aabb.min) * 0.5f;
+    return IsBoxOccluded(buffer, center.x, center.y, center.z, extent.x, extent.y, extent.z);
+}
+
+// Tests the set bits of the mask words covering [start, end). start must be a multiple of 64.
+inline void CullRange(const DepthBuffer& buffer, const cull::BoxArrays& boxes, u64 start, u64 end, u64* mask)
+{
+    ASSERT(start % 64 == 0);
+    for(u64 base = start; base < end; base += 64)
+    {
+        u64 bits = mask[base / 64];
+        if(end - base < 64) bits &= ((u64)1 << (end - base)) - 1;
+        u64 occluded = 0;
+        while(bits)
+        {
+            u32 bit = __builtin_ctzll(bits);
+            bits &= bits - 1;
+            u64 i = base + bit;
+            if(IsBoxOccluded(buffer, boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i], boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]))
+            {
+                occluded |= (u64)1 << bit;
+            }
+        }
+        mask[base / 64] &= ~occluded;
+    }
+}
+
+struct CullTask
+{
+    const DepthBuffer* buffer = NULL;
+    const cull::BoxArrays* boxes = NULL;
+    u64* mask = NULL;
+};
+
+void CullTaskProc(void* data, u64 start, u64 end, u32 threadIndex)
+{
+    CullTask* task = (CullTask*)data;
+    CullRange(*task->buffer, *task->boxes, start, end, task->mask);
+}
+
+void CullBoxes(const DepthBuffer& buffer, const cull::BoxArrays& boxes, u64* mask, bool parallel)
+{
+    ASSERT(mask);
+    if(parallel)
+    {
+        CullTask task = {};
+        task.buffer = &buffer;
+        task.boxes = &boxes;
+        task.mask = mask;
+        async::ParallelFor(boxes.count, TY_OCCLUSION_PARALLEL_BATCH, CullTaskProc, &task);
+    }
+    else
+    {
+        CullRange(buffer, boxes, 0, boxes.count, mask);
+    }
+}
+
+};
+};
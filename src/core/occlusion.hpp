@@ -0,0 +1,95 @@
+// ========================================================
+// OCCLUSION
+// Software occlusion culling: a few large occluder meshes (walls, floors, terrain) are
+// rasterized into a small depth buffer on the CPU, then object bounds are tested against
+// it, so objects behind the occluders are dropped before draw submission. Meant to run
+// after frustum culling (core/cull), it only clears objects proven hidden.
+// The buffer is split in 8x8 pixel tiles, each keeping its 64 depths as 8 rows of 8 lanes
+// (core/simd's 8-wide vectors) and the farthest of them. Triangles are clipped to the near
+// plane and set up once, then rasterized a tile at a time with edge functions: each row
+// gives a coverage mask, and depth is written where covered and nearer (Hasselgren et al.,
+// "Masked Software Occlusion Culling", 2016, without the compressed layers). Tiles already
+// nearer than a whole triangle are skipped. Rows of tiles are independent, so rendering
+// runs across the async workers.
+// Tests project a box's 8 corners and compare its nearest depth with the farthest depth of
+// each tile it covers, reading pixels only for tiles that don't settle it.
+// Depth is clip z / w as in math::PerspectiveRH, 0 at the near plane and 1 at the far one.
+// Coverage is sampled at pixel centers, so occluders should sit slightly inside what they
+// stand for, as occlusion meshes usually do.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./debug.hpp"
+#include "./memory.hpp"
+#include "./simd.hpp"
+#include "./math.hpp"
+#include "./async.hpp"
+#include "./cull.hpp"
+#include "./ds.hpp"
+
+namespace ty
+{
+namespace occlusion
+{
+
+#define TY_OCCLUSION_TILE_SIZE 8
+#define TY_OCCLUSION_PARALLEL_BATCH 1024    // Boxes per parallel task. Multiple of 64, so mask words aren't shared.
+
+struct Occluder
+{
+    const f32* positions = NULL;        // Packed xyz.
+    const u32* indices = NULL;          // 3 per triangle.
+    u32 triangleCount = 0;
+    m4f transform = math::Identity();   // Model to world.
+    bool cullBackFaces = false;         // Counter-clockwise front faces, as in glTF. Only for closed meshes.
+};
+
+// Screen space triangle, ready for rasterization.
+struct Triangle
+{
+    f32 x[3];                           // Pixels.
+    f32 y[3];
+    f32 edgeX[3];                       // Edge i, from vertex i to the next, is edgeX * (x - x[i]) + edgeY * (y - y[i]),
+    f32 edgeY[3];                       // positive inside.
+    f32 depth;                          // At vertex 0.
+    f32 depthX;                         // Per pixel.
+    f32 depthY;
+    f32 minDepth;
+    u16 minTileX;
+    u16 minTileY;
+    u16 maxTileX;
+    u16 maxTileY;
+};
+
+struct DepthBuffer
+{
+    u32 width = 0;                      // Pixels, multiples of the tile size.
+    u32 height = 0;
+    u32 tilesX = 0;
+    u32 tilesY = 0;
+    SArray<f32> depths;                 // Tile after tile, rows of 8 pixels.
+    SArray<f32> tileDepths;             // Farthest depth of each tile.
+    SArray<Triangle> triangles;         // Scratch for RenderOccluders.
+    m4f viewProj = {};
+};
+
+// Up to maxTriangles after near plane clipping, per RenderOccluders call.
+DepthBuffer MakeDepthBuffer(mem::Arena* arena, u32 width, u32 height, u32 maxTriangles);
+
+// Empties the buffer and sets the camera for the next renders and tests.
+void Clear(DepthBuffer* buffer, const m4f& viewProj);
+void RenderOccluders(DepthBuffer* buffer, const Occluder* occluders, u32 count, bool parallel = false);
+
+// ========================================================
+// [TESTS]
+// Boxes crossing the near plane or outside the screen are never occluded.
+bool IsOccluded(const DepthBuffer& buffer, math::AABB aabb);
+
+// Clears the bits of occluded boxes in a mask from cull::CullBoxes (same layout), boxes with
+// their bit already clear aren't tested. cull::MaskToIndices gives the visible list.
+void CullBoxes(const DepthBuffer& buffer, const cull::BoxArrays& boxes, u64* mask, bool parallel = false);
+
+};
+};
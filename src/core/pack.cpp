@@ -0,0 +1,365 @@
+#include "./pack.hpp"
+
+namespace ty
+{
+namespace pack
+{
+
+static Pack packMounts[TY_PACK_MAX_MOUNTS];
+static u32 packMountCount = 0;
+
+inline char NormalizePathChar(char c)
+{
+    if(c == '\\') return '/';
+    if(c >= 'A' && c <= 'Z') return c + ('a' - 'A');
+    return c;
+}
+
+u64 NormalizePath(String path, char* output, u64 outputSize)
+{
+    // Lowercase, forward slashes, no leading "./" or "/".
+    u64 start = 0;
+    while(start < path.len)
+    {
+        char c = NormalizePathChar(path[start]);
+        if(c == '/') start++;
+        else if(c == '.' && start + 1 < path.len && NormalizePathChar(path[start + 1]) == '/') start += 2;
+        else break;
+    }
+    u64 len = 0;
+    for(u64 i = start; i < path.len && len + 1 < outputSize; i++)
+    {
+        output[len++] = NormalizePathChar(path[i]);
+    }
+    ASSERT(len + 1 < outputSize || start + len == path.len);
+    output[len] = 0;
+    return len;
+}
+
+u64 HashNormalizedPath(const char* path, u64 len)
+{
+    // FNV-1a 64
+    u64 result = 0xCBF29CE484222325ULL;
+    for(u64 i = 0; i < len; i++)
+    {
+        result ^= (u8)path[i];
+        result *= 0x100000001B3ULL;
+    }
+    return result;
+}
+
+u64 HashPath(String path)
+{
+    char normalized[MAX_PATH * 2];
+    u64 len = NormalizePath(path, normalized, sizeof(normalized));
+    return HashNormalizedPath(normalized, len);
+}
+
+bool Mount(String packPath, String mountPoint)
+{
+    ASSERT(packMountCount < TY_PACK_MAX_MOUNTS);
+    Pack pack = {};
+    pack.hFile = CreateFile(
+            packPath.CStr(),
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            NULL,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL,
+            NULL);
+    if(pack.hFile == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize = {};
+    if(!GetFileSizeEx(pack.hFile, &fileSize) || (u64)fileSize.QuadPart < sizeof(PackHeader))
+    {
+        CloseHandle(pack.hFile);
+        return false;
+    }
+    pack.size = fileSize.QuadPart;
+    pack.hMapping = CreateFileMapping(pack.hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(pack.hMapping) pack.data = (byte*)MapViewOfFile(pack.hMapping, FILE_MAP_READ, 0, 0, 0);
+    if(!pack.data)
+    {
+        if(pack.hMapping) CloseHandle(pack.hMapping);
+        CloseHandle(pack.hFile);
+        return false;
+    }
+
+    PackHeader* header = (PackHeader*)(pack.data + pack.size - sizeof(PackHeader));
+    bool valid = header->magic == TY_PACK_MAGIC
+        && header->version == TY_PACK_VERSION
+        && header->tocOffset + (u64)header->entryCount * sizeof(PackEntry) <= pack.size
+        && header->namesOffset + header->namesSize <= pack.size
+        && IS_ALIGNED(header->tocOffset, alignof(PackEntry));
+    if(!valid)
+    {
+        UnmapViewOfFile(pack.data);
+        CloseHandle(pack.hMapping);
+        CloseHandle(pack.hFile);
+        return false;
+    }
+    pack.header = header;
+    pack.entries = (PackEntry*)(pack.data + header->tocOffset);
+    pack.names = (char*)(pack.data + header->namesOffset);
+
+    pack.mountPointLen = NormalizePath(mountPoint, pack.mountPoint, sizeof(pack.mountPoint) - 1);
+    if(pack.mountPointLen && pack.mountPoint[pack.mountPointLen - 1] != '/')
+    {
+        pack.mountPoint[pack.mountPointLen++] = '/';
+        pack.mountPoint[pack.mountPointLen] = 0;
+    }
+
+    packMounts[packMountCount++] = pack;
+    return true;
+}
+
+void UnmountAll()
+{
+    for(u32 i = 0; i < packMountCount; i++)
+    {
+        UnmapViewOfFile(packMounts[i].data);
+        CloseHandle(packMounts[i].hMapping);
+        CloseHandle(packMounts[i].hFile);
+        packMounts[i] = {};
+    }
+    packMountCount = 0;
+}
+
+u32 GetMountCount()
+{
+    return packMountCount;
+}
+
+PackEntry* FindEntryInPack(Pack* pack, const char* name, u64 nameLen)
+{
+    u64 hash = HashNormalizedPath(name, nameLen);
+    PackEntry* entries = pack->entries;
+    u64 lo = 0;
+    u64 hi = pack->header->entryCount;
+    while(lo < hi)
+    {
+        u64 mid = lo + (hi - lo) / 2;
+        if(entries[mid].hash < hash) lo = mid + 1;
+        else hi = mid;
+    }
+    for(u64 i = lo; i < pack->header->entryCount && entries[i].hash == hash; i++)
+    {
+        PackEntry* entry = &entries[i];
+        if(entry->nameLen == nameLen
+                && entry->nameOffset + nameLen <= pack->header->namesSize
+                && memcmp(pack->names + entry->nameOffset, name, nameLen) == 0)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+PackEntry* FindEntry(String path, Pack** outPack)
+{
+    if(!packMountCount || !path.len) return NULL;
+
+    char normalized[MAX_PATH * 2];
+    u64 len = NormalizePath(path, normalized, sizeof(normalized));
+    for(i32 i = (i32)packMountCount - 1; i >= 0; i--)
+    {
+        Pack* pack = &packMounts[i];
+        if(len < pack->mountPointLen || memcmp(normalized, pack->mountPoint, pack->mountPointLen) != 0) continue;
+        PackEntry* entry = FindEntryInPack(pack, normalized + pack->mountPointLen, len - pack->mountPointLen);
+        if(entry)
+        {
+            if(outPack) *outPack = pack;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+bool ReadEntry(Pack* pack, PackEntry* entry, byte* output)
+{
+    ASSERT(pack && entry);
+    if(entry->offset + entry->size > pack->size) return false;
+    byte* src = pack->data + entry->offset;
+    switch(entry->compression)
+    {
+        case PACK_COMPRESSION_NONE:
+        {
+            if(entry->size != entry->rawSize) return false;
+            memcpy(output, src, entry->size);
+            return true;
+        } break;
+        case PACK_COMPRESSION_LZ:
+        {
+            return compress::DecompressFrame(src, entry->size, output, entry->rawSize);
+        } break;
+        default: break;
+    }
+    return false;
+}
+
+byte* GetEntryData(Pack* pack, PackEntry* entry)
+{
+    ASSERT(pack && entry);
+    if(entry->compression != PACK_COMPRESSION_NONE) return NULL;
+    if(entry->offset + entry->size > pack->size) return NULL;
+    return pack->data + entry->offset;
+}
+
+String GetEntryName(Pack* pack, PackEntry* entry)
+{
+    ASSERT(pack && entry);
+    return Str((byte*)pack->names + entry->nameOffset, entry->nameLen);
+}
+
+struct PackBuildItem
+{
+    u64 hash = 0;
+    String name;        // Normalized, relative to root.
+    String path;        // Source file path.
+    u64 size = 0;
+};
+
+i32 ComparePackBuildItems(const void* a, const void* b)
+{
+    PackBuildItem* ia = (PackBuildItem*)a;
+    PackBuildItem* ib = (PackBuildItem*)b;
+    if(ia->hash != ib->hash) return ia->hash < ib->hash ? -1 : 1;
+    i32 cmp = memcmp(ia->name.data, ib->name.data, MIN(ia->name.len, ib->name.len));
+    if(cmp != 0) return cmp;
+    return ia->name.len < ib->name.len ? -1 : (ia->name.len > ib->name.len ? 1 : 0);
+}
+
+#define TY_PACK_MIN_COMPRESSION_SAVINGS 0.1f     // Keep compressed entries only if at least 10% smaller.
+
+bool WritePackPadding(file::FileWriter* writer, u64 padding)
+{
+    static const byte zeros[KB(4)] = {};
+    while(padding)
+    {
+        u64 size = MIN(padding, sizeof(zeros));
+        file::Write(writer, zeros, size);
+        padding -= size;
+    }
+    return writer->IsValid();
+}
+
+bool BuildPack(String outputPath, String rootDir, SArray<file::DirEntry> files, PackBuildDesc desc)
+{
+    ASSERT(desc.alignment > 0 && IS_POW2(desc.alignment));
+    MEM_ARENA_SCRATCH_START(scratch);
+
+    char rootNormalized[MAX_PATH * 2];
+    u64 rootLen = NormalizePath(rootDir, rootNormalized, sizeof(rootNormalized));
+    while(rootLen && rootNormalized[rootLen - 1] == '/')
+    {
+        rootLen--;
+    }
+    if(rootLen == 1 && rootNormalized[0] == '.') rootLen = 0;     // Walked paths lose their "./".
+
+    // Normalized names relative to root, sorted by hash.
+    u64 count = files.count;
+    PackBuildItem* items = count ? (PackBuildItem*)mem::ArenaPush(scratch, count * sizeof(PackBuildItem)) : NULL;
+    u64 namesSize = 0;
+    for(u64 i = 0; i < count; i++)
+    {
+        char normalized[MAX_PATH * 2];
+        u64 len = NormalizePath(files[i].path, normalized, sizeof(normalized));
+        bool inRoot = len > rootLen
+            && memcmp(normalized, rootNormalized, rootLen) == 0
+            && (rootLen == 0 || normalized[rootLen] == '/');
+        if(!inRoot)
+        {
+            LOGLF("PACK", "File is outside pack root: %s", files[i].path.CStr());
+            MEM_ARENA_SCRATCH_END(scratch);
+            return false;
+        }
+        u64 nameStart = rootLen ? rootLen + 1 : 0;
+        items[i] = {};
+        items[i].name = Str(scratch, Str((byte*)normalized + nameStart, len - nameStart));
+        items[i].hash = HashNormalizedPath(items[i].name.CStr(), items[i].name.len);
+        items[i].path = files[i].path;
+        items[i].size = files[i].size;
+        namesSize += items[i].name.len;
+    }
+    if(count) qsort(items, count, sizeof(PackBuildItem), ComparePackBuildItems);
+    for(u64 i = 1; i < count; i++)
+    {
+        if(ComparePackBuildItems(&items[i - 1], &items[i]) == 0)
+        {
+            LOGLF("PACK", "Duplicate pack entry: %s", items[i].name.CStr());
+            MEM_ARENA_SCRATCH_END(scratch);
+            return false;
+        }
+    }
+
+    file::FileWriterDesc writerDesc = {};
+    writerDesc.bufferSize = MB(4);
+    writerDesc.atomic = true;
+    file::FileWriter writer = file::MakeFileWriter(scratch, outputPath, writerDesc);
+    PackEntry* entries = count ? (PackEntry*)mem::ArenaPush(scratch, count * sizeof(PackEntry)) : NULL;
+
+    // Entry data
+    u64 offset = 0;
+    u32 nameOffset = 0;
+    for(u64 i = 0; i < count && writer.IsValid(); i++)
+    {
+        PackBuildItem& item = items[i];
+        u64 alignedOffset = ALIGN_TO(offset, (u64)desc.alignment);
+        WritePackPadding(&writer, alignedOffset - offset);
+        offset = alignedOffset;
+
+        PackEntry entry = {};
+        entry.hash = item.hash;
+        entry.offset = offset;
+        entry.nameOffset = nameOffset;
+        entry.nameLen = (u32)item.name.len;
+        entry.compression = PACK_COMPRESSION_NONE;
+        if(item.size)
+        {
+            MEM_ARENA_CHECKPOINT_SET(scratch, fileData);
+            u64 size = 0;
+            byte* data = file::ReadFileToBuffer(scratch, item.path, &size);
+            entry.size = size;
+            entry.rawSize = size;
+            if(desc.compress)
+            {
+                u64 frameCapacity = compress::GetMaxFrameSize(size);
+                byte* frame = (byte*)mem::ArenaPush(scratch, frameCapacity);
+                u64 frameSize = compress::CompressFrame(data, size, frame, frameCapacity);
+                if(frameSize && frameSize <= (u64)(size * (1.f - TY_PACK_MIN_COMPRESSION_SAVINGS)))
+                {
+                    data = frame;
+                    entry.size = frameSize;
+                    entry.compression = PACK_COMPRESSION_LZ;
+                }
+            }
+            file::Write(&writer, data, entry.size);
+            MEM_ARENA_CHECKPOINT_RESET(scratch, fileData);
+        }
+        entries[i] = entry;
+        offset += entry.size;
+        nameOffset += entry.nameLen;
+    }
+
+    // Table of contents, names and header
+    PackHeader header = {};
+    header.entryCount = (u32)count;
+    header.alignment = desc.alignment;
+    header.tocOffset = ALIGN_TO(offset, (u64)alignof(PackEntry));
+    header.namesOffset = header.tocOffset + count * sizeof(PackEntry);
+    header.namesSize = namesSize;
+    WritePackPadding(&writer, header.tocOffset - offset);
+    if(count) file::Write(&writer, entries, count * sizeof(PackEntry));
+    for(u64 i = 0; i < count; i++)
+    {
+        file::Write(&writer, items[i].name.data, items[i].name.len);
+    }
+    file::Write(&writer, &header, sizeof(PackHeader));
+
+    bool result = file::CloseFileWriter(&writer);
+    MEM_ARENA_SCRATCH_END(scratch);
+    return result;
+}
+
+};
+};
@@ -0,0 +1,98 @@
+// ========================================================
+// PACK
+// Pack archives and virtual file system. A pack is a single file holding many
+// files, memory mapped once when mounted. File reads in core/file resolve through
+// mounted packs first and fall back to disk.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./string.hpp"
+#include "./file.hpp"
+#include "./compress.hpp"
+
+namespace ty
+{
+namespace pack
+{
+
+// ========================================================
+// [FORMAT]
+// Layout: [entry data (aligned)...][table of contents][names][header]
+// The header is stored at the end of the file so packs can be written in a single
+// sequential pass. Table of contents is sorted by path hash for binary search.
+// Paths are stored normalized: relative to the pack root, lowercase, '/' separators.
+#define TY_PACK_MAGIC 0x4B505954       // 'TYPK'
+#define TY_PACK_VERSION 1
+#define TY_PACK_MAX_MOUNTS 16
+
+enum PackCompression : u32
+{
+    PACK_COMPRESSION_NONE = 0,
+    PACK_COMPRESSION_LZ = 1,        // compress::Frame
+};
+
+struct PackHeader
+{
+    u32 magic = TY_PACK_MAGIC;
+    u32 version = TY_PACK_VERSION;
+    u32 entryCount = 0;
+    u32 alignment = 0;
+    u64 tocOffset = 0;
+    u64 namesOffset = 0;
+    u64 namesSize = 0;
+};
+
+struct PackEntry
+{
+    u64 hash = 0;           // HashPath of the normalized name.
+    u64 offset = 0;         // Stored data offset from start of pack.
+    u64 size = 0;           // Stored (possibly compressed) size.
+    u64 rawSize = 0;        // Original file size.
+    u32 nameOffset = 0;     // Offset in names block.
+    u32 nameLen = 0;
+    PackCompression compression = PACK_COMPRESSION_NONE;
+    u32 reserved = 0;
+};
+
+// ========================================================
+// [MOUNTING]
+struct Pack
+{
+    char mountPoint[MAX_PATH];  // Normalized, empty or ending in '/'.
+    u64 mountPointLen = 0;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    HANDLE hMapping = NULL;
+    byte* data = NULL;
+    u64 size = 0;
+    PackHeader* header = NULL;
+    PackEntry* entries = NULL;
+    char* names = NULL;
+};
+
+u64 HashPath(String path);
+
+// Packs mounted later take precedence over earlier ones.
+bool Mount(String packPath, String mountPoint = "");
+void UnmountAll();
+u32 GetMountCount();
+
+PackEntry*  FindEntry(String path, Pack** outPack = NULL);
+bool        ReadEntry(Pack* pack, PackEntry* entry, byte* output);     // Output must hold entry->rawSize bytes.
+byte*       GetEntryData(Pack* pack, PackEntry* entry);                // Zero-copy view, NULL if entry is compressed.
+String      GetEntryName(Pack* pack, PackEntry* entry);
+
+// ========================================================
+// [BUILDING]
+struct PackBuildDesc
+{
+    u32 alignment = 16;     // Entry data alignment, power of 2.
+    bool compress = false;  // Entries that don't shrink enough are stored uncompressed.
+};
+
+// Files must be inside rootDir. Names in the pack are relative to rootDir.
+bool BuildPack(String outputPath, String rootDir, SArray<file::DirEntry> files, PackBuildDesc desc = {});
+
+};
+};
@@ -0,0 +1,453 @@
+#include "./profile.hpp"
+#include "./file.hpp"
+#include <intrin.h>
+
+namespace ty
+{
+namespace profile
+{
+
+struct TrackedZone
+{
+    const char* name = NULL;
+    const char* matched = NULL;         // Recorded name pointer known to match.
+    stats::Histogram* histogram = NULL;
+};
+
+struct Profiler
+{
+    bool initialized = false;
+    ProfileDesc desc = {};
+    mem::Arena* arena = NULL;
+
+    ThreadRing* volatile rings[TY_PROFILE_MAX_THREADS] = {};
+    volatile LONG ringCount = 0;
+
+    u64 frameIndex = 0;
+    u64 frameStart = 0;
+    u64 droppedRecords = 0;
+
+    // Zone stats, frameStats[i] and totalStats[i] are the same zone.
+    HashMap<u64, u32> zoneIndices;
+    SArray<ZoneStats> frameStats;
+    SArray<ZoneStats> totalStats;
+
+    bool capturing = false;
+    u64 captureStart = 0;
+    SArray<CaptureEvent> captureEvents;
+
+    TrackedZone trackedZones[TY_PROFILE_MAX_TRACKED_ZONES];
+    u32 trackedZoneCount = 0;
+};
+
+static Profiler profiler;
+static thread_local ThreadRing* threadRing = NULL;
+
+#define TY_PROFILE_FRAME_TRACK ((u32)MAX_U32)   // Capture event thread index for frame markers.
+
+void Init(ProfileDesc desc)
+{
+    ASSERT(!profiler.initialized);
+    ASSERT(desc.ringSize > 0 && IS_POW2(desc.ringSize));
+    ASSERT(desc.maxCaptureEvents > 0);
+    time::InitTimestamps();
+
+    u64 arenaSize = TY_PROFILE_MAX_ZONES * 2 * sizeof(HashMap<u64, u32>::Bucket)
+        + TY_PROFILE_MAX_ZONES * 2 * sizeof(ZoneStats)
+        + desc.maxCaptureEvents * sizeof(CaptureEvent)
+        + KB(4);
+    profiler.desc = desc;
+    profiler.arena = mem::MakeArena(arenaSize);
+    profiler.zoneIndices = MakeMap<u64, u32>(profiler.arena, TY_PROFILE_MAX_ZONES * 2);
+    profiler.frameStats = MakeSArray<ZoneStats>(profiler.arena, TY_PROFILE_MAX_ZONES);
+    profiler.totalStats = MakeSArray<ZoneStats>(profiler.arena, TY_PROFILE_MAX_ZONES);
+    profiler.captureEvents = MakeSArray<CaptureEvent>(profiler.arena, desc.maxCaptureEvents);
+    profiler.frameStart = time::GetTimestamp();
+    _ReadWriteBarrier();
+    profiler.initialized = true;
+}
+
+void Shutdown()
+{
+    // Instrumented threads other than the caller must have exited, their rings are freed here.
+    if(!profiler.initialized) return;
+    profiler.initialized = false;
+    for(u32 i = 0; i < TY_PROFILE_MAX_THREADS; i++)
+    {
+        if(profiler.rings[i]) mem::DestroyArena(profiler.rings[i]->arena);
+    }
+    mem::DestroyArena(profiler.arena);
+    profiler = {};
+    threadRing = NULL;
+}
+
+ThreadRing* RegisterThread(const char* name)
+{
+    if(!profiler.initialized) return NULL;
+    if(!threadRing)
+    {
+        LONG slot = InterlockedIncrement(&profiler.ringCount) - 1;
+        if(slot >= TY_PROFILE_MAX_THREADS)
+        {
+            // Out of rings, this thread stays uninstrumented.
+            InterlockedDecrement(&profiler.ringCount);
+            return NULL;
+        }
+        u64 ringSize = profiler.desc.ringSize;
+        mem::Arena* ringArena = mem::MakeArena(sizeof(ThreadRing) + ringSize * sizeof(ZoneRecord) + 64);
+        ThreadRing* ring = (ThreadRing*)mem::ArenaPush(ringArena, sizeof(ThreadRing), 64);
+        *ring = {};
+        ring->arena = ringArena;
+        ring->records = (ZoneRecord*)mem::ArenaPush(ringArena, ringSize * sizeof(ZoneRecord));
+        ring->mask = ringSize - 1;
+        ring->threadIndex = (u32)slot;
+        snprintf(ring->name, sizeof(ring->name), "Thread %u", (u32)slot);
+        threadRing = ring;
+        _ReadWriteBarrier();
+        profiler.rings[slot] = ring;
+    }
+    if(name) snprintf(threadRing->name, sizeof(threadRing->name), "%s", name);
+    return threadRing;
+}
+
+void BeginZone(const char* name)
+{
+    ASSERT(name);
+    ThreadRing* ring = threadRing;
+    if(!ring)
+    {
+        ring = RegisterThread(NULL);
+        if(!ring) return;
+    }
+    u64 index = ring->writeIndex;
+    ZoneRecord& record = ring->records[index & ring->mask];
+    record.name = name;
+    record.timestamp = time::GetTimestamp();
+    // Record must be visible before the index that publishes it.
+    _ReadWriteBarrier();
+    ring->writeIndex = index + 1;
+}
+
+void EndZone()
+{
+    u64 timestamp = time::GetTimestamp();
+    ThreadRing* ring = threadRing;
+    if(!ring) return;
+    u64 index = ring->writeIndex;
+    ZoneRecord& record = ring->records[index & ring->mask];
+    record.name = NULL;
+    record.timestamp = timestamp;
+    _ReadWriteBarrier();
+    ring->writeIndex = index + 1;
+}
+
+ZoneStats* GetZoneStats(const char* name, SArray<ZoneStats>* stats)
+{
+    i64 pos = profiler.zoneIndices.Find((u64)name);
+    if(pos != -1) return &(*stats)[profiler.zoneIndices.buckets[pos].value];
+    if(profiler.totalStats.count >= TY_PROFILE_MAX_ZONES) return NULL;
+
+    ZoneStats zone = {};
+    zone.name = name;
+    u32 index = (u32)profiler.totalStats.Push(zone);
+    profiler.frameStats.Push(zone);
+    profiler.zoneIndices.Insert((u64)name, index);
+    return &(*stats)[index];
+}
+
+void AddZoneTime(SArray<ZoneStats>* stats, const char* name, u64 ticks, u64 selfTicks)
+{
+    ZoneStats* zone = GetZoneStats(name, stats);
+    if(!zone) return;
+    zone->calls++;
+    zone->totalTicks += ticks;
+    zone->selfTicks += selfTicks;
+    zone->maxTicks = MAX(zone->maxTicks, ticks);
+}
+
+void RecordTrackedZone(const char* name, u64 ticks)
+{
+    for(u32 i = 0; i < profiler.trackedZoneCount; i++)
+    {
+        TrackedZone& tracked = profiler.trackedZones[i];
+        if(tracked.matched != name)
+        {
+            if(tracked.matched || strcmp(tracked.name, name) != 0) continue;
+            tracked.matched = name;
+        }
+        stats::Record(tracked.histogram, time::TimestampToNSec(ticks));
+    }
+}
+
+void PushCaptureEvent(const char* name, u64 start, u64 duration, u32 threadIndex)
+{
+    if(!profiler.capturing || start < profiler.captureStart) return;
+    if(profiler.captureEvents.count >= profiler.captureEvents.capacity)
+    {
+        LOGLF("PROFILE", "Capture buffer full, stopped recording at %llu events.", profiler.captureEvents.count);
+        profiler.capturing = false;
+        return;
+    }
+    CaptureEvent event = {};
+    event.name = name;
+    event.start = start;
+    event.duration = duration;
+    event.threadIndex = threadIndex;
+    profiler.captureEvents.Push(event);
+}
+
+void DrainRing(ThreadRing* ring)
+{
+    u64 writeIndex = ring->writeIndex;
+    _ReadWriteBarrier();
+    u64 capacity = ring->mask + 1;
+    if(writeIndex - ring->readIndex > capacity)
+    {
+        // Thread wrapped around its ring since the last drain. Open zones can't be matched anymore.
+        profiler.droppedRecords += writeIndex - ring->readIndex - capacity;
+        ring->readIndex = writeIndex - capacity;
+        ring->depth = 0;
+    }
+
+    while(ring->readIndex < writeIndex)
+    {
+        ZoneRecord record = ring->records[ring->readIndex & ring->mask];
+        _ReadWriteBarrier();
+        // The owner may have lapped the reader while copying, the record is then stale.
+        if(ring->writeIndex - ring->readIndex > capacity)
+        {
+            profiler.droppedRecords++;
+            ring->readIndex++;
+            ring->depth = 0;
+            continue;
+        }
+        ring->readIndex++;
+
+        if(record.name)
+        {
+            if(ring->depth < TY_PROFILE_MAX_DEPTH)
+            {
+                ring->stack[ring->depth] = { record.name, record.timestamp, 0 };
+            }
+            ring->depth++;
+            continue;
+        }
+
+        if(ring->depth == 0) continue;      // End of a zone whose begin was dropped.
+        ring->depth--;
+        if(ring->depth >= TY_PROFILE_MAX_DEPTH) continue;
+        OpenZone zone = ring->stack[ring->depth];
+        u64 ticks = record.timestamp - zone.start;
+        u64 selfTicks = ticks > zone.childTicks ? ticks - zone.childTicks : 0;
+        if(ring->depth > 0) ring->stack[ring->depth - 1].childTicks += ticks;
+
+        AddZoneTime(&profiler.frameStats, zone.name, ticks, selfTicks);
+        AddZoneTime(&profiler.totalStats, zone.name, ticks, selfTicks);
+        if(profiler.trackedZoneCount) RecordTrackedZone(zone.name, ticks);
+        PushCaptureEvent(zone.name, zone.start, ticks, ring->threadIndex);
+    }
+}
+
+void FrameMark()
+{
+    if(!profiler.initialized) return;
+    PROFILE_SCOPE("profile::FrameMark");
+    u64 frameEnd = time::GetTimestamp();
+
+    for(u32 i = 0; i < profiler.frameStats.count; i++)
+    {
+        ZoneStats& zone = profiler.frameStats[i];
+        zone = { zone.name };
+    }
+    u64 droppedRecords = profiler.droppedRecords;
+    u32 ringCount = MIN((u32)profiler.ringCount, TY_PROFILE_MAX_THREADS);
+    for(u32 i = 0; i < ringCount; i++)
+    {
+        ThreadRing* ring = profiler.rings[i];
+        if(ring) DrainRing(ring);
+    }
+    if(profiler.droppedRecords != droppedRecords)
+    {
+        LOGLF("PROFILE", "Dropped %llu zone records in frame %llu, ring size is too small.",
+                profiler.droppedRecords - droppedRecords, profiler.frameIndex);
+    }
+
+    PushCaptureEvent("Frame", profiler.frameStart, frameEnd - profiler.frameStart, TY_PROFILE_FRAME_TRACK);
+    profiler.frameStart = frameEnd;
+    profiler.frameIndex++;
+}
+
+u64 GetFrameIndex()
+{
+    return profiler.frameIndex;
+}
+
+i32 CompareZoneStats(const void* a, const void* b)
+{
+    u64 ta = ((ZoneStats*)a)->totalTicks;
+    u64 tb = ((ZoneStats*)b)->totalTicks;
+    return ta > tb ? -1 : (ta < tb ? 1 : 0);
+}
+
+SArray<ZoneStats> CopySortedStats(mem::Arena* arena, SArray<ZoneStats>& stats)
+{
+    u64 count = 0;
+    for(u32 i = 0; i < stats.count; i++)
+    {
+        if(stats[i].calls) count++;
+    }
+    SArray<ZoneStats> result = {};
+    if(count == 0) return result;
+    result = MakeSArray<ZoneStats>(arena, count);
+    for(u32 i = 0; i < stats.count; i++)
+    {
+        if(stats[i].calls) result.Push(stats[i]);
+    }
+    qsort(result.data, result.count, sizeof(ZoneStats), CompareZoneStats);
+    return result;
+}
+
+SArray<ZoneStats> GetFrameStats(mem::Arena* arena)
+{
+    return CopySortedStats(arena, profiler.frameStats);
+}
+
+SArray<ZoneStats> GetTotalStats(mem::Arena* arena)
+{
+    return CopySortedStats(arena, profiler.totalStats);
+}
+
+void ResetTotalStats()
+{
+    for(u32 i = 0; i < profiler.totalStats.count; i++)
+    {
+        ZoneStats& zone = profiler.totalStats[i];
+        zone = { zone.name };
+    }
+}
+
+void LogSummary(u32 maxZones)
+{
+    MEM_ARENA_SCRATCH_START(scratch);
+    SArray<ZoneStats> stats = GetTotalStats(scratch);
+    LOGLF("PROFILE", "%-40s %10s %12s %12s %12s %12s", "Zone", "Calls", "Total ms", "Self ms", "Avg us", "Max us");
+    for(u32 i = 0; i < MIN(stats.count, (u64)maxZones); i++)
+    {
+        ZoneStats& zone = stats[i];
+        LOGLF("PROFILE", "%-40s %10llu %12.3f %12.3f %12.3f %12.3f",
+                zone.name, zone.calls,
+                time::TimestampToNSec(zone.totalTicks) / 1e6,
+                time::TimestampToNSec(zone.selfTicks) / 1e6,
+                time::TimestampToNSec(zone.totalTicks / zone.calls) / 1e3,
+                time::TimestampToNSec(zone.maxTicks) / 1e3);
+    }
+    MEM_ARENA_SCRATCH_END(scratch);
+}
+
+void TrackZone(const char* name, stats::Histogram* histogram)
+{
+    ASSERT(name && histogram);
+    ASSERT(profiler.trackedZoneCount < TY_PROFILE_MAX_TRACKED_ZONES);
+    TrackedZone& tracked = profiler.trackedZones[profiler.trackedZoneCount++];
+    tracked = {};
+    tracked.name = name;
+    tracked.histogram = histogram;
+}
+
+void UntrackZone(const char* name)
+{
+    for(u32 i = 0; i < profiler.trackedZoneCount;)
+    {
+        if(strcmp(profiler.trackedZones[i].name, name) == 0)
+        {
+            profiler.trackedZones[i] = profiler.trackedZones[--profiler.trackedZoneCount];
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+void StartCapture()
+{
+    if(!profiler.initialized) return;
+    profiler.captureEvents.Clear();
+    profiler.captureStart = time::GetTimestamp();
+    profiler.capturing = true;
+}
+
+bool IsCapturing()
+{
+    return profiler.capturing;
+}
+
+void WriteJsonString(file::FileWriter* writer, const char* str)
+{
+    char buffer[512];
+    u64 len = 0;
+    buffer[len++] = '"';
+    for(const char* c = str; *c && len < sizeof(buffer) - 3; c++)
+    {
+        if(*c == '"' || *c == '\\') buffer[len++] = '\\';
+        buffer[len++] = *c < ' ' ? ' ' : *c;
+    }
+    buffer[len++] = '"';
+    file::Write(writer, buffer, len);
+}
+
+bool StopCapture(String path)
+{
+    if(!profiler.initialized) return false;
+    profiler.capturing = false;
+
+    MEM_ARENA_SCRATCH_START(scratch);
+    file::FileWriter writer = file::MakeFileWriter(scratch, path);
+    if(!writer.IsValid())
+    {
+        MEM_ARENA_SCRATCH_END(scratch);
+        return false;
+    }
+
+    char line[256];
+    i32 len = snprintf(line, sizeof(line), "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    file::Write(&writer, line, len);
+    len = snprintf(line, sizeof(line), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"Frames\"}}",
+            TY_PROFILE_FRAME_TRACK);
+    file::Write(&writer, line, len);
+    u32 ringCount = MIN((u32)profiler.ringCount, TY_PROFILE_MAX_THREADS);
+    for(u32 i = 0; i < ringCount; i++)
+    {
+        ThreadRing* ring = profiler.rings[i];
+        if(!ring) continue;
+        len = snprintf(line, sizeof(line), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":", ring->threadIndex);
+        file::Write(&writer, line, len);
+        WriteJsonString(&writer, ring->name);
+        file::Write(&writer, "}}", 2);
+    }
+
+    // Complete ("X") events, timestamps in microseconds since capture start.
+    for(u64 i = 0; i < profiler.captureEvents.count; i++)
+    {
+        CaptureEvent& event = profiler.captureEvents[i];
+        len = snprintf(line, sizeof(line), ",\n{\"name\":");
+        file::Write(&writer, line, len);
+        WriteJsonString(&writer, event.name);
+        len = snprintf(line, sizeof(line), ",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                event.threadIndex,
+                time::TimestampToNSec(event.start - profiler.captureStart) / 1e3,
+                time::TimestampToNSec(event.duration) / 1e3);
+        file::Write(&writer, line, len);
+    }
+    file::Write(&writer, "\n]}\n", 4);
+    bool result = file::CloseFileWriter(&writer);
+    if(result)
+    {
+        LOGLF("PROFILE", "Wrote %llu zones to %s.", profiler.captureEvents.count, path.CStr());
+    }
+    MEM_ARENA_SCRATCH_END(scratch);
+    return result;
+}
+
+};
+};
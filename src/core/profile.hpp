@@ -0,0 +1,136 @@
+// ========================================================
+// PROFILE
+// Instrumenting CPU profiler. Zones write begin/end records (static name + timestamp)
+// into a per-thread ring buffer with no locks or allocations, so instrumentation can stay
+// in hot code. Once per frame the main thread drains all rings, aggregates zone stats
+// and optionally records a capture that is exported as Chrome trace JSON
+// (chrome://tracing, ui.perfetto.dev).
+// Enabled with _PROFILE, otherwise all macros compile to nothing.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./debug.hpp"
+#include "./memory.hpp"
+#include "./string.hpp"
+#include "./time.hpp"
+#include "./ds.hpp"
+#include "./stats.hpp"
+
+namespace ty
+{
+namespace profile
+{
+
+#define TY_PROFILE_MAX_THREADS 64
+#define TY_PROFILE_MAX_DEPTH 64
+#define TY_PROFILE_MAX_ZONES 1024       // Distinct zone names.
+#define TY_PROFILE_MAX_TRACKED_ZONES 32
+
+#if _PROFILE
+#define PROFILE_SCOPE(NAME) ty::profile::ScopedZone CONCATENATE(_profileZone, __LINE__)(NAME)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_BEGIN(NAME) ty::profile::BeginZone(NAME)
+#define PROFILE_END() ty::profile::EndZone()
+#define PROFILE_FRAME() ty::profile::FrameMark()
+#define PROFILE_THREAD(NAME) ty::profile::RegisterThread(NAME)
+#else
+#define PROFILE_SCOPE(NAME)
+#define PROFILE_FUNCTION()
+#define PROFILE_BEGIN(NAME)
+#define PROFILE_END()
+#define PROFILE_FRAME()
+#define PROFILE_THREAD(NAME)
+#endif
+
+struct ProfileDesc
+{
+    u32 ringSize = 1 << 16;             // Records per thread between frames, power of 2.
+    u32 maxCaptureEvents = 1 << 20;     // Completed zones kept while capturing.
+};
+
+// Names must be static strings (literals), only the pointer is recorded.
+struct ZoneRecord
+{
+    const char* name = NULL;            // NULL marks a zone end.
+    u64 timestamp = 0;
+};
+
+struct OpenZone
+{
+    const char* name = NULL;
+    u64 start = 0;
+    u64 childTicks = 0;
+};
+
+struct ThreadRing
+{
+    mem::Arena* arena = NULL;
+    ZoneRecord* records = NULL;
+    u64 mask = 0;
+    volatile u64 writeIndex = 0;        // Only written by the owning thread.
+    u32 threadIndex = 0;
+    char name[32] = {};
+
+    // Collector state, only touched by FrameMark.
+    u64 readIndex = 0;
+    OpenZone stack[TY_PROFILE_MAX_DEPTH];
+    u32 depth = 0;
+};
+
+struct ZoneStats
+{
+    const char* name = NULL;
+    u64 calls = 0;
+    u64 totalTicks = 0;                 // Inclusive
+    u64 selfTicks = 0;                  // Exclusive of child zones.
+    u64 maxTicks = 0;
+};
+
+struct CaptureEvent
+{
+    const char* name = NULL;
+    u64 start = 0;
+    u64 duration = 0;
+    u32 threadIndex = 0;
+};
+
+void Init(ProfileDesc desc = {});
+void Shutdown();
+
+// Threads register on their first zone. Call explicitly to name a thread in traces.
+ThreadRing* RegisterThread(const char* name);
+
+void BeginZone(const char* name);
+void EndZone();
+
+struct ScopedZone
+{
+    ScopedZone(const char* name) { BeginZone(name); }
+    ~ScopedZone() { EndZone(); }
+};
+
+// Drains all thread rings and closes the current frame. Call once per frame from the main thread.
+void FrameMark();
+u64 GetFrameIndex();
+
+// Stats for zones that ended during the last frame, and accumulated since the last reset.
+// Sorted by total time, descending.
+SArray<ZoneStats> GetFrameStats(mem::Arena* arena);
+SArray<ZoneStats> GetTotalStats(mem::Arena* arena);
+void ResetTotalStats();
+void LogSummary(u32 maxZones = 32);     // Flat summary of total stats.
+
+// Records the duration (in nanoseconds) of every zone named name into histogram, as zones
+// are drained by FrameMark. Names are matched by content.
+void TrackZone(const char* name, stats::Histogram* histogram);
+void UntrackZone(const char* name);
+
+void StartCapture();
+bool IsCapturing();
+// Stops capturing and writes collected zones as Chrome trace JSON.
+bool StopCapture(String path);
+
+};
+};
@@ -0,0 +1,471 @@
+#include "./quantize.hpp"
+
+namespace ty
+{
+namespace quantize
+{
+
+// ========================================================
+// [HALF]
+// Scalar conversions from Fabian Giesen's "float->half variants" (public domain), letting
+// the FPU do the rounding of denormals.
+
+u16 F32ToF16(f32 value)
+{
+    const u32 f32Infinity = 255u << 23;
+    const u32 f16Overflow = (127u + 16) << 23;              // 65520 and up round to infinity.
+    const u32 f16Normal = (127u - 14) << 23;                // Below 2^-14 halfs are denormal.
+    const u32 denormMagic = ((127u - 15) + (23 - 10) + 1) << 23;
+
+    u32 bits;
+    memcpy(&bits, &value, 4);
+    u32 sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    u16 result;
+    if(bits >= f16Overflow)
+    {
+        result = bits > f32Infinity ? 0x7E00 : 0x7C00;
+    }
+    else if(bits < f16Normal)
+    {
+        // Adding 0.5 lines the half denormal mantissa up with the low float bits, rounded.
+        f32 f, magic;
+        memcpy(&f, &bits, 4);
+        memcpy(&magic, &denormMagic, 4);
+        f += magic;
+        memcpy(&bits, &f, 4);
+        result = (u16)(bits - denormMagic);
+    }
+    else
+    {
+        u32 mantissaOdd = (bits >> 13) & 1;
+        bits += ((u32)(15 - 127) << 23) + 0xFFF;            // Rebias, round half up...
+        bits += mantissaOdd;                                // ...or to even on ties.
+        result = (u16)(bits >> 13);
+    }
+    return result | (u16)(sign >> 16);
+}
+
+f32 F16ToF32(u16 value)
+{
+    const u32 shiftedExponent = 0x7C00u << 13;
+    const u32 denormMagic = 113u << 23;
+
+    u32 bits = (u32)(value & 0x7FFF) << 13;
+    u32 exponent = bits & shiftedExponent;
+    bits += (127u - 15) << 23;
+    if(exponent == shiftedExponent)
+    {
+        bits += (128u - 16) << 23;                          // Infinity and NaN.
+    }
+    else if(exponent == 0)
+    {
+        f32 f, magic;
+        bits += 1 << 23;
+        memcpy(&f, &bits, 4);
+        memcpy(&magic, &denormMagic, 4);
+        f -= magic;                                         // Renormalize.
+        memcpy(&bits, &f, 4);
+    }
+    bits |= (u32)(value & 0x8000) << 16;
+
+    f32 result;
+    memcpy(&result, &bits, 4);
+    return result;
+}
+
+void F32ToF16(const f32* values, u16* result, u64 count)
+{
+    u64 i = 0;
+#if TY_SIMD_F16C
+    for(; i + 8 <= count; i += 8)
+    {
+        _mm_storeu_si128((__m128i*)(result + i), _mm256_cvtps_ph(_mm256_loadu_ps(values + i), _MM_FROUND_TO_NEAREST_INT));
+    }
+#elif TY_SIMD_NEON
+    for(; i + 4 <= count; i += 4)
+    {
+        vst1_u16(result + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(values + i))));
+    }
+#endif
+    for(; i < count; i++)
+    {
+        result[i] = F32ToF16(values[i]);
+    }
+}
+
+void F16ToF32(const u16* values, f32* result, u64 count)
+{
+    u64 i = 0;
+#if TY_SIMD_F16C
+    for(; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_ps(result + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(values + i))));
+    }
+#elif TY_SIMD_NEON
+    for(; i + 4 <= count; i += 4)
+    {
+        vst1q_f32(result + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(values + i))));
+    }
+#endif
+    for(; i < count; i++)
+    {
+        result[i] = F16ToF32(values[i]);
+    }
+}
+
+// ========================================================
+// [NORMALIZED]
+// Decoding divides instead of multiplying by the reciprocal, so codes give the exact
+// values the GPU reads (1/127 isn't representable). The divisor goes through simd::Barrier,
+// or -Ofast would turn the division back into that multiply.
+
+inline simd::f32x4 DivideCode(simd::f32x4 code, f32 scale)    { return simd::Div(code, simd::Barrier(simd::Set1(scale))); }
+inline f32 DivideCode(f32 code, f32 scale)                      { return simd::GetLane<0>(DivideCode(simd::Set1(code), scale)); }
+
+template <typename T>
+void FloatToNormalized(const f32* values, T* result, u64 count, f32 lo, f32 scale)
+{
+    simd::f32x4 vLo = simd::Set1(lo);
+    simd::f32x4 vHi = simd::Set1(1);
+    simd::f32x4 vScale = simd::Set1(scale);
+    u64 i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        simd::f32x4 v = simd::Min(simd::Max(simd::Load(values + i), vLo), vHi);
+        i32 q[4];
+        simd::Store(q, simd::ConvertToI32(simd::Mul(v, vScale)));
+        result[i] = (T)q[0];
+        result[i + 1] = (T)q[1];
+        result[i + 2] = (T)q[2];
+        result[i + 3] = (T)q[3];
+    }
+    for(; i < count; i++)
+    {
+        result[i] = (T)rintf(CLAMP(values[i], lo, 1.f) * scale);
+    }
+}
+
+template <typename T>
+void NormalizedToFloat(const T* values, f32* result, u64 count, f32 lo, f32 scale)
+{
+    simd::f32x4 vLo = simd::Set1(lo);
+    u64 i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        i32 q[4] = { values[i], values[i + 1], values[i + 2], values[i + 3] };
+        simd::f32x4 v = DivideCode(simd::ConvertToF32(simd::LoadI32(q)), scale);
+        simd::Store(result + i, simd::Max(v, vLo));
+    }
+    for(; i < count; i++)
+    {
+        result[i] = MAX(DivideCode((f32)values[i], scale), lo);
+    }
+}
+
+void F32ToSnorm8(const f32* values, i8* result, u64 count)      { FloatToNormalized(values, result, count, -1, 127); }
+void F32ToSnorm16(const f32* values, i16* result, u64 count)    { FloatToNormalized(values, result, count, -1, 32767); }
+void F32ToUnorm8(const f32* values, u8* result, u64 count)      { FloatToNormalized(values, result, count, 0, 255); }
+void F32ToUnorm16(const f32* values, u16* result, u64 count)    { FloatToNormalized(values, result, count, 0, 65535); }
+
+void Snorm8ToF32(const i8* values, f32* result, u64 count)      { NormalizedToFloat(values, result, count, -1, 127); }
+void Snorm16ToF32(const i16* values, f32* result, u64 count)    { NormalizedToFloat(values, result, count, -1, 32767); }
+void Unorm8ToF32(const u8* values, f32* result, u64 count)      { NormalizedToFloat(values, result, count, 0, 255); }
+void Unorm16ToF32(const u16* values, f32* result, u64 count)    { NormalizedToFloat(values, result, count, 0, 65535); }
+
+// ========================================================
+// [OCTAHEDRAL]
+// Written once 4-wide, the scalar versions run it on one lane. Sums go through simd::Barrier
+// so -Ofast adds them up in the same order in every inlined copy.
+
+inline void OctEncode4(simd::f32x4 x, simd::f32x4 y, simd::f32x4 z, simd::f32x4* u, simd::f32x4* v)
+{
+    simd::f32x4 one = simd::Set1(1);
+    simd::f32x4 signBit = simd::Set1(-0.f);
+    simd::f32x4 l1 = simd::Add(simd::Barrier(simd::Add(simd::Abs(x), simd::Abs(y))), simd::Abs(z));
+    simd::f32x4 inv = simd::Div(one, simd::Max(l1, simd::Set1(FLT_MIN)));
+    simd::f32x4 px = simd::Mul(x, inv);
+    simd::f32x4 py = simd::Mul(y, inv);
+
+    // Lower half: reflect over the diagonals, keeping the quadrant.
+    simd::f32x4 fx = simd::Mul(simd::Sub(one, simd::Abs(py)), simd::Or(simd::And(px, signBit), one));
+    simd::f32x4 fy = simd::Mul(simd::Sub(one, simd::Abs(px)), simd::Or(simd::And(py, signBit), one));
+    simd::f32x4 lower = simd::CmpLT(z, simd::Zero());
+    *u = simd::Select(lower, fx, px);
+    *v = simd::Select(lower, fy, py);
+}
+
+inline void OctDecode4(simd::f32x4 u, simd::f32x4 v, simd::f32x4* x, simd::f32x4* y, simd::f32x4* z)
+{
+    simd::f32x4 signBit = simd::Set1(-0.f);
+    simd::f32x4 pz = simd::Sub(simd::Sub(simd::Set1(1), simd::Abs(u)), simd::Abs(v));
+    simd::f32x4 t = simd::Max(simd::Sub(simd::Zero(), pz), simd::Zero());   // Unfold by -z towards the origin.
+    simd::f32x4 px = simd::Sub(u, simd::Xor(t, simd::And(u, signBit)));
+    simd::f32x4 py = simd::Sub(v, simd::Xor(t, simd::And(v, signBit)));
+    simd::f32x4 len2 = simd::Add(simd::Barrier(simd::Add(simd::Mul(px, px), simd::Mul(py, py))), simd::Mul(pz, pz));
+    simd::f32x4 invLen = approx::Rsqrt(len2);
+    *x = simd::Mul(px, invLen);
+    *y = simd::Mul(py, invLen);
+    *z = simd::Mul(pz, invLen);
+}
+
+v2f OctEncode(v3f direction)
+{
+    simd::f32x4 u, v;
+    OctEncode4(simd::Set1(direction.x), simd::Set1(direction.y), simd::Set1(direction.z), &u, &v);
+    return { simd::GetLane<0>(u), simd::GetLane<0>(v) };
+}
+
+v3f OctDecode(v2f encoded)
+{
+    simd::f32x4 x, y, z;
+    OctDecode4(simd::Set1(encoded.x), simd::Set1(encoded.y), &x, &y, &z);
+    return { simd::GetLane<0>(x), simd::GetLane<0>(y), simd::GetLane<0>(z) };
+}
+
+inline simd::i32x4 ToSnorm(simd::f32x4 v, f32 scale)
+{
+    v = simd::Min(simd::Max(v, simd::Set1(-1)), simd::Set1(1));
+    return simd::ConvertToI32(simd::Mul(v, simd::Set1(scale)));
+}
+
+inline simd::f32x4 FromSnorm(simd::i32x4 q, f32 scale)
+{
+    return simd::Max(DivideCode(simd::ConvertToF32(q), scale), simd::Set1(-1));
+}
+
+template <typename T>
+void EncodeNormalsT(const f32* normals, T* result, u64 count, f32 scale)
+{
+    u64 i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        simd::f32x4 x, y, z, u, v;
+        simd::LoadXYZ4(normals + i * 3, x, y, z);
+        OctEncode4(x, y, z, &u, &v);
+        i32 qu[4], qv[4];
+        simd::Store(qu, ToSnorm(u, scale));
+        simd::Store(qv, ToSnorm(v, scale));
+        for(u32 j = 0; j < 4; j++)
+        {
+            result[(i + j) * 2] = (T)qu[j];
+            result[(i + j) * 2 + 1] = (T)qv[j];
+        }
+    }
+    for(; i < count; i++)
+    {
+        v2f e = OctEncode({ normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2] });
+        result[i * 2] = (T)rintf(CLAMP(e.x, -1.f, 1.f) * scale);
+        result[i * 2 + 1] = (T)rintf(CLAMP(e.y, -1.f, 1.f) * scale);
+    }
+}
+
+template <typename T>
+void DecodeNormalsT(const T* encoded, f32* normals, u64 count, f32 scale)
+{
+    u64 i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        const T* e = encoded + i * 2;
+        i32 qu[4] = { e[0], e[2], e[4], e[6] };
+        i32 qv[4] = { e[1], e[3], e[5], e[7] };
+        simd::f32x4 x, y, z;
+        OctDecode4(FromSnorm(simd::LoadI32(qu), scale), FromSnorm(simd::LoadI32(qv), scale), &x, &y, &z);
+        simd::StoreXYZ4(normals + i * 3, x, y, z);
+    }
+    for(; i < count; i++)
+    {
+        v2f e = { MAX(DivideCode((f32)encoded[i * 2], scale), -1.f),
+                  MAX(DivideCode((f32)encoded[i * 2 + 1], scale), -1.f) };
+        v3f n = OctDecode(e);
+        normals[i * 3] = n.x;
+        normals[i * 3 + 1] = n.y;
+        normals[i * 3 + 2] = n.z;
+    }
+}
+
+void EncodeNormals(const f32* normals, i16* result, u64 count)    { EncodeNormalsT(normals, result, count, 32767); }
+void EncodeNormals(const f32* normals, i8* result, u64 count)     { EncodeNormalsT(normals, result, count, 127); }
+void DecodeNormals(const i16* encoded, f32* normals, u64 count)   { DecodeNormalsT(encoded, normals, count, 32767); }
+void DecodeNormals(const i8* encoded, f32* normals, u64 count)    { DecodeNormalsT(encoded, normals, count, 127); }
+
+void EncodeTangents(const f32* tangents, i16* result, u64 count)
+{
+    u64 i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        simd::f32x4 x = simd::Load(tangents + i * 4);
+        simd::f32x4 y = simd::Load(tangents + i * 4 + 4);
+        simd::f32x4 z = simd::Load(tangents + i * 4 + 8);
+        simd::f32x4 w = simd::Load(tangents + i * 4 + 12);
+        simd::Transpose4(x, y, z, w);
+        simd::f32x4 u, v;
+        OctEncode4(x, y, z, &u, &v);
+        simd::i32x4 sign = simd::And(simd::CastToI32(simd::CmpLT(w, simd::Zero())), simd::Set1I32(1));
+        i32 qu[4], qv[4];
+        simd::Store(qu, ToSnorm(u, 32767));
+        simd::Store(qv, simd::Or(simd::And(ToSnorm(v, 32767), simd::Set1I32(~1)), sign));
+        for(u32 j = 0; j < 4; j++)
+        {
+            result[(i + j) * 2] = (i16)qu[j];
+            result[(i + j) * 2 + 1] = (i16)qv[j];
+        }
+    }
+    for(; i < count; i++)
+    {
+        const f32* t = tangents + i * 4;
+        v2f e = OctEncode({ t[0], t[1], t[2] });
+        i32 qv = (i32)rintf(CLAMP(e.y, -1.f, 1.f) * 32767);
+        result[i * 2] = (i16)rintf(CLAMP(e.x, -1.f, 1.f) * 32767);
+        result[i * 2 + 1] = (i16)((qv & ~1) | (t[3] < 0 ? 1 : 0));
+    }
+}
+
+void DecodeTangents(const i16* encoded, f32* tangents, u64 count)
+{
+    u64 i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        const i16* e = encoded + i * 2;
+        i32 qu[4] = { e[0], e[2], e[4], e[6] };
+        i32 qv[4] = { e[1], e[3], e[5], e[7] };
+        simd::i32x4 v = simd::LoadI32(qv);
+        simd::f32x4 x, y, z;
+        OctDecode4(FromSnorm(simd::LoadI32(qu), 32767), FromSnorm(v, 32767), &x, &y, &z);
+        simd::f32x4 sign = simd::ConvertToF32(simd::And(v, simd::Set1I32(1)));
+        simd::f32x4 w = simd::Sub(simd::Set1(1), simd::Add(sign, sign));
+        simd::Transpose4(x, y, z, w);
+        simd::Store(tangents + i * 4, x);
+        simd::Store(tangents + i * 4 + 4, y);
+        simd::Store(tangents + i * 4 + 8, z);
+        simd::Store(tangents + i * 4 + 12, w);
+    }
+    for(; i < count; i++)
+    {
+        i16 qv = encoded[i * 2 + 1];
+        v2f e = { MAX(DivideCode((f32)encoded[i * 2], 32767), -1.f), MAX(DivideCode((f32)qv, 32767), -1.f) };
+        v3f t = OctDecode(e);
+        tangents[i * 4] = t.x;
+        tangents[i * 4 + 1] = t.y;
+        tangents[i * 4 + 2] = t.z;
+        tangents[i * 4 + 3] = (qv & 1) ? -1.f : 1.f;
+    }
+}
+
+// ========================================================
+// [PACKED]
+// The 2 bit snorm w has codes -2 to 1, read back clamped like the others.
+
+inline u32 Pack1010102(v4f value, f32 lo, f32 scale, f32 scaleW)
+{
+    u32 x = (u32)(i32)rintf(CLAMP(value.x, lo, 1.f) * scale) & 1023;
+    u32 y = (u32)(i32)rintf(CLAMP(value.y, lo, 1.f) * scale) & 1023;
+    u32 z = (u32)(i32)rintf(CLAMP(value.z, lo, 1.f) * scale) & 1023;
+    u32 w = (u32)(i32)rintf(CLAMP(value.w, lo, 1.f) * scaleW);
+    return x | (y << 10) | (z << 20) | (w << 30);
+}
+
+inline void Pack1010102(const f32* values, u32* result, u64 count, f32 lo, f32 scale, f32 scaleW)
+{
+    simd::f32x4 vLo = simd::Set1(lo);
+    simd::f32x4 vHi = simd::Set1(1);
+    simd::i32x4 mask = simd::Set1I32(1023);
+    u64 i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        simd::f32x4 x = simd::Load(values + i * 4);
+        simd::f32x4 y = simd::Load(values + i * 4 + 4);
+        simd::f32x4 z = simd::Load(values + i * 4 + 8);
+        simd::f32x4 w = simd::Load(values + i * 4 + 12);
+        simd::Transpose4(x, y, z, w);
+        simd::i32x4 qx = simd::ConvertToI32(simd::Mul(simd::Min(simd::Max(x, vLo), vHi), simd::Set1(scale)));
+        simd::i32x4 qy = simd::ConvertToI32(simd::Mul(simd::Min(simd::Max(y, vLo), vHi), simd::Set1(scale)));
+        simd::i32x4 qz = simd::ConvertToI32(simd::Mul(simd::Min(simd::Max(z, vLo), vHi), simd::Set1(scale)));
+        simd::i32x4 qw = simd::ConvertToI32(simd::Mul(simd::Min(simd::Max(w, vLo), vHi), simd::Set1(scaleW)));
+        simd::i32x4 xy = simd::Or(simd::And(qx, mask), simd::ShiftLeft<10>(simd::And(qy, mask)));
+        simd::i32x4 zw = simd::Or(simd::ShiftLeft<20>(simd::And(qz, mask)), simd::ShiftLeft<30>(qw));
+        simd::Store((i32*)(result + i), simd::Or(xy, zw));
+    }
+    for(; i < count; i++)
+    {
+        result[i] = Pack1010102({ values[i * 4], values[i * 4 + 1], values[i * 4 + 2], values[i * 4 + 3] }, lo, scale, scaleW);
+    }
+}
+
+u32 PackSnorm1010102(v4f value)     { return Pack1010102(value, -1, 511, 1); }
+u32 PackUnorm1010102(v4f value)     { return Pack1010102(value, 0, 1023, 3); }
+
+v4f UnpackSnorm1010102(u32 packed)
+{
+    // Shift each field to the top and back down to sign extend it.
+    return { MAX(DivideCode((f32)((i32)(packed << 22) >> 22), 511), -1.f),
+             MAX(DivideCode((f32)((i32)(packed << 12) >> 22), 511), -1.f),
+             MAX(DivideCode((f32)((i32)(packed << 2) >> 22), 511), -1.f),
+             MAX((f32)((i32)packed >> 30), -1.f) };
+}
+
+v4f UnpackUnorm1010102(u32 packed)
+{
+    return { DivideCode((f32)(packed & 1023), 1023),
+             DivideCode((f32)((packed >> 10) & 1023), 1023),
+             DivideCode((f32)((packed >> 20) & 1023), 1023),
+             DivideCode((f32)(packed >> 30), 3) };
+}
+
+void PackSnorm1010102(const f32* values, u32* result, u64 count)    { Pack1010102(values, result, count, -1, 511, 1); }
+void PackUnorm1010102(const f32* values, u32* result, u64 count)    { Pack1010102(values, result, count, 0, 1023, 3); }
+
+void UnpackSnorm1010102(const u32* packed, f32* values, u64 count)
+{
+    simd::f32x4 minusOne = simd::Set1(-1);
+    u64 i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        simd::i32x4 p = simd::LoadI32((const i32*)(packed + i));
+        simd::f32x4 x = simd::ConvertToF32(simd::ShiftRight<22>(simd::ShiftLeft<22>(p)));
+        simd::f32x4 y = simd::ConvertToF32(simd::ShiftRight<22>(simd::ShiftLeft<12>(p)));
+        simd::f32x4 z = simd::ConvertToF32(simd::ShiftRight<22>(simd::ShiftLeft<2>(p)));
+        simd::f32x4 w = simd::Max(simd::ConvertToF32(simd::ShiftRight<30>(p)), minusOne);
+        x = simd::Max(DivideCode(x, 511), minusOne);
+        y = simd::Max(DivideCode(y, 511), minusOne);
+        z = simd::Max(DivideCode(z, 511), minusOne);
+        simd::Transpose4(x, y, z, w);
+        simd::Store(values + i * 4, x);
+        simd::Store(values + i * 4 + 4, y);
+        simd::Store(values + i * 4 + 8, z);
+        simd::Store(values + i * 4 + 12, w);
+    }
+    for(; i < count; i++)
+    {
+        v4f v = UnpackSnorm1010102(packed[i]);
+        memcpy(values + i * 4, v.data, sizeof(v.data));
+    }
+}
+
+void UnpackUnorm1010102(const u32* packed, f32* values, u64 count)
+{
+    simd::i32x4 mask = simd::Set1I32(1023);
+    u64 i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        simd::i32x4 p = simd::LoadI32((const i32*)(packed + i));
+        simd::f32x4 x = DivideCode(simd::ConvertToF32(simd::And(p, mask)), 1023);
+        simd::f32x4 y = DivideCode(simd::ConvertToF32(simd::And(simd::ShiftRight<10>(p), mask)), 1023);
+        simd::f32x4 z = DivideCode(simd::ConvertToF32(simd::And(simd::ShiftRight<20>(p), mask)), 1023);
+        simd::f32x4 w = DivideCode(simd::ConvertToF32(simd::And(simd::ShiftRight<30>(p), simd::Set1I32(3))), 3);
+        simd::Transpose4(x, y, z, w);
+        simd::Store(values + i * 4, x);
+        simd::Store(values + i * 4 + 4, y);
+        simd::Store(values + i * 4 + 8, z);
+        simd::Store(values + i * 4 + 12, w);
+    }
+    for(; i < count; i++)
+    {
+        v4f v = UnpackUnorm1010102(packed[i]);
+        memcpy(values + i * 4, v.data, sizeof(v.data));
+    }
+}
+
+};
+};
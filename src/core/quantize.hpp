@@ -0,0 +1,95 @@
+// ========================================================
+// QUANTIZE
+// Compact encodings for vertex attributes and other bulk data that goes to the GPU: half
+// floats, SNORM/UNORM integers, octahedral unit vectors and 10_10_10_2 words. Every format
+// matches the GPU's own conversion for the Vulkan format named next to it, so shaders read
+// the data back with a plain vertex format or texel fetch.
+// Array versions run 4 elements at a time with core/simd (half floats 8 at a time with F16C,
+// or with NEON's conversions) and the leftovers through the scalar ones, which give the same
+// bits.
+// Max round-trip errors, for inputs inside the encoded range:
+//   Half                       2^-11 relative for normals, 2^-24 absolute below 2^-14
+//   Snorm8, Unorm8             1/254, 1/510 absolute
+//   Snorm16, Unorm16           1/65534, 1/131070 absolute
+//   Octahedral normals         0.0037 degrees with 16 bits, 0.95 with 8
+//   Octahedral tangents        0.0077 degrees, handedness exact
+//   Snorm 10_10_10_2           1/1022 absolute xyz, w rounds to -1, 0 or 1
+//   Unorm 10_10_10_2           1/2046 absolute xyz, w rounds to 0, 1/3, 2/3 or 1
+// The bench executable checks them (bench --check --filter quantize).
+// Out of range inputs are clamped, half floats overflow to infinity. NaNs are kept as half
+// NaNs and give unspecified integers.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./debug.hpp"
+#include "./simd.hpp"
+#include "./math.hpp"
+#include "./approx.hpp"
+
+namespace ty
+{
+namespace quantize
+{
+
+// ========================================================
+// [HALF]
+// IEEE binary16 (VK_FORMAT_R16_SFLOAT), rounded to nearest even.
+u16 F32ToF16(f32 value);
+f32 F16ToF32(u16 value);
+
+void F32ToF16(const f32* values, u16* result, u64 count);
+void F16ToF32(const u16* values, f32* result, u64 count);
+
+// ========================================================
+// [NORMALIZED]
+// SNORM maps [-1, 1] to [-(2^(n-1) - 1), 2^(n-1) - 1], so -1 has two codes and 0 is
+// exact. UNORM maps [0, 1] to [0, 2^n - 1]. Both round to nearest.
+void F32ToSnorm8(const f32* values, i8* result, u64 count);
+void F32ToSnorm16(const f32* values, i16* result, u64 count);
+void F32ToUnorm8(const f32* values, u8* result, u64 count);
+void F32ToUnorm16(const f32* values, u16* result, u64 count);
+
+void Snorm8ToF32(const i8* values, f32* result, u64 count);
+void Snorm16ToF32(const i16* values, f32* result, u64 count);
+void Unorm8ToF32(const u8* values, f32* result, u64 count);
+void Unorm16ToF32(const u16* values, f32* result, u64 count);
+
+// ========================================================
+// [OCTAHEDRAL]
+// Unit vectors projected on the octahedron |x| + |y| + |z| = 1, whose lower half is folded
+// over the upper one to fill the [-1, 1] square (Cigolle et al., "A Survey of Efficient
+// Representations for Independent Unit Vectors", 2014). Two snorm components per vector,
+// decoded with a few adds and one normalization.
+v2f OctEncode(v3f direction);           // Needs no normalization, zero maps to +z.
+v3f OctDecode(v2f encoded);             // Unit length.
+
+// Packed xyz normals to two snorm components each (VK_FORMAT_R16G16_SNORM or R8G8_SNORM).
+void EncodeNormals(const f32* normals, i16* result, u64 count);
+void EncodeNormals(const f32* normals, i8* result, u64 count);
+void DecodeNormals(const i16* encoded, f32* normals, u64 count);
+void DecodeNormals(const i8* encoded, f32* normals, u64 count);
+
+// Packed xyzw tangents, w the bitangent sign as in glTF, to two snorm16 components. The
+// lowest bit of the second one holds the sign (set when negative), costing 1 bit of its
+// precision. Decoding gives w = +-1.
+void EncodeTangents(const f32* tangents, i16* result, u64 count);
+void DecodeTangents(const i16* encoded, f32* tangents, u64 count);
+
+// ========================================================
+// [PACKED]
+// x in bits 0-9, y in 10-19, z in 20-29, w in 30-31 (VK_FORMAT_A2B10G10R10_SNORM_PACK32
+// and _UNORM_PACK32). Arrays take packed xyzw vectors.
+u32 PackSnorm1010102(v4f value);
+u32 PackUnorm1010102(v4f value);
+v4f UnpackSnorm1010102(u32 packed);
+v4f UnpackUnorm1010102(u32 packed);
+
+void PackSnorm1010102(const f32* values, u32* result, u64 count);
+void PackUnorm1010102(const f32* values, u32* result, u64 count);
+void UnpackSnorm1010102(const u32* packed, f32* values, u64 count);
+void UnpackUnorm1010102(const u32* packed, f32* values, u64 count);
+
+};
+};
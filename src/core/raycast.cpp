@@ -0,0 +1,431 @@
+#include "./raycast.hpp"
+
+namespace ty
+{
+namespace raycast
+{
+
+// ========================================================
+// [BUILD]
+
+Scene Build(mem::Arena* arena, const Mesh* meshes, u32 meshCount, bvh::BuildDesc desc)
+{
+    Scene result = {};
+    result.firstTriangles = MakeSArray<u32>(arena, meshCount + 1);
+    u32 triangleCount = 0;
+    u32 maxVertexCount = 0;
+    for(u32 i = 0; i < meshCount; i++)
+    {
+        result.firstTriangles.Push(triangleCount);
+        triangleCount += meshes[i].triangleCount;
+        maxVertexCount = MAX(maxVertexCount, meshes[i].vertexCount);
+    }
+    result.firstTriangles.Push(triangleCount);
+    result.vertices = MakeSArray<v3f>(arena, MAX(triangleCount * 3, 1));
+
+    u64 scratchSize = (u64)maxVertexCount * sizeof(v3f) + (u64)triangleCount * sizeof(math::AABB) + KB(1);
+    mem::Arena* scratch = mem::MakeArena(scratchSize);
+    v3f* positions = (v3f*)mem::ArenaPush(scratch, MAX(maxVertexCount, 1) * sizeof(v3f));
+    math::AABB* bounds = (math::AABB*)mem::ArenaPush(scratch, MAX(triangleCount, 1) * sizeof(math::AABB));
+
+    for(u32 i = 0; i < meshCount; i++)
+    {
+        const Mesh& mesh = meshes[i];
+        math::TransformPositions(positions, (const v3f*)mesh.positions, mesh.vertexCount, mesh.transform);
+        for(u32 j = 0; j < mesh.triangleCount * 3; j++)
+        {
+            u32 index = mesh.indices ? mesh.indices[j] : j;
+            ASSERT(index < mesh.vertexCount);
+            result.vertices.Push(positions[index]);
+        }
+    }
+    for(u32 i = 0; i < triangleCount; i++)
+    {
+        const v3f* p = result.vertices.data + i * 3;
+        bounds[i] = { p[0], p[0] };
+        for(u32 j = 1; j < 3; j++)
+        {
+            bounds[i].min = { MIN(bounds[i].min.x, p[j].x), MIN(bounds[i].min.y, p[j].y), MIN(bounds[i].min.z, p[j].z) };
+            bounds[i].max = { MAX(bounds[i].max.x, p[j].x), MAX(bounds[i].max.y, p[j].y), MAX(bounds[i].max.z, p[j].z) };
+        }
+    }
+
+    result.bvh = bvh::Build(arena, bounds, triangleCount, desc);
+    mem::DestroyArena(scratch);
+    return result;
+}
+
+// ========================================================
+// [TRIANGLE]
+// Watertight ray/triangle test. Vertices are moved relative to the ray origin, then sheared
+// so the ray points down +z from (0, 0) (kz is the largest direction component, kx and ky are
+// swapped when it's negative to keep the winding). The edge functions U, V, W are then 2D
+// cross products whose signs say on which side of each edge the ray passes. Each edge function
+// only depends on the edge's two vertices, so triangles sharing it agree exactly. That needs
+// products rounded on their own: fused into the subtraction, a - b and b - a round differently.
+// Products and partial sums go through simd::Barrier, so FMA and -Ofast builds keep the edge
+// functions antisymmetric, and the packet test gives the same bits as this one with FMA too.
+
+struct RayShear
+{
+    u32 kx;
+    u32 ky;
+    u32 kz;
+    f32 sx;
+    f32 sy;
+    f32 sz;
+};
+
+RayShear MakeRayShear(v3f direction)
+{
+    RayShear result = {};
+    v3f absDirection = { ABS(direction.x), ABS(direction.y), ABS(direction.z) };
+    result.kz = absDirection.x > absDirection.y
+        ? (absDirection.x > absDirection.z ? 0 : 2)
+        : (absDirection.y > absDirection.z ? 1 : 2);
+    result.kx = (result.kz + 1) % 3;
+    result.ky = (result.kx + 1) % 3;
+    if(direction.data[result.kz] < 0)
+    {
+        u32 swap = result.kx;
+        result.kx = result.ky;
+        result.ky = swap;
+    }
+    result.sx = direction.data[result.kx] / direction.data[result.kz];
+    result.sy = direction.data[result.ky] / direction.data[result.kz];
+    result.sz = 1.f / direction.data[result.kz];
+    return result;
+}
+
+inline bool IntersectTriangle(v3f origin, const RayShear& shear, const v3f* p, f32 tMax, f32* t, f32* u, f32* v)
+{
+    v3f a = p[0] - origin;
+    v3f b = p[1] - origin;
+    v3f c = p[2] - origin;
+    f32 ax = a.data[shear.kx] - simd::Barrier(shear.sx * a.data[shear.kz]);
+    f32 ay = a.data[shear.ky] - simd::Barrier(shear.sy * a.data[shear.kz]);
+    f32 bx = b.data[shear.kx] - simd::Barrier(shear.sx * b.data[shear.kz]);
+    f32 by = b.data[shear.ky] - simd::Barrier(shear.sy * b.data[shear.kz]);
+    f32 cx = c.data[shear.kx] - simd::Barrier(shear.sx * c.data[shear.kz]);
+    f32 cy = c.data[shear.ky] - simd::Barrier(shear.sy * c.data[shear.kz]);
+
+    f32 edgeU = simd::Barrier(cx * by) - simd::Barrier(cy * bx);
+    f32 edgeV = simd::Barrier(ax * cy) - simd::Barrier(ay * cx);
+    f32 edgeW = simd::Barrier(bx * ay) - simd::Barrier(by * ax);
+    if((edgeU < 0 || edgeV < 0 || edgeW < 0) && (edgeU > 0 || edgeV > 0 || edgeW > 0)) return false;
+
+    // Hit distance scaled by det, compared without dividing.
+    f32 det = simd::Barrier(edgeU + edgeV) + edgeW;
+    f32 az = shear.sz * a.data[shear.kz];
+    f32 bz = shear.sz * b.data[shear.kz];
+    f32 cz = shear.sz * c.data[shear.kz];
+    f32 scaledT = simd::Barrier(simd::Barrier(edgeU * az) + simd::Barrier(edgeV * bz)) + simd::Barrier(edgeW * cz);
+    if(det > 0)
+    {
+        if(scaledT <= 0 || scaledT > tMax * det) return false;
+    }
+    else if(det < 0)
+    {
+        if(scaledT >= 0 || scaledT < tMax * det) return false;
+    }
+    else return false;
+
+    f32 invDet = 1.f / det;
+    *t = scaledT * invDet;
+    *u = edgeV * invDet;
+    *v = edgeW * invDet;
+    return true;
+}
+
+bool IntersectRayTriangle(const math::Ray& ray, v3f p0, v3f p1, v3f p2, f32 tMax, f32* t, f32* u, f32* v)
+{
+    v3f p[3] = { p0, p1, p2 };
+    return IntersectTriangle(ray.origin, MakeRayShear(ray.direction), p, tMax, t, u, v);
+}
+
+// ========================================================
+// [SINGLE RAYS]
+// Traversal is core/bvh's, with the triangle test as its hit callback.
+
+struct TriangleHitData
+{
+    const Scene* scene;
+    RayShear shear;
+    f32 u;
+    f32 v;
+};
+
+f32 HitTriangle(void* userData, u32 primitive, const math::Ray& ray, f32 tMax)
+{
+    TriangleHitData* data = (TriangleHitData*)userData;
+    f32 t, u, v;
+    if(!IntersectTriangle(ray.origin, data->shear, data->scene->vertices.data + primitive * 3, tMax, &t, &u, &v)) return -1;
+    data->u = u;    // Raycast keeps every hit it's given, the last is the nearest.
+    data->v = v;
+    return t;
+}
+
+void SetHitTriangle(const Scene& scene, u32 triangle, Hit* hit)
+{
+    // Last mesh starting at or before the triangle.
+    u32 first = 0;
+    u32 last = (u32)scene.firstTriangles.count - 1;
+    while(last - first > 1)
+    {
+        u32 middle = (first + last) / 2;
+        if(scene.firstTriangles.data[middle] <= triangle) first = middle;
+        else last = middle;
+    }
+    hit->mesh = first;
+    hit->triangle = triangle - scene.firstTriangles.data[first];
+}
+
+Hit RaycastClosest(const Scene& scene, const math::Ray& ray, f32 tMax)
+{
+    TriangleHitData data = { &scene, MakeRayShear(ray.direction), 0, 0 };
+    bvh::RayHit bvhHit = bvh::Raycast(scene.bvh, ray, tMax, HitTriangle, &data);
+    Hit result = {};
+    if(!bvhHit.IsValid()) return result;
+    result.t = bvhHit.t;
+    result.u = data.u;
+    result.v = data.v;
+    SetHitTriangle(scene, bvhHit.primitive, &result);
+    return result;
+}
+
+bool RaycastAny(const Scene& scene, const math::Ray& ray, f32 tMax)
+{
+    TriangleHitData data = { &scene, MakeRayShear(ray.direction), 0, 0 };
+    return bvh::RaycastAny(scene.bvh, ray, tMax, HitTriangle, &data).IsValid();
+}
+
+// ========================================================
+// [PACKETS]
+// One ray per lane. The per-ray shear is stored as a 3x3 matrix whose entries are 0, 1 or the
+// shear factors, so every lane computes exactly what the single ray test would without
+// gathering coordinates by axis index.
+
+STATIC_ASSERT(TY_RAYCAST_PACKET_SIZE == 4);
+
+struct Packet
+{
+    simd::f32x4 originX, originY, originZ;
+    simd::f32x4 invDirectionX, invDirectionY, invDirectionZ;
+    simd::f32x4 shear[3][3];
+    f32 t[4];
+    f32 u[4];
+    f32 v[4];
+    u32 triangle[4];
+    u32 active;                 // Lanes still looking for hits.
+};
+
+struct PacketStackEntry
+{
+    u32 node;
+    simd::f32x4 t;
+};
+
+Packet MakePacket(const math::Ray* rays, f32 tMax)
+{
+    Packet result = {};
+    f32 shear[3][3][4] = {};
+    f32 origin[3][4];
+    f32 invDirection[3][4];
+    for(u32 i = 0; i < 4; i++)
+    {
+        const math::Ray& ray = rays[i];
+        RayShear s = MakeRayShear(ray.direction);
+        v3f inverse = math::GetInverseDirection(ray);
+        shear[0][s.kx][i] = 1;
+        shear[0][s.kz][i] = -s.sx;
+        shear[1][s.ky][i] = 1;
+        shear[1][s.kz][i] = -s.sy;
+        shear[2][s.kz][i] = s.sz;
+        for(u32 j = 0; j < 3; j++)
+        {
+            origin[j][i] = ray.origin.data[j];
+            invDirection[j][i] = inverse.data[j];
+        }
+        result.t[i] = tMax;
+        result.triangle[i] = HANDLE_INVALID;
+    }
+    result.originX = simd::Load(origin[0]);
+    result.originY = simd::Load(origin[1]);
+    result.originZ = simd::Load(origin[2]);
+    result.invDirectionX = simd::Load(invDirection[0]);
+    result.invDirectionY = simd::Load(invDirection[1]);
+    result.invDirectionZ = simd::Load(invDirection[2]);
+    for(u32 i = 0; i < 3; i++)
+    {
+        for(u32 j = 0; j < 3; j++)
+        {
+            result.shear[i][j] = simd::Load(shear[i][j]);
+        }
+    }
+    result.active = 0xF;
+    return result;
+}
+
+// Lanes in mask whose ray hits bounds before its current hit, entry distances in t.
+inline u32 TestPacket(const Packet& packet, const math::AABB& bounds, u32 mask, simd::f32x4* t)
+{
+    simd::f32x4 x0 = simd::Mul(simd::Sub(simd::Set1(bounds.min.x), packet.originX), packet.invDirectionX);
+    simd::f32x4 x1 = simd::Mul(simd::Sub(simd::Set1(bounds.max.x), packet.originX), packet.invDirectionX);
+    simd::f32x4 y0 = simd::Mul(simd::Sub(simd::Set1(bounds.min.y), packet.originY), packet.invDirectionY);
+    simd::f32x4 y1 = simd::Mul(simd::Sub(simd::Set1(bounds.max.y), packet.originY), packet.invDirectionY);
+    simd::f32x4 z0 = simd::Mul(simd::Sub(simd::Set1(bounds.min.z), packet.originZ), packet.invDirectionZ);
+    simd::f32x4 z1 = simd::Mul(simd::Sub(simd::Set1(bounds.max.z), packet.originZ), packet.invDirectionZ);
+    simd::f32x4 tNear = simd::Max(simd::Max(simd::Min(x0, x1), simd::Min(y0, y1)), simd::Max(simd::Min(z0, z1), simd::Zero()));
+    simd::f32x4 tFar = simd::Min(simd::Min(simd::Max(x0, x1), simd::Max(y0, y1)), simd::Min(simd::Max(z0, z1), simd::Load(packet.t)));
+    *t = tNear;
+    return simd::MoveMask(simd::CmpLE(tNear, simd::Mul(tFar, simd::Set1(TY_BVH_RAY_EXIT_SCALE)))) & mask;
+}
+
+inline void ShearPacket(const Packet& packet, v3f p, simd::f32x4* x, simd::f32x4* y, simd::f32x4* z)
+{
+    simd::f32x4 dx = simd::Sub(simd::Set1(p.x), packet.originX);
+    simd::f32x4 dy = simd::Sub(simd::Set1(p.y), packet.originY);
+    simd::f32x4 dz = simd::Sub(simd::Set1(p.z), packet.originZ);
+    simd::f32x4* result[3] = { x, y, z };
+    for(u32 i = 0; i < 3; i++)
+    {
+        *result[i] = simd::Add(simd::Add(
+                    simd::Barrier(simd::Mul(packet.shear[i][0], dx)),
+                    simd::Barrier(simd::Mul(packet.shear[i][1], dy))),
+                simd::Barrier(simd::Mul(packet.shear[i][2], dz)));
+    }
+}
+
+// Same test as IntersectTriangle, for the lanes in mask. Returns the lanes that hit.
+inline u32 IntersectPacket(Packet* packet, const v3f* p, u32 triangle, u32 mask)
+{
+    simd::f32x4 ax, ay, az, bx, by, bz, cx, cy, cz;
+    ShearPacket(*packet, p[0], &ax, &ay, &az);
+    ShearPacket(*packet, p[1], &bx, &by, &bz);
+    ShearPacket(*packet, p[2], &cx, &cy, &cz);
+
+    simd::f32x4 edgeU = simd::Sub(simd::Barrier(simd::Mul(cx, by)), simd::Barrier(simd::Mul(cy, bx)));
+    simd::f32x4 edgeV = simd::Sub(simd::Barrier(simd::Mul(ax, cy)), simd::Barrier(simd::Mul(ay, cx)));
+    simd::f32x4 edgeW = simd::Sub(simd::Barrier(simd::Mul(bx, ay)), simd::Barrier(simd::Mul(by, ax)));
+    simd::f32x4 zero = simd::Zero();
+    simd::f32x4 inside = simd::Or(
+            simd::And(simd::And(simd::CmpGE(edgeU, zero), simd::CmpGE(edgeV, zero)), simd::CmpGE(edgeW, zero)),
+            simd::And(simd::And(simd::CmpLE(edgeU, zero), simd::CmpLE(edgeV, zero)), simd::CmpLE(edgeW, zero)));
+
+    simd::f32x4 det = simd::Add(simd::Barrier(simd::Add(edgeU, edgeV)), edgeW);
+    simd::f32x4 scaledT = simd::Add(simd::Barrier(simd::Add(simd::Barrier(simd::Mul(edgeU, az)), simd::Barrier(simd::Mul(edgeV, bz)))),
+            simd::Barrier(simd::Mul(edgeW, cz)));
+    simd::f32x4 scaledMax = simd::Mul(simd::Load(packet->t), det);
+    simd::f32x4 front = simd::And(simd::CmpGT(det, zero), simd::And(simd::CmpGT(scaledT, zero), simd::CmpLE(scaledT, scaledMax)));
+    simd::f32x4 back = simd::And(simd::CmpLT(det, zero), simd::And(simd::CmpLT(scaledT, zero), simd::CmpGE(scaledT, scaledMax)));
+    u32 hits = simd::MoveMask(simd::And(inside, simd::Or(front, back))) & mask;
+    if(!hits) return 0;
+
+    simd::f32x4 invDet = simd::Div(simd::Set1(1.f), det);
+    f32 t[4], u[4], v[4];
+    simd::Store(t, simd::Mul(scaledT, invDet));
+    simd::Store(u, simd::Mul(edgeV, invDet));
+    simd::Store(v, simd::Mul(edgeW, invDet));
+    for(u32 bits = hits; bits; bits &= bits - 1)
+    {
+        u32 lane = __builtin_ctz(bits);
+        packet->t[lane] = t[lane];
+        packet->u[lane] = u[lane];
+        packet->v[lane] = v[lane];
+        packet->triangle[lane] = triangle;
+    }
+    return hits;
+}
+
+// Depth-first like core/bvh's binary traversal, a node is skipped once no active ray reaches
+// it before its current hit. For any hit, rays stop being active when they hit.
+void TraversePacket(const Scene& scene, Packet* packet, bool any)
+{
+    const bvh::BVH& tree = scene.bvh;
+    if(!tree.indices.count || scene.firstTriangles.data[scene.firstTriangles.count - 1] == 0) return;
+
+    PacketStackEntry stack[TY_BVH_MAX_DEPTH + 1];
+    u32 top = 0;
+    simd::f32x4 rootT;
+    if(!TestPacket(*packet, tree.nodes.data[0].bounds, packet->active, &rootT)) return;
+    stack[top++] = { 0, rootT };
+    while(top)
+    {
+        PacketStackEntry entry = stack[--top];
+        u32 mask = simd::MoveMask(simd::CmpLE(entry.t, simd::Load(packet->t))) & packet->active;
+        if(!mask) continue;
+        const bvh::Node& node = tree.nodes.data[entry.node];
+        if(node.IsLeaf())
+        {
+            for(u32 i = node.offset; i < node.offset + node.count; i++)
+            {
+                u32 triangle = tree.indices.data[i];
+                u32 hits = IntersectPacket(packet, scene.vertices.data + triangle * 3, triangle, mask);
+                if(any && hits)
+                {
+                    packet->active &= ~hits;
+                    mask &= ~hits;
+                    if(!mask) break;
+                }
+            }
+            if(!packet->active) return;
+            continue;
+        }
+
+        PacketStackEntry left = { entry.node + 1 };
+        PacketStackEntry right = { node.offset };
+        u32 hitLeft = TestPacket(*packet, tree.nodes.data[left.node].bounds, mask, &left.t);
+        u32 hitRight = TestPacket(*packet, tree.nodes.data[right.node].bounds, mask, &right.t);
+        if(hitLeft && hitRight)
+        {
+            // Nearest child first, by the closest entry among the rays that hit each.
+            f32 tLeft[4], tRight[4];
+            simd::Store(tLeft, left.t);
+            simd::Store(tRight, right.t);
+            f32 nearLeft = MAX_F32;
+            f32 nearRight = MAX_F32;
+            for(u32 i = 0; i < 4; i++)
+            {
+                if(hitLeft & (1 << i)) nearLeft = MIN(nearLeft, tLeft[i]);
+                if(hitRight & (1 << i)) nearRight = MIN(nearRight, tRight[i]);
+            }
+            if(nearLeft <= nearRight)
+            {
+                stack[top++] = right;
+                stack[top++] = left;
+            }
+            else
+            {
+                stack[top++] = left;
+                stack[top++] = right;
+            }
+        }
+        else if(hitLeft) stack[top++] = left;
+        else if(hitRight) stack[top++] = right;
+    }
+}
+
+void RaycastClosest4(const Scene& scene, const math::Ray* rays, f32 tMax, Hit* hits)
+{
+    Packet packet = MakePacket(rays, tMax);
+    TraversePacket(scene, &packet, false);
+    for(u32 i = 0; i < 4; i++)
+    {
+        hits[i] = {};
+        if(packet.triangle[i] == HANDLE_INVALID) continue;
+        hits[i].t = packet.t[i];
+        hits[i].u = packet.u[i];
+        hits[i].v = packet.v[i];
+        SetHitTriangle(scene, packet.triangle[i], &hits[i]);
+    }
+}
+
+u32 RaycastAny4(const Scene& scene, const math::Ray* rays, f32 tMax)
+{
+    Packet packet = MakePacket(rays, tMax);
+    TraversePacket(scene, &packet, true);
+    return ~packet.active & 0xF;
+}
+
+};
+};
@@ -0,0 +1,76 @@
+// ========================================================
+// RAYCAST
+// Ray queries against triangle meshes, for picking, line of sight and baking.
+// Meshes are transformed into one scene and a BVH (core/bvh) is built over their triangles.
+// Triangles are tested with the watertight algorithm of Woop, Benthin and Wald (2013): the
+// scene is sheared into each ray's space so the three edge tests of a triangle are computed
+// the same way by its neighbours, rays through a shared edge or vertex never slip between
+// triangles.
+// Coherent rays (a camera tile, texels of a bake, a light's shadow rays) can be cast as
+// packets of 4: the packet walks the tree once, testing each node and triangle against all
+// of its rays with core/simd.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./debug.hpp"
+#include "./memory.hpp"
+#include "./simd.hpp"
+#include "./math.hpp"
+#include "./ds.hpp"
+#include "./bvh.hpp"
+
+namespace ty
+{
+namespace raycast
+{
+
+#define TY_RAYCAST_PACKET_SIZE 4
+
+struct Mesh
+{
+    const f32* positions = NULL;    // Packed xyz per vertex.
+    const u32* indices = NULL;      // 3 per triangle, NULL for unindexed triangle lists.
+    u32 vertexCount = 0;
+    u32 triangleCount = 0;
+    m4f transform = math::Identity();
+};
+
+struct Scene
+{
+    bvh::BVH bvh;
+    SArray<v3f> vertices;           // 3 per triangle in scene space.
+    SArray<u32> firstTriangles;     // Per mesh, then the total triangle count.
+};
+
+struct Hit
+{
+    f32 t = MAX_F32;
+    f32 u = 0;                      // Barycentric weights of the second and third vertices,
+    f32 v = 0;                      // the first one's is 1 - u - v.
+    u32 mesh = HANDLE_INVALID;      // Index in the meshes the scene was built from.
+    u32 triangle = HANDLE_INVALID;  // Triangle in the mesh.
+
+    bool IsValid() { return triangle != HANDLE_INVALID; }
+};
+
+// Building with BuildDesc::wide speeds up single rays, packets always use the binary tree.
+Scene Build(mem::Arena* arena, const Mesh* meshes, u32 meshCount, bvh::BuildDesc desc = {});
+
+// Hits at t > 0 only, so rays leaving a surface don't hit it at their origin. Rays through a
+// shared edge report one of the triangles.
+bool IntersectRayTriangle(const math::Ray& ray, v3f p0, v3f p1, v3f p2, f32 tMax, f32* t, f32* u, f32* v);
+
+Hit RaycastClosest(const Scene& scene, const math::Ray& ray, f32 tMax = MAX_F32);
+bool RaycastAny(const Scene& scene, const math::Ray& ray, f32 tMax = MAX_F32);
+
+// ========================================================
+// [PACKETS]
+// TY_RAYCAST_PACKET_SIZE rays at once. Nodes are visited while any ray of the packet hits
+// them, so divergent rays cost the union of their traversals.
+void RaycastClosest4(const Scene& scene, const math::Ray* rays, f32 tMax, Hit* hits);
+u32 RaycastAny4(const Scene& scene, const math::Ray* rays, f32 tMax);   // Bit i set if ray i hit.
+
+};
+};
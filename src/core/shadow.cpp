@@ -0,0 +1,347 @@
+#include "./shadow.hpp"
+
+namespace ty
+{
+namespace shadow
+{
+
+// ========================================================
+// [CASCADES]
+
+inline void SetProjection(Cascade* cascade)
+{
+    // Light view space looks down -z, so the near plane is the top of the box.
+    cascade->proj = math::OrthoRH(cascade->minX, cascade->maxX, cascade->minY, cascade->maxY, -cascade->maxZ, -cascade->minZ);
+    cascade->viewProj = cascade->proj * cascade->view;
+}
+
+void ComputeCascades(const math::Frustum& frustum, v3f lightDirection, const CascadeDesc& desc, Cascade* cascades)
+{
+    ASSERT(cascades);
+    ASSERT(desc.cascadeCount > 0 && desc.cascadeCount <= TY_SHADOW_MAX_CASCADES);
+    ASSERT(desc.resolution > 2);
+    const v3f* points = frustum.points;
+
+    // Camera distances out of the corners: the near face is n / f the size of the far one,
+    // and they're f - n apart along the view direction.
+    v3f forward = math::Normalize(math::Cross(points[1] - points[0], points[3] - points[0]));
+    f32 depthRange = fabsf(math::Dot(forward, points[4] - points[0]));
+    f32 ratio = math::Len(points[1] - points[0]) / math::Len(points[5] - points[4]);
+    ASSERT(depthRange > 0);
+    f32 nearDepth = 0;
+    f32 lambda = 0;
+    if(ratio < 0.9999f)
+    {
+        nearDepth = depthRange * ratio / (1 - ratio);
+        lambda = CLAMP(desc.splitLambda, 0.f, 1.f);
+    }
+    f32 lastDepth = nearDepth + depthRange;
+    if(desc.shadowDistance > 0) lastDepth = CLAMP(desc.shadowDistance, nearDepth + 1e-3f, lastDepth);
+
+    // Light rotation, shared by every cascade so texels line up in world space.
+    v3f axisZ = -math::Normalize(lightDirection);
+    v3f up = fabsf(axisZ.y) < 0.99f ? v3f{0, 1, 0} : v3f{1, 0, 0};
+    v3f axisX = math::Normalize(math::Cross(up, axisZ));
+    v3f axisY = math::Cross(axisZ, axisX);
+    m4f view = math::ViewRH(axisX, axisY, axisZ, {0, 0, 0});
+
+    f32 splitNear = nearDepth;
+    for(u32 i = 0; i < desc.cascadeCount; i++)
+    {
+        f32 s = (f32)(i + 1) / desc.cascadeCount;
+        f32 splitFar = lastDepth;
+        if(i + 1 < desc.cascadeCount)
+        {
+            f32 logSplit = lambda > 0 ? nearDepth * powf(lastDepth / nearDepth, s) : 0;
+            f32 uniformSplit = nearDepth + (lastDepth - nearDepth) * s;
+            splitFar = lambda * logSplit + (1 - lambda) * uniformSplit;
+        }
+
+        // Slice corners along the frustum edges.
+        f32 tNear = (splitNear - nearDepth) / depthRange;
+        f32 tFar = (splitFar - nearDepth) / depthRange;
+        v3f corners[8];
+        v3f center = {};
+        for(u32 j = 0; j < 4; j++)
+        {
+            v3f edge = points[j + 4] - points[j];
+            corners[j] = points[j] + edge * tNear;
+            corners[j + 4] = points[j] + edge * tFar;
+            center = center + corners[j] + corners[j + 4];
+        }
+        center = center * 0.125f;
+
+        // The sphere only depends on the slice's shape, so the map keeps its size as the camera
+        // turns. Corners from math::GetFrustum carry noise that grows with the distance to the
+        // origin, so the radius is rounded up to 1/256 of the next power of two.
+        f32 radius = 0;
+        for(u32 j = 0; j < 8; j++)
+        {
+            radius = MAX(radius, math::Len(corners[j] - center));
+        }
+        i32 exponent = 0;
+        frexpf(radius, &exponent);
+        f32 radiusStep = ldexpf(1.f, exponent - 8);
+        radius = ceilf(radius / radiusStep) * radiusStep;
+
+        // Snapping moves the center by less than a texel, one texel of margin per side keeps
+        // the sphere inside: half size - texel = radius.
+        f32 halfSize = radius * desc.resolution / (desc.resolution - 2);
+        f32 texelSize = 2 * halfSize / desc.resolution;
+        f32 centerX = floorf(math::Dot(axisX, center) / texelSize) * texelSize;
+        f32 centerY = floorf(math::Dot(axisY, center) / texelSize) * texelSize;
+        f32 centerZ = math::Dot(axisZ, center);
+
+        Cascade* cascade = &cascades[i];
+        cascade->view = view;
+        cascade->splitNear = splitNear;
+        cascade->splitFar = splitFar;
+        cascade->texelSize = texelSize;
+        cascade->minX = centerX - halfSize;
+        cascade->maxX = centerX + halfSize;
+        cascade->minY = centerY - halfSize;
+        cascade->maxY = centerY + halfSize;
+        cascade->minZ = centerZ - radius;
+        cascade->maxZ = centerZ + radius;
+        SetProjection(cascade);
+
+        splitNear = splitFar;
+    }
+}
+
+// ========================================================
+// [LIGHT SPACE]
+// Light rotation and cascade boxes with every value repeated across 8 lanes, as in
+// cull::CullPlanes.
+struct CasterBounds
+{
+    f32 rotation[9][8];
+    f32 absRotation[9][8];
+    f32 minX[TY_SHADOW_MAX_CASCADES][8];
+    f32 maxX[TY_SHADOW_MAX_CASCADES][8];
+    f32 minY[TY_SHADOW_MAX_CASCADES][8];
+    f32 maxY[TY_SHADOW_MAX_CASCADES][8];
+    f32 minZ[TY_SHADOW_MAX_CASCADES][8];
+    u32 count;
+};
+
+inline void MakeCasterBounds(const Cascade* cascades, u32 count, CasterBounds* result)
+{
+    ASSERT(count > 0 && count <= TY_SHADOW_MAX_CASCADES);
+    const m4f& view = cascades[0].view;
+    f32 rotation[9] = { view.m00, view.m01, view.m02, view.m10, view.m11, view.m12, view.m20, view.m21, view.m22 };
+    for(u32 lane = 0; lane < 8; lane++)
+    {
+        for(u32 i = 0; i < 9; i++)
+        {
+            result->rotation[i][lane] = rotation[i];
+            result->absRotation[i][lane] = fabsf(rotation[i]);
+        }
+        for(u32 i = 0; i < count; i++)
+        {
+            result->minX[i][lane] = cascades[i].minX;
+            result->maxX[i][lane] = cascades[i].maxX;
+            result->minY[i][lane] = cascades[i].minY;
+            result->maxY[i][lane] = cascades[i].maxY;
+            result->minZ[i][lane] = cascades[i].minZ;
+        }
+    }
+    result->count = count;
+}
+
+// Box centers and extents in light view space, xyz.
+inline void ToLightSpace8(const CasterBounds& bounds, const cull::BoxArrays& boxes, u64 start, simd::f32x8* center, simd::f32x8* extent)
+{
+    simd::f32x8 cx = simd::Load8(boxes.centerX + start);
+    simd::f32x8 cy = simd::Load8(boxes.centerY + start);
+    simd::f32x8 cz = simd::Load8(boxes.centerZ + start);
+    simd::f32x8 ex = simd::Load8(boxes.extentX + start);
+    simd::f32x8 ey = simd::Load8(boxes.extentY + start);
+    simd::f32x8 ez = simd::Load8(boxes.extentZ + start);
+    for(u32 i = 0; i < 3; i++)
+    {
+        center[i] = simd::Mul(simd::Load8(bounds.rotation[i * 3]), cx);
+        center[i] = simd::MulAdd(simd::Load8(bounds.rotation[i * 3 + 1]), cy, center[i]);
+        center[i] = simd::MulAdd(simd::Load8(bounds.rotation[i * 3 + 2]), cz, center[i]);
+        extent[i] = simd::Mul(simd::Load8(bounds.absRotation[i * 3]), ex);
+        extent[i] = simd::MulAdd(simd::Load8(bounds.absRotation[i * 3 + 1]), ey, extent[i]);
+        extent[i] = simd::MulAdd(simd::Load8(bounds.absRotation[i * 3 + 2]), ez, extent[i]);
+    }
+}
+
+inline void ToLightSpace(const CasterBounds& bounds, const cull::BoxArrays& boxes, u64 index, f32* center, f32* extent)
+{
+    for(u32 i = 0; i < 3; i++)
+    {
+        center[i] = bounds.rotation[i * 3][0] * boxes.centerX[index];
+        center[i] = bounds.rotation[i * 3 + 1][0] * boxes.centerY[index] + center[i];
+        center[i] = bounds.rotation[i * 3 + 2][0] * boxes.centerZ[index] + center[i];
+        extent[i] = bounds.absRotation[i * 3][0] * boxes.extentX[index];
+        extent[i] = bounds.absRotation[i * 3 + 1][0] * boxes.extentY[index] + extent[i];
+        extent[i] = bounds.absRotation[i * 3 + 2][0] * boxes.extentZ[index] + extent[i];
+    }
+}
+
+// Lanes whose box overlaps the cascade's x and y range.
+inline simd::f32x8 OverlapXY8(const CasterBounds& bounds, u32 cascade, const simd::f32x8* center, const simd::f32x8* extent)
+{
+    simd::f32x8 result = simd::CmpGE(simd::Add(center[0], extent[0]), simd::Load8(bounds.minX[cascade]));
+    result = simd::And(result, simd::CmpGE(simd::Load8(bounds.maxX[cascade]), simd::Sub(center[0], extent[0])));
+    result = simd::And(result, simd::CmpGE(simd::Add(center[1], extent[1]), simd::Load8(bounds.minY[cascade])));
+    result = simd::And(result, simd::CmpGE(simd::Load8(bounds.maxY[cascade]), simd::Sub(center[1], extent[1])));
+    return result;
+}
+
+inline bool OverlapXY(const CasterBounds& bounds, u32 cascade, const f32* center, const f32* extent)
+{
+    return center[0] + extent[0] >= bounds.minX[cascade][0] && bounds.maxX[cascade][0] >= center[0] - extent[0] &&
+           center[1] + extent[1] >= bounds.minY[cascade][0] && bounds.maxY[cascade][0] >= center[1] - extent[1];
+}
+
+// ========================================================
+// [DEPTH]
+
+void FitCascadeDepths(Cascade* cascades, u32 count, const cull::BoxArrays& boxes)
+{
+    ASSERT(cascades);
+    CasterBounds bounds;
+    MakeCasterBounds(cascades, count, &bounds);
+
+    // Highest and lowest light space z of the boxes over each cascade.
+    simd::f32x8 top[TY_SHADOW_MAX_CASCADES];
+    simd::f32x8 bottom[TY_SHADOW_MAX_CASCADES];
+    for(u32 i = 0; i < count; i++)
+    {
+        top[i] = simd::Splat8(-MAX_F32);
+        bottom[i] = simd::Splat8(MAX_F32);
+    }
+    u64 index = 0;
+    for(; index + 8 <= boxes.count; index += 8)
+    {
+        simd::f32x8 center[3];
+        simd::f32x8 extent[3];
+        ToLightSpace8(bounds, boxes, index, center, extent);
+        simd::f32x8 boxTop = simd::Add(center[2], extent[2]);
+        simd::f32x8 boxBottom = simd::Sub(center[2], extent[2]);
+        for(u32 i = 0; i < count; i++)
+        {
+            simd::f32x8 overlap = OverlapXY8(bounds, i, center, extent);
+            top[i] = simd::Max(top[i], simd::Select(overlap, boxTop, simd::Splat8(-MAX_F32)));
+            bottom[i] = simd::Min(bottom[i], simd::Select(overlap, boxBottom, simd::Splat8(MAX_F32)));
+        }
+    }
+    f32 tops[TY_SHADOW_MAX_CASCADES][8];
+    f32 bottoms[TY_SHADOW_MAX_CASCADES][8];
+    for(u32 i = 0; i < count; i++)
+    {
+        simd::Store8(tops[i], top[i]);
+        simd::Store8(bottoms[i], bottom[i]);
+    }
+    for(; index < boxes.count; index++)
+    {
+        f32 center[3];
+        f32 extent[3];
+        ToLightSpace(bounds, boxes, index, center, extent);
+        for(u32 i = 0; i < count; i++)
+        {
+            if(!OverlapXY(bounds, i, center, extent)) continue;
+            tops[i][0] = MAX(tops[i][0], center[2] + extent[2]);
+            bottoms[i][0] = MIN(bottoms[i][0], center[2] - extent[2]);
+        }
+    }
+
+    for(u32 i = 0; i < count; i++)
+    {
+        f32 maxZ = tops[i][0];
+        f32 minZ = bottoms[i][0];
+        for(u32 lane = 1; lane < 8; lane++)
+        {
+            maxZ = MAX(maxZ, tops[i][lane]);
+            minZ = MIN(minZ, bottoms[i][lane]);
+        }
+        if(maxZ < minZ) continue;   // Nothing over the cascade.
+
+        // Casters anywhere toward the light are kept, receivers end at the slice.
+        Cascade* cascade = &cascades[i];
+        cascade->maxZ = MAX(maxZ, cascade->minZ + cascade->texelSize);
+        cascade->minZ = MIN(MAX(cascade->minZ, minZ), cascade->maxZ - cascade->texelSize);
+        SetProjection(cascade);
+    }
+}
+
+// ========================================================
+// [CULL]
+
+// Fills the mask words covering [start, end) of every cascade. start must be a multiple of 64.
+void CullRange(const CasterBounds& bounds, const cull::BoxArrays& casters, u64 start, u64 end, u64** masks)
+{
+    ASSERT(start % 64 == 0);
+    for(u64 base = start; base < end; base += 64)
+    {
+        u64 wordEnd = MIN(base + 64, end);
+        u64 bits[TY_SHADOW_MAX_CASCADES] = {};
+        u64 i = base;
+        for(; i + 8 <= wordEnd; i += 8)
+        {
+            simd::f32x8 center[3];
+            simd::f32x8 extent[3];
+            ToLightSpace8(bounds, casters, i, center, extent);
+            simd::f32x8 boxTop = simd::Add(center[2], extent[2]);
+            for(u32 c = 0; c < bounds.count; c++)
+            {
+                simd::f32x8 inside = simd::And(OverlapXY8(bounds, c, center, extent), simd::CmpGE(boxTop, simd::Load8(bounds.minZ[c])));
+                bits[c] |= (u64)simd::MoveMask(inside) << (i - base);
+            }
+        }
+        for(; i < wordEnd; i++)
+        {
+            f32 center[3];
+            f32 extent[3];
+            ToLightSpace(bounds, casters, i, center, extent);
+            for(u32 c = 0; c < bounds.count; c++)
+            {
+                bool inside = OverlapXY(bounds, c, center, extent) && center[2] + extent[2] >= bounds.minZ[c][0];
+                bits[c] |= (u64)inside << (i - base);
+            }
+        }
+        for(u32 c = 0; c < bounds.count; c++)
+        {
+            masks[c][base / 64] = bits[c];
+        }
+    }
+}
+
+struct CullTask
+{
+    const CasterBounds* bounds = NULL;
+    const cull::BoxArrays* casters = NULL;
+    u64** masks = NULL;
+};
+
+void CullTaskProc(void* data, u64 start, u64 end, u32 threadIndex)
+{
+    CullTask* task = (CullTask*)data;
+    CullRange(*task->bounds, *task->casters, start, end, task->masks);
+}
+
+void CullCasters(const Cascade* cascades, u32 count, const cull::BoxArrays& casters, u64** masks, bool parallel)
+{
+    ASSERT(cascades && masks);
+    CasterBounds bounds;
+    MakeCasterBounds(cascades, count, &bounds);
+    if(parallel)
+    {
+        CullTask task = {};
+        task.bounds = &bounds;
+        task.casters = &casters;
+        task.masks = masks;
+        async::ParallelFor(casters.count, TY_SHADOW_PARALLEL_BATCH, CullTaskProc, &task);
+    }
+    else
+    {
+        CullRange(bounds, casters, 0, casters.count, masks);
+    }
+}
+
+};
+};
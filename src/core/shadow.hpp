@@ -0,0 +1,79 @@
+// ========================================================
+// SHADOW
+// Cascaded shadow maps for a directional light: the camera frustum is cut in depth slices,
+// each covered by its own orthographic shadow map, so texel density follows the camera.
+// Splits blend logarithmic and uniform spacing (Zhang et al., "Parallel-Split Shadow Maps",
+// 2006). Each cascade is fit around the bounding sphere of its slice and its origin snapped
+// to whole texels, so the map doesn't change size as the camera turns and doesn't shimmer as
+// it moves (Valient, "Stable Cascaded Shadow Maps", 2008). Depth bounds can then be
+// tightened to the scene's boxes, pulling the near plane back to the farthest caster toward
+// the light and the far plane in to the last receiver.
+// Casters are culled against each cascade's box extruded toward the light, since anything
+// between the light and a slice can cast into it. Every cascade shares the light rotation,
+// so boxes go to light space once, 8 at a time with core/simd, and are tested against all
+// cascades from there. Results are core/cull masks, one per cascade, which
+// cull::MaskToIndices turns into draw lists.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./debug.hpp"
+#include "./simd.hpp"
+#include "./math.hpp"
+#include "./async.hpp"
+#include "./cull.hpp"
+
+namespace ty
+{
+namespace shadow
+{
+
+#define TY_SHADOW_MAX_CASCADES 8
+#define TY_SHADOW_PARALLEL_BATCH 4096   // Casters per parallel task. Multiple of 64, so mask words aren't shared.
+
+struct CascadeDesc
+{
+    u32 cascadeCount = 4;
+    f32 splitLambda = 0.75f;            // 1 for logarithmic splits, 0 for uniform ones.
+    f32 shadowDistance = 0;             // View distance of the last split, 0 covers the whole frustum.
+    u32 resolution = 2048;              // Shadow map texels per side.
+};
+
+struct Cascade
+{
+    m4f view = {};                      // Light rotation, the same for every cascade.
+    m4f proj = {};                      // Orthographic, Vulkan clip space as math::PerspectiveRH.
+    m4f viewProj = {};
+    f32 splitNear = 0;                  // View distances the cascade covers, for picking it in shaders.
+    f32 splitFar = 0;
+    f32 texelSize = 0;                  // World units per shadow map texel.
+
+    // Light view space box, z grows toward the light.
+    f32 minX = 0;
+    f32 maxX = 0;
+    f32 minY = 0;
+    f32 maxY = 0;
+    f32 minZ = 0;
+    f32 maxZ = 0;
+};
+
+// Fills desc.cascadeCount cascades for a camera frustum from math::GetFrustum, nearest first.
+// lightDirection is the direction light travels in. Depth bounds are the slice's bounding
+// sphere. Perspective frustums give view distances from the camera; orthographic ones are
+// split uniformly and give distances from their near plane.
+void ComputeCascades(const math::Frustum& frustum, v3f lightDirection, const CascadeDesc& desc, Cascade* cascades);
+
+// Tightens the depth bounds from ComputeCascades to the boxes each cascade overlaps: near
+// to the farthest one toward the light, far to the last one if it ends before the slice.
+// Rebuilds proj and viewProj, x and y stay snapped.
+void FitCascadeDepths(Cascade* cascades, u32 count, const cull::BoxArrays& boxes);
+
+// ========================================================
+// [CULL]
+// masks[i] receives the casters of cascade i in the core/cull layout, each holding
+// cull::GetMaskWordCount(casters.count) words.
+void CullCasters(const Cascade* cascades, u32 count, const cull::BoxArrays& casters, u64** masks, bool parallel = false);
+
+};
+};
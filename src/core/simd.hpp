@@ -0,0 +1,440 @@
+// ========================================================
+// SIMD
+// Thin wrapper over 4-wide f32 vector registers, so kernels are written once and compile to
+// SSE (x64), NEON (arm64) or plain scalar code. The backend is selected at compile time
+// from the target; define TY_NO_SIMD to force the scalar one.
+// Unaligned loads/stores are the default since arena allocations are not 16-byte aligned
+// unless asked for; the aligned variants assert it.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./debug.hpp"
+
+#if !defined(TY_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#define TY_SIMD_SSE 1
+#include <immintrin.h>
+#elif !defined(TY_NO_SIMD) && (defined(__ARM_NEON) || defined(_M_ARM64))
+#define TY_SIMD_NEON 1
+#include <arm_neon.h>
+#else
+#define TY_SIMD_SCALAR 1
+#endif
+
+#if TY_SIMD_SSE && defined(__FMA__)
+#define TY_SIMD_FMA 1       // Fused multiply-add, results differ from separate mul/add in the last bit.
+#endif
+#if TY_SIMD_SSE && defined(__AVX2__)
+#define TY_SIMD_AVX2 1
+#endif
+#if TY_SIMD_SSE && defined(__F16C__)
+#define TY_SIMD_F16C 1      // Hardware f32 <-> f16 conversion, always there with AVX2.
+#endif
+
+namespace ty
+{
+namespace simd
+{
+
+#if TY_SIMD_SSE
+typedef __m128 f32x4;
+
+inline f32x4 Load(const f32* p)             { return _mm_loadu_ps(p); }
+inline f32x4 LoadAligned(const f32* p)      { ASSERT(IS_ALIGNED(p, 16)); return _mm_load_ps(p); }
+inline void  Store(f32* p, f32x4 a)         { _mm_storeu_ps(p, a); }
+inline void  StoreAligned(f32* p, f32x4 a)  { ASSERT(IS_ALIGNED(p, 16)); _mm_store_ps(p, a); }
+inline f32x4 Set(f32 x, f32 y, f32 z, f32 w) { return _mm_setr_ps(x, y, z, w); }
+inline f32x4 Set1(f32 a)                    { return _mm_set1_ps(a); }
+inline f32x4 Zero()                         { return _mm_setzero_ps(); }
+
+inline f32x4 Add(f32x4 a, f32x4 b)          { return _mm_add_ps(a, b); }
+inline f32x4 Sub(f32x4 a, f32x4 b)          { return _mm_sub_ps(a, b); }
+inline f32x4 Mul(f32x4 a, f32x4 b)          { return _mm_mul_ps(a, b); }
+inline f32x4 Div(f32x4 a, f32x4 b)          { return _mm_div_ps(a, b); }
+inline f32x4 Min(f32x4 a, f32x4 b)          { return _mm_min_ps(a, b); }
+inline f32x4 Max(f32x4 a, f32x4 b)          { return _mm_max_ps(a, b); }
+inline f32x4 Abs(f32x4 a)                   { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+inline f32x4 RsqrtEstimate(f32x4 a)         { return _mm_rsqrt_ps(a); }    // 12 bits, refine with a Newton step.
+#if TY_SIMD_FMA
+inline f32x4 MulAdd(f32x4 a, f32x4 b, f32x4 c) { return _mm_fmadd_ps(a, b, c); }
+#else
+inline f32x4 MulAdd(f32x4 a, f32x4 b, f32x4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+#endif
+// Opaque to the optimizer, which can't reorder operations across it, see through it to a
+// constant or merge two of them, so -Ofast keeps split constant reductions in order and
+// divisions as divisions.
+inline f32x4 Barrier(f32x4 a)               { asm volatile("" : "+x"(a)); return a; }
+inline f32 Barrier(f32 a)                   { asm volatile("" : "+x"(a)); return a; }     // Same for scalar code.
+
+// Lanes X, Y from a and Z, W from b.
+template <u32 X, u32 Y, u32 Z, u32 W>
+inline f32x4 Shuffle(f32x4 a, f32x4 b)      { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(W, Z, Y, X)); }
+template <u32 I>
+inline f32 GetLane(f32x4 a)                 { return _mm_cvtss_f32(_mm_shuffle_ps(a, a, _MM_SHUFFLE(I, I, I, I))); }
+
+// Comparisons return lane masks, MoveMask packs their sign bits (lane i in bit i). Select
+// takes a where the mask is set, b elsewhere.
+inline f32x4 CmpLT(f32x4 a, f32x4 b)        { return _mm_cmplt_ps(a, b); }
+inline f32x4 CmpLE(f32x4 a, f32x4 b)        { return _mm_cmple_ps(a, b); }
+inline f32x4 CmpGT(f32x4 a, f32x4 b)        { return _mm_cmpgt_ps(a, b); }
+inline f32x4 CmpGE(f32x4 a, f32x4 b)        { return _mm_cmpge_ps(a, b); }
+inline f32x4 And(f32x4 a, f32x4 b)          { return _mm_and_ps(a, b); }
+inline f32x4 Or(f32x4 a, f32x4 b)           { return _mm_or_ps(a, b); }
+inline f32x4 Xor(f32x4 a, f32x4 b)          { return _mm_xor_ps(a, b); }
+inline f32x4 Select(f32x4 mask, f32x4 a, f32x4 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+inline u32   MoveMask(f32x4 a)              { return (u32)_mm_movemask_ps(a); }
+
+#elif TY_SIMD_NEON
+typedef float32x4_t f32x4;
+
+inline f32x4 Load(const f32* p)             { return vld1q_f32(p); }
+inline f32x4 LoadAligned(const f32* p)      { ASSERT(IS_ALIGNED(p, 16)); return vld1q_f32(p); }
+inline void  Store(f32* p, f32x4 a)         { vst1q_f32(p, a); }
+inline void  StoreAligned(f32* p, f32x4 a)  { ASSERT(IS_ALIGNED(p, 16)); vst1q_f32(p, a); }
+inline f32x4 Set(f32 x, f32 y, f32 z, f32 w) { f32 v[4] = { x, y, z, w }; return vld1q_f32(v); }
+inline f32x4 Set1(f32 a)                    { return vdupq_n_f32(a); }
+inline f32x4 Zero()                         { return vdupq_n_f32(0); }
+
+inline f32x4 Add(f32x4 a, f32x4 b)          { return vaddq_f32(a, b); }
+inline f32x4 Sub(f32x4 a, f32x4 b)          { return vsubq_f32(a, b); }
+inline f32x4 Mul(f32x4 a, f32x4 b)          { return vmulq_f32(a, b); }
+inline f32x4 Div(f32x4 a, f32x4 b)          { return vdivq_f32(a, b); }
+inline f32x4 Min(f32x4 a, f32x4 b)          { return vminq_f32(a, b); }
+inline f32x4 Max(f32x4 a, f32x4 b)          { return vmaxq_f32(a, b); }
+inline f32x4 Abs(f32x4 a)                   { return vabsq_f32(a); }
+inline f32x4 RsqrtEstimate(f32x4 a)         // The raw estimate has 8 bits, one step brings it near SSE's 12.
+{
+    f32x4 e = vrsqrteq_f32(a);
+    return vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(a, e), e));
+}
+inline f32x4 MulAdd(f32x4 a, f32x4 b, f32x4 c) { return vaddq_f32(vmulq_f32(a, b), c); }
+inline f32x4 Barrier(f32x4 a)               { asm volatile("" : "+w"(a)); return a; }
+inline f32 Barrier(f32 a)                   { asm volatile("" : "+w"(a)); return a; }
+
+template <u32 X, u32 Y, u32 Z, u32 W>
+inline f32x4 Shuffle(f32x4 a, f32x4 b)      { return __builtin_shufflevector(a, b, X, Y, Z + 4, W + 4); }
+template <u32 I>
+inline f32 GetLane(f32x4 a)                 { return vgetq_lane_f32(a, I); }
+
+inline f32x4 CmpLT(f32x4 a, f32x4 b)        { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+inline f32x4 CmpLE(f32x4 a, f32x4 b)        { return vreinterpretq_f32_u32(vcleq_f32(a, b)); }
+inline f32x4 CmpGT(f32x4 a, f32x4 b)        { return vreinterpretq_f32_u32(vcgtq_f32(a, b)); }
+inline f32x4 CmpGE(f32x4 a, f32x4 b)        { return vreinterpretq_f32_u32(vcgeq_f32(a, b)); }
+inline f32x4 And(f32x4 a, f32x4 b)
+{
+    return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+}
+inline f32x4 Or(f32x4 a, f32x4 b)
+{
+    return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+}
+inline f32x4 Xor(f32x4 a, f32x4 b)
+{
+    return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+}
+inline f32x4 Select(f32x4 mask, f32x4 a, f32x4 b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+inline u32 MoveMask(f32x4 a)
+{
+    const int32_t shifts[4] = { 0, 1, 2, 3 };
+    uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(a), 31);
+    return vaddvq_u32(vshlq_u32(bits, vld1q_s32(shifts)));
+}
+
+#else
+struct f32x4 { f32 v[4]; };
+
+inline f32x4 Load(const f32* p)             { return { p[0], p[1], p[2], p[3] }; }
+inline f32x4 LoadAligned(const f32* p)      { ASSERT(IS_ALIGNED(p, 16)); return Load(p); }
+inline void  Store(f32* p, f32x4 a)         { p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3]; }
+inline void  StoreAligned(f32* p, f32x4 a)  { ASSERT(IS_ALIGNED(p, 16)); Store(p, a); }
+inline f32x4 Set(f32 x, f32 y, f32 z, f32 w) { return { x, y, z, w }; }
+inline f32x4 Set1(f32 a)                    { return { a, a, a, a }; }
+inline f32x4 Zero()                         { return { 0, 0, 0, 0 }; }
+
+#define TY_SIMD_SCALAR_OP(NAME, EXPR) \
+    inline f32x4 NAME(f32x4 a, f32x4 b) \
+    { \
+        f32x4 r; \
+        for(u32 i = 0; i < 4; i++) { f32 x = a.v[i]; f32 y = b.v[i]; r.v[i] = (EXPR); } \
+        return r; \
+    }
+TY_SIMD_SCALAR_OP(Add, x + y)
+TY_SIMD_SCALAR_OP(Sub, x - y)
+TY_SIMD_SCALAR_OP(Mul, x * y)
+TY_SIMD_SCALAR_OP(Div, x / y)
+TY_SIMD_SCALAR_OP(Min, x < y ? x : y)
+TY_SIMD_SCALAR_OP(Max, x > y ? x : y)
+#undef TY_SIMD_SCALAR_OP
+inline f32x4 Abs(f32x4 a)                   { return { fabsf(a.v[0]), fabsf(a.v[1]), fabsf(a.v[2]), fabsf(a.v[3]) }; }
+inline f32x4 RsqrtEstimate(f32x4 a)         { f32x4 r; for(u32 i = 0; i < 4; i++) r.v[i] = 1.f / sqrtf(a.v[i]); return r; }
+inline f32x4 MulAdd(f32x4 a, f32x4 b, f32x4 c) { return Add(Mul(a, b), c); }
+inline f32x4 Barrier(f32x4 a)               { asm volatile("" : "+m"(a)); return a; }
+inline f32 Barrier(f32 a)                   { asm volatile("" : "+m"(a)); return a; }
+
+template <u32 X, u32 Y, u32 Z, u32 W>
+inline f32x4 Shuffle(f32x4 a, f32x4 b)      { return { a.v[X], a.v[Y], b.v[Z], b.v[W] }; }
+template <u32 I>
+inline f32 GetLane(f32x4 a)                 { return a.v[I]; }
+
+// Masks are all ones (as f32 bits) for true lanes.
+inline f32 MaskLane(bool b)                 { u32 bits = b ? MAX_U32 : 0; f32 r; memcpy(&r, &bits, 4); return r; }
+inline f32x4 CmpLT(f32x4 a, f32x4 b)        { f32x4 r; for(u32 i = 0; i < 4; i++) r.v[i] = MaskLane(a.v[i] < b.v[i]); return r; }
+inline f32x4 CmpLE(f32x4 a, f32x4 b)        { f32x4 r; for(u32 i = 0; i < 4; i++) r.v[i] = MaskLane(a.v[i] <= b.v[i]); return r; }
+inline f32x4 CmpGT(f32x4 a, f32x4 b)        { return CmpLT(b, a); }
+inline f32x4 CmpGE(f32x4 a, f32x4 b)        { return CmpLE(b, a); }
+inline f32x4 And(f32x4 a, f32x4 b)
+{
+    f32x4 r;
+    for(u32 i = 0; i < 4; i++)
+    {
+        u32 x, y;
+        memcpy(&x, &a.v[i], 4);
+        memcpy(&y, &b.v[i], 4);
+        x &= y;
+        memcpy(&r.v[i], &x, 4);
+    }
+    return r;
+}
+inline f32x4 Or(f32x4 a, f32x4 b)
+{
+    f32x4 r;
+    for(u32 i = 0; i < 4; i++)
+    {
+        u32 x, y;
+        memcpy(&x, &a.v[i], 4);
+        memcpy(&y, &b.v[i], 4);
+        x |= y;
+        memcpy(&r.v[i], &x, 4);
+    }
+    return r;
+}
+inline f32x4 Xor(f32x4 a, f32x4 b)
+{
+    f32x4 r;
+    for(u32 i = 0; i < 4; i++)
+    {
+        u32 x, y;
+        memcpy(&x, &a.v[i], 4);
+        memcpy(&y, &b.v[i], 4);
+        x ^= y;
+        memcpy(&r.v[i], &x, 4);
+    }
+    return r;
+}
+inline f32x4 Select(f32x4 mask, f32x4 a, f32x4 b)
+{
+    f32x4 r;
+    for(u32 i = 0; i < 4; i++)
+    {
+        u32 m;
+        memcpy(&m, &mask.v[i], 4);
+        r.v[i] = m ? a.v[i] : b.v[i];
+    }
+    return r;
+}
+inline u32 MoveMask(f32x4 a)
+{
+    u32 result = 0;
+    for(u32 i = 0; i < 4; i++)
+    {
+        u32 x;
+        memcpy(&x, &a.v[i], 4);
+        result |= (x >> 31) << i;
+    }
+    return result;
+}
+#endif
+
+// Backend independent helpers.
+template <u32 X, u32 Y, u32 Z, u32 W>
+inline f32x4 Swizzle(f32x4 a)               { return Shuffle<X, Y, Z, W>(a, a); }
+template <u32 I>
+inline f32x4 Splat(f32x4 a)                 { return Shuffle<I, I, I, I>(a, a); }
+inline f32x4 HorizontalSum(f32x4 a)         // Sum of all lanes in every lane.
+{
+    a = Add(a, Swizzle<1, 0, 3, 2>(a));
+    return Add(a, Swizzle<2, 3, 0, 1>(a));
+}
+
+// Four packed xyz triples (12 floats) to and from one vector per component.
+inline void LoadXYZ4(const f32* p, f32x4& x, f32x4& y, f32x4& z)
+{
+    f32x4 a = Load(p);          // x0 y0 z0 x1
+    f32x4 b = Load(p + 4);      // y1 z1 x2 y2
+    f32x4 c = Load(p + 8);      // z2 x3 y3 z3
+    x = Shuffle<0, 1, 0, 2>(Shuffle<0, 3, 2, 3>(a, b), Shuffle<2, 2, 1, 1>(b, c));
+    y = Shuffle<0, 2, 0, 2>(Shuffle<1, 1, 0, 0>(a, b), Shuffle<3, 3, 2, 2>(b, c));
+    z = Shuffle<0, 2, 0, 2>(Shuffle<2, 2, 1, 1>(a, b), Shuffle<0, 0, 3, 3>(c, c));
+}
+
+inline void StoreXYZ4(f32* p, f32x4 x, f32x4 y, f32x4 z)
+{
+    Store(p, Shuffle<0, 2, 0, 2>(Shuffle<0, 0, 0, 0>(x, y), Shuffle<0, 0, 1, 1>(z, x)));
+    Store(p + 4, Shuffle<0, 2, 0, 2>(Shuffle<1, 1, 1, 1>(y, z), Shuffle<2, 2, 2, 2>(x, y)));
+    Store(p + 8, Shuffle<0, 2, 0, 2>(Shuffle<2, 2, 3, 3>(z, x), Shuffle<3, 3, 3, 3>(y, z)));
+}
+
+// In-place 4x4 transpose of four rows.
+inline void Transpose4(f32x4& r0, f32x4& r1, f32x4& r2, f32x4& r3)
+{
+    f32x4 t0 = Shuffle<0, 1, 0, 1>(r0, r1);
+    f32x4 t1 = Shuffle<2, 3, 2, 3>(r0, r1);
+    f32x4 t2 = Shuffle<0, 1, 0, 1>(r2, r3);
+    f32x4 t3 = Shuffle<2, 3, 2, 3>(r2, r3);
+    r0 = Shuffle<0, 2, 0, 2>(t0, t2);
+    r1 = Shuffle<1, 3, 1, 3>(t0, t2);
+    r2 = Shuffle<0, 2, 0, 2>(t1, t3);
+    r3 = Shuffle<1, 3, 1, 3>(t1, t3);
+}
+
+// ========================================================
+// [INTEGER]
+// i32 lanes, for building and taking apart float bits (exponents, quadrants, signs) and
+// packed formats. ConvertToI32 rounds to nearest (even on ties), Cast reinterprets the
+// bits. ShiftRight is arithmetic.
+#if TY_SIMD_SSE
+typedef __m128i i32x4;
+
+inline i32x4 LoadI32(const i32* p)          { return _mm_loadu_si128((const __m128i*)p); }
+inline void  Store(i32* p, i32x4 a)         { _mm_storeu_si128((__m128i*)p, a); }
+inline i32x4 Set1I32(i32 a)                 { return _mm_set1_epi32(a); }
+inline i32x4 Add(i32x4 a, i32x4 b)          { return _mm_add_epi32(a, b); }
+inline i32x4 And(i32x4 a, i32x4 b)          { return _mm_and_si128(a, b); }
+inline i32x4 Or(i32x4 a, i32x4 b)           { return _mm_or_si128(a, b); }
+template <u32 N>
+inline i32x4 ShiftLeft(i32x4 a)             { return _mm_slli_epi32(a, N); }
+template <u32 N>
+inline i32x4 ShiftRight(i32x4 a)            { return _mm_srai_epi32(a, N); }
+inline i32x4 ConvertToI32(f32x4 a)          { return _mm_cvtps_epi32(a); }
+inline f32x4 ConvertToF32(i32x4 a)          { return _mm_cvtepi32_ps(a); }
+inline i32x4 CastToI32(f32x4 a)             { return _mm_castps_si128(a); }
+inline f32x4 CastToF32(i32x4 a)             { return _mm_castsi128_ps(a); }
+
+#elif TY_SIMD_NEON
+typedef int32x4_t i32x4;
+
+inline i32x4 LoadI32(const i32* p)          { return vld1q_s32(p); }
+inline void  Store(i32* p, i32x4 a)         { vst1q_s32(p, a); }
+inline i32x4 Set1I32(i32 a)                 { return vdupq_n_s32(a); }
+inline i32x4 Add(i32x4 a, i32x4 b)          { return vaddq_s32(a, b); }
+inline i32x4 And(i32x4 a, i32x4 b)          { return vandq_s32(a, b); }
+inline i32x4 Or(i32x4 a, i32x4 b)           { return vorrq_s32(a, b); }
+template <u32 N>
+inline i32x4 ShiftLeft(i32x4 a)             { return vshlq_n_s32(a, N); }
+template <u32 N>
+inline i32x4 ShiftRight(i32x4 a)            { return vshrq_n_s32(a, N); }
+inline i32x4 ConvertToI32(f32x4 a)          { return vcvtnq_s32_f32(a); }
+inline f32x4 ConvertToF32(i32x4 a)          { return vcvtq_f32_s32(a); }
+inline i32x4 CastToI32(f32x4 a)             { return vreinterpretq_s32_f32(a); }
+inline f32x4 CastToF32(i32x4 a)             { return vreinterpretq_f32_s32(a); }
+
+#else
+struct i32x4 { i32 v[4]; };
+
+inline i32x4 LoadI32(const i32* p)          { return { p[0], p[1], p[2], p[3] }; }
+inline void  Store(i32* p, i32x4 a)         { p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3]; }
+inline i32x4 Set1I32(i32 a)                 { return { a, a, a, a }; }
+inline i32x4 Add(i32x4 a, i32x4 b)          { i32x4 r; for(u32 i = 0; i < 4; i++) r.v[i] = (i32)((u32)a.v[i] + (u32)b.v[i]); return r; }
+inline i32x4 And(i32x4 a, i32x4 b)          { i32x4 r; for(u32 i = 0; i < 4; i++) r.v[i] = a.v[i] & b.v[i]; return r; }
+inline i32x4 Or(i32x4 a, i32x4 b)           { i32x4 r; for(u32 i = 0; i < 4; i++) r.v[i] = a.v[i] | b.v[i]; return r; }
+template <u32 N>
+inline i32x4 ShiftLeft(i32x4 a)             { i32x4 r; for(u32 i = 0; i < 4; i++) r.v[i] = (i32)((u32)a.v[i] << N); return r; }
+template <u32 N>
+inline i32x4 ShiftRight(i32x4 a)            { i32x4 r; for(u32 i = 0; i < 4; i++) r.v[i] = a.v[i] >> N; return r; }
+inline i32x4 ConvertToI32(f32x4 a)          { i32x4 r; for(u32 i = 0; i < 4; i++) r.v[i] = (i32)rintf(a.v[i]); return r; }
+inline f32x4 ConvertToF32(i32x4 a)          { f32x4 r; for(u32 i = 0; i < 4; i++) r.v[i] = (f32)a.v[i]; return r; }
+inline i32x4 CastToI32(f32x4 a)             { i32x4 r; memcpy(&r, &a, sizeof(r)); return r; }
+inline f32x4 CastToF32(i32x4 a)             { f32x4 r; memcpy(&r, &a, sizeof(r)); return r; }
+#endif
+
+// ========================================================
+// [8-WIDE]
+// One AVX2 register, otherwise a pair of 4-wide vectors, so 8-wide kernels are written once.
+// Only lane-wise operations.
+#if TY_SIMD_AVX2
+typedef __m256 f32x8;
+
+inline f32x8 Load8(const f32* p)            { return _mm256_loadu_ps(p); }
+inline void  Store8(f32* p, f32x8 a)        { _mm256_storeu_ps(p, a); }
+inline f32x8 Splat8(f32 a)                  { return _mm256_set1_ps(a); }
+
+inline f32x8 Add(f32x8 a, f32x8 b)          { return _mm256_add_ps(a, b); }
+inline f32x8 Sub(f32x8 a, f32x8 b)          { return _mm256_sub_ps(a, b); }
+inline f32x8 Mul(f32x8 a, f32x8 b)          { return _mm256_mul_ps(a, b); }
+inline f32x8 Div(f32x8 a, f32x8 b)          { return _mm256_div_ps(a, b); }
+inline f32x8 Min(f32x8 a, f32x8 b)          { return _mm256_min_ps(a, b); }
+inline f32x8 Max(f32x8 a, f32x8 b)          { return _mm256_max_ps(a, b); }
+inline f32x8 Abs(f32x8 a)                   { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+inline f32x8 RsqrtEstimate(f32x8 a)         { return _mm256_rsqrt_ps(a); }
+#if TY_SIMD_FMA
+inline f32x8 MulAdd(f32x8 a, f32x8 b, f32x8 c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+inline f32x8 MulAdd(f32x8 a, f32x8 b, f32x8 c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+inline f32x8 Barrier(f32x8 a)               { asm volatile("" : "+x"(a)); return a; }
+inline f32x8 CmpLT(f32x8 a, f32x8 b)        { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline f32x8 CmpGE(f32x8 a, f32x8 b)        { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+inline f32x8 And(f32x8 a, f32x8 b)          { return _mm256_and_ps(a, b); }
+inline f32x8 Or(f32x8 a, f32x8 b)           { return _mm256_or_ps(a, b); }
+inline f32x8 Xor(f32x8 a, f32x8 b)          { return _mm256_xor_ps(a, b); }
+inline f32x8 Select(f32x8 mask, f32x8 a, f32x8 b) { return _mm256_blendv_ps(b, a, mask); }
+inline u32   MoveMask(f32x8 a)              { return (u32)_mm256_movemask_ps(a); }
+
+typedef __m256i i32x8;
+
+inline i32x8 Splat8I32(i32 a)               { return _mm256_set1_epi32(a); }
+inline i32x8 Add(i32x8 a, i32x8 b)          { return _mm256_add_epi32(a, b); }
+template <u32 N>
+inline i32x8 ShiftLeft(i32x8 a)             { return _mm256_slli_epi32(a, N); }
+template <u32 N>
+inline i32x8 ShiftRight(i32x8 a)            { return _mm256_srai_epi32(a, N); }
+inline i32x8 ConvertToI32(f32x8 a)          { return _mm256_cvtps_epi32(a); }
+inline f32x8 ConvertToF32(i32x8 a)          { return _mm256_cvtepi32_ps(a); }
+inline i32x8 CastToI32(f32x8 a)             { return _mm256_castps_si256(a); }
+inline f32x8 CastToF32(i32x8 a)             { return _mm256_castsi256_ps(a); }
+
+#else
+struct f32x8 { f32x4 lo; f32x4 hi; };
+
+inline f32x8 Load8(const f32* p)            { return { Load(p), Load(p + 4) }; }
+inline void  Store8(f32* p, f32x8 a)        { Store(p, a.lo); Store(p + 4, a.hi); }
+inline f32x8 Splat8(f32 a)                  { return { Set1(a), Set1(a) }; }
+
+#define TY_SIMD_PAIR_OP(NAME) \
+    inline f32x8 NAME(f32x8 a, f32x8 b)     { return { NAME(a.lo, b.lo), NAME(a.hi, b.hi) }; }
+TY_SIMD_PAIR_OP(Add)
+TY_SIMD_PAIR_OP(Sub)
+TY_SIMD_PAIR_OP(Mul)
+TY_SIMD_PAIR_OP(Div)
+TY_SIMD_PAIR_OP(Min)
+TY_SIMD_PAIR_OP(Max)
+TY_SIMD_PAIR_OP(CmpLT)
+TY_SIMD_PAIR_OP(CmpGE)
+TY_SIMD_PAIR_OP(And)
+TY_SIMD_PAIR_OP(Or)
+TY_SIMD_PAIR_OP(Xor)
+#undef TY_SIMD_PAIR_OP
+inline f32x8 Abs(f32x8 a)                   { return { Abs(a.lo), Abs(a.hi) }; }
+inline f32x8 RsqrtEstimate(f32x8 a)         { return { RsqrtEstimate(a.lo), RsqrtEstimate(a.hi) }; }
+inline f32x8 MulAdd(f32x8 a, f32x8 b, f32x8 c) { return { MulAdd(a.lo, b.lo, c.lo), MulAdd(a.hi, b.hi, c.hi) }; }
+inline f32x8 Barrier(f32x8 a)               { return { Barrier(a.lo), Barrier(a.hi) }; }
+inline f32x8 Select(f32x8 mask, f32x8 a, f32x8 b) { return { Select(mask.lo, a.lo, b.lo), Select(mask.hi, a.hi, b.hi) }; }
+inline u32   MoveMask(f32x8 a)              { return MoveMask(a.lo) | (MoveMask(a.hi) << 4); }
+
+struct i32x8 { i32x4 lo; i32x4 hi; };
+
+inline i32x8 Splat8I32(i32 a)               { return { Set1I32(a), Set1I32(a) }; }
+inline i32x8 Add(i32x8 a, i32x8 b)          { return { Add(a.lo, b.lo), Add(a.hi, b.hi) }; }
+template <u32 N>
+inline i32x8 ShiftLeft(i32x8 a)             { return { ShiftLeft<N>(a.lo), ShiftLeft<N>(a.hi) }; }
+template <u32 N>
+inline i32x8 ShiftRight(i32x8 a)            { return { ShiftRight<N>(a.lo), ShiftRight<N>(a.hi) }; }
+inline i32x8 ConvertToI32(f32x8 a)          { return { ConvertToI32(a.lo), ConvertToI32(a.hi) }; }
+inline f32x8 ConvertToF32(i32x8 a)          { return { ConvertToF32(a.lo), ConvertToF32(a.hi) }; }
+inline i32x8 CastToI32(f32x8 a)             { return { CastToI32(a.lo), CastToI32(a.hi) }; }
+inline f32x8 CastToF32(i32x8 a)             { return { CastToF32(a.lo), CastToF32(a.hi) }; }
+#endif
+
+};
+};
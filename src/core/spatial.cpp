@@ -0,0 +1,510 @@
+#include "./spatial.hpp"
+
+namespace ty
+{
+namespace spatial
+{
+
+STATIC_ASSERT(TY_SPATIAL_CHUNK_SIZE == 4);  // Chunks are tested as one f32x4 per component.
+
+// ========================================================
+// [CELLS]
+// Keys pack the level in the top 4 bits and each cell coordinate in 20 bits, biased to be
+// positive. Coordinates are clamped, so far away objects share the border cells; queries
+// clamp the same way and still find them.
+#define TY_SPATIAL_COORD_BITS 20
+#define TY_SPATIAL_COORD_BIAS (1 << (TY_SPATIAL_COORD_BITS - 1))
+#define TY_SPATIAL_COORD_MASK ((1ULL << TY_SPATIAL_COORD_BITS) - 1)
+
+inline u64 PackCell(i32 x, i32 y, i32 z, u32 level)
+{
+    return ((u64)level << (3 * TY_SPATIAL_COORD_BITS)) |
+        ((u64)(x + TY_SPATIAL_COORD_BIAS) << (2 * TY_SPATIAL_COORD_BITS)) |
+        ((u64)(y + TY_SPATIAL_COORD_BIAS) << TY_SPATIAL_COORD_BITS) |
+        (u64)(z + TY_SPATIAL_COORD_BIAS);
+}
+
+inline u32 GetKeyLevel(u64 key)
+{
+    return (u32)(key >> (3 * TY_SPATIAL_COORD_BITS));
+}
+
+inline i32 GetKeyCoord(u64 key, u32 axis)
+{
+    return (i32)((key >> ((2 - axis) * TY_SPATIAL_COORD_BITS)) & TY_SPATIAL_COORD_MASK) - TY_SPATIAL_COORD_BIAS;
+}
+
+inline i32 CellCoord(f32 scaled)
+{
+    return (i32)floorf(CLAMP(scaled, (f32)-TY_SPATIAL_COORD_BIAS, (f32)(TY_SPATIAL_COORD_BIAS - 1)));
+}
+
+inline u32 HashKey(u64 key)
+{
+    key ^= key >> 33;           // Finalizer of MurmurHash3, neighbouring cells land far apart.
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ULL;
+    key ^= key >> 33;
+    return (u32)key;
+}
+
+u32 GetLevel(const HashGrid& grid, v3f halfSize)
+{
+    f32 size = 2 * MAX(halfSize.x, MAX(halfSize.y, halfSize.z));
+    u32 level = 0;
+    while(level < grid.levelCount && grid.cellSizes[level] < size)
+    {
+        level++;
+    }
+    return level;
+}
+
+inline u64 GetKey(const HashGrid& grid, v3f center, u32 level)
+{
+    if(level == grid.levelCount) return PackCell(0, 0, 0, level);
+    f32 inv = grid.invCellSizes[level];
+    return PackCell(CellCoord(center.x * inv), CellCoord(center.y * inv), CellCoord(center.z * inv), level);
+}
+
+inline u32* GetListHead(HashGrid* grid, u64 key)
+{
+    if(GetKeyLevel(key) == grid->levelCount) return &grid->largeObjects;
+    return &grid->buckets.data[HashKey(key) & (grid->buckets.count - 1)];
+}
+
+// ========================================================
+// [CHUNKS]
+
+inline void WriteBounds(Chunk* chunk, u32 slot, const math::AABB& bounds)
+{
+    chunk->minX[slot] = bounds.min.x;
+    chunk->minY[slot] = bounds.min.y;
+    chunk->minZ[slot] = bounds.min.z;
+    chunk->maxX[slot] = bounds.max.x;
+    chunk->maxY[slot] = bounds.max.y;
+    chunk->maxZ[slot] = bounds.max.z;
+}
+
+void CopySlot(Chunk* dst, u32 dstSlot, const Chunk& src, u32 srcSlot)
+{
+    dst->minX[dstSlot] = src.minX[srcSlot];
+    dst->minY[dstSlot] = src.minY[srcSlot];
+    dst->minZ[dstSlot] = src.minZ[srcSlot];
+    dst->maxX[dstSlot] = src.maxX[srcSlot];
+    dst->maxY[dstSlot] = src.maxY[srcSlot];
+    dst->maxZ[dstSlot] = src.maxZ[srcSlot];
+    dst->keys[dstSlot] = src.keys[srcSlot];
+    dst->objects[dstSlot] = src.objects[srcSlot];
+}
+
+void AddToCell(HashGrid* grid, handle object, u64 key, const math::AABB& bounds)
+{
+    u32* head = GetListHead(grid, key);
+    if(*head == HANDLE_INVALID || grid->chunks.data[*head].count == TY_SPATIAL_CHUNK_SIZE)
+    {
+        u32 chunk = grid->freeChunks.count ? grid->freeChunks.Pop() : (u32)grid->chunks.Push({});
+        grid->chunks.data[chunk].count = 0;
+        grid->chunks.data[chunk].next = *head;
+        *head = chunk;
+    }
+    Chunk* chunk = &grid->chunks.data[*head];
+    u32 slot = chunk->count++;
+    WriteBounds(chunk, slot, bounds);
+    chunk->keys[slot] = key;
+    chunk->objects[slot] = object;
+
+    Object& o = grid->objects.data[object];
+    o.key = key;
+    o.location = *head * TY_SPATIAL_CHUNK_SIZE + slot;
+    grid->levelObjectCounts[GetKeyLevel(key)]++;
+}
+
+// The last entry of the list's first chunk fills the hole, so only that chunk is ever partial.
+void RemoveFromCell(HashGrid* grid, handle object)
+{
+    Object& o = grid->objects.data[object];
+    u32* head = GetListHead(grid, o.key);
+    Chunk* first = &grid->chunks.data[*head];
+    Chunk* chunk = &grid->chunks.data[o.location / TY_SPATIAL_CHUNK_SIZE];
+    u32 slot = o.location % TY_SPATIAL_CHUNK_SIZE;
+    u32 last = --first->count;
+    if(chunk != first || slot != last)
+    {
+        CopySlot(chunk, slot, *first, last);
+        grid->objects.data[chunk->objects[slot]].location = o.location;
+    }
+    if(first->count == 0)
+    {
+        grid->freeChunks.Push(*head);
+        *head = first->next;
+    }
+    grid->levelObjectCounts[GetKeyLevel(o.key)]--;
+}
+
+// ========================================================
+// [GRID]
+
+HashGrid MakeHashGrid(mem::Arena* arena, u32 capacity, GridDesc desc)
+{
+    ASSERT(desc.levelCount > 0 && desc.levelCount <= TY_SPATIAL_MAX_LEVELS);
+    ASSERT(desc.cellSize > 0);
+
+    HashGrid result = {};
+    result.levelCount = desc.levelCount;
+    f32 cellSize = desc.cellSize;
+    for(u32 i = 0; i < desc.levelCount; i++)
+    {
+        result.cellSizes[i] = cellSize;
+        result.invCellSizes[i] = 1.f / cellSize;
+        cellSize *= 2;
+    }
+    for(u32 i = 0; i <= TY_SPATIAL_MAX_LEVELS; i++)
+    {
+        result.levelObjectCounts[i] = 0;
+    }
+
+    // Every chunk holds at least one object, so the pool never needs more than capacity.
+    capacity = MAX(capacity, 1);
+    u64 bucketCount = 1;
+    while(bucketCount < (desc.bucketCount ? desc.bucketCount : capacity))
+    {
+        bucketCount *= 2;
+    }
+    result.objects = MakeSArray<Object>(arena, capacity);
+    result.freeObjects = MakeSArray<u32>(arena, capacity);
+    result.chunks = MakeSArray<Chunk>(arena, capacity);
+    result.freeChunks = MakeSArray<u32>(arena, capacity);
+    result.buckets = MakeSArray<u32>(arena, bucketCount, bucketCount, HANDLE_INVALID);
+    u64 maskWords = (capacity + 63) / 64;
+    result.moveMask = MakeSArray<u64>(arena, maskWords, maskWords, 0);
+    return result;
+}
+
+handle Insert(HashGrid* grid, math::AABB bounds)
+{
+    handle result = grid->freeObjects.count ? grid->freeObjects.Pop() : grid->objects.Push({});
+    v3f halfSize = (bounds.max - bounds.min) * 0.5f;
+    grid->objects.data[result].halfSize = halfSize;
+    AddToCell(grid, result, GetKey(*grid, (bounds.min + bounds.max) * 0.5f, GetLevel(*grid, halfSize)), bounds);
+    grid->count++;
+    return result;
+}
+
+handle Insert(HashGrid* grid, v3f position)
+{
+    return Insert(grid, { position, position });
+}
+
+void Update(HashGrid* grid, handle object, math::AABB bounds)
+{
+    Object& o = grid->objects[object];
+    ASSERT(o.location != HANDLE_INVALID);
+    o.halfSize = (bounds.max - bounds.min) * 0.5f;
+    u64 key = GetKey(*grid, (bounds.min + bounds.max) * 0.5f, GetLevel(*grid, o.halfSize));
+    if(key == o.key)
+    {
+        WriteBounds(&grid->chunks.data[o.location / TY_SPATIAL_CHUNK_SIZE], o.location % TY_SPATIAL_CHUNK_SIZE, bounds);
+        return;
+    }
+    RemoveFromCell(grid, object);
+    AddToCell(grid, object, key, bounds);
+}
+
+void Remove(HashGrid* grid, handle object)
+{
+    Object& o = grid->objects[object];
+    ASSERT(o.location != HANDLE_INVALID);
+    RemoveFromCell(grid, object);
+    o.location = HANDLE_INVALID;
+    grid->freeObjects.Push(object);
+    grid->count--;
+}
+
+void Clear(HashGrid* grid)
+{
+    for(u64 i = 0; i < grid->buckets.count; i++)
+    {
+        grid->buckets.data[i] = HANDLE_INVALID;
+    }
+    for(u32 i = 0; i <= TY_SPATIAL_MAX_LEVELS; i++)
+    {
+        grid->levelObjectCounts[i] = 0;
+    }
+    grid->objects.Clear();
+    grid->freeObjects.Clear();
+    grid->chunks.Clear();
+    grid->freeChunks.Clear();
+    grid->largeObjects = HANDLE_INVALID;
+    grid->count = 0;
+}
+
+math::AABB GetBounds(const HashGrid& grid, handle object)
+{
+    const Object& o = grid.objects[object];
+    ASSERT(o.location != HANDLE_INVALID);
+    const Chunk& chunk = grid.chunks.data[o.location / TY_SPATIAL_CHUNK_SIZE];
+    u32 slot = o.location % TY_SPATIAL_CHUNK_SIZE;
+    return { {chunk.minX[slot], chunk.minY[slot], chunk.minZ[slot]}, {chunk.maxX[slot], chunk.maxY[slot], chunk.maxZ[slot]} };
+}
+
+// ========================================================
+// [BATCH]
+// Objects that stay in their cell get their new bounds written in parallel, each task
+// owning whole words of the move mask. Relocating the others touches shared chunk lists, so
+// it runs afterwards on the calling thread.
+
+struct MoveTask
+{
+    HashGrid* grid = NULL;
+    const handle* objects = NULL;
+    const f32* x = NULL;
+    const f32* y = NULL;
+    const f32* z = NULL;
+};
+
+inline math::AABB GetMoveBounds(const MoveTask& task, const Object& o, u64 i, v3f* center)
+{
+    *center = { task.x[i], task.y[i], task.z[i] };
+    return { *center - o.halfSize, *center + o.halfSize };
+}
+
+void MoveRange(const MoveTask& task, u64 start, u64 end)
+{
+    HashGrid* grid = task.grid;
+    for(u64 base = start; base < end; base += 64)
+    {
+        u64 wordEnd = MIN(base + 64, end);
+        u64 bits = 0;
+        for(u64 i = base; i < wordEnd; i++)
+        {
+            const Object& o = grid->objects.data[task.objects[i]];
+            ASSERT(o.location != HANDLE_INVALID);
+            v3f center;
+            math::AABB bounds = GetMoveBounds(task, o, i, &center);
+            if(GetKey(*grid, center, GetKeyLevel(o.key)) == o.key)
+            {
+                WriteBounds(&grid->chunks.data[o.location / TY_SPATIAL_CHUNK_SIZE], o.location % TY_SPATIAL_CHUNK_SIZE, bounds);
+            }
+            else
+            {
+                bits |= 1ULL << (i - base);
+            }
+        }
+        grid->moveMask.data[base / 64] = bits;
+    }
+}
+
+void MoveTaskProc(void* data, u64 start, u64 end, u32 threadIndex)
+{
+    MoveRange(*(MoveTask*)data, start, end);
+}
+
+void MoveBatch(HashGrid* grid, const handle* objects, const f32* x, const f32* y, const f32* z, u64 count, bool parallel)
+{
+    ASSERT(count <= grid->objects.count);
+    MoveTask task = {};
+    task.grid = grid;
+    task.objects = objects;
+    task.x = x;
+    task.y = y;
+    task.z = z;
+    if(parallel)
+    {
+        async::ParallelFor(count, TY_SPATIAL_PARALLEL_BATCH, MoveTaskProc, &task);
+    }
+    else
+    {
+        MoveRange(task, 0, count);
+    }
+
+    for(u64 word = 0; word < (count + 63) / 64; word++)
+    {
+        u64 bits = grid->moveMask.data[word];
+        while(bits)
+        {
+            u64 i = word * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            Object& o = grid->objects.data[objects[i]];
+            v3f center;
+            math::AABB bounds = GetMoveBounds(task, o, i, &center);
+            u64 key = GetKey(*grid, center, GetKeyLevel(o.key));
+            RemoveFromCell(grid, objects[i]);
+            AddToCell(grid, objects[i], key, bounds);
+        }
+    }
+}
+
+// ========================================================
+// [QUERIES]
+// Per level, the cells whose loose bounds (half a cell larger on each side) overlap the
+// query range are visited. Only the entries keyed with the visited cell are taken from its
+// bucket, so cells sharing a bucket don't report objects twice. Levels whose range covers
+// more cells than there are buckets are handled together in one pass over every bucket.
+
+struct QueryResults
+{
+    u32* data = NULL;
+    u64 capacity = 0;
+    u64 count = 0;
+
+    void Add(u32 object)
+    {
+        if(count < capacity) data[count] = object;
+        count++;
+    }
+};
+
+struct AABBTest
+{
+    simd::f32x4 minX, minY, minZ;
+    simd::f32x4 maxX, maxY, maxZ;
+
+    AABBTest(const math::AABB& aabb)
+    {
+        minX = simd::Set1(aabb.min.x);
+        minY = simd::Set1(aabb.min.y);
+        minZ = simd::Set1(aabb.min.z);
+        maxX = simd::Set1(aabb.max.x);
+        maxY = simd::Set1(aabb.max.y);
+        maxZ = simd::Set1(aabb.max.z);
+    }
+
+    u32 Test(const Chunk& chunk) const
+    {
+        simd::f32x4 x = simd::And(simd::CmpLE(simd::Load(chunk.minX), maxX), simd::CmpGE(simd::Load(chunk.maxX), minX));
+        simd::f32x4 y = simd::And(simd::CmpLE(simd::Load(chunk.minY), maxY), simd::CmpGE(simd::Load(chunk.maxY), minY));
+        simd::f32x4 z = simd::And(simd::CmpLE(simd::Load(chunk.minZ), maxZ), simd::CmpGE(simd::Load(chunk.maxZ), minZ));
+        return simd::MoveMask(simd::And(simd::And(x, y), z));
+    }
+};
+
+struct SphereTest
+{
+    simd::f32x4 x, y, z;
+    simd::f32x4 radiusSq;
+
+    SphereTest(v3f center, f32 radius)
+    {
+        x = simd::Set1(center.x);
+        y = simd::Set1(center.y);
+        z = simd::Set1(center.z);
+        radiusSq = simd::Set1(radius * radius);
+    }
+
+    // Distance from the center to the closest point of each box.
+    u32 Test(const Chunk& chunk) const
+    {
+        simd::f32x4 dx = simd::Sub(x, simd::Min(simd::Max(x, simd::Load(chunk.minX)), simd::Load(chunk.maxX)));
+        simd::f32x4 dy = simd::Sub(y, simd::Min(simd::Max(y, simd::Load(chunk.minY)), simd::Load(chunk.maxY)));
+        simd::f32x4 dz = simd::Sub(z, simd::Min(simd::Max(z, simd::Load(chunk.minZ)), simd::Load(chunk.maxZ)));
+        simd::f32x4 distSq = simd::MulAdd(dz, dz, simd::MulAdd(dy, dy, simd::Mul(dx, dx)));
+        return simd::MoveMask(simd::CmpLE(distSq, radiusSq));
+    }
+};
+
+inline u32 GetSlotMask(const Chunk& chunk)
+{
+    return (1u << chunk.count) - 1;
+}
+
+template <typename T>
+u64 Query(const HashGrid& grid, const math::AABB& range, const T& test, u32* result, u64 capacity)
+{
+    QueryResults results = { result, capacity, 0 };
+    const Chunk* chunks = grid.chunks.data;
+    u32 bucketMask = (u32)grid.buckets.count - 1;
+    i32 scanLo[TY_SPATIAL_MAX_LEVELS][3];
+    i32 scanHi[TY_SPATIAL_MAX_LEVELS][3];
+    u32 scanLevels = 0;
+
+    for(u32 level = 0; level < grid.levelCount; level++)
+    {
+        if(!grid.levelObjectCounts[level]) continue;
+        f32 inv = grid.invCellSizes[level];
+        i32 lo[3] = { CellCoord(range.min.x * inv - 0.5f), CellCoord(range.min.y * inv - 0.5f), CellCoord(range.min.z * inv - 0.5f) };
+        i32 hi[3] = { CellCoord(range.max.x * inv + 0.5f), CellCoord(range.max.y * inv + 0.5f), CellCoord(range.max.z * inv + 0.5f) };
+        f64 cellCount = ((f64)hi[0] - lo[0] + 1) * ((f64)hi[1] - lo[1] + 1) * ((f64)hi[2] - lo[2] + 1);
+        if(cellCount > (f64)grid.buckets.count)
+        {
+            scanLevels |= 1 << level;
+            memcpy(scanLo[level], lo, sizeof(lo));
+            memcpy(scanHi[level], hi, sizeof(hi));
+            continue;
+        }
+
+        for(i32 x = lo[0]; x <= hi[0]; x++)
+        {
+            for(i32 y = lo[1]; y <= hi[1]; y++)
+            {
+                for(i32 z = lo[2]; z <= hi[2]; z++)
+                {
+                    u64 key = PackCell(x, y, z, level);
+                    for(u32 c = grid.buckets.data[HashKey(key) & bucketMask]; c != HANDLE_INVALID; c = chunks[c].next)
+                    {
+                        const Chunk& chunk = chunks[c];
+                        u32 hits = test.Test(chunk) & GetSlotMask(chunk);
+                        while(hits)
+                        {
+                            u32 slot = __builtin_ctz(hits);
+                            hits &= hits - 1;
+                            if(chunk.keys[slot] == key) results.Add(chunk.objects[slot]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if(scanLevels)
+    {
+        for(u64 bucket = 0; bucket < grid.buckets.count; bucket++)
+        {
+            for(u32 c = grid.buckets.data[bucket]; c != HANDLE_INVALID; c = chunks[c].next)
+            {
+                const Chunk& chunk = chunks[c];
+                u32 hits = test.Test(chunk) & GetSlotMask(chunk);
+                while(hits)
+                {
+                    u32 slot = __builtin_ctz(hits);
+                    hits &= hits - 1;
+                    u64 key = chunk.keys[slot];
+                    u32 level = GetKeyLevel(key);
+                    if(!(scanLevels & (1 << level))) continue;
+                    bool inside = true;
+                    for(u32 axis = 0; axis < 3; axis++)
+                    {
+                        inside &= WITHIN(scanLo[level][axis], GetKeyCoord(key, axis), scanHi[level][axis]);
+                    }
+                    if(inside) results.Add(chunk.objects[slot]);
+                }
+            }
+        }
+    }
+
+    for(u32 c = grid.largeObjects; c != HANDLE_INVALID; c = chunks[c].next)
+    {
+        const Chunk& chunk = chunks[c];
+        u32 hits = test.Test(chunk) & GetSlotMask(chunk);
+        while(hits)
+        {
+            results.Add(chunk.objects[__builtin_ctz(hits)]);
+            hits &= hits - 1;
+        }
+    }
+    return results.count;
+}
+
+u64 QueryAABB(const HashGrid& grid, math::AABB aabb, u32* result, u64 capacity)
+{
+    return Query(grid, aabb, AABBTest(aabb), result, capacity);
+}
+
+u64 QueryRadius(const HashGrid& grid, v3f center, f32 radius, u32* result, u64 capacity)
+{
+    v3f extent = { radius, radius, radius };
+    return Query(grid, { center - extent, center + extent }, SphereTest(center, radius), result, capacity);
+}
+
+};
+};
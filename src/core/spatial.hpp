@@ -0,0 +1,102 @@
+// ========================================================
+// SPATIAL
+// Multi-level hash grid for objects that move every frame, where rebuilding or refitting a
+// BVH (core/bvh) costs more than it saves.
+// Each level is a loose grid with cells twice the size of the level below. An object goes
+// to the first level whose cells are at least as large as its bounds, in the cell holding
+// its center; its bounds may reach half a cell outside, so queries look one half cell
+// further. Cells are hashed into one fixed bucket array (Teschner et al., "Optimized
+// Spatial Hashing for Collision Detection of Deformable Objects", 2003), so inserting,
+// moving and removing are O(1) and empty cells cost nothing.
+// A bucket keeps its objects in chunks of 4 with bounds as one array per component, tested
+// at once with core/simd. Objects larger than the top level are kept in their own chunks,
+// tested by every query.
+// Batch moves compute new cells in parallel and relocate only the objects that changed cell.
+// Queries only read the grid and may run on several threads at once.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./debug.hpp"
+#include "./memory.hpp"
+#include "./simd.hpp"
+#include "./math.hpp"
+#include "./async.hpp"
+#include "./ds.hpp"
+
+namespace ty
+{
+namespace spatial
+{
+
+#define TY_SPATIAL_MAX_LEVELS 15            // Levels and the large object list fit the 4 level bits of a cell key.
+#define TY_SPATIAL_CHUNK_SIZE 4
+#define TY_SPATIAL_PARALLEL_BATCH 4096      // Objects per parallel task. Multiple of 64, so mask words aren't shared.
+
+struct Chunk
+{
+    f32 minX[TY_SPATIAL_CHUNK_SIZE];
+    f32 minY[TY_SPATIAL_CHUNK_SIZE];
+    f32 minZ[TY_SPATIAL_CHUNK_SIZE];
+    f32 maxX[TY_SPATIAL_CHUNK_SIZE];
+    f32 maxY[TY_SPATIAL_CHUNK_SIZE];
+    f32 maxZ[TY_SPATIAL_CHUNK_SIZE];
+    u64 keys[TY_SPATIAL_CHUNK_SIZE];        // Cell of each object, several cells can share a bucket.
+    u32 objects[TY_SPATIAL_CHUNK_SIZE];
+    u32 count = 0;
+    u32 next = HANDLE_INVALID;              // Only the first chunk of a list can be partially filled.
+};
+
+struct Object
+{
+    u64 key = 0;                            // Packed level and cell coordinates.
+    v3f halfSize = {};
+    u32 location = HANDLE_INVALID;          // Chunk * TY_SPATIAL_CHUNK_SIZE + slot, HANDLE_INVALID once removed.
+};
+
+struct GridDesc
+{
+    f32 cellSize = 1;           // Level 0, around the size of the smallest objects and of common query radii.
+    u32 levelCount = 8;         // At most TY_SPATIAL_MAX_LEVELS.
+    u32 bucketCount = 0;        // Rounded up to a power of 2, 0 uses the capacity.
+};
+
+struct HashGrid
+{
+    u32 levelCount = 0;
+    f32 cellSizes[TY_SPATIAL_MAX_LEVELS];
+    f32 invCellSizes[TY_SPATIAL_MAX_LEVELS];
+    u32 levelObjectCounts[TY_SPATIAL_MAX_LEVELS + 1];  // Queries skip empty levels. Last one counts large objects.
+
+    SArray<Object> objects;     // Indexed by handle.
+    SArray<u32> freeObjects;
+    SArray<Chunk> chunks;
+    SArray<u32> freeChunks;
+    SArray<u32> buckets;        // First chunk of each bucket.
+    SArray<u64> moveMask;       // Scratch for MoveBatch, a bit per object that changed cell.
+    u32 largeObjects = HANDLE_INVALID;
+    u32 count = 0;
+};
+
+HashGrid MakeHashGrid(mem::Arena* arena, u32 capacity, GridDesc desc = {});
+
+handle Insert(HashGrid* grid, math::AABB bounds);
+handle Insert(HashGrid* grid, v3f position);
+void Update(HashGrid* grid, handle object, math::AABB bounds);
+void Remove(HashGrid* grid, handle object);
+void Clear(HashGrid* grid);
+math::AABB GetBounds(const HashGrid& grid, handle object);
+
+// New centers for objects, their sizes are kept. Each object at most once per batch.
+void MoveBatch(HashGrid* grid, const handle* objects, const f32* x, const f32* y, const f32* z, u64 count, bool parallel = false);
+
+// ========================================================
+// [QUERIES]
+// Write up to capacity handles to result and return how many matched, which can be more
+// than capacity. Objects are tested against their exact bounds, in no particular order.
+u64 QueryAABB(const HashGrid& grid, math::AABB aabb, u32* result, u64 capacity);
+u64 QueryRadius(const HashGrid& grid, v3f center, f32 radius, u32* result, u64 capacity);
+
+};
+};
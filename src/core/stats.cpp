@@ -0,0 +1,382 @@
+#include "./stats.hpp"
+
+namespace ty
+{
+namespace stats
+{
+
+// ========================================================
+// [HISTOGRAM]
+// Values are split into buckets covering power of 2 ranges, each divided linearly into
+// sub-buckets. The first bucket spans [0, subBucketCount), every following bucket doubles
+// the range and the sub-bucket width, and only stores its upper half (the lower half
+// overlaps the previous bucket).
+
+void InitHistogramLayout(Histogram* histogram, HistogramDesc desc)
+{
+    ASSERT(desc.lowestValue >= 1);
+    ASSERT(desc.significantDigits >= 1 && desc.significantDigits <= 5);
+    ASSERT(desc.highestValue >= 2 * desc.lowestValue);
+
+    u64 largestSingleUnitResolution = 2;
+    for(u32 i = 0; i < desc.significantDigits; i++)
+    {
+        largestSingleUnitResolution *= 10;
+    }
+    u32 subBucketCountMagnitude = 64 - __builtin_clzll(largestSingleUnitResolution - 1);     // ceil(log2)
+
+    histogram->desc = desc;
+    histogram->subBucketHalfCountMagnitude = MAX(subBucketCountMagnitude, 1) - 1;
+    histogram->unitMagnitude = 63 - __builtin_clzll(desc.lowestValue);
+    histogram->subBucketCount = 1 << (histogram->subBucketHalfCountMagnitude + 1);
+    histogram->subBucketHalfCount = histogram->subBucketCount / 2;
+    histogram->subBucketMask = (u64)(histogram->subBucketCount - 1) << histogram->unitMagnitude;
+
+    u64 smallestUntrackable = (u64)histogram->subBucketCount << histogram->unitMagnitude;
+    u32 bucketCount = 1;
+    while(smallestUntrackable <= desc.highestValue)
+    {
+        bucketCount++;
+        if(smallestUntrackable > MAX_U64 / 2) break;
+        smallestUntrackable <<= 1;
+    }
+    histogram->bucketCount = bucketCount;
+    histogram->countsLen = (bucketCount + 1) * histogram->subBucketHalfCount;
+}
+
+u64 GetHistogramMemorySize(HistogramDesc desc)
+{
+    Histogram layout = {};
+    InitHistogramLayout(&layout, desc);
+    return layout.countsLen * sizeof(u64);
+}
+
+Histogram MakeHistogram(mem::Arena* arena, HistogramDesc desc)
+{
+    Histogram result = {};
+    InitHistogramLayout(&result, desc);
+    result.counts = (u64*)mem::ArenaPushZero(arena, result.countsLen * sizeof(u64), sizeof(u64));
+    return result;
+}
+
+u32 GetCountsIndex(const Histogram* histogram, u64 value)
+{
+    u32 pow2Ceiling = 64 - __builtin_clzll(value | histogram->subBucketMask);
+    u32 bucketIndex = pow2Ceiling - histogram->unitMagnitude - (histogram->subBucketHalfCountMagnitude + 1);
+    u32 subBucketIndex = (u32)(value >> (bucketIndex + histogram->unitMagnitude));
+    return ((bucketIndex + 1) << histogram->subBucketHalfCountMagnitude) + (subBucketIndex - histogram->subBucketHalfCount);
+}
+
+// Highest value that maps to the same counts index.
+u64 GetValueFromIndex(const Histogram* histogram, u32 index)
+{
+    i32 bucketIndex = (i32)(index >> histogram->subBucketHalfCountMagnitude) - 1;
+    u32 subBucketIndex = (index & (histogram->subBucketHalfCount - 1)) + histogram->subBucketHalfCount;
+    if(bucketIndex < 0)
+    {
+        subBucketIndex -= histogram->subBucketHalfCount;
+        bucketIndex = 0;
+    }
+    u32 shift = bucketIndex + histogram->unitMagnitude;
+    return ((u64)subBucketIndex << shift) + ((1ULL << shift) - 1);
+}
+
+void Record(Histogram* histogram, u64 value, u64 count)
+{
+    ASSERT(histogram && histogram->counts);
+    value = MIN(value, histogram->desc.highestValue);
+    histogram->counts[GetCountsIndex(histogram, value)] += count;
+    histogram->totalCount += count;
+    histogram->minValue = MIN(histogram->minValue, value);
+    histogram->maxValue = MAX(histogram->maxValue, value);
+    histogram->sum += (f64)value * (f64)count;
+}
+
+void Reset(Histogram* histogram)
+{
+    ASSERT(histogram && histogram->counts);
+    memset(histogram->counts, 0, histogram->countsLen * sizeof(u64));
+    histogram->totalCount = 0;
+    histogram->minValue = MAX_U64;
+    histogram->maxValue = 0;
+    histogram->sum = 0;
+}
+
+void Add(Histogram* dst, const Histogram* src)
+{
+    ASSERT(dst && src);
+    ASSERT(dst->countsLen == src->countsLen && dst->unitMagnitude == src->unitMagnitude);
+    if(src->totalCount == 0) return;
+    for(u32 i = 0; i < src->countsLen; i++)
+    {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->totalCount += src->totalCount;
+    dst->minValue = MIN(dst->minValue, src->minValue);
+    dst->maxValue = MAX(dst->maxValue, src->maxValue);
+    dst->sum += src->sum;
+}
+
+u64 GetPercentile(const Histogram* histogram, f64 percentile)
+{
+    ASSERT(histogram);
+    if(histogram->totalCount == 0) return 0;
+    percentile = CLAMP(percentile, 0.0, 100.0);
+    u64 target = (u64)(percentile / 100.0 * (f64)histogram->totalCount + 0.5);
+    target = CLAMP(target, 1, histogram->totalCount);
+
+    u64 cumulative = 0;
+    for(u32 i = 0; i < histogram->countsLen; i++)
+    {
+        cumulative += histogram->counts[i];
+        if(cumulative >= target)
+        {
+            u64 value = GetValueFromIndex(histogram, i);
+            return CLAMP(value, histogram->minValue, histogram->maxValue);
+        }
+    }
+    return histogram->maxValue;
+}
+
+f64 GetMean(const Histogram* histogram)
+{
+    ASSERT(histogram);
+    if(histogram->totalCount == 0) return 0;
+    return histogram->sum / (f64)histogram->totalCount;
+}
+
+u64 GetMin(const Histogram* histogram)
+{
+    ASSERT(histogram);
+    return histogram->totalCount ? histogram->minValue : 0;
+}
+
+u64 GetMax(const Histogram* histogram)
+{
+    ASSERT(histogram);
+    return histogram->maxValue;
+}
+
+// ========================================================
+// [ROLLING WINDOW]
+
+RollingHistogram MakeRollingHistogram(mem::Arena* arena, RollingDesc desc)
+{
+    ASSERT(desc.intervalCount > 0 && desc.intervalMs > 0);
+    RollingHistogram result = {};
+    result.desc = desc;
+    result.intervals = (Histogram*)mem::ArenaPush(arena, desc.intervalCount * sizeof(Histogram));
+    for(u32 i = 0; i < desc.intervalCount; i++)
+    {
+        result.intervals[i] = MakeHistogram(arena, desc.histogram);
+    }
+    result.merged = MakeHistogram(arena, desc.histogram);
+    result.intervalTicks = MAX(1, time::GetTimestampFrequency() * desc.intervalMs / 1000);
+    return result;
+}
+
+bool AdvanceRolling(RollingHistogram* rolling, u64 timestamp)
+{
+    ASSERT(rolling);
+    if(rolling->intervalStart == 0 || timestamp < rolling->intervalStart)
+    {
+        rolling->intervalStart = timestamp;
+        return false;
+    }
+    u64 elapsed = (timestamp - rolling->intervalStart) / rolling->intervalTicks;
+    if(elapsed == 0) return false;
+
+    // Intervals skipped entirely (no values recorded during them) are cleared too.
+    u64 steps = MIN(elapsed, (u64)rolling->desc.intervalCount);
+    for(u64 i = 0; i < steps; i++)
+    {
+        rolling->current = (rolling->current + 1) % rolling->desc.intervalCount;
+        Reset(&rolling->intervals[rolling->current]);
+    }
+    rolling->intervalStart += elapsed * rolling->intervalTicks;
+    rolling->mergedDirty = true;
+    return true;
+}
+
+void Record(RollingHistogram* rolling, u64 value, u64 timestamp)
+{
+    AdvanceRolling(rolling, timestamp);
+    Record(&rolling->intervals[rolling->current], value);
+    rolling->mergedDirty = true;
+}
+
+void Reset(RollingHistogram* rolling)
+{
+    ASSERT(rolling);
+    for(u32 i = 0; i < rolling->desc.intervalCount; i++)
+    {
+        Reset(&rolling->intervals[i]);
+    }
+    Reset(&rolling->merged);
+    rolling->current = 0;
+    rolling->intervalStart = 0;
+    rolling->mergedDirty = false;
+}
+
+const Histogram* GetMerged(RollingHistogram* rolling)
+{
+    ASSERT(rolling);
+    if(rolling->mergedDirty)
+    {
+        Reset(&rolling->merged);
+        for(u32 i = 0; i < rolling->desc.intervalCount; i++)
+        {
+            Add(&rolling->merged, &rolling->intervals[i]);
+        }
+        rolling->mergedDirty = false;
+    }
+    return &rolling->merged;
+}
+
+// ========================================================
+// [FRAME STATS]
+
+FrameStats MakeFrameStats(mem::Arena* arena, FrameStatsDesc desc)
+{
+    ASSERT(desc.maxHitches > 0);
+    FrameStats result = {};
+    result.desc = desc;
+    result.frameTimeTotal = MakeHistogram(arena, desc.rolling.histogram);
+    result.cpuTimeTotal = MakeHistogram(arena, desc.rolling.histogram);
+    result.frameTime = MakeRollingHistogram(arena, desc.rolling);
+    result.cpuTime = MakeRollingHistogram(arena, desc.rolling);
+    result.hitches = (Hitch*)mem::ArenaPushZero(arena, desc.maxHitches * sizeof(Hitch));
+    return result;
+}
+
+void RecordFrame(FrameStats* stats, u64 frameStart, u64 present)
+{
+    ASSERT(stats);
+    ASSERT(present >= frameStart);
+    u64 frequency = time::GetTimestampFrequency();
+
+    u64 cpuUs = time::TicksToUSec(present - frameStart, frequency);
+    Record(&stats->cpuTimeTotal, cpuUs);
+    Record(&stats->cpuTime, cpuUs, present);
+
+    // First frame has no previous present to measure frame time against.
+    if(stats->lastPresent != 0 && present > stats->lastPresent)
+    {
+        u64 frameUs = time::TicksToUSec(present - stats->lastPresent, frequency);
+        if(AdvanceRolling(&stats->frameTime, present))
+        {
+            stats->medianUs = GetPercentile(GetMerged(&stats->frameTime), 50);
+        }
+        Record(&stats->frameTimeTotal, frameUs);
+        Record(&stats->frameTime, frameUs, present);
+
+        if(stats->medianUs
+                && frameUs >= stats->desc.hitchMinUs
+                && (f64)frameUs > stats->desc.hitchFactor * (f64)stats->medianUs)
+        {
+            Hitch& hitch = stats->hitches[stats->hitchCount % stats->desc.maxHitches];
+            hitch.frameIndex = stats->frameIndex;
+            hitch.frameUs = frameUs;
+            hitch.medianUs = stats->medianUs;
+            stats->hitchCount++;
+        }
+    }
+    stats->lastPresent = present;
+    stats->frameIndex++;
+}
+
+void ResetFrameStats(FrameStats* stats)
+{
+    ASSERT(stats);
+    Reset(&stats->frameTimeTotal);
+    Reset(&stats->cpuTimeTotal);
+    Reset(&stats->frameTime);
+    Reset(&stats->cpuTime);
+    stats->frameIndex = 0;
+    stats->lastPresent = 0;
+    stats->medianUs = 0;
+    stats->hitchCount = 0;
+}
+
+u64 GetHitches(FrameStats* stats, Hitch* out, u64 maxCount)
+{
+    ASSERT(stats && out);
+    u64 count = MIN(stats->hitchCount, (u64)stats->desc.maxHitches);
+    count = MIN(count, maxCount);
+    for(u64 i = 0; i < count; i++)
+    {
+        out[i] = stats->hitches[(stats->hitchCount - 1 - i) % stats->desc.maxHitches];
+    }
+    return count;
+}
+
+// ========================================================
+// [JSON]
+
+struct JsonWriter
+{
+    char* data = NULL;
+    u64 len = 0;
+    u64 capacity = 0;
+};
+
+void JsonAppend(JsonWriter* writer, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    i32 written = vsnprintf(writer->data + writer->len, writer->capacity - writer->len, fmt, args);
+    va_end(args);
+    ASSERT(written >= 0 && writer->len + written < writer->capacity);
+    writer->len += written;
+}
+
+#define TY_STATS_JSON_HISTOGRAM_SIZE 512
+#define TY_STATS_JSON_HITCH_SIZE 96
+
+void AppendHistogram(JsonWriter* writer, const Histogram* histogram)
+{
+    JsonAppend(writer, "{\"count\":%llu,\"min\":%llu,\"max\":%llu,\"mean\":%.3f,"
+            "\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p99.9\":%llu,\"p99.99\":%llu}",
+            histogram->totalCount, GetMin(histogram), GetMax(histogram), GetMean(histogram),
+            GetPercentile(histogram, 50), GetPercentile(histogram, 90), GetPercentile(histogram, 99),
+            GetPercentile(histogram, 99.9), GetPercentile(histogram, 99.99));
+}
+
+String HistogramToJson(mem::Arena* arena, const Histogram* histogram)
+{
+    JsonWriter writer = {};
+    writer.capacity = TY_STATS_JSON_HISTOGRAM_SIZE;
+    writer.data = (char*)mem::ArenaPush(arena, writer.capacity);
+    AppendHistogram(&writer, histogram);
+    return Str((byte*)writer.data, writer.len);
+}
+
+String FrameStatsToJson(mem::Arena* arena, FrameStats* stats)
+{
+    ASSERT(stats);
+    u64 hitchCount = MIN(stats->hitchCount, (u64)stats->desc.maxHitches);
+    JsonWriter writer = {};
+    writer.capacity = 4 * TY_STATS_JSON_HISTOGRAM_SIZE + hitchCount * TY_STATS_JSON_HITCH_SIZE + 512;
+    writer.data = (char*)mem::ArenaPush(arena, writer.capacity);
+
+    JsonAppend(&writer, "{\"unit\":\"us\",\"frames\":%llu,\"frameTime\":{\"total\":", stats->frameIndex);
+    AppendHistogram(&writer, &stats->frameTimeTotal);
+    JsonAppend(&writer, ",\"window\":");
+    AppendHistogram(&writer, GetMerged(&stats->frameTime));
+    JsonAppend(&writer, "},\"cpuTime\":{\"total\":");
+    AppendHistogram(&writer, &stats->cpuTimeTotal);
+    JsonAppend(&writer, ",\"window\":");
+    AppendHistogram(&writer, GetMerged(&stats->cpuTime));
+    JsonAppend(&writer, "},\"hitchCount\":%llu,\"hitches\":[", stats->hitchCount);
+    for(u64 i = 0; i < hitchCount; i++)
+    {
+        Hitch& hitch = stats->hitches[(stats->hitchCount - 1 - i) % stats->desc.maxHitches];
+        JsonAppend(&writer, "%s{\"frame\":%llu,\"us\":%llu,\"medianUs\":%llu}",
+                i ? "," : "", hitch.frameIndex, hitch.frameUs, hitch.medianUs);
+    }
+    JsonAppend(&writer, "]}");
+    return Str((byte*)writer.data, writer.len);
+}
+
+};
+};
@@ -0,0 +1,139 @@
+// ========================================================
+// STATS
+// Latency statistics. Histograms are HDR (high dynamic range) histograms: constant memory,
+// values bucketed with a fixed number of significant digits over the whole trackable range,
+// so percentiles stay accurate for both typical values and rare outliers.
+// Frame stats track frame times over a rolling window and detect hitches.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./debug.hpp"
+#include "./memory.hpp"
+#include "./string.hpp"
+#include "./time.hpp"
+#include "./ds.hpp"
+
+namespace ty
+{
+namespace stats
+{
+
+// ========================================================
+// [HISTOGRAM]
+// Recorded values are unitless. Values above highestValue are clamped to it.
+struct HistogramDesc
+{
+    u64 lowestValue = 1;                // Smallest value told apart from 0, rounded down to a power of 2.
+    u64 highestValue = 10000000;        // 10s in microseconds
+    u32 significantDigits = 3;          // [1, 5], relative precision of 10^-digits.
+};
+
+struct Histogram
+{
+    HistogramDesc desc;
+    u32 unitMagnitude = 0;
+    u32 subBucketHalfCountMagnitude = 0;
+    u32 subBucketCount = 0;
+    u32 subBucketHalfCount = 0;
+    u64 subBucketMask = 0;
+    u32 bucketCount = 0;
+
+    u64* counts = NULL;
+    u32 countsLen = 0;
+    u64 totalCount = 0;
+    u64 minValue = MAX_U64;
+    u64 maxValue = 0;
+    f64 sum = 0;
+};
+
+Histogram MakeHistogram(mem::Arena* arena, HistogramDesc desc = {});
+u64 GetHistogramMemorySize(HistogramDesc desc);
+
+void Record(Histogram* histogram, u64 value, u64 count = 1);
+void Reset(Histogram* histogram);
+void Add(Histogram* dst, const Histogram* src);     // Both must have the same desc.
+
+u64 GetPercentile(const Histogram* histogram, f64 percentile);     // percentile in [0, 100]
+f64 GetMean(const Histogram* histogram);
+u64 GetMin(const Histogram* histogram);
+u64 GetMax(const Histogram* histogram);
+
+// ========================================================
+// [ROLLING WINDOW]
+// Histogram over the last (intervalCount * intervalMs). Values go into the current interval,
+// and the oldest interval is discarded as time advances. Queries merge all intervals.
+struct RollingDesc
+{
+    HistogramDesc histogram = {};
+    u32 intervalCount = 10;
+    u32 intervalMs = 1000;
+};
+
+struct RollingHistogram
+{
+    RollingDesc desc;
+    Histogram* intervals = NULL;
+    u32 current = 0;
+    u64 intervalStart = 0;              // time::GetTimestamp
+    u64 intervalTicks = 0;
+    Histogram merged;                   // Result of the last merge.
+    bool mergedDirty = true;
+};
+
+RollingHistogram MakeRollingHistogram(mem::Arena* arena, RollingDesc desc = {});
+void Record(RollingHistogram* rolling, u64 value, u64 timestamp);
+void Reset(RollingHistogram* rolling);
+bool AdvanceRolling(RollingHistogram* rolling, u64 timestamp);  // Returns true if an interval was closed.
+const Histogram* GetMerged(RollingHistogram* rolling);          // Merges intervals if anything changed.
+
+// ========================================================
+// [FRAME STATS]
+// Fed with timestamps (time::GetTimestamp) of each frame's start and present.
+// Frame time is present-to-present, CPU time is frame start-to-present. Values are in microseconds.
+// A hitch is a frame longer than hitchFactor times the rolling median (and than hitchMinUs).
+// The median is refreshed every time a rolling interval closes.
+struct FrameStatsDesc
+{
+    RollingDesc rolling = {};
+    f64 hitchFactor = 2.0;
+    u64 hitchMinUs = 4000;
+    u32 maxHitches = 64;                // Most recent hitches kept.
+};
+
+struct Hitch
+{
+    u64 frameIndex = 0;
+    u64 frameUs = 0;
+    u64 medianUs = 0;
+};
+
+struct FrameStats
+{
+    FrameStatsDesc desc;
+    u64 frameIndex = 0;
+    u64 lastPresent = 0;
+
+    Histogram frameTimeTotal;
+    Histogram cpuTimeTotal;
+    RollingHistogram frameTime;
+    RollingHistogram cpuTime;
+    u64 medianUs = 0;
+
+    Hitch* hitches = NULL;              // Ring of the most recent hitches.
+    u64 hitchCount = 0;                 // Total detected, may exceed maxHitches.
+};
+
+FrameStats MakeFrameStats(mem::Arena* arena, FrameStatsDesc desc = {});
+void RecordFrame(FrameStats* stats, u64 frameStart, u64 present);
+void ResetFrameStats(FrameStats* stats);
+u64 GetHitches(FrameStats* stats, Hitch* out, u64 maxCount);    // Most recent first.
+
+// ========================================================
+// [JSON]
+String HistogramToJson(mem::Arena* arena, const Histogram* histogram);
+String FrameStatsToJson(mem::Arena* arena, FrameStats* stats);
+
+};
+};
@@ -220,12 +220,15 @@ String StrFmt(mem::Arena* arena, const char* fmt, ...)
     // NOTE(caio): If using this with String, use String::CStr();
     va_list args;
     va_start(args, fmt);
+    va_list argsCopy;
+    va_copy(argsCopy, args);    // A va_list can't be reused after being consumed by vsnprintf.
 
     i64 len = vsnprintf(0, 0, fmt, args);
     byte* buf = (byte*)mem::ArenaPush(arena, len + 1);
-    vsnprintf((char*)buf, len + 1, fmt, args);
+    vsnprintf((char*)buf, len + 1, fmt, argsCopy);
     buf[len] = 0;   // Null terminator for c-string compatibility
 
+    va_end(argsCopy);
     va_end(args);
     return Str(buf, len);
 }
@@ -1,5 +1,6 @@
 #include "./time.hpp"
 #include "./debug.hpp"
+#include <intrin.h>
 
 namespace ty
 {
@@ -14,6 +15,7 @@ Context MakeTimeContext()
 
     Context result = {};
     result.ticksPerSecond = frequency.QuadPart;
+    InitTimestamps();
     return result;
 }
 
@@ -58,13 +60,119 @@ f64 GetElapsedSec(Timer* timer)
 f64 GetElapsedMSec(Timer* timer)
 {
     ASSERT(timer && timer->frequency != TIMER_INVALID);
-    return (f64)(GetElapsedTicks(timer) * (u64)1e3) / (f64)(timer->frequency);
+    return (f64)(GetElapsedTicks(timer)) * 1e3 / (f64)(timer->frequency);
 }
 
 f64 GetElapsedNSec(Timer* timer)
 {
     ASSERT(timer && timer->frequency != TIMER_INVALID);
-    return (f64)(GetElapsedTicks(timer) * (u64)1e9) / (f64)(timer->frequency);
+    return (f64)(GetElapsedTicks(timer)) * 1e9 / (f64)(timer->frequency);
+}
+
+// a * b / c without overflowing the intermediate product, as long as b * c fits in 64 bits.
+u64 MulDivU64(u64 a, u64 b, u64 c)
+{
+    ASSERT(c);
+    return (a / c) * b + (a % c) * b / c;
+}
+
+u64 TicksToNSec(u64 ticks, u64 frequency)
+{
+    return MulDivU64(ticks, 1000000000ull, frequency);
+}
+
+u64 TicksToUSec(u64 ticks, u64 frequency)
+{
+    return MulDivU64(ticks, 1000000ull, frequency);
+}
+
+// ========================================================
+// [TIMESTAMPS]
+
+#define TY_TIME_CALIBRATION_MS 10
+
+struct TimestampState
+{
+    u64 frequency = 0;
+    bool useTSC = false;
+};
+
+static TimestampState timestampState = {};
+
+u64 ReadPerformanceCounter()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+bool HasInvariantTSC()
+{
+    i32 regs[4] = {};
+    __cpuid(regs, 0x80000000);
+    if((u32)regs[0] < 0x80000007) return false;
+    __cpuid(regs, 0x80000007);
+    return regs[3] & (1 << 8);      // EDX bit 8: invariant TSC
+}
+
+void InitTimestamps()
+{
+    if(timestampState.frequency) return;
+
+    LARGE_INTEGER qpcFrequency;
+    BOOL ret = QueryPerformanceFrequency(&qpcFrequency);
+    ASSERT(ret);
+    if(!HasInvariantTSC())
+    {
+        timestampState.useTSC = false;
+        timestampState.frequency = qpcFrequency.QuadPart;
+        return;
+    }
+
+    // Measure TSC ticks over a short performance counter window. The window is long enough
+    // to put the calibration error well under 0.1%.
+    u64 qpcWindow = MAX(1, qpcFrequency.QuadPart * TY_TIME_CALIBRATION_MS / 1000);
+    u64 qpcStart = ReadPerformanceCounter();
+    u64 tscStart = __rdtsc();
+    u64 qpcEnd = qpcStart;
+    while(qpcEnd - qpcStart < qpcWindow)
+    {
+        qpcEnd = ReadPerformanceCounter();
+    }
+    u64 tscEnd = __rdtsc();
+    u64 tscFrequency = MulDivU64(tscEnd - tscStart, qpcFrequency.QuadPart, qpcEnd - qpcStart);
+    if(tscFrequency == 0)
+    {
+        timestampState.useTSC = false;
+        timestampState.frequency = qpcFrequency.QuadPart;
+        return;
+    }
+    timestampState.useTSC = true;
+    timestampState.frequency = tscFrequency;
+}
+
+u64 GetTimestamp()
+{
+    if(!timestampState.frequency) InitTimestamps();
+    if(timestampState.useTSC) return __rdtsc();
+    return ReadPerformanceCounter();
+}
+
+u64 GetTimestampFrequency()
+{
+    InitTimestamps();
+    return timestampState.frequency;
+}
+
+bool IsTimestampTSC()
+{
+    InitTimestamps();
+    return timestampState.useTSC;
+}
+
+u64 TimestampToNSec(u64 ticks)
+{
+    return TicksToNSec(ticks, GetTimestampFrequency());
 }
 
 };
@@ -40,5 +40,21 @@ f64 GetElapsedSec(Timer* timer);
 f64 GetElapsedMSec(Timer* timer);
 f64 GetElapsedNSec(Timer* timer);
 
+// Integer tick conversions, exact and overflow-safe for any tick count.
+u64 TicksToNSec(u64 ticks, u64 frequency);
+u64 TicksToUSec(u64 ticks, u64 frequency);
+
+// ========================================================
+// [TIMESTAMPS]
+// Cheap monotonic timestamps for instrumenting hot code. Uses the CPU timestamp counter
+// when it is invariant (constant rate across cores and power states), with its frequency
+// calibrated against the performance counter. Falls back to the performance counter.
+// Timestamps are only meaningful as differences.
+void InitTimestamps();              // Calibrates once (~10ms). Called by MakeTimeContext and on first use.
+u64 GetTimestamp();
+u64 GetTimestampFrequency();        // Timestamp ticks per second.
+bool IsTimestampTSC();
+u64 TimestampToNSec(u64 ticks);
+
 };
 };
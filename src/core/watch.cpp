@@ -0,0 +1,210 @@
+#include "./watch.hpp"
+#include "./file.hpp"
+
+namespace ty
+{
+namespace watch
+{
+
+#define TY_WATCH_NOTIFY_FILTER (FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE)
+
+Watcher* MakeWatcher(WatchDesc desc)
+{
+    ASSERT(desc.maxPending > 0);
+    u64 arenaSize = sizeof(Watcher)
+        + desc.maxPending * sizeof(PendingChange)
+        + TY_WATCH_MAX_DIRS * (TY_WATCH_BUFFER_SIZE + MAX_PATH + 16);
+    mem::Arena* arena = mem::MakeArena(arenaSize);
+    Watcher* watcher = (Watcher*)mem::ArenaPush(arena, sizeof(Watcher));
+    *watcher = {};
+    watcher->arena = arena;
+    watcher->desc = desc;
+    watcher->pending = (PendingChange*)mem::ArenaPushZero(arena, desc.maxPending * sizeof(PendingChange));
+    return watcher;
+}
+
+void DestroyWatcher(Watcher* watcher)
+{
+    ASSERT(watcher);
+    for(u32 i = 0; i < watcher->dirCount; i++)
+    {
+        WatchedDir& dir = watcher->dirs[i];
+        CancelIo(dir.hDir);
+        DWORD bytes = 0;
+        GetOverlappedResult(dir.hDir, &dir.overlapped, &bytes, TRUE);
+        CloseHandle(dir.overlapped.hEvent);
+        CloseHandle(dir.hDir);
+    }
+    mem::DestroyArena(watcher->arena);
+}
+
+bool IssueDirRead(WatchedDir* dir)
+{
+    ResetEvent(dir->overlapped.hEvent);
+    BOOL ret = ReadDirectoryChangesW(
+            dir->hDir,
+            dir->buffer,
+            TY_WATCH_BUFFER_SIZE,
+            dir->recursive,
+            TY_WATCH_NOTIFY_FILTER,
+            NULL,
+            &dir->overlapped,
+            NULL);
+    return ret;
+}
+
+bool AddWatchDir(Watcher* watcher, String dirPath, bool recursive)
+{
+    ASSERT(watcher);
+    ASSERT(watcher->dirCount < TY_WATCH_MAX_DIRS);
+    WatchedDir dir = {};
+    dir.recursive = recursive;
+    dir.hDir = CreateFile(
+            dirPath.CStr(),
+            FILE_LIST_DIRECTORY,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            NULL,
+            OPEN_EXISTING,
+            FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+            NULL);
+    if(dir.hDir == INVALID_HANDLE_VALUE) return false;
+    dir.overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    ASSERT(dir.overlapped.hEvent);
+    dir.buffer = (byte*)mem::ArenaPush(watcher->arena, TY_WATCH_BUFFER_SIZE, sizeof(DWORD));
+
+    MEM_ARENA_SCRATCH_START(scratch);
+    String canonical = file::PathCanonical(scratch, dirPath);
+    if(canonical.len && canonical[canonical.len - 1] != '/') canonical = StrConcat(scratch, canonical, "/");
+    dir.path = Str(watcher->arena, canonical);
+    MEM_ARENA_SCRATCH_END(scratch);
+
+    // Read is issued on the final slot, the OVERLAPPED must not move while the read is pending.
+    WatchedDir* slot = &watcher->dirs[watcher->dirCount];
+    *slot = dir;
+    if(!IssueDirRead(slot))
+    {
+        CloseHandle(slot->overlapped.hEvent);
+        CloseHandle(slot->hDir);
+        *slot = {};
+        return false;
+    }
+    watcher->dirCount++;
+    return true;
+}
+
+void UpdatePendingChange(Watcher* watcher, WatchedDir* dir, FILE_NOTIFY_INFORMATION* info, u64 now)
+{
+    // Canonical path: dir path + relative name, lowercase with '/' separators.
+    char path[MAX_PATH];
+    u64 pathLen = dir->path.len;
+    if(pathLen >= MAX_PATH) return;
+    memcpy(path, dir->path.data, pathLen);
+    i32 nameLen = WideCharToMultiByte(CP_UTF8, 0,
+            info->FileName, info->FileNameLength / sizeof(WCHAR),
+            path + pathLen, (i32)(MAX_PATH - 1 - pathLen), NULL, NULL);
+    if(nameLen <= 0) return;
+    for(u64 i = pathLen; i < pathLen + nameLen; i++)
+    {
+        char c = path[i];
+        if(c == '\\') c = '/';
+        else if(c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        path[i] = c;
+    }
+    pathLen += nameLen;
+    path[pathLen] = 0;
+
+    // Files removed (or renamed away) before their changes were reported are dropped.
+    bool removed = info->Action == FILE_ACTION_REMOVED || info->Action == FILE_ACTION_RENAMED_OLD_NAME;
+    for(u32 i = 0; i < watcher->pendingCount; i++)
+    {
+        PendingChange& pending = watcher->pending[i];
+        if(pending.pathLen == pathLen && memcmp(pending.path, path, pathLen) == 0)
+        {
+            if(removed) pending = watcher->pending[--watcher->pendingCount];
+            else pending.lastEventMs = now;
+            return;
+        }
+    }
+    if(removed) return;
+    if(watcher->pendingCount >= watcher->desc.maxPending)
+    {
+        LOGLF("WATCH", "Too many pending changes, dropping %s", path);
+        return;
+    }
+    PendingChange& pending = watcher->pending[watcher->pendingCount++];
+    memcpy(pending.path, path, pathLen + 1);
+    pending.pathLen = pathLen;
+    pending.lastEventMs = now;
+}
+
+SArray<String> PollChanges(Watcher* watcher, mem::Arena* arena)
+{
+    ASSERT(watcher);
+    u64 now = GetTickCount64();
+    for(u32 i = 0; i < watcher->dirCount; i++)
+    {
+        WatchedDir& dir = watcher->dirs[i];
+        if(dir.hDir == INVALID_HANDLE_VALUE) continue;
+        DWORD bytes = 0;
+        if(!GetOverlappedResult(dir.hDir, &dir.overlapped, &bytes, FALSE))
+        {
+            if(GetLastError() != ERROR_IO_INCOMPLETE)
+            {
+                LOGLF("WATCH", "Stopped watching %s (error %u)", dir.path.CStr(), GetLastError());
+                CloseHandle(dir.hDir);
+                dir.hDir = INVALID_HANDLE_VALUE;
+            }
+            continue;
+        }
+
+        if(bytes == 0)
+        {
+            // Buffer overflowed and events were dropped. Nothing to recover except reissuing the read.
+            LOGLF("WATCH", "Change buffer overflow in %s, some changes were missed", dir.path.CStr());
+        }
+        else
+        {
+            byte* cursor = dir.buffer;
+            while(true)
+            {
+                FILE_NOTIFY_INFORMATION* info = (FILE_NOTIFY_INFORMATION*)cursor;
+                UpdatePendingChange(watcher, &dir, info, now);
+                if(info->NextEntryOffset == 0) break;
+                cursor += info->NextEntryOffset;
+            }
+        }
+        if(!IssueDirRead(&dir))
+        {
+            LOGLF("WATCH", "Stopped watching %s", dir.path.CStr());
+            CloseHandle(dir.hDir);
+            dir.hDir = INVALID_HANDLE_VALUE;
+        }
+    }
+
+    // Report changes whose event bursts settled.
+    u32 readyCount = 0;
+    for(u32 i = 0; i < watcher->pendingCount; i++)
+    {
+        if(now - watcher->pending[i].lastEventMs >= watcher->desc.coalesceMs) readyCount++;
+    }
+    SArray<String> result = {};
+    if(readyCount == 0) return result;
+    result = MakeSArray<String>(arena, readyCount);
+    for(u32 i = 0; i < watcher->pendingCount;)
+    {
+        PendingChange& pending = watcher->pending[i];
+        if(now - pending.lastEventMs >= watcher->desc.coalesceMs)
+        {
+            result.Push(Str(arena, Str((byte*)pending.path, pending.pathLen)));
+            pending = watcher->pending[--watcher->pendingCount];
+        }
+        else
+        {
+            i++;
+        }
+    }
+    return result;
+}
+
+};
+};
@@ -0,0 +1,65 @@
+// ========================================================
+// WATCH
+// File system change notifications for hot reloading. Watched directories are polled
+// without blocking (usually once per frame), and bursts of events on the same file
+// (editors often write a file several times per save) are coalesced into one change.
+// @Caio Guedes, 2023
+// ========================================================
+
+#pragma once
+#include "./base.hpp"
+#include "./debug.hpp"
+#include "./memory.hpp"
+#include "./string.hpp"
+#include "./ds.hpp"
+
+namespace ty
+{
+namespace watch
+{
+
+#define TY_WATCH_MAX_DIRS 32
+#define TY_WATCH_BUFFER_SIZE KB(64)
+
+struct WatchDesc
+{
+    u32 coalesceMs = 100;       // A change is reported once no events arrived for it in this window.
+    u32 maxPending = 1024;      // Max distinct files with unreported changes.
+};
+
+struct WatchedDir
+{
+    String path;                // Canonical, ending in '/'.
+    bool recursive = true;
+    HANDLE hDir = INVALID_HANDLE_VALUE;
+    OVERLAPPED overlapped = {};
+    byte* buffer = NULL;
+};
+
+struct PendingChange
+{
+    char path[MAX_PATH];        // Canonical
+    u64 pathLen = 0;
+    u64 lastEventMs = 0;
+};
+
+struct Watcher
+{
+    mem::Arena* arena = NULL;
+    WatchDesc desc = {};
+    WatchedDir dirs[TY_WATCH_MAX_DIRS];
+    u32 dirCount = 0;
+    PendingChange* pending = NULL;
+    u32 pendingCount = 0;
+};
+
+Watcher* MakeWatcher(WatchDesc desc = {});
+void DestroyWatcher(Watcher* watcher);
+bool AddWatchDir(Watcher* watcher, String dirPath, bool recursive = true);
+
+// Returns canonical paths (see file::PathCanonical) of files created, modified or renamed into
+// watched directories since the last poll, once their event bursts settle. Non-blocking.
+SArray<String> PollChanges(Watcher* watcher, mem::Arena* arena);
+
+};
+};
@@ -5,11 +5,28 @@
 #include "./core/debug.hpp"
 #include "./core/memory.hpp"
 #include "./core/string.hpp"
+#include "./core/simd.hpp"
 #include "./core/math.hpp"
+#include "./core/approx.hpp"
+#include "./core/quantize.hpp"
 #include "./core/time.hpp"
+#include "./core/async.hpp"
+#include "./core/cull.hpp"
+#include "./core/occlusion.hpp"
+#include "./core/cluster.hpp"
+#include "./core/shadow.hpp"
+#include "./core/compress.hpp"
 #include "./core/input.hpp"
 #include "./core/file.hpp"
 #include "./core/ds.hpp"
+#include "./core/bvh.hpp"
+#include "./core/raycast.hpp"
+#include "./core/spatial.hpp"
+#include "./core/stats.hpp"
+#include "./core/pack.hpp"
+#include "./core/watch.hpp"
+#include "./core/profile.hpp"
+#include "./core/metrics.hpp"
 #include "./asset/json.hpp"
 #include "./asset/asset.hpp"
 #include "./render/window.hpp"
@@ -22,9 +39,25 @@
 #include "./core/memory.cpp"
 #include "./core/string.cpp"
 #include "./core/math.cpp"
+#include "./core/approx.cpp"
+#include "./core/quantize.cpp"
 #include "./core/time.cpp"
+#include "./core/async.cpp"
+#include "./core/cull.cpp"
+#include "./core/occlusion.cpp"
+#include "./core/cluster.cpp"
+#include "./core/shadow.cpp"
+#include "./core/compress.cpp"
 #include "./core/input.cpp"
 #include "./core/file.cpp"
+#include "./core/bvh.cpp"
+#include "./core/raycast.cpp"
+#include "./core/spatial.cpp"
+#include "./core/stats.cpp"
+#include "./core/pack.cpp"
+#include "./core/watch.cpp"
+#include "./core/profile.cpp"
+#include "./core/metrics.cpp"
 #include "./asset/json.cpp"
 #include "./asset/asset.cpp"
 #include "./asset/gltf.cpp"
@@ -44,6 +44,14 @@ u32 vertexAttributeSizes[] =
     2 * sizeof(f32),
     3 * sizeof(f32),
     4 * sizeof(f32),
+    2 * sizeof(u16),
+    4 * sizeof(u16),
+    2 * sizeof(i8),
+    2 * sizeof(i16),
+    4 * sizeof(i8),
+    4 * sizeof(u8),
+    sizeof(u32),
+    sizeof(u32),
 };
 STATIC_ASSERT(ARR_LEN(vertexAttributeSizes) == VERTEX_ATTR_COUNT);
 VkFormat vertexAttributeFormats[] =
@@ -52,6 +60,14 @@ VkFormat vertexAttributeFormats[] =
     VK_FORMAT_R32G32_SFLOAT,
     VK_FORMAT_R32G32B32_SFLOAT,
     VK_FORMAT_R32G32B32A32_SFLOAT,
+    VK_FORMAT_R16G16_SFLOAT,
+    VK_FORMAT_R16G16B16A16_SFLOAT,
+    VK_FORMAT_R8G8_SNORM,
+    VK_FORMAT_R16G16_SNORM,
+    VK_FORMAT_R8G8B8A8_SNORM,
+    VK_FORMAT_R8G8B8A8_UNORM,
+    VK_FORMAT_A2B10G10R10_SNORM_PACK32,
+    VK_FORMAT_A2B10G10R10_UNORM_PACK32,
 };
 STATIC_ASSERT(ARR_LEN(vertexAttributeFormats) == VERTEX_ATTR_COUNT);
 
@@ -272,6 +288,7 @@ void CopyMemoryToBuffer(Context* ctx, handle hDst, u64 dstOffset, u64 srcSize, v
     ASSERTVK(ret);
     memcpy((void*)((u64)mapping + dstOffset), srcData, srcSize);
     vmaUnmapMemory(ctx->vkAllocator, buffer.vkAllocation);
+    METRIC_ADD("render.buffer_bytes_copied", srcSize);
 }
 
 u32 GetBufferTypeAlignment(Context* ctx, BufferType type)
@@ -437,6 +454,7 @@ void UploadResourceSet(Context* ctx, handle hSet)
     }
 
     vkUpdateDescriptorSets(ctx->vkDevice, resourceSet.resources.count, vkDescriptorSetWrites, 0, NULL);
+    METRIC_ADD("render.descriptor_writes", resourceSet.resources.count);
 
     MEM_ARENA_CHECKPOINT_RESET(ctx->arena, check);
 }
@@ -1531,6 +1549,7 @@ Context* MakeRenderContext(u64 arenaSize, Window* window)
     *ctx = {};
     ctx->arena = arena;
     ctx->window = window;
+    metrics::TrackArena("render.arena_used", arena);
 
     // API context
     MakeRenderContext_CreateAPIInstance(ctx);
@@ -2195,6 +2214,7 @@ void CmdDraw(Context* ctx, handle hCb, i32 vertexCount, i32 instanceCount)
     CommandBuffer& cmd = ctx->commandBuffers[hCb];
 
     vkCmdDraw(cmd.vkHandle, vertexCount, instanceCount, 0, 0);
+    METRIC_ADD("render.draw_calls", 1);
 }
 
 void CmdDrawIndexed(Context* ctx, handle hCb, handle hIB, i32 instanceCount)
@@ -2204,6 +2224,7 @@ void CmdDrawIndexed(Context* ctx, handle hCb, handle hIB, i32 instanceCount)
     ASSERT(ib.type == BUFFER_TYPE_INDEX);
 
     vkCmdDrawIndexed(cmd.vkHandle, ib.count, instanceCount, 0, 0, 0);
+    METRIC_ADD("render.draw_calls", 1);
 }
 
 void CmdDispatch(Context* ctx, handle hCb, u32 x, u32 y, u32 z)
@@ -2216,6 +2237,7 @@ void CmdDispatch(Context* ctx, handle hCb, u32 x, u32 y, u32 z)
 
 void BeginFrame(Context* ctx, u32 frame)
 {
+    ctx->frameStartTimestamp = time::GetTimestamp();
     u32 inFlightFrame = frame % TY_RENDER_CONCURRENT_FRAMES;
     
     VkSemaphore presentSemaphore = ctx->vkPresentSemaphores[inFlightFrame];
@@ -2269,6 +2291,10 @@ void Present(Context* ctx, u32 frame)
     presentInfo.pWaitSemaphores = &renderSemaphore;
     presentInfo.pImageIndices = &(ctx->swapChain.activeImage);
     VkResult ret = vkQueuePresentKHR(ctx->vkCommandQueue, &presentInfo);
+    if(ctx->frameStats)
+    {
+        stats::RecordFrame(ctx->frameStats, ctx->frameStartTimestamp, time::GetTimestamp());
+    }
     if(ret == VK_ERROR_OUT_OF_DATE_KHR || ret == VK_SUBOPTIMAL_KHR || ctx->window->state == WINDOW_RESIZING)
     {
         vkDeviceWaitIdle(ctx->vkDevice);
@@ -11,6 +11,9 @@
 #include "../core/memory.hpp"
 #include "../core/ds.hpp"
 #include "../core/string.hpp"
+#include "../core/time.hpp"
+#include "../core/stats.hpp"
+#include "../core/metrics.hpp"
 #include "./window.hpp"
 #include "vulkan/vulkan_core.h"
 
@@ -74,6 +77,15 @@ enum VertexAttribute
     VERTEX_ATTR_V2F,
     VERTEX_ATTR_V3F,
     VERTEX_ATTR_V4F,
+    // Packed, written with core/quantize.
+    VERTEX_ATTR_V2H,
+    VERTEX_ATTR_V4H,
+    VERTEX_ATTR_V2_SNORM8,              // Octahedral normals.
+    VERTEX_ATTR_V2_SNORM16,             // Octahedral normals and tangents.
+    VERTEX_ATTR_V4_SNORM8,
+    VERTEX_ATTR_V4_UNORM8,              // Colors.
+    VERTEX_ATTR_V4_SNORM_1010102,
+    VERTEX_ATTR_V4_UNORM_1010102,
 
     VERTEX_ATTR_COUNT,
 };
@@ -467,6 +479,10 @@ struct Context
     SArray<ResourceSet> resourceSets;
     SArray<GraphicsPipeline> pipelinesGraphics;
     SArray<ComputePipeline> pipelinesCompute;
+
+    // Frame timing. When frameStats is set, every Present records into it.
+    u64 frameStartTimestamp = 0;
+    stats::FrameStats* frameStats = NULL;
 };
 
 Context* MakeRenderContext(u64 arenaSize, Window* window);
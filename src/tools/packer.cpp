@@ -0,0 +1,117 @@
+// ========================================================
+// PACKER
+// Command line tool for building pack archives from a directory.
+// Usage: packer <input dir> <output pack> [-a <alignment>] [-e <ext>]... [-c]
+// @Caio Guedes, 2023
+// ========================================================
+
+// ===============================================================
+// [HEADER FILES]
+#include "../core/base.hpp"
+#include "../core/debug.hpp"
+#include "../core/memory.hpp"
+#include "../core/string.hpp"
+#include "../core/simd.hpp"
+#include "../core/math.hpp"
+#include "../core/time.hpp"
+#include "../core/async.hpp"
+#include "../core/compress.hpp"
+#include "../core/file.hpp"
+#include "../core/ds.hpp"
+#include "../core/pack.hpp"
+
+// ===============================================================
+// [SOURCE FILES]
+#include "../core/debug.cpp"
+#include "../core/memory.cpp"
+#include "../core/string.cpp"
+#include "../core/math.cpp"
+#include "../core/time.cpp"
+#include "../core/async.cpp"
+#include "../core/compress.cpp"
+#include "../core/file.cpp"
+#include "../core/pack.cpp"
+
+using namespace ty;
+
+#define PACKER_MAX_EXTENSIONS 64
+
+void PrintUsage()
+{
+    printf("Usage: packer <input dir> <output pack> [-a <alignment>] [-e <ext>]... [-c]\n");
+    printf("  -a <alignment>   Entry data alignment, power of 2 (default 16).\n");
+    printf("  -e <ext>         Only pack files with extension (e.g. -e .png), can repeat.\n");
+    printf("  -c               Compress entries.\n");
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 3)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    String inputDir = argv[1];
+    String outputPath = argv[2];
+    pack::PackBuildDesc desc = {};
+    String extensions[PACKER_MAX_EXTENSIONS];
+    u64 extensionCount = 0;
+    for(i32 i = 3; i < argc; i++)
+    {
+        String arg = argv[i];
+        if(arg == "-a" && i + 1 < argc)
+        {
+            desc.alignment = (u32)atoi(argv[++i]);
+        }
+        else if(arg == "-e" && i + 1 < argc && extensionCount < PACKER_MAX_EXTENSIONS)
+        {
+            extensions[extensionCount++] = argv[++i];
+        }
+        else if(arg == "-c")
+        {
+            desc.compress = true;
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if(desc.alignment == 0 || !IS_POW2(desc.alignment))
+    {
+        printf("Alignment must be a power of 2.\n");
+        return 1;
+    }
+    if(!file::PathExists(inputDir) || !file::PathIsDir(inputDir))
+    {
+        printf("Input directory not found: %s\n", inputDir.CStr());
+        return 1;
+    }
+
+    mem::Arena* arena = mem::MakeArena(MB(256));
+
+    time::Context timeContext = time::MakeTimeContext();
+    time::Timer timer = time::MakeTimer(&timeContext);
+    time::StartTimer(&timer);
+    file::DirWalkOptions options = {};
+    options.extensions = extensions;
+    options.extensionCount = extensionCount;
+    SArray<file::DirEntry> files = file::WalkDir(arena, inputDir, options);
+    u64 totalSize = 0;
+    for(u64 i = 0; i < files.count; i++)
+    {
+        totalSize += files[i].size;
+    }
+
+    bool result = pack::BuildPack(outputPath, inputDir, files, desc);
+    time::EndTimer(&timer);
+    if(!result)
+    {
+        printf("Failed to build pack %s\n", outputPath.CStr());
+        return 1;
+    }
+    printf("Packed %llu files (%llu bytes) into %s in %.3f s.\n",
+            files.count, totalSize, outputPath.CStr(), time::GetElapsedSec(&timer));
+    return 0;
+}